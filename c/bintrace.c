@@ -0,0 +1,807 @@
+
+
+/*
+  This program and the accompanying materials are
+  made available under the terms of the Eclipse Public License v2.0 which accompanies
+  this distribution, and is available at https://www.eclipse.org/legal/epl-v20.html
+
+  SPDX-License-Identifier: EPL-2.0
+
+  Copyright Contributors to the Zowe Project.
+*/
+
+#ifndef METTLE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <time.h>
+#ifdef __ZOWE_OS_WINDOWS
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sys/time.h>
+#endif
+
+#include "zowetypes.h"
+#include "alloc.h"
+#include "openprims.h"
+#include "xlate.h"
+#include "bintrace.h"
+
+#ifdef __ZOWE_OS_ZOS
+#include "zos.h"
+#endif
+
+/*
+  Dump layout, all integers in the byte order of the tracing host:
+
+    BinaryTraceDumpHeader
+    formatCount entries of   uint32 id, uint32 length, length bytes of format text
+    bufferCount entries of   BinaryTraceDumpBuffer, recordCount BinaryTraceRecords
+
+  The magic is spelled in ASCII code points on every platform so that the decoder can
+  recognize a dump before it knows its charset.
+ */
+
+#define BINARY_TRACE_DUMP_VERSION 1
+#define BINARY_TRACE_BYTE_ORDER   0x01020304
+#define BINARY_TRACE_CHARSET_ASCII  0
+#define BINARY_TRACE_CHARSET_EBCDIC 1
+
+#define BINARY_TRACE_MAX_FORMATS  4096
+#define BINARY_TRACE_MAX_RECORDS  32768        /* record sequences are 16 bits */
+
+static const unsigned char dumpMagic[8] = { 0x5A, 0x57, 0x45, 0x42, 0x54, 0x52, 0x43, 0x31 }; /* ZWEBTRC1 */
+
+typedef struct BinaryTraceDumpHeader_tag{
+  unsigned char magic[8];
+  uint32 byteOrder;
+  uint32 version;
+  uint32 charset;
+  uint32 recordSize;
+  uint32 formatCount;
+  uint32 bufferCount;
+} BinaryTraceDumpHeader;
+
+typedef struct BinaryTraceDumpBuffer_tag{
+  uint64 threadID;
+  uint32 recordCount;
+  uint32 reserved;
+} BinaryTraceDumpBuffer;
+
+typedef struct BinaryTraceBuffer_tag{
+  char eyecatcher[8];                         /* RSBTRBUF */
+  struct BinaryTraceBuffer_tag *next;
+  uint64 threadID;
+  int    owned;                               /* FALSE once the owning thread has ended */
+  unsigned int mask;
+  volatile uint64 written;                    /* records written since the buffer was claimed */
+  BinaryTraceRecord *records;
+} BinaryTraceBuffer;
+
+volatile int binaryTraceActive = FALSE;
+
+static BinaryTraceFormat *volatile formats[BINARY_TRACE_MAX_FORMATS];
+static volatile unsigned int formatCount = 0;
+
+static BinaryTraceBuffer *buffers = NULL;
+static unsigned int recordsPerBuffer = BINARY_TRACE_DEFAULT_RECORDS;
+static int initialized = FALSE;
+static Mutex bufferLock;
+#ifdef __ZOWE_OS_WINDOWS
+static DWORD bufferKey;
+#else
+static pthread_key_t bufferKey;
+#endif
+
+static int traceCompareAndSwap(volatile unsigned int *target, unsigned int expected, unsigned int replacement){
+#ifdef __ZOWE_OS_ZOS
+  return cs((cs_t *)&expected, (cs_t *)target, (cs_t)replacement) == 0;
+#elif defined __GNUC__ || defined __ZOWE_OS_AIX
+  return __sync_bool_compare_and_swap(target, expected, replacement);
+#elif defined __ZOWE_OS_WINDOWS
+  return InterlockedCompareExchange((volatile LONG *)target, replacement, expected) == expected;
+#else
+  #error Unsupported platform for atomic operation
+#endif
+}
+
+static uint64 traceClock(){
+#ifdef __ZOWE_OS_WINDOWS
+  FILETIME now;
+  GetSystemTimeAsFileTime(&now);
+  uint64 ticks = (((uint64)now.dwHighDateTime) << 32) | now.dwLowDateTime;
+  return ticks / 10 - 11644473600000000LL; /* 100ns ticks since 1601 */
+#else
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return ((uint64)now.tv_sec) * 1000000 + now.tv_usec;
+#endif
+}
+
+static uint64 traceThreadID(){
+#ifdef __ZOWE_OS_WINDOWS
+  return (uint64)GetCurrentThreadId();
+#else
+  pthread_t self = pthread_self();
+  uint64 id = 0;
+  memcpy(&id, &self, (sizeof(self) < sizeof(id)) ? sizeof(self) : sizeof(id));
+  return id;
+#endif
+}
+
+/*** Format strings ***/
+
+typedef struct TraceConversion_tag{
+  int  length;                                /* of the whole specification in the format */
+  int  stars;                                 /* '*' widths and precisions, each an int argument */
+  char kind;
+  char conversion;
+  char spec[32];                              /* '%', flags, width and precision */
+} TraceConversion;
+
+/* Scans the conversion specification that starts at the '%' p points to */
+static void scanConversion(char *p, TraceConversion *conversion){
+  char *q = p + 1;
+  int specLength = 0;
+  int longs = 0;
+  int sizes = 0;
+  int longDouble = FALSE;
+
+  conversion->stars = 0;
+  conversion->spec[specLength++] = '%';
+  while (*q != 0 && (strchr("-+ #0", *q) != NULL || isdigit((unsigned char)*q) || *q == '.' || *q == '*')) {
+    if (*q == '*') {
+      conversion->stars++;
+    }
+    if (specLength < (int)sizeof(conversion->spec) - 1) {
+      conversion->spec[specLength++] = *q;
+    }
+    q++;
+  }
+  conversion->spec[specLength] = 0;
+  while (*q != 0 && strchr("hlLqjzt", *q) != NULL) {
+    switch (*q) {
+    case 'l': longs++;            break;
+    case 'q':
+    case 'j': longs = 2;          break;
+    case 'z':
+    case 't': sizes = 1;          break;
+    case 'L': longDouble = TRUE;  break;
+    }
+    q++;
+  }
+
+  conversion->conversion = *q;
+  switch (*q) {
+  case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': case 'c':
+    if (longs >= 2) {
+      conversion->kind = BINARY_TRACE_ARG_INT64;
+    } else if (longs == 1) {
+      conversion->kind = (sizeof(long) == 8) ? BINARY_TRACE_ARG_INT64 : BINARY_TRACE_ARG_INT;
+    } else if (sizes) {
+      conversion->kind = (sizeof(size_t) == 8) ? BINARY_TRACE_ARG_INT64 : BINARY_TRACE_ARG_INT;
+    } else {
+      conversion->kind = BINARY_TRACE_ARG_INT;
+    }
+    break;
+  case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+    conversion->kind = longDouble ? BINARY_TRACE_ARG_LONG_DOUBLE : BINARY_TRACE_ARG_DOUBLE;
+    break;
+  case 's':
+    conversion->kind = BINARY_TRACE_ARG_STRING;
+    break;
+  case 'p':
+    conversion->kind = BINARY_TRACE_ARG_POINTER;
+    break;
+  default:
+    conversion->kind = BINARY_TRACE_ARG_NONE;
+    break;
+  }
+  if (*q != 0) {
+    q++;
+  }
+  conversion->length = q - p;
+}
+
+static int parseTraceFormat(char *format, char *kinds){
+  int count = 0;
+  char *p = format;
+  while ((p = strchr(p, '%')) != NULL) {
+    TraceConversion conversion;
+    scanConversion(p, &conversion);
+    for (int i = 0; i < conversion.stars && count < BINARY_TRACE_MAX_ARGS; i++) {
+      kinds[count++] = BINARY_TRACE_ARG_INT;
+    }
+    if (conversion.kind != BINARY_TRACE_ARG_NONE && count < BINARY_TRACE_MAX_ARGS) {
+      kinds[count++] = conversion.kind;
+    }
+    p += conversion.length;
+  }
+  return count;
+}
+
+int binaryTraceRegister(BinaryTraceFormat *format){
+  if (format->id != 0) {
+    return format->id;
+  }
+  format->argCount = parseTraceFormat(format->format, format->argKinds);
+
+  unsigned int id;
+  do {
+    id = formatCount + 1;
+    if (id > BINARY_TRACE_MAX_FORMATS) {
+      return -1;
+    }
+  } while (!traceCompareAndSwap(&formatCount, id - 1, id));
+  formats[id - 1] = format;
+  /* two threads may race to register the same format, the loser's id is simply never used */
+  traceCompareAndSwap((volatile unsigned int *)&format->id, 0, id);
+  return format->id;
+}
+
+/*** Per-thread buffers ***/
+
+#ifdef __ZOWE_OS_WINDOWS
+static void WINAPI releaseThreadBuffer(void *data){
+#else
+static void releaseThreadBuffer(void *data){
+#endif
+  BinaryTraceBuffer *buffer = (BinaryTraceBuffer *)data;
+  if (buffer != NULL) {
+    mutexLock(bufferLock);
+    buffer->owned = FALSE;
+    mutexUnlock(bufferLock);
+  }
+}
+
+static BinaryTraceBuffer *claimThreadBuffer(){
+  BinaryTraceBuffer *buffer = NULL;
+
+  mutexLock(bufferLock);
+  /* the records of an ended thread are kept until a new thread needs its buffer */
+  for (BinaryTraceBuffer *candidate = buffers; candidate != NULL; candidate = candidate->next) {
+    if (!candidate->owned && candidate->mask + 1 == recordsPerBuffer) {
+      buffer = candidate;
+      break;
+    }
+  }
+  if (buffer == NULL) {
+    buffer = (BinaryTraceBuffer *)safeMalloc(sizeof(BinaryTraceBuffer), "BinaryTraceBuffer");
+    memcpy(buffer->eyecatcher, "RSBTRBUF", sizeof(buffer->eyecatcher));
+    buffer->mask = recordsPerBuffer - 1;
+    buffer->records = (BinaryTraceRecord *)safeMalloc(recordsPerBuffer * sizeof(BinaryTraceRecord),
+                                                      "BinaryTraceRecords");
+    buffer->next = buffers;
+    buffers = buffer;
+  }
+  buffer->owned = TRUE;
+  buffer->written = 0;
+  buffer->threadID = traceThreadID();
+  mutexUnlock(bufferLock);
+
+#ifdef __ZOWE_OS_WINDOWS
+  FlsSetValue(bufferKey, buffer);
+#else
+  pthread_setspecific(bufferKey, buffer);
+#endif
+  return buffer;
+}
+
+static BinaryTraceBuffer *getThreadBuffer(){
+#ifdef __ZOWE_OS_WINDOWS
+  BinaryTraceBuffer *buffer = (BinaryTraceBuffer *)FlsGetValue(bufferKey);
+#else
+  BinaryTraceBuffer *buffer = (BinaryTraceBuffer *)pthread_getspecific(bufferKey);
+#endif
+  if (buffer == NULL) {
+    buffer = claimThreadBuffer();
+  }
+  return buffer;
+}
+
+int binaryTraceStart(int recordsPerThread){
+  if (binaryTraceActive) {
+    return -1;
+  }
+  if (!initialized) {
+    mutexCreate(bufferLock);
+#ifdef __ZOWE_OS_WINDOWS
+    bufferKey = FlsAlloc(releaseThreadBuffer);
+#else
+    pthread_key_create(&bufferKey, releaseThreadBuffer);
+#endif
+    initialized = TRUE;
+  }
+
+  unsigned int records = 16;
+  while (records < (unsigned int)recordsPerThread && records < BINARY_TRACE_MAX_RECORDS) {
+    records <<= 1;
+  }
+  mutexLock(bufferLock);
+  recordsPerBuffer = records;
+  mutexUnlock(bufferLock);
+
+  binaryTraceActive = TRUE;
+  return 0;
+}
+
+void binaryTraceStop(void){
+  binaryTraceActive = FALSE;
+}
+
+void binaryTraceRecord(BinaryTraceFormat *format, ...){
+  if (format->id == 0 && binaryTraceRegister(format) <= 0) {
+    return;
+  }
+  BinaryTraceBuffer *buffer = getThreadBuffer();
+  uint64 position = buffer->written;
+  BinaryTraceRecord *record = &buffer->records[position & buffer->mask];
+
+  /* an invalid sequence while the record is being filled, see copyRecords */
+  record->sequence = (unsigned short)~position;
+  record->timestamp = traceClock();
+  record->formatID = format->id;
+  record->argCount = format->argCount;
+
+  int textLength = 0;
+  va_list argList;
+  va_start(argList, format);
+  for (int i = 0; i < format->argCount; i++) {
+    switch (format->argKinds[i]) {
+    case BINARY_TRACE_ARG_INT:
+      record->args[i] = (uint64)(int64)va_arg(argList, int);
+      break;
+    case BINARY_TRACE_ARG_INT64:
+      record->args[i] = (uint64)va_arg(argList, long long);
+      break;
+    case BINARY_TRACE_ARG_DOUBLE:
+    case BINARY_TRACE_ARG_LONG_DOUBLE:
+      {
+        double value = (format->argKinds[i] == BINARY_TRACE_ARG_DOUBLE) ?
+                       va_arg(argList, double) : (double)va_arg(argList, long double);
+        memcpy(&record->args[i], &value, sizeof(value));
+      }
+      break;
+    case BINARY_TRACE_ARG_POINTER:
+      record->args[i] = (uint64)(uintptr_t)va_arg(argList, void *);
+      break;
+    case BINARY_TRACE_ARG_STRING:
+      {
+        char *string = va_arg(argList, char *);
+        int length = 0;
+        if (string != NULL) {
+          int room = BINARY_TRACE_TEXT_SIZE - textLength;
+          while (length < room && string[length] != 0) {
+            length++;
+          }
+          memcpy(record->text + textLength, string, length);
+        }
+        record->args[i] = textLength | (((uint64)length) << 16) | (string == NULL ? (((uint64)1) << 32) : 0);
+        textLength += length;
+      }
+      break;
+    }
+  }
+  va_end(argList);
+  record->textLength = textLength;
+
+  record->sequence = (unsigned short)position;
+  buffer->written = position + 1;
+}
+
+/*** Dumping ***/
+
+/* copies the records of one buffer newer than since, skipping any that are being overwritten */
+static int copyRecords(BinaryTraceBuffer *buffer, BinaryTraceRecord *copy, uint64 since){
+  uint64 written = buffer->written;
+  uint64 capacity = buffer->mask + 1;
+  uint64 position = (written > capacity) ? written - capacity : 0;
+  int count = 0;
+  for (; position < written; position++) {
+    BinaryTraceRecord *record = &buffer->records[position & buffer->mask];
+    memcpy(&copy[count], record, sizeof(BinaryTraceRecord));
+    if (copy[count].sequence != (unsigned short)position ||
+        record->sequence != (unsigned short)position) {
+      continue;
+    }
+    if (copy[count].timestamp >= since) {
+      count++;
+    }
+  }
+  return count;
+}
+
+int binaryTraceDump(FILE *out, int seconds){
+  if (!initialized) {
+    return -1;
+  }
+  uint64 since = (seconds > 0) ? traceClock() - ((uint64)seconds) * 1000000 : 0;
+
+  mutexLock(bufferLock);
+
+  BinaryTraceDumpHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, dumpMagic, sizeof(header.magic));
+  header.byteOrder = BINARY_TRACE_BYTE_ORDER;
+  header.version = BINARY_TRACE_DUMP_VERSION;
+#ifdef __ZOWE_EBCDIC
+  header.charset = BINARY_TRACE_CHARSET_EBCDIC;
+#else
+  header.charset = BINARY_TRACE_CHARSET_ASCII;
+#endif
+  header.recordSize = sizeof(BinaryTraceRecord);
+  header.formatCount = formatCount;
+  unsigned int largestBuffer = 0;
+  for (BinaryTraceBuffer *buffer = buffers; buffer != NULL; buffer = buffer->next) {
+    header.bufferCount++;
+    if (buffer->mask + 1 > largestBuffer) {
+      largestBuffer = buffer->mask + 1;
+    }
+  }
+  fwrite(&header, sizeof(header), 1, out);
+
+  for (unsigned int i = 0; i < header.formatCount; i++) {
+    BinaryTraceFormat *format = formats[i];
+    uint32 entry[2];
+    entry[0] = i + 1;
+    entry[1] = (format != NULL) ? strlen(format->format) : 0;
+    fwrite(entry, sizeof(entry), 1, out);
+    if (entry[1] > 0) {
+      fwrite(format->format, 1, entry[1], out);
+    }
+  }
+
+  int total = 0;
+  BinaryTraceRecord *copy = NULL;
+  if (largestBuffer > 0) {
+    copy = (BinaryTraceRecord *)safeMalloc(largestBuffer * sizeof(BinaryTraceRecord), "BinaryTraceCopy");
+  }
+  for (BinaryTraceBuffer *buffer = buffers; buffer != NULL; buffer = buffer->next) {
+    BinaryTraceDumpBuffer bufferHeader;
+    memset(&bufferHeader, 0, sizeof(bufferHeader));
+    bufferHeader.threadID = buffer->threadID;
+    bufferHeader.recordCount = copyRecords(buffer, copy, since);
+    fwrite(&bufferHeader, sizeof(bufferHeader), 1, out);
+    if (bufferHeader.recordCount > 0) {
+      fwrite(copy, sizeof(BinaryTraceRecord), bufferHeader.recordCount, out);
+    }
+    total += bufferHeader.recordCount;
+  }
+  if (copy != NULL) {
+    safeFree((char *)copy, largestBuffer * sizeof(BinaryTraceRecord));
+  }
+
+  mutexUnlock(bufferLock);
+
+  if (ferror(out)) {
+    return -1;
+  }
+  return total;
+}
+
+int binaryTraceDumpFile(char *path, int seconds){
+  FILE *out = fopen(path, "wb");
+  if (out == NULL) {
+    return -1;
+  }
+  int count = binaryTraceDump(out, seconds);
+  if (fclose(out) != 0) {
+    return -1;
+  }
+  return count;
+}
+
+/*** Decoding ***/
+
+typedef struct DecodedRecord_tag{
+  uint64 threadID;
+  BinaryTraceRecord record;
+} DecodedRecord;
+
+static uint32 swap32(uint32 value){
+  return ((value & 0xFF) << 24) | ((value & 0xFF00) << 8) |
+         ((value >> 8) & 0xFF00) | ((value >> 24) & 0xFF);
+}
+
+static uint64 swap64(uint64 value){
+  return (((uint64)swap32((uint32)value)) << 32) | swap32((uint32)(value >> 32));
+}
+
+static void swapRecord(BinaryTraceRecord *record){
+  record->timestamp = swap64(record->timestamp);
+  record->formatID = (int)swap32((uint32)record->formatID);
+  record->sequence = (unsigned short)((record->sequence << 8) | (record->sequence >> 8));
+  for (int i = 0; i < BINARY_TRACE_MAX_ARGS; i++) {
+    record->args[i] = swap64(record->args[i]);
+  }
+}
+
+static void translateText(char *text, int length, int fromCharset){
+#ifdef __ZOWE_EBCDIC
+  if (fromCharset == BINARY_TRACE_CHARSET_ASCII) {
+    a2e(text, length);
+  }
+#else
+  if (fromCharset == BINARY_TRACE_CHARSET_EBCDIC) {
+    e2a(text, length);
+  }
+#endif
+}
+
+static int compareDecodedRecords(const void *a, const void *b){
+  uint64 first = ((DecodedRecord *)a)->record.timestamp;
+  uint64 second = ((DecodedRecord *)b)->record.timestamp;
+  return (first < second) ? -1 : ((first > second) ? 1 : 0);
+}
+
+/* renders one conversion; stars holds the '*' values that precede its argument */
+static int renderConversion(char *out, int outSize, TraceConversion *conversion,
+                            int *stars, BinaryTraceRecord *record, int argIndex){
+  char spec[48];
+  int specLength = 0;
+  int starIndex = 0;
+
+  for (char *p = conversion->spec; *p != 0 && specLength < (int)sizeof(spec) - 16; p++) {
+    if (*p == '*') {
+      specLength += snprintf(spec + specLength, sizeof(spec) - specLength, "%d", stars[starIndex++]);
+    } else {
+      spec[specLength++] = *p;
+    }
+  }
+  spec[specLength] = 0;
+
+  if (argIndex >= record->argCount) {
+    return snprintf(out, outSize, "?");
+  }
+  uint64 value = record->args[argIndex];
+  switch (conversion->kind) {
+  case BINARY_TRACE_ARG_INT:
+    snprintf(spec + specLength, sizeof(spec) - specLength, "%c", conversion->conversion);
+    return snprintf(out, outSize, spec, (int)value);
+  case BINARY_TRACE_ARG_INT64:
+    snprintf(spec + specLength, sizeof(spec) - specLength, "ll%c", conversion->conversion);
+    return snprintf(out, outSize, spec, (long long)value);
+  case BINARY_TRACE_ARG_DOUBLE:
+  case BINARY_TRACE_ARG_LONG_DOUBLE:
+    {
+      double number;
+      memcpy(&number, &value, sizeof(number));
+      snprintf(spec + specLength, sizeof(spec) - specLength, "%c", conversion->conversion);
+      return snprintf(out, outSize, spec, number);
+    }
+  case BINARY_TRACE_ARG_POINTER:
+    snprintf(spec + specLength, sizeof(spec) - specLength, "p");
+    return snprintf(out, outSize, spec, (void *)(uintptr_t)value);
+  case BINARY_TRACE_ARG_STRING:
+    {
+      char text[BINARY_TRACE_TEXT_SIZE + 1];
+      int offset = value & 0xFFFF;
+      int length = (value >> 16) & 0xFFFF;
+      if (offset + length > BINARY_TRACE_TEXT_SIZE) {
+        length = 0;
+      }
+      memcpy(text, record->text + offset, length);
+      text[length] = 0;
+      snprintf(spec + specLength, sizeof(spec) - specLength, "s");
+      return snprintf(out, outSize, spec, ((value >> 32) & 1) ? "(null)" : text);
+    }
+  }
+  return 0;
+}
+
+static void renderRecord(FILE *out, char *format, BinaryTraceRecord *record, uint64 threadID){
+  char line[1024];
+  int length = 0;
+
+  time_t seconds = (time_t)(record->timestamp / 1000000);
+  struct tm fields;
+#ifdef __ZOWE_OS_WINDOWS
+  gmtime_s(&fields, &seconds);
+#else
+  gmtime_r(&seconds, &fields);
+#endif
+  length = snprintf(line, sizeof(line), "%04d-%02d-%02dT%02d:%02d:%02d.%06dZ %llx ",
+                    fields.tm_year + 1900, fields.tm_mon + 1, fields.tm_mday,
+                    fields.tm_hour, fields.tm_min, fields.tm_sec,
+                    (int)(record->timestamp % 1000000), (unsigned long long)threadID);
+
+  if (format == NULL) {
+    length += snprintf(line + length, sizeof(line) - length, "<unknown format %d>", record->formatID);
+  } else {
+    int argIndex = 0;
+    char *p = format;
+    while (*p != 0 && length < (int)sizeof(line) - 1) {
+      if (*p != '%') {
+        line[length++] = *p++;
+        continue;
+      }
+      TraceConversion conversion;
+      scanConversion(p, &conversion);
+      p += conversion.length;
+      if (conversion.conversion == '%') {
+        line[length++] = '%';
+        continue;
+      }
+      int stars[2] = {0, 0};
+      for (int i = 0; i < conversion.stars; i++, argIndex++) {
+        if (i < 2 && argIndex < record->argCount) {
+          stars[i] = (int)record->args[argIndex];
+        }
+      }
+      if (conversion.kind == BINARY_TRACE_ARG_NONE) {
+        continue;
+      }
+      int rendered = renderConversion(line + length, sizeof(line) - length, &conversion,
+                                      stars, record, argIndex++);
+      length += rendered;
+      if (length > (int)sizeof(line) - 1) {
+        length = sizeof(line) - 1;
+      }
+    }
+  }
+  while (length > 0 && line[length - 1] == '\n') {
+    length--;
+  }
+  line[length] = 0;
+  fprintf(out, "%s\n", line);
+}
+
+int binaryTraceDecode(FILE *in, FILE *out){
+  BinaryTraceDumpHeader header;
+  if (fread(&header, sizeof(header), 1, in) != 1 ||
+      memcmp(header.magic, dumpMagic, sizeof(dumpMagic)) != 0) {
+    return -1;
+  }
+  int swap = (header.byteOrder != BINARY_TRACE_BYTE_ORDER);
+  if (swap) {
+    header.version = swap32(header.version);
+    header.charset = swap32(header.charset);
+    header.recordSize = swap32(header.recordSize);
+    header.formatCount = swap32(header.formatCount);
+    header.bufferCount = swap32(header.bufferCount);
+  }
+  if (header.version != BINARY_TRACE_DUMP_VERSION || header.recordSize != sizeof(BinaryTraceRecord) ||
+      header.formatCount > BINARY_TRACE_MAX_FORMATS) {
+    return -1;
+  }
+
+  int status = 0;
+  int tableSize = (header.formatCount + 1) * sizeof(char *);
+  char **formatTable = (char **)safeMalloc(tableSize, "BinaryTraceFormats");
+  memset(formatTable, 0, tableSize);
+  for (unsigned int i = 0; i < header.formatCount && status == 0; i++) {
+    uint32 entry[2];
+    if (fread(entry, sizeof(entry), 1, in) != 1) {
+      status = -1;
+      break;
+    }
+    if (swap) {
+      entry[0] = swap32(entry[0]);
+      entry[1] = swap32(entry[1]);
+    }
+    if (entry[0] > header.formatCount || entry[1] > 0xFFFF) {
+      status = -1;
+      break;
+    }
+    char *text = safeMalloc(entry[1] + 1, "BinaryTraceFormat");
+    if (fread(text, 1, entry[1], in) != entry[1]) {
+      safeFree(text, entry[1] + 1);
+      status = -1;
+      break;
+    }
+    text[entry[1]] = 0;
+    translateText(text, entry[1], header.charset);
+    if (formatTable[entry[0]] != NULL) {
+      safeFree(formatTable[entry[0]], strlen(formatTable[entry[0]]) + 1);
+    }
+    formatTable[entry[0]] = text;
+  }
+
+  int recordCount = 0;
+  int recordCapacity = 0;
+  DecodedRecord *records = NULL;
+  for (unsigned int i = 0; i < header.bufferCount && status == 0; i++) {
+    BinaryTraceDumpBuffer bufferHeader;
+    if (fread(&bufferHeader, sizeof(bufferHeader), 1, in) != 1) {
+      status = -1;
+      break;
+    }
+    if (swap) {
+      bufferHeader.threadID = swap64(bufferHeader.threadID);
+      bufferHeader.recordCount = swap32(bufferHeader.recordCount);
+    }
+    if (bufferHeader.recordCount > BINARY_TRACE_MAX_RECORDS) {
+      status = -1;
+      break;
+    }
+    if (recordCount + (int)bufferHeader.recordCount > recordCapacity) {
+      int newCapacity = recordCount + bufferHeader.recordCount + 1024;
+      DecodedRecord *newRecords = (DecodedRecord *)safeMalloc(newCapacity * sizeof(DecodedRecord), "DecodedRecords");
+      if (records != NULL) {
+        memcpy(newRecords, records, recordCount * sizeof(DecodedRecord));
+        safeFree((char *)records, recordCapacity * sizeof(DecodedRecord));
+      }
+      records = newRecords;
+      recordCapacity = newCapacity;
+    }
+    for (unsigned int j = 0; j < bufferHeader.recordCount; j++) {
+      DecodedRecord *decoded = &records[recordCount];
+      if (fread(&decoded->record, sizeof(BinaryTraceRecord), 1, in) != 1) {
+        status = -1;
+        break;
+      }
+      if (swap) {
+        swapRecord(&decoded->record);
+      }
+      translateText(decoded->record.text, BINARY_TRACE_TEXT_SIZE, header.charset);
+      decoded->threadID = bufferHeader.threadID;
+      recordCount++;
+    }
+  }
+
+  if (recordCount > 0) {
+    qsort(records, recordCount, sizeof(DecodedRecord), compareDecodedRecords);
+  }
+  for (int i = 0; i < recordCount; i++) {
+    BinaryTraceRecord *record = &records[i].record;
+    char *format = NULL;
+    if (record->formatID > 0 && record->formatID <= (int)header.formatCount) {
+      format = formatTable[record->formatID];
+    }
+    renderRecord(out, format, record, records[i].threadID);
+  }
+
+  if (records != NULL) {
+    safeFree((char *)records, recordCapacity * sizeof(DecodedRecord));
+  }
+  for (unsigned int i = 0; i <= header.formatCount; i++) {
+    if (formatTable[i] != NULL) {
+      safeFree(formatTable[i], strlen(formatTable[i]) + 1);
+    }
+  }
+  safeFree((char *)formatTable, tableSize);
+
+  return (status == 0) ? recordCount : -1;
+}
+
+#ifdef BINARY_TRACE_DECODER
+
+int main(int argc, char *argv[]){
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <binary trace dump>\n", argv[0]);
+    return 8;
+  }
+  FILE *in = fopen(argv[1], "rb");
+  if (in == NULL) {
+    fprintf(stderr, "cannot open %s\n", argv[1]);
+    return 8;
+  }
+  int count = binaryTraceDecode(in, stdout);
+  fclose(in);
+  if (count < 0) {
+    fprintf(stderr, "%s is not a valid binary trace dump\n", argv[1]);
+    return 8;
+  }
+  return 0;
+}
+
+#endif /* BINARY_TRACE_DECODER */
+
+#endif /* not METTLE */
+
+
+/*
+  This program and the accompanying materials are
+  made available under the terms of the Eclipse Public License v2.0 which accompanies
+  this distribution, and is available at https://www.eclipse.org/legal/epl-v20.html
+
+  SPDX-License-Identifier: EPL-2.0
+
+  Copyright Contributors to the Zowe Project.
+*/
+
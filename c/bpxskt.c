@@ -1396,6 +1396,10 @@ void freeSocketSet(SocketSet *set){
   return;
 }
 
+void setSocketSetIdleTimeLimit(SocketSet *set, int idleSeconds){
+  set->idleTimeLimit = (idleSeconds > 0) ? idleSeconds : 0;
+}
+
 int socketSetAdd(SocketSet *set, Socket *socket){
   int sd = socket->sd;
 
@@ -4,7 +4,7 @@ typedef struct{
   char *idName;
   } CCSID_ID;
 
-CCSID_ID ccsidList[] = {
+static CCSID_ID ccsidList[] = {
   { 37, "IBM-037"},
   {273, "IBM-273"},
   {274, "IBM-274"},
@@ -359,6 +359,9 @@ int convertCharset(char *input,
 
 #include <iconv.h>
 #include <errno.h>
+#include <pthread.h>
+
+#include "ccsidList.c"
 
 
 /*
@@ -368,8 +371,10 @@ int convertCharset(char *input,
 
   what is "WCHAR_T" (is it UTF16 (BE/LE)?) 
 
-  NOTE: iconv_open is EXPENSIVE. It would make sense to keep a dictionary of
-        already-opened converters and reuse them.
+  NOTE: iconv_open is EXPENSIVE, so convertCharset keeps the converters it opens in a small
+        per-thread cache keyed by the (input, output) CCSID pair.  An iconv_t cannot be used
+        by two threads at once, and keeping the cache per thread means it needs no locking.
+        A cached converter is reset to its initial shift state before every reuse.
  */
 
 static const char *getCharsetName(int ibmCode){
@@ -387,10 +392,547 @@ static const char *getCharsetName(int ibmCode){
   case CCSID_UTF_16_LE:
     return "UTF-16LE";
   default:
+    for (CCSID_ID *entry = ccsidList; entry->idName != NULL; entry++){
+      if (entry->ccsid == ibmCode){
+        return entry->idName;
+      }
+    }
     return NULL;
   }
 }
 
+/* z/OS names such as IBM-037 are known to glibc as IBM037 */
+static int undashCharsetName(const char *name, char *buffer, int bufferSize){
+  int length = strlen(name);
+  if ((strncmp(name,"IBM-",4) == 0) && (length < bufferSize)){
+    memcpy(buffer,"IBM",3);
+    memcpy(buffer+3,name+4,length-3);
+    return TRUE;
+  } else if (length < bufferSize){
+    memcpy(buffer,name,length+1);
+  } else {
+    buffer[0] = 0;
+  }
+  return FALSE;
+}
+
+static iconv_t openConverter(const char *outputCharset, const char *inputCharset){
+  iconv_t converter = iconv_open(outputCharset,inputCharset);
+  if (converter == (iconv_t)-1){
+    char outputName[CHARSETNAME_SIZE+1];
+    char inputName[CHARSETNAME_SIZE+1];
+    int renamed = undashCharsetName(outputCharset,outputName,sizeof(outputName));
+    renamed |= undashCharsetName(inputCharset,inputName,sizeof(inputName));
+    if (renamed && outputName[0] && inputName[0]){
+      converter = iconv_open(outputName,inputName);
+    }
+  }
+  return converter;
+}
+
+/*
+  Single-byte conversions are table driven.  The first time a CCSID pair is converted, each of
+  the 256 byte values of its single-byte side is run through iconv once to learn its code point,
+  and the code points are composed into a table for the pair.  Charsets in which a byte does not
+  stand for exactly one UTF-16 unit (DBCS, stateful and UTF encodings) get no table and stay on
+  iconv, as do pairs that involve neither a single-byte charset and UTF-8 nor two single-byte
+  charsets.  Tables are shared by all threads and live as long as the process.
+ */
+
+#define SBCS_NO_TABLE  0
+#define SBCS_TO_SBCS   1
+#define SBCS_TO_UTF8   2
+#define UTF8_TO_SBCS   3
+
+#define SBCS_UNMAPPED  0xFFFF
+
+typedef struct SingleByteTable_tag{
+  struct SingleByteTable_tag *next;
+  int inputCCSID;
+  int outputCCSID;
+  int kind;
+  int allMapped;                          /* every input byte (for UTF-8 input, ASCII byte) maps */
+  unsigned char mapped[256];
+  unsigned char bytes[256];               /* the output byte, for output of one byte */
+  unsigned char utf8Length[256];          /* SBCS_TO_UTF8, 0 if the byte is unmapped */
+  unsigned char utf8[256][3];
+  short twoByteTargets[0x800];            /* UTF8_TO_SBCS, by code point below 0x800, -1 if unmapped */
+  int reverseCount;                       /* UTF8_TO_SBCS, other code points in order */
+  unsigned short reverseCodePoints[256];
+  unsigned char reverseBytes[256];
+} SingleByteTable;
+
+static SingleByteTable *singleByteTables = NULL;
+static pthread_mutex_t singleByteTablesLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int loadCodePoints(int ccsid, unsigned short *codePoints){
+  const char *charset = getCharsetName(ccsid);
+  if (charset == NULL){
+    return FALSE;
+  }
+  iconv_t converter = openConverter("UTF-16BE",charset);
+  if (converter == (iconv_t)-1){
+    return FALSE;
+  }
+  int singleByte = TRUE;
+  for (int b = 0; (b < 256) && singleByte; b++){
+    char in = (char)b;
+    unsigned char out[8];
+    char *inPtr = &in;
+    size_t inSize = 1;
+    char *outPtr = (char*)out;
+    size_t outSize = sizeof(out);
+    iconv(converter,NULL,NULL,NULL,NULL);
+    size_t status = iconv(converter,&inPtr,&inSize,&outPtr,&outSize);
+    int produced = (int)(sizeof(out) - outSize);
+    if (status == (size_t)-1){
+      if (errno == EILSEQ){
+        codePoints[b] = SBCS_UNMAPPED;
+      } else {
+        singleByte = FALSE;
+      }
+    } else if (produced == 2){
+      codePoints[b] = (unsigned short)((out[0] << 8) | out[1]);
+      if ((codePoints[b] >= 0xD800) && (codePoints[b] <= 0xDFFF)){
+        singleByte = FALSE;
+      }
+    } else {
+      singleByte = FALSE;
+    }
+  }
+  iconv_close(converter);
+  return singleByte;
+}
+
+static int encodeUtf8(unsigned int codePoint, unsigned char *utf8){
+  if (codePoint < 0x80){
+    utf8[0] = (unsigned char)codePoint;
+    return 1;
+  } else if (codePoint < 0x800){
+    utf8[0] = (unsigned char)(0xC0 | (codePoint >> 6));
+    utf8[1] = (unsigned char)(0x80 | (codePoint & 0x3F));
+    return 2;
+  } else {
+    utf8[0] = (unsigned char)(0xE0 | (codePoint >> 12));
+    utf8[1] = (unsigned char)(0x80 | ((codePoint >> 6) & 0x3F));
+    utf8[2] = (unsigned char)(0x80 | (codePoint & 0x3F));
+    return 3;
+  }
+}
+
+static SingleByteTable *buildSingleByteTable(int inputCCSID, int outputCCSID){
+  SingleByteTable *table = (SingleByteTable*)safeMalloc(sizeof(SingleByteTable),"SingleByteTable");
+  unsigned short inputCodePoints[256];
+  unsigned short outputCodePoints[256];
+  int inputSingle = (inputCCSID != CCSID_UTF_8) && loadCodePoints(inputCCSID,inputCodePoints);
+  int outputSingle = (outputCCSID != CCSID_UTF_8) && loadCodePoints(outputCCSID,outputCodePoints);
+  int mappedCount = 0;
+
+  table->inputCCSID = inputCCSID;
+  table->outputCCSID = outputCCSID;
+  if (inputSingle && outputSingle){
+    table->kind = SBCS_TO_SBCS;
+    for (int b = 0; b < 256; b++){
+      if (inputCodePoints[b] == SBCS_UNMAPPED){
+        continue;
+      }
+      for (int t = 0; t < 256; t++){
+        if (outputCodePoints[t] == inputCodePoints[b]){
+          table->mapped[b] = TRUE;
+          table->bytes[b] = (unsigned char)t;
+          mappedCount++;
+          break;
+        }
+      }
+    }
+    table->allMapped = (mappedCount == 256);
+  } else if (inputSingle && (outputCCSID == CCSID_UTF_8)){
+    table->kind = SBCS_TO_UTF8;
+    for (int b = 0; b < 256; b++){
+      if (inputCodePoints[b] != SBCS_UNMAPPED){
+        table->mapped[b] = TRUE;
+        table->utf8Length[b] = (unsigned char)encodeUtf8(inputCodePoints[b],table->utf8[b]);
+        table->bytes[b] = table->utf8[b][0];
+        mappedCount++;
+      }
+    }
+    table->allMapped = (mappedCount == 256);
+  } else if (outputSingle && (inputCCSID == CCSID_UTF_8)){
+    table->kind = UTF8_TO_SBCS;
+    for (int i = 0; i < 0x800; i++){
+      table->twoByteTargets[i] = -1;
+    }
+    for (int b = 0; b < 256; b++){
+      unsigned short codePoint = outputCodePoints[b];
+      if (codePoint == SBCS_UNMAPPED){
+        continue;
+      } else if (codePoint < 0x80){
+        if (!table->mapped[codePoint]){
+          table->mapped[codePoint] = TRUE;
+          table->bytes[codePoint] = (unsigned char)b;
+          mappedCount++;
+        }
+      } else if (codePoint < 0x800){
+        if (table->twoByteTargets[codePoint] < 0){
+          table->twoByteTargets[codePoint] = (short)b;
+        }
+      } else {
+        /* insertion sort, keeping the first byte for a code point */
+        int i = table->reverseCount;
+        while ((i > 0) && (table->reverseCodePoints[i-1] > codePoint)){
+          table->reverseCodePoints[i] = table->reverseCodePoints[i-1];
+          table->reverseBytes[i] = table->reverseBytes[i-1];
+          i--;
+        }
+        if ((i > 0) && (table->reverseCodePoints[i-1] == codePoint)){
+          memmove(&table->reverseCodePoints[i],&table->reverseCodePoints[i+1],
+                  (table->reverseCount-i)*sizeof(unsigned short));
+          memmove(&table->reverseBytes[i],&table->reverseBytes[i+1],table->reverseCount-i);
+          continue;
+        }
+        table->reverseCodePoints[i] = codePoint;
+        table->reverseBytes[i] = (unsigned char)b;
+        table->reverseCount++;
+      }
+    }
+    table->allMapped = (mappedCount == 128);
+  } else {
+    table->kind = SBCS_NO_TABLE;
+  }
+  return table;
+}
+
+/* Returns NULL if the pair has to be converted by iconv */
+static SingleByteTable *getSingleByteTable(int inputCCSID, int outputCCSID){
+  pthread_mutex_lock(&singleByteTablesLock);
+  SingleByteTable *table = singleByteTables;
+  while ((table != NULL) &&
+         ((table->inputCCSID != inputCCSID) || (table->outputCCSID != outputCCSID))){
+    table = table->next;
+  }
+  if (table == NULL){
+    table = buildSingleByteTable(inputCCSID,outputCCSID);
+    table->next = singleByteTables;
+    singleByteTables = table;
+  }
+  pthread_mutex_unlock(&singleByteTablesLock);
+  return (table->kind == SBCS_NO_TABLE) ? NULL : table;
+}
+
+static int findReverseByte(const SingleByteTable *table, unsigned int codePoint){
+  int low = 0;
+  int high = table->reverseCount - 1;
+  while (low <= high){
+    int middle = (low + high) / 2;
+    unsigned int middleCodePoint = table->reverseCodePoints[middle];
+    if (middleCodePoint == codePoint){
+      return table->reverseBytes[middle];
+    } else if (middleCodePoint < codePoint){
+      low = middle + 1;
+    } else {
+      high = middle - 1;
+    }
+  }
+  return -1;
+}
+
+/* Has the calling convention of iconv, so that callers can use either one */
+static size_t singleByteConvert(const SingleByteTable *table,
+                                char **inputBuffer, size_t *inputSize,
+                                char **outputBuffer, size_t *outputSize){
+  const unsigned char *in = (const unsigned char*)*inputBuffer;
+  const unsigned char *inEnd = in + *inputSize;
+  unsigned char *out = (unsigned char*)*outputBuffer;
+  unsigned char *outEnd = out + *outputSize;
+  const unsigned char *bytes = table->bytes;
+  int error = 0;
+
+  switch (table->kind){
+  case SBCS_TO_SBCS:
+    if (table->allMapped){
+      size_t length = inEnd - in;
+      if ((size_t)(outEnd - out) < length){
+        length = outEnd - out;
+        error = E2BIG;
+      }
+      const unsigned char *stop = in + length;
+      while (stop - in >= 4){
+        out[0] = bytes[in[0]];
+        out[1] = bytes[in[1]];
+        out[2] = bytes[in[2]];
+        out[3] = bytes[in[3]];
+        in += 4;
+        out += 4;
+      }
+      while (in < stop){
+        *out++ = bytes[*in++];
+      }
+    } else {
+      while (in < inEnd){
+        if (!table->mapped[*in]){
+          error = EILSEQ;
+          break;
+        }
+        if (out == outEnd){
+          error = E2BIG;
+          break;
+        }
+        *out++ = bytes[*in++];
+      }
+    }
+    break;
+  case SBCS_TO_UTF8:
+    while (in < inEnd){
+      /* runs of characters that are ASCII in UTF-8 are translated eight bytes at a time; a block
+         is kept only if every length is 1, which the OR and the AND of the lengths tell at once */
+      while ((inEnd - in >= 8) && (outEnd - out >= 8)){
+        const unsigned char *utf8Length = table->utf8Length;
+        unsigned int any = 0;
+        unsigned int every = 1;
+        for (int i = 0; i < 8; i++){
+          unsigned int length = utf8Length[in[i]];
+          any |= length;
+          every &= length;
+          out[i] = bytes[in[i]];
+        }
+        if ((any != 1) || (every != 1)){
+          break;
+        }
+        in += 8;
+        out += 8;
+      }
+      if (in == inEnd){
+        break;
+      }
+      unsigned char c = *in;
+      int length = table->utf8Length[c];
+      if (length == 1){
+        /* the common case, a character that is ASCII in UTF-8 */
+        if (out == outEnd){
+          error = E2BIG;
+          break;
+        }
+        *out++ = bytes[c];
+        in++;
+      } else if (length == 0){
+        error = EILSEQ;
+        break;
+      } else {
+        if (outEnd - out < length){
+          error = E2BIG;
+          break;
+        }
+        memcpy(out,table->utf8[c],length);
+        out += length;
+        in++;
+      }
+    }
+    break;
+  case UTF8_TO_SBCS:
+    while (in < inEnd){
+      /* runs of ASCII are checked and translated eight bytes at a time */
+      if (table->allMapped){
+        while ((inEnd - in >= 8) && (outEnd - out >= 8)){
+          uint64 word;
+          memcpy(&word,in,8);
+          if (word & 0x8080808080808080LL){
+            break;
+          }
+          out[0] = bytes[in[0]];
+          out[1] = bytes[in[1]];
+          out[2] = bytes[in[2]];
+          out[3] = bytes[in[3]];
+          out[4] = bytes[in[4]];
+          out[5] = bytes[in[5]];
+          out[6] = bytes[in[6]];
+          out[7] = bytes[in[7]];
+          in += 8;
+          out += 8;
+        }
+        if (in == inEnd){
+          break;
+        }
+      }
+      unsigned char c = *in;
+      int length = 1;
+      int target = -1;
+      if (c < 0x80){
+        if (table->mapped[c]){
+          target = bytes[c];
+        }
+      } else if (((c & 0xE0) == 0xC0) && (inEnd - in >= 2) && ((in[1] & 0xC0) == 0x80)){
+        /* the usual non-ASCII character of a single-byte charset */
+        length = 2;
+        target = table->twoByteTargets[((c & 0x1F) << 6) | (in[1] & 0x3F)];
+        if (c < 0xC2){
+          target = -1;            /* overlong */
+        }
+      } else {
+        unsigned int codePoint = 0;
+        if ((c & 0xE0) == 0xC0){
+          length = 2;
+          codePoint = c & 0x1F;
+        } else if ((c & 0xF0) == 0xE0){
+          length = 3;
+          codePoint = c & 0x0F;
+        } else if ((c & 0xF8) == 0xF0){
+          length = 4;
+          codePoint = c & 0x07;
+        } else {
+          error = EILSEQ;
+          break;
+        }
+        int available = (inEnd - in < length) ? (int)(inEnd - in) : length;
+        int i;
+        for (i = 1; i < available; i++){
+          if ((in[i] & 0xC0) != 0x80){
+            break;
+          }
+          codePoint = (codePoint << 6) | (in[i] & 0x3F);
+        }
+        if (i < available){
+          error = EILSEQ;
+          break;
+        } else if (available < length){
+          error = EINVAL;         /* the input ends in the middle of the character */
+          break;
+        }
+        target = (codePoint < 0x800) ? -1 : findReverseByte(table,codePoint);
+      }
+      if (target < 0){
+        error = EILSEQ;
+        break;
+      }
+      if (out == outEnd){
+        error = E2BIG;
+        break;
+      }
+      *out++ = (unsigned char)target;
+      in += length;
+    }
+    break;
+  }
+  *inputSize = inEnd - in;
+  *outputSize = outEnd - out;
+  *inputBuffer = (char*)in;
+  *outputBuffer = (char*)out;
+  if (error){
+    errno = error;
+    return (size_t)-1;
+  }
+  return 0;
+}
+
+#define CONVERTER_CACHE_SIZE 8
+
+typedef struct ConverterCacheEntry_tag{
+  int inputCCSID;
+  int outputCCSID;
+  SingleByteTable *table;         /* if the pair is table driven, otherwise converter */
+  iconv_t converter;
+} ConverterCacheEntry;
+
+typedef struct ConverterCache_tag{
+  int count;
+  int nextVictim;                 /* round robin replacement once the cache is full */
+  ConverterCacheEntry entries[CONVERTER_CACHE_SIZE];
+} ConverterCache;
+
+static pthread_key_t converterCacheKey;
+static pthread_once_t converterCacheOnce = PTHREAD_ONCE_INIT;
+static int converterCacheKeyStatus = -1;
+
+static void freeConverterCache(void *data){
+  ConverterCache *cache = (ConverterCache*)data;
+  for (int i = 0; i < cache->count; i++){
+    if (cache->entries[i].table == NULL){
+      iconv_close(cache->entries[i].converter);
+    }
+  }
+  safeFree((char*)cache,sizeof(ConverterCache));
+}
+
+static void createConverterCacheKey(void){
+  converterCacheKeyStatus = pthread_key_create(&converterCacheKey,freeConverterCache);
+}
+
+static ConverterCache *getConverterCache(void){
+  pthread_once(&converterCacheOnce,createConverterCacheKey);
+  if (converterCacheKeyStatus != 0){
+    return NULL;
+  }
+  ConverterCache *cache = (ConverterCache*)pthread_getspecific(converterCacheKey);
+  if (cache == NULL){
+    cache = (ConverterCache*)safeMalloc(sizeof(ConverterCache),"ConverterCache");
+    if (pthread_setspecific(converterCacheKey,cache) != 0){
+      safeFree((char*)cache,sizeof(ConverterCache));
+      return NULL;
+    }
+  }
+  return cache;
+}
+
+/* 
+   Finds the table or the converter, in its initial shift state, for a pair and returns 0, or
+   errno if there is neither.  If the thread's cache could not be set up a converter is not
+   cached and *cached is set to FALSE, so that the caller closes it.
+ */
+static int getConverter(int inputCCSID, const char *inputCharset,
+                        int outputCCSID, const char *outputCharset,
+                        SingleByteTable **table, iconv_t *converter, int *cached){
+  ConverterCache *cache = getConverterCache();
+  *table = NULL;
+  *converter = (iconv_t)-1;
+  *cached = FALSE;
+  if (cache != NULL){
+    for (int i = 0; i < cache->count; i++){
+      ConverterCacheEntry *entry = &cache->entries[i];
+      if ((entry->inputCCSID == inputCCSID) && (entry->outputCCSID == outputCCSID)){
+        if (entry->table != NULL){
+          *table = entry->table;
+        } else {
+          iconv(entry->converter,NULL,NULL,NULL,NULL);
+          *converter = entry->converter;
+        }
+        *cached = TRUE;
+        return 0;
+      }
+    }
+  }
+  *table = getSingleByteTable(inputCCSID,outputCCSID);
+  if (*table == NULL){
+    *converter = openConverter(outputCharset,inputCharset);
+    if (*converter == (iconv_t)-1){
+      return errno;
+    }
+  }
+  if (cache == NULL){
+    return 0;
+  }
+  ConverterCacheEntry *entry = NULL;
+  if (cache->count < CONVERTER_CACHE_SIZE){
+    entry = &cache->entries[cache->count++];
+  } else {
+    entry = &cache->entries[cache->nextVictim];
+    cache->nextVictim = (cache->nextVictim + 1) % CONVERTER_CACHE_SIZE;
+    if (entry->table == NULL){
+      iconv_close(entry->converter);
+    }
+  }
+  entry->inputCCSID = inputCCSID;
+  entry->outputCCSID = outputCCSID;
+  entry->table = *table;
+  entry->converter = *converter;
+  *cached = TRUE;
+  return 0;
+}
+
+static void releaseConverter(iconv_t converter, int cached){
+  if (!cached && (converter != (iconv_t)-1)){
+    iconv_close(converter);
+  }
+}
+
 int convertCharset(char *input, 
                    int inputLength, 
                    int inputCCSID,
@@ -409,9 +951,13 @@ int convertCharset(char *input,
     return CHARSET_UNKNOWN_CCSID;
   }
 
-  iconv_t converter = iconv_open (outputCharset, inputCharset);
-  if (converter == (iconv_t) -1){
-    *reasonCode = errno;
+  int cached = FALSE;
+  SingleByteTable *table = NULL;
+  iconv_t converter = (iconv_t) -1;
+  int openStatus = getConverter(inputCCSID,inputCharset,outputCCSID,outputCharset,
+                                &table,&converter,&cached);
+  if (openStatus != 0){
+    *reasonCode = openStatus;
     return CHARSET_CONVERSION_UNIMPLEMENTED;
   }
 
@@ -439,6 +985,7 @@ int convertCharset(char *input,
     *output = outputBuffer;
     break;
   default:
+    releaseConverter(converter,cached);
     return CHARSET_INTERNAL_ERROR;
   }
 
@@ -446,11 +993,14 @@ int convertCharset(char *input,
   char* outputBufferStart = outputBuffer;
   int result = CHARSET_CONVERSION_SUCCESS;
 
-  size_t iconv_status = iconv(converter, &inputBuffer, &inputSize, &outputBuffer, &outputSize);
-  iconv_close(converter);
+  size_t iconv_status = ((table != NULL) ?
+                         singleByteConvert(table, &inputBuffer, &inputSize, &outputBuffer, &outputSize) :
+                         iconv(converter, &inputBuffer, &inputSize, &outputBuffer, &outputSize));
+  int iconvErrno = errno;
+  releaseConverter(converter,cached);
 
   if (iconv_status == -1){
-    switch(errno) {
+    switch(iconvErrno) {
     case E2BIG: 
       result = CHARSET_SHORT_BUFFER;
       break;
@@ -493,10 +1043,218 @@ int convertCharset(char *input,
   }
   return result;
 }
+
+/*
+  The streaming converter owns its iconv_t rather than borrowing one from the thread's cache,
+  because a stream may be continued on another thread.  Input that ends in the middle of a
+  multibyte character is held back in 'pending' and completed by the next chunk.
+ */
+
+#define CHARSET_PENDING_MAX 16
+
+struct CharsetConverter_tag{
+  char eyecatcher[8];            /* RSCHRCNV */
+  int inputCCSID;
+  int outputCCSID;
+  SingleByteTable *table;        /* if the pair is table driven, otherwise converter */
+  iconv_t converter;
+  int pendingLength;
+  char pending[CHARSET_PENDING_MAX];
+};
+
+CharsetConverter *makeCharsetConverter(int inputCCSID, int outputCCSID, int *reasonCode){
+  *reasonCode = 0;
+  const char *inputCharset = getCharsetName(inputCCSID);
+  const char *outputCharset = getCharsetName(outputCCSID);
+  if ((inputCharset == NULL) || (outputCharset == NULL)){
+    *reasonCode = CHARSET_UNKNOWN_CCSID;
+    return NULL;
+  }
+  SingleByteTable *table = getSingleByteTable(inputCCSID,outputCCSID);
+  iconv_t converter = (iconv_t)-1;
+  if (table == NULL){
+    converter = openConverter(outputCharset,inputCharset);
+    if (converter == (iconv_t)-1){
+      *reasonCode = errno;
+      return NULL;
+    }
+  }
+  CharsetConverter *charsetConverter = (CharsetConverter*)safeMalloc(sizeof(CharsetConverter),"CharsetConverter");
+  memcpy(charsetConverter->eyecatcher,"RSCHRCNV",8);
+  charsetConverter->inputCCSID = inputCCSID;
+  charsetConverter->outputCCSID = outputCCSID;
+  charsetConverter->table = table;
+  charsetConverter->converter = converter;
+  return charsetConverter;
+}
+
+static size_t streamConvert(CharsetConverter *charsetConverter,
+                            char **inputBuffer, size_t *inputSize,
+                            char **outputBuffer, size_t *outputSize){
+  if (charsetConverter->table != NULL){
+    return singleByteConvert(charsetConverter->table,inputBuffer,inputSize,outputBuffer,outputSize);
+  }
+  return iconv(charsetConverter->converter,inputBuffer,inputSize,outputBuffer,outputSize);
+}
+
+static int iconvErrorStatus(int error){
+  switch (error){
+  case E2BIG:
+    return CHARSET_SHORT_BUFFER;
+  case EILSEQ:
+  case EINVAL:
+    return CHARSET_CONVERSION_ROUTINE_FAILURE;
+  default:
+    return CHARSET_INTERNAL_ERROR;
+  }
+}
+
+int charsetConverterConvert(CharsetConverter *charsetConverter,
+                            char *input, int inputLength,
+                            char *output, int outputLength,
+                            int *inputConsumed, int *outputProduced,
+                            int *reasonCode){
+  char *outputBuffer = output;
+  size_t outputSize = (size_t)outputLength;
+  int inputOffset = 0;
+
+  *inputConsumed = 0;
+  *outputProduced = 0;
+  *reasonCode = 0;
+
+  if (charsetConverter->pendingLength > 0){
+    /* finish the held-back character with the first bytes of this chunk */
+    int previous = charsetConverter->pendingLength;
+    int take = CHARSET_PENDING_MAX - previous;
+    if (take > inputLength){
+      take = inputLength;
+    }
+    memcpy(charsetConverter->pending + previous,input,take);
+    char *pendingBuffer = charsetConverter->pending;
+    size_t pendingSize = (size_t)(previous + take);
+    size_t status = streamConvert(charsetConverter,&pendingBuffer,&pendingSize,&outputBuffer,&outputSize);
+    int error = errno;
+    int used = previous + take - (int)pendingSize;
+    *outputProduced = (int)(outputBuffer - output);
+    if (used < previous){
+      /* the held-back bytes are still not converted */
+      int stillPending = previous - used;
+      if ((status == (size_t)-1) && (error == EINVAL) && (take == inputLength)){
+        /* even the whole chunk does not complete the character, so keep all of it */
+        memmove(charsetConverter->pending,pendingBuffer,(int)pendingSize);
+        charsetConverter->pendingLength = (int)pendingSize;
+        *inputConsumed = inputLength;
+        return CHARSET_CONVERSION_SUCCESS;
+      }
+      memmove(charsetConverter->pending,charsetConverter->pending + used,stillPending);
+      charsetConverter->pendingLength = stillPending;
+      *reasonCode = error;
+      return (status == (size_t)-1) ? iconvErrorStatus(error) : CHARSET_INTERNAL_ERROR;
+    }
+    charsetConverter->pendingLength = 0;
+    inputOffset = used - previous;
+    *inputConsumed = inputOffset;
+    if ((status == (size_t)-1) && (error != EINVAL)){
+      *reasonCode = error;
+      return iconvErrorStatus(error);
+    }
+  }
+
+  char *inputBuffer = input + inputOffset;
+  size_t inputSize = (size_t)(inputLength - inputOffset);
+  size_t status = streamConvert(charsetConverter,&inputBuffer,&inputSize,&outputBuffer,&outputSize);
+  int error = errno;
+  *inputConsumed = (int)(inputBuffer - input);
+  *outputProduced = (int)(outputBuffer - output);
+  if (status == (size_t)-1){
+    if ((error == EINVAL) && (inputSize <= CHARSET_PENDING_MAX)){
+      /* an incomplete character at the end of the chunk */
+      memcpy(charsetConverter->pending,inputBuffer,(int)inputSize);
+      charsetConverter->pendingLength = (int)inputSize;
+      *inputConsumed = inputLength;
+      return CHARSET_CONVERSION_SUCCESS;
+    }
+    *reasonCode = error;
+    return iconvErrorStatus(error);
+  }
+  return CHARSET_CONVERSION_SUCCESS;
+}
+
+int charsetConverterFinish(CharsetConverter *charsetConverter,
+                           char *output, int outputLength,
+                           int *outputProduced, int *reasonCode){
+  char *outputBuffer = output;
+  size_t outputSize = (size_t)outputLength;
+  int result = CHARSET_CONVERSION_SUCCESS;
+
+  *outputProduced = 0;
+  *reasonCode = 0;
+  if (charsetConverter->pendingLength > 0){
+    /* the input ended in the middle of a character */
+    result = CHARSET_CONVERSION_ROUTINE_FAILURE;
+    *reasonCode = EINVAL;
+  }
+  if ((charsetConverter->table == NULL) &&
+      (iconv(charsetConverter->converter,NULL,NULL,&outputBuffer,&outputSize) == (size_t)-1)){
+    *reasonCode = errno;
+    result = iconvErrorStatus(errno);
+  }
+  *outputProduced = (int)(outputBuffer - output);
+  if (result != CHARSET_SHORT_BUFFER){
+    if (charsetConverter->table == NULL){
+      iconv(charsetConverter->converter,NULL,NULL,NULL,NULL);
+    }
+    charsetConverter->pendingLength = 0;
+  }
+  return result;
+}
+
+void freeCharsetConverter(CharsetConverter *charsetConverter){
+  if (charsetConverter != NULL){
+    if (charsetConverter->table == NULL){
+      iconv_close(charsetConverter->converter);
+    }
+    safeFree((char*)charsetConverter,sizeof(CharsetConverter));
+  }
+}
+
 #else  
 #error Unknown OS
 #endif
 
+#if !(defined(__ZOWE_OS_LINUX) || defined(__ZOWE_OS_AIX) || (defined(__ZOWE_OS_ZOS) && defined(__ZOWE_COMP_XLCLANG)))
+
+/* Streaming conversion is only built on iconv; callers fall back to convertCharset */
+
+CharsetConverter *makeCharsetConverter(int inputCCSID, int outputCCSID, int *reasonCode){
+  *reasonCode = CHARSET_CONVERSION_UNIMPLEMENTED;
+  return NULL;
+}
+
+int charsetConverterConvert(CharsetConverter *charsetConverter,
+                            char *input, int inputLength,
+                            char *output, int outputLength,
+                            int *inputConsumed, int *outputProduced,
+                            int *reasonCode){
+  *inputConsumed = 0;
+  *outputProduced = 0;
+  *reasonCode = 0;
+  return CHARSET_CONVERSION_UNIMPLEMENTED;
+}
+
+int charsetConverterFinish(CharsetConverter *charsetConverter,
+                           char *output, int outputLength,
+                           int *outputProduced, int *reasonCode){
+  *outputProduced = 0;
+  *reasonCode = 0;
+  return CHARSET_CONVERSION_UNIMPLEMENTED;
+}
+
+void freeCharsetConverter(CharsetConverter *charsetConverter){
+}
+
+#endif
+
 
 
 
@@ -37,6 +37,15 @@
 #endif /* METTLE */
 
 #include "zowetypes.h"
+
+#if defined(__ZOWE_OS_LINUX) || defined(__ZOWE_OS_AIX)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+#if defined(__ZOWE_OS_LINUX)
+#include <sys/sendfile.h>
+#endif
+
 #include "alloc.h"
 #include "utils.h"
 #include "openprims.h"
@@ -244,6 +253,177 @@ int writeFully(Socket *socket, char *buffer, int len){
   return 1;
 }
 
+/* Gathered writes are coalesced into one buffer of this size when the platform
+   cannot hand an iovec to the kernel (z/OS, Windows, or a TLS socket), so that
+   a small response still goes out in one socketWrite/TLS record. */
+#define GATHER_BUFFER_SIZE 8192
+
+#if (defined(__ZOWE_OS_LINUX) || defined(__ZOWE_OS_AIX)) && !defined(METTLE)
+
+#define MAX_GATHER_IOV 16
+
+static int canWriteVectorDirectly(Socket *socket){
+#ifdef USE_RS_SSL
+  if (socket->sslHandle != NULL){
+    return FALSE;
+  }
+#endif
+#ifdef USE_ZOWE_TLS
+  if (socket->tlsSocket != NULL){
+    return FALSE;
+  }
+#endif
+  return TRUE;
+}
+
+static int writeFullyVectorNative(Socket *socket, HttpIOVector *vector, int count, int flags){
+  struct iovec iov[MAX_GATHER_IOV];
+  int iovCount = 0;
+  for (int i = 0; i < count; i++){
+    if (vector[i].length > 0){
+      iov[iovCount].iov_base = vector[i].data;
+      iov[iovCount].iov_len = (size_t)vector[i].length;
+      iovCount++;
+    }
+  }
+  int first = 0;
+  struct msghdr message;
+  memset(&message,0,sizeof(struct msghdr));
+  int sendFlags = 0;
+#ifdef MSG_MORE
+  if (flags & HTTP_WRITE_MORE_TO_FOLLOW){
+    sendFlags |= MSG_MORE;
+  }
+#endif
+#ifdef MSG_NOSIGNAL
+  sendFlags |= MSG_NOSIGNAL;
+#endif
+  while (first < iovCount){
+    message.msg_iov = &iov[first];
+    message.msg_iovlen = iovCount - first;
+    ssize_t status = sendmsg(socket->sd,&message,sendFlags);
+    if (status >= 0){
+      size_t written = (size_t)status;
+      while (first < iovCount && written >= iov[first].iov_len){
+        written -= iov[first].iov_len;
+        first++;
+      }
+      if (first < iovCount){
+        iov[first].iov_base = ((char*)iov[first].iov_base) + written;
+        iov[first].iov_len -= written;
+      }
+    } else if (errno == EINTR){
+      continue;
+    } else if (WRITE_FORCE && (errno == EAGAIN || errno == EWOULDBLOCK)){
+      int returnCode = 0;
+      int reasonCode = 0;
+      PollItem item = {0};
+      item.fd = socket->sd;
+      item.events = POLLEWRNORM;
+      fdPoll(&item, 0, 1, POLL_TIME, &returnCode, &reasonCode);
+    } else {
+      zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG2, "IO error while writing vector, errno=%d\n",errno);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+#endif
+
+/*
+  writeFullyVector writes all the pieces of the vector to the socket, in order, with as few
+  system calls as the platform allows.  Returns 1 on success and 0 on failure, like writeFully.
+ */
+int writeFullyVector(Socket *socket, HttpIOVector *vector, int count, int flags){
+  int total = 0;
+  for (int i = 0; i < count; i++){
+    total += vector[i].length;
+  }
+  if (total == 0){
+    return 1;
+  }
+#if (defined(__ZOWE_OS_LINUX) || defined(__ZOWE_OS_AIX)) && !defined(METTLE)
+  if (count <= MAX_GATHER_IOV && canWriteVectorDirectly(socket)){
+    return writeFullyVectorNative(socket,vector,count,flags);
+  }
+#endif
+  if (total <= GATHER_BUFFER_SIZE){
+    char gatherBuffer[GATHER_BUFFER_SIZE];
+    int pos = 0;
+    for (int i = 0; i < count; i++){
+      if (vector[i].length > 0){
+        memcpy(gatherBuffer+pos,vector[i].data,vector[i].length);
+        pos += vector[i].length;
+      }
+    }
+    return writeFully(socket,gatherBuffer,pos);
+  } else {
+    for (int i = 0; i < count; i++){
+      if (vector[i].length > 0){
+        if (writeFully(socket,vector[i].data,vector[i].length) == 0){
+          return 0;
+        }
+      }
+    }
+    return 1;
+  }
+}
+
+
+/*
+  writeFullyFromFile hands the byte range of an open file to the kernel to be sent on the socket
+  without passing through a user-space buffer.  Returns 1 on success, 0 on an IO failure after
+  some data may have been sent, and -1 if nothing was sent because this platform or socket
+  (e.g. TLS) cannot do it, in which case the caller should fall back to read and write.
+ */
+int writeFullyFromFile(Socket *socket, int fd, int64 offset, int64 length){
+#if defined(__ZOWE_OS_LINUX) && !defined(METTLE)
+#ifdef USE_RS_SSL
+  if (socket->sslHandle != NULL){
+    return -1;
+  }
+#endif
+#ifdef USE_ZOWE_TLS
+  if (socket->tlsSocket != NULL){
+    return -1;
+  }
+#endif
+  off_t fileOffset = (off_t)offset;
+  int64 remaining = length;
+  int anySent = FALSE;
+  while (remaining > 0){
+    size_t piece = (remaining > 0x40000000) ? 0x40000000 : (size_t)remaining;
+    ssize_t status = sendfile(socket->sd,fd,&fileOffset,piece);
+    if (status > 0){
+      remaining -= status;
+      anySent = TRUE;
+    } else if (status == 0){
+      /* the file is shorter than its stat said */
+      zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG2, "sendfile hit EOF with %lld bytes left\n",(long long)remaining);
+      return 0;
+    } else if (errno == EINTR){
+      continue;
+    } else if (WRITE_FORCE && (errno == EAGAIN || errno == EWOULDBLOCK)){
+      int returnCode = 0;
+      int reasonCode = 0;
+      PollItem item = {0};
+      item.fd = socket->sd;
+      item.events = POLLEWRNORM;
+      fdPoll(&item, 0, 1, POLL_TIME, &returnCode, &reasonCode);
+    } else if (!anySent && (errno == EINVAL || errno == ENOSYS)){
+      return -1;
+    } else {
+      zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG2, "IO error in sendfile, errno=%d\n",errno);
+      return 0;
+    }
+  }
+  return 1;
+#else
+  return -1;
+#endif
+}
+
 
 /*
   This program and the accompanying materials are
@@ -254,4 +434,3 @@ int writeFully(Socket *socket, char *buffer, int len){
   
   Copyright Contributors to the Zowe Project.
 */
-
@@ -25,6 +25,12 @@
 #include "utils.h"
 #include "xlate.h"
 #include "bpxnet.h"
+#include "unixfile.h"
+#include "charsets.h"
+#ifndef METTLE
+#include <time.h>
+#include "openprims.h"
+#endif
 #include "httpclient.h"
 
 #define HTTP_CLIENT_SLH_BLOCKSIZE    65536
@@ -32,6 +38,7 @@
 #define HTTP_CLIENT_SETTINGS_SLHSIZE 8192
 #define HTTP_CLIENT_DEFAULT_TIMEOUT  3
 #define HTTP_CLIENT_JSONBLOB_BUFSIZE 512
+#define HTTP_CLIENT_STREAM_BUFSIZE   16384
 
 #define HTTP_STATE_RESP_STATUS_VERSION   1
 #define HTTP_STATE_RESP_STATUS_GAP1      2
@@ -175,6 +182,14 @@ static void addResponseHeader(HttpResponseParser *parser) {
     parser->specifiedContentLength = atoi(newHeader->nativeValue);
   } else if (!compareIgnoringCase(newHeader->nativeName, "Content-Type", parser->headerNameLength)) {
     parser->contentType = newHeader->nativeValue;
+  } else if (!compareIgnoringCase(newHeader->nativeName, "Connection", parser->headerNameLength)) {
+    if (parser->headerValueLength == 5 &&
+        !compareIgnoringCase(newHeader->nativeValue, "close", 5)) {
+      parser->connectionClose = TRUE;
+    } else if (parser->headerValueLength == 10 &&
+               !compareIgnoringCase(newHeader->nativeValue, "keep-alive", 10)) {
+      parser->connectionKeepAlive = TRUE;
+    }
   }
 
   HttpHeader *headerChain = parser->headerChain;
@@ -205,6 +220,102 @@ static int asciiHexDigitDecimalValue(char c) {
   return -1;
 }
 
+static HttpClientResponse *makeHttpClientResponse(HttpResponseParser *parser, char *body, int contentLength) {
+  HttpClientResponse *resp = (HttpClientResponse*)SLHAlloc(parser->slh, sizeof(HttpClientResponse));
+  memset(resp, 0, sizeof(HttpClientResponse));
+  resp->slh = parser->slh;
+  resp->statusCode = parser->httpStatusCode;
+  resp->headers = parser->headerChain;
+  resp->contentLength = contentLength;
+  resp->body = body;
+  /* statusReason holds everything after the version, i.e. the code as well */
+  char *reason = copyStringToNative(parser->slh, parser->statusReason, parser->statusReasonLength);
+  while (*reason && *reason != ' ') {
+    reason++;
+  }
+  while (*reason == ' ') {
+    reason++;
+  }
+  resp->statusReason = reason;
+  char *version = copyStringToNative(parser->slh, parser->version, parser->versionLength);
+  if (!strcmp(version, "HTTP/1.1")) {
+    resp->keepAlive = !parser->connectionClose;
+  } else {
+    resp->keepAlive = parser->connectionKeepAlive;
+  }
+  if (parser->readUntilClose) {
+    /* the end of the body was guessed, so what follows on the connection is unknown */
+    resp->keepAlive = FALSE;
+  }
+  return resp;
+}
+
+/*
+  An interim (1xx) response such as 100 Continue or 103 Early Hints is followed by the real one on
+  the same connection, so the parser starts over on the next status line.  101 is final.
+ */
+static int isInterimResponse(HttpResponseParser *parser) {
+  int status = parser->httpStatusCode;
+  return (status >= 100) && (status < 200) && (status != 101);
+}
+
+static void restartResponseStatus(HttpResponseParser *parser) {
+  parser->state = HTTP_STATE_RESP_STATUS_VERSION;
+  parser->versionLength = 0;
+  parser->statusReasonLength = 0;
+  parser->headerNameLength = 0;
+  parser->headerValueLength = 0;
+  parser->headerChain = NULL;
+  parser->isChunked = FALSE;
+  parser->contentType = NULL;
+  parser->specifiedContentLength = -1;
+  parser->httpStatusCode = 0;
+  parser->connectionClose = FALSE;
+  parser->connectionKeepAlive = FALSE;
+}
+
+/*
+  Streaming mode, at the end of the headers: works out how the body is delimited and hands the
+  headers to the response handler.  Sets *outClientResponse if there is no body to follow.
+ */
+static int startStreamedBody(HttpResponseParser *parser, HttpClientResponse **outClientResponse) {
+  int status = parser->httpStatusCode;
+  int hasBody = !parser->noBody && (status >= 200) && (status != 204) && (status != 304);
+  int announcedLength = parser->isChunked ? -1 : parser->specifiedContentLength;
+  parser->resp = makeHttpClientResponse(parser, NULL, hasBody ? announcedLength : 0);
+  if (hasBody && announcedLength < 0 && !parser->isChunked) {
+    /* the body runs to the end of the connection */
+    parser->resp->keepAlive = FALSE;
+  }
+  if (parser->responseHandler && parser->responseHandler(parser->resp, parser->handlerData) != 0) {
+    parser->aborted = TRUE;
+    return ANSI_FAILED;
+  }
+  if (!hasBody || parser->specifiedContentLength == 0) {
+    *outClientResponse = parser->resp;
+  } else if (parser->isChunked) {
+    parser->specifiedChunkLength = -1;
+    parser->state = HTTP_STATE_READING_CHUNK_HEADER;
+  } else if (parser->specifiedContentLength > 0) {
+    parser->remainingContentLength = parser->specifiedContentLength;
+    parser->state = HTTP_STATE_READING_FIXED_BODY;
+  } else {
+    parser->readUntilClose = TRUE;
+    parser->state = HTTP_STATE_READING_FIXED_BODY;
+  }
+  return ANSI_OK;
+}
+
+/* streaming mode: passes as much of the fragment as belongs to the body, returns the count */
+static int streamBodyBytes(HttpResponseParser *parser, char *data, int available, int remaining) {
+  int count = (remaining >= 0 && remaining < available) ? remaining : available;
+  if (parser->bodyHandler(data, count, parser->handlerData) != 0) {
+    parser->aborted = TRUE;
+    return -1;
+  }
+  return count;
+}
+
 /* returns ansi status */
 static int processHttpResponseFragment(HttpResponseParser *parser,
                                        char *data,
@@ -366,7 +477,17 @@ static int processHttpResponseFragment(HttpResponseParser *parser,
         }
         break;
       case HTTP_STATE_END_CR_SEEN:
-        if (isLF) {
+        if (isLF && isInterimResponse(parser)) {
+          zowelog(NULL, LOG_COMP_HTTPCLIENT, ZOWE_LOG_DEBUG, "____ Skipping interim %d response ____\n", parser->httpStatusCode);
+          restartResponseStatus(parser);
+        } else if (isLF && (NULL != parser->bodyHandler)) {
+          if (ANSI_OK != startStreamedBody(parser, outClientResponse)) {
+            return ANSI_FAILED;
+          }
+          if (NULL != *outClientResponse) {
+            return ANSI_OK;
+          }
+        } else if (isLF) {
           /* read entity body - if present */
           if (parser->isChunked) {
             zowelog(NULL, LOG_COMP_HTTPCLIENT, ZOWE_LOG_DEBUG, "____ end CR -> READING_CHUNK_HEADER ____\n");
@@ -385,12 +506,7 @@ static int processHttpResponseFragment(HttpResponseParser *parser,
               parser->contentSize = HTTP_CLIENT_MAX_RESPONSE;
             }
             /* allocate response and use resp->contentLength as accumulator */
-            parser->resp = (HttpClientResponse*)SLHAlloc(parser->slh, sizeof(HttpClientResponse));
-            parser->resp->slh = parser->slh;
-            parser->resp->statusCode = parser->httpStatusCode;
-            parser->resp->headers = parser->headerChain;
-            parser->resp->contentLength = 0;
-            parser->resp->body = parser->content;
+            parser->resp = makeHttpClientResponse(parser, parser->content, 0);
             /* do NOT output resp address until chunk parsing succeeds */
           } else {
             /* fixed or no body */
@@ -405,18 +521,17 @@ static int processHttpResponseFragment(HttpResponseParser *parser,
                                    /* there was no Content-length header, but we got more data */
                 zowelog(NULL, LOG_COMP_HTTPCLIENT, ZOWE_LOG_DEBUG, "____ Simulating Content-length of %d ____\n", (len - i) - 1);
                 parser->specifiedContentLength = (len - i) - 1;
+                parser->readUntilClose = TRUE;
                 parser->state = HTTP_STATE_READING_FIXED_BODY;
                 parser->content = SLHAlloc(parser->slh, parser->specifiedContentLength);
                 parser->contentSize = parser->specifiedContentLength;
                 parser->remainingContentLength = parser->specifiedContentLength;
               } else { /* no body */
                 zowelog(NULL, LOG_COMP_HTTPCLIENT, ZOWE_LOG_DEBUG, "____ No body, output response  ______\n");
-                parser->resp = (HttpClientResponse*)SLHAlloc(parser->slh, sizeof(HttpClientResponse));
-                parser->resp->slh = parser->slh;
-                parser->resp->statusCode = parser->httpStatusCode;
-                parser->resp->headers = parser->headerChain;
-                parser->resp->contentLength = 0;
-                parser->resp->body = NULL;
+                int status = parser->httpStatusCode;
+                parser->readUntilClose = (parser->specifiedContentLength < 0) && !parser->noBody &&
+                                         (status >= 200) && (status != 204) && (status != 304);
+                parser->resp = makeHttpClientResponse(parser, NULL, 0);
                 *outClientResponse = parser->resp;
               }
             }
@@ -426,16 +541,27 @@ static int processHttpResponseFragment(HttpResponseParser *parser,
         }
         break;
       case HTTP_STATE_READING_FIXED_BODY:
+        if (NULL != parser->bodyHandler) {
+          int remaining = parser->readUntilClose ? -1 : parser->remainingContentLength;
+          int count = streamBodyBytes(parser, data + i, len - i, remaining);
+          if (count < 0) {
+            return ANSI_FAILED;
+          }
+          i += count - 1;
+          if (!parser->readUntilClose) {
+            parser->remainingContentLength -= count;
+            if (parser->remainingContentLength <= 0) {
+              *outClientResponse = parser->resp;
+              return ANSI_OK;
+            }
+          }
+          break;
+        }
         parser->content[parser->specifiedContentLength - parser->remainingContentLength] = (char)c;
         --(parser->remainingContentLength);
         if (parser->remainingContentLength <= 0) {
           zowelog(NULL, LOG_COMP_HTTPCLIENT, ZOWE_LOG_DEBUG, "_____ END OF FIXED BODY _________\n");
-          parser->resp = (HttpClientResponse*)SLHAlloc(parser->slh, sizeof(HttpClientResponse));
-          parser->resp->slh = parser->slh;
-          parser->resp->statusCode = parser->httpStatusCode;
-          parser->resp->headers = parser->headerChain;
-          parser->resp->contentLength = parser->specifiedContentLength;
-          parser->resp->body = parser->content;
+          parser->resp = makeHttpClientResponse(parser, parser->content, parser->specifiedContentLength);
           *outClientResponse = parser->resp;
         }
         break;
@@ -474,7 +600,14 @@ static int processHttpResponseFragment(HttpResponseParser *parser,
         }
         break;
       case HTTP_STATE_READING_CHUNK_DATA:
-        if (0 < parser->remainingChunkLength) {
+        if ((0 < parser->remainingChunkLength) && (NULL != parser->bodyHandler)) {
+          int count = streamBodyBytes(parser, data + i, len - i, parser->remainingChunkLength);
+          if (count < 0) {
+            return ANSI_FAILED;
+          }
+          i += count - 1;
+          parser->remainingChunkLength -= count;
+        } else if (0 < parser->remainingChunkLength) {
           if (parser->contentSize > parser->resp->contentLength) {
             parser->content[parser->resp->contentLength++] = c;
             --(parser->remainingChunkLength);
@@ -510,7 +643,10 @@ static int processHttpResponseFragment(HttpResponseParser *parser,
         }
         break;
       case HTTP_STATE_CHUNK_TRAILER_CR_SEEN:
-        if (isLF) {
+        if (isLF && (NULL != parser->bodyHandler)) {
+          *outClientResponse = parser->resp;
+          return ANSI_OK;
+        } else if (isLF) {
           /* output response and reset parser */
           *outClientResponse = parser->resp;
           resetHttpResponseParser(parser);
@@ -523,6 +659,135 @@ static int processHttpResponseFragment(HttpResponseParser *parser,
   return ANSI_OK;
 }
 
+/*
+  Connection pool.  Connections are kept per context, and a context is for one host:port.  Not
+  available under METTLE, where there is no mutex to guard it.
+ */
+
+typedef struct HttpClientPooledSocket_tag {
+  Socket *socket;
+  time_t idleSince;
+  struct HttpClientPooledSocket_tag *next;
+} HttpClientPooledSocket;
+
+typedef struct HttpClientPool_tag {
+#ifndef METTLE
+  Mutex lock;
+#endif
+  HttpClientPooledSocket *idle; /* most recently used first */
+  int idleCount;
+  int maxIdle;
+  int maxIdleSeconds;
+} HttpClientPool;
+
+static void closeClientSocket(Socket *socket) {
+  int bpxrc = 0, bpxrsn = 0;
+  socketClose(socket, &bpxrc, &bpxrsn);
+  socketFree(socket);
+}
+
+void httpClientContextSetPool(HttpClientContext *ctx, int maxIdle, int maxIdleSeconds) {
+#ifndef METTLE
+  HttpClientPool *pool = ctx->pool;
+  if (NULL == pool) {
+    pool = (HttpClientPool*)safeMalloc(sizeof(HttpClientPool), "http client pool");
+    memset(pool, 0, sizeof(HttpClientPool));
+    mutexCreate(pool->lock);
+    ctx->pool = pool;
+  }
+  HttpClientPooledSocket *surplus = NULL;
+  mutexLock(pool->lock);
+  pool->maxIdle = maxIdle;
+  pool->maxIdleSeconds = maxIdleSeconds;
+  while (pool->idleCount > pool->maxIdle) {
+    /* the list is newest first, so drop from the front until it fits */
+    HttpClientPooledSocket *entry = pool->idle;
+    pool->idle = entry->next;
+    pool->idleCount--;
+    entry->next = surplus;
+    surplus = entry;
+  }
+  mutexUnlock(pool->lock);
+  while (surplus) {
+    HttpClientPooledSocket *next = surplus->next;
+    closeClientSocket(surplus->socket);
+    safeFree((char*)surplus, sizeof(HttpClientPooledSocket));
+    surplus = next;
+  }
+#endif
+}
+
+/* an idle connection with something to read has been closed by the server (or is out of step) */
+static Socket *checkOutPooledSocket(HttpClientContext *ctx) {
+#ifndef METTLE
+  HttpClientPool *pool = ctx->pool;
+  if (NULL == pool) {
+    return NULL;
+  }
+  time_t now = time(NULL);
+  while (TRUE) {
+    mutexLock(pool->lock);
+    HttpClientPooledSocket *entry = pool->idle;
+    if (entry) {
+      pool->idle = entry->next;
+      pool->idleCount--;
+    }
+    mutexUnlock(pool->lock);
+    if (NULL == entry) {
+      break;
+    }
+    Socket *socket = entry->socket;
+    int fresh = (now - entry->idleSince) <= pool->maxIdleSeconds;
+    safeFree((char*)entry, sizeof(HttpClientPooledSocket));
+    int bpxrc = 0, bpxrsn = 0;
+    if (fresh && (SD_STATUS_TIMEOUT == tcpStatus(socket, 0, FALSE, &bpxrc, &bpxrsn))) {
+      return socket;
+    }
+    HTTP_CLIENT_TRACE_VERBOSE("Dropping %s pooled connection\n", fresh ? "closed" : "expired");
+    closeClientSocket(socket);
+  }
+#endif
+  return NULL;
+}
+
+/* returns TRUE if the pool took the socket */
+static int checkInPooledSocket(HttpClientContext *ctx, Socket *socket) {
+#ifndef METTLE
+  HttpClientPool *pool = ctx->pool;
+  if ((NULL == pool) || (0 >= pool->maxIdle)) {
+    return FALSE;
+  }
+  HttpClientPooledSocket *entry = (HttpClientPooledSocket*)safeMalloc(sizeof(HttpClientPooledSocket), "http client pooled socket");
+  entry->socket = socket;
+  entry->idleSince = time(NULL);
+  mutexLock(pool->lock);
+  int taken = (pool->idleCount < pool->maxIdle);
+  if (taken) {
+    entry->next = pool->idle;
+    pool->idle = entry;
+    pool->idleCount++;
+  }
+  mutexUnlock(pool->lock);
+  if (!taken) {
+    safeFree((char*)entry, sizeof(HttpClientPooledSocket));
+  }
+  return taken;
+#else
+  return FALSE;
+#endif
+}
+
+static void destroyClientPool(HttpClientPool *pool) {
+  HttpClientPooledSocket *entry = pool->idle;
+  while (entry) {
+    HttpClientPooledSocket *next = entry->next;
+    closeClientSocket(entry->socket);
+    safeFree((char*)entry, sizeof(HttpClientPooledSocket));
+    entry = next;
+  }
+  safeFree((char*)pool, sizeof(HttpClientPool));
+}
+
 void httpClientSettingsDestroy(HttpClientSettings *settings) {
   if (settings) {
     if (settings->host) {
@@ -553,6 +818,9 @@ void httpClientContextDestroy(HttpClientContext *ctx) {
     if (ctx->serverAddress) {
       freeSocketAddr(ctx->serverAddress);
     }
+    if (ctx->pool) {
+      destroyClientPool(ctx->pool);
+    }
     memset(ctx, 0x00, sizeof(HttpClientContext));
     safeFree((char*)ctx, sizeof(HttpClientContext));
   }
@@ -628,6 +896,10 @@ void httpClientSessionDestroy(HttpClientSession *session) {
         /* socket has a SocketExtension; assume socket will be cleaned up
          * by whomever cleans up the SocketExtension */
         session->socket = NULL;
+      } else if (session->context && session->response && session->response->keepAlive &&
+                 checkInPooledSocket(session->context, session->socket)) {
+        /* the last response was read to its end, so the connection can take another request */
+        session->socket = NULL;
       } else {
         socketClose(session->socket, &bpxrc, &bpxrsn);
         socketFree(session->socket);
@@ -660,41 +932,49 @@ int httpClientSessionInit(HttpClientContext *ctx, HttpClientSession **outSession
       break;
     }
 
-    Socket *socket = tcpClient2(ctx->serverAddress, 1000 * ctx->recvTimeoutSeconds, &bpxrc, &bpxrsn);
-    if ((bpxrc != 0) || (NULL == socket)) {
+    Socket *socket = checkOutPooledSocket(ctx);
+    int reused = (NULL != socket);
+    if (reused) {
+      HTTP_CLIENT_TRACE_VERBOSE("Reusing pooled connection to port %d\n", ctx->serverAddress->port);
+    } else {
+      socket = tcpClient2(ctx->serverAddress, 1000 * ctx->recvTimeoutSeconds, &bpxrc, &bpxrsn);
+      if ((bpxrc != 0) || (NULL == socket)) {
 #ifdef __ZOWE_OS_ZOS
-      HTTP_CLIENT_TRACE_VERBOSE("%s (rc=%d, rsn=0x%x, addr=0x%08x, port=%d)\n", HTTP_CLIENT_MSG_CONNECT_FAILED, bpxrc,
-                                bpxrsn, ctx->serverAddress->v4Address, ctx->serverAddress->port);
+        HTTP_CLIENT_TRACE_VERBOSE("%s (rc=%d, rsn=0x%x, addr=0x%08x, port=%d)\n", HTTP_CLIENT_MSG_CONNECT_FAILED, bpxrc,
+                                  bpxrsn, ctx->serverAddress->v4Address, ctx->serverAddress->port);
 #else
-      HTTP_CLIENT_TRACE_VERBOSE("%s (rc=%d, rsn=0x%x, addr=0x%08x, port=%d)\n", HTTP_CLIENT_MSG_CONNECT_FAILED, bpxrc,
-                                bpxrsn, ctx->serverAddress->internalAddress.v4Address, ctx->serverAddress->port);
+        HTTP_CLIENT_TRACE_VERBOSE("%s (rc=%d, rsn=0x%x, addr=0x%08x, port=%d)\n", HTTP_CLIENT_MSG_CONNECT_FAILED, bpxrc,
+                                  bpxrsn, ctx->serverAddress->internalAddress.v4Address, ctx->serverAddress->port);
 #endif
-      sts = HTTP_CLIENT_CONNECT_FAILED;
-      break;
-    } else {
+        sts = HTTP_CLIENT_CONNECT_FAILED;
+        break;
+      } else {
 #ifdef __ZOWE_OS_ZOS
-      HTTP_CLIENT_TRACE_VERBOSE("Connected to peer addr=0x%08x, port=%d)\n", ctx->serverAddress->v4Address,
-                                ctx->serverAddress->port);
+        HTTP_CLIENT_TRACE_VERBOSE("Connected to peer addr=0x%08x, port=%d)\n", ctx->serverAddress->v4Address,
+                                  ctx->serverAddress->port);
 #else
-      HTTP_CLIENT_TRACE_VERBOSE("Connected to peer port=%d)\n", ctx->serverAddress->port);
+        HTTP_CLIENT_TRACE_VERBOSE("Connected to peer port=%d)\n", ctx->serverAddress->port);
 #endif
-    }
+      }
 #ifdef USE_ZOWE_TLS
-  if (ctx->tlsEnvironment) {
-    int rc = tlsSocketInit(ctx->tlsEnvironment, &socket->tlsSocket, socket->sd, false);
-    if (rc != 0) {
-      HTTP_CLIENT_TRACE_VERBOSE("failed to init tls socket, rc=%d, (%s)", rc, tlsStrError(rc));
-      socketClose(socket, &bpxrc, &bpxrsn);
-      sts = HTTP_CLIENT_TLS_ERROR;
-      break;
-    }
-  }
+      if (ctx->tlsEnvironment) {
+        int rc = tlsSocketInit(ctx->tlsEnvironment, &socket->tlsSocket, socket->sd, false);
+        if (rc != 0) {
+          HTTP_CLIENT_TRACE_VERBOSE("failed to init tls socket, rc=%d, (%s)", rc, tlsStrError(rc));
+          socketClose(socket, &bpxrc, &bpxrsn);
+          sts = HTTP_CLIENT_TLS_ERROR;
+          break;
+        }
+      }
 #endif // USE_ZOWE_TLS
+    }
     slh = makeShortLivedHeap(HTTP_CLIENT_SLH_BLOCKSIZE, 100);
 
     session = (HttpClientSession*)safeMalloc(sizeof(HttpClientSession), "http client session");
     session->slh = slh;
     session->socket = socket;
+    session->context = ctx;
+    session->reusedConnection = reused;
 
     *outSession = session;
 
@@ -871,77 +1151,64 @@ int httpClientSessionSetBearerTokenAuthHeader(HttpClientContext *ctx, HttpClient
 }
 
 /* This function expects that the request does NOT already have a
- * Content-Length header already set! */
-static void writeRequestWithBody(HttpRequest *request, Socket *socket) {
-  int returnCode;
-  int reasonCode;
-  char line[1024];
-  int len = 0;
-  HttpHeader *headerChain = NULL;
+ * Content-Length header already set!  The request line and headers are
+ * formatted into one block and sent with the body in a single gathered
+ * write.  Returns non-zero if everything was written. */
+static int writeRequestWithBody(HttpRequest *request, Socket *socket) {
   char crlf[] = {0x0d, 0x0a};
 
   zowelog(NULL, LOG_COMP_HTTPCLIENT, ZOWE_LOG_DEBUG, "in writeRequestWithBody\n");
-  // printf("socket->sslHandle is 0x%p\n", socket->sslHandle);
-
-  len = snprintf(line, 1024, "%s %s HTTP/1.1", request->method, request->uri);
-  zowelog(NULL, LOG_COMP_HTTPCLIENT, ZOWE_LOG_DEBUG, "header: %s\n", line);
-#ifdef __ZOWE_OS_ZOS
-  e2a(line, len);
-#endif
 
-  writeFully(socket, line, len);
-#ifdef DEBUG
-  dumpbuffer(line, len);
-#endif
-
-  writeFully(socket, crlf, 2);
-#ifdef DEBUG
-  dumpbuffer(crlf, 2);
-#endif
-
-  zowelog(NULL, LOG_COMP_HTTPCLIENT, ZOWE_LOG_DEBUG, "write header chain 0x%x\n", headerChain);
-
-  if (request->contentBody && (0 < request->contentLength)) {
-    requestIntHeader(request, TRUE, "Content-Length", request->contentLength);
+  int hasBody = (request->contentBody && (0 < request->contentLength));
+  /* the request is left as it was, so it can be sent again */
+  int blockSize = strlen(request->method) + strlen(request->uri) + 16 + (hasBody ? 32 : 0);
+  HttpHeader *headerChain = request->headerChain;
+  while (headerChain) {
+    blockSize += strlen(headerChain->nativeName) + 4 +
+      (headerChain->nativeValue ? strlen(headerChain->nativeValue) : 12);
+    headerChain = headerChain->next;
   }
+  char *block = SLHAlloc(request->slh, blockSize);
+  int len = snprintf(block, blockSize, "%s %s HTTP/1.1", request->method, request->uri);
+  zowelog(NULL, LOG_COMP_HTTPCLIENT, ZOWE_LOG_DEBUG, "header: %s\n", block);
+  memcpy(block + len, crlf, 2);
+  len += 2;
+
   headerChain = request->headerChain;
   while (headerChain) {
 #ifdef DEBUG
     printf("headerChain %s %s or %d\n", headerChain->name, (headerChain->nativeValue ? headerChain->nativeValue : "<n/a>"),
            headerChain->intValue);
 #endif
-
     if (headerChain->nativeValue) {
-      len = snprintf(line, 1024, "%s: %s", headerChain->nativeName, headerChain->nativeValue);
+      len += snprintf(block + len, blockSize - len, "%s: %s", headerChain->nativeName, headerChain->nativeValue);
     } else {
-      len = snprintf(line, 1024, "%s: %d", headerChain->nativeName, headerChain->intValue);
+      len += snprintf(block + len, blockSize - len, "%s: %d", headerChain->nativeName, headerChain->intValue);
     }
-#ifdef __ZOWE_OS_ZOS
-    e2a(line, len);
-#endif
-
-    writeFully(socket, line, len);
-#ifdef DEBUG
-    dumpbuffer(line, len);
-#endif
-    writeFully(socket, crlf, 2);
-#ifdef DEBUG
-    dumpbuffer(crlf, 2);
-#endif
+    memcpy(block + len, crlf, 2);
+    len += 2;
     headerChain = headerChain->next;
   }
-
-  writeFully(socket, crlf, 2);
-#ifdef DEBUG
-  dumpbuffer(crlf, 2);
+  if (hasBody) {
+    len += snprintf(block + len, blockSize - len, "Content-Length: %d", request->contentLength);
+    memcpy(block + len, crlf, 2);
+    len += 2;
+  }
+  memcpy(block + len, crlf, 2);
+  len += 2;
+#ifdef __ZOWE_OS_ZOS
+  e2a(block, len);
 #endif
-
-  if (request->contentBody && (0 < request->contentLength)) {
-    writeFully(socket, request->contentBody, request->contentLength);
 #ifdef DEBUG
-    dumpbuffer(request->contentBody, request->contentLength);
+  dumpbuffer(block, len);
 #endif
-  }
+
+  HttpIOVector vector[2];
+  vector[0].data = block;
+  vector[0].length = len;
+  vector[1].data = request->contentBody;
+  vector[1].length = hasBody ? request->contentLength : 0;
+  return writeFullyVector(socket, vector, 2, 0);
 }
 
 int httpClientSessionSend(HttpClientContext *ctx, HttpClientSession *session) {
@@ -961,10 +1228,14 @@ int httpClientSessionSend(HttpClientContext *ctx, HttpClientSession *session) {
       break;
     }
 
-    writeRequestWithBody(session->request, session->socket);
-
     prepareForNewResponse(session);
 
+    if (!writeRequestWithBody(session->request, session->socket)) {
+      HTTP_CLIENT_TRACE_VERBOSE("%s\n", HTTP_CLIENT_MSG_SEND_ERROR);
+      sts = HTTP_CLIENT_SEND_ERROR;
+      break;
+    }
+
   } while (0);
 
   return sts;
@@ -1059,6 +1330,313 @@ int httpClientSessionReceiveNativeLoop(HttpClientContext *ctx, HttpClientSession
   return sts;
 }
 
+/*
+  Data already decrypted by the TLS layer is invisible to select.  System SSL reads whole records
+  from the socket, so that can only be left over when the previous read filled the buffer; in every
+  other case the wait is on the socket, as for plain connections.
+ */
+static int waitForResponseData(HttpClientContext *ctx, HttpClientSession *session) {
+  int bpxrc = 0, bpxrsn = 0;
+  Socket *socket = session->socket;
+#ifdef USE_ZOWE_TLS
+  if (socket->tlsSocket && session->tlsDataMayBePending) {
+    return 0;
+  }
+#endif
+  int status = tcpStatus(socket, 1000 * ctx->recvTimeoutSeconds, FALSE, &bpxrc, &bpxrsn);
+  if (status & SD_STATUS_TIMEOUT) {
+    HTTP_CLIENT_TRACE_VERBOSE("http client timed out after %d seconds waiting for the response\n", ctx->recvTimeoutSeconds);
+    return HTTP_CLIENT_TIMEOUT;
+  }
+  return 0;
+}
+
+/* switches the session's parser to streaming mode, shared by the push and pull interfaces */
+static HttpResponseParser *startStreamedResponse(HttpClientSession *session,
+                                                 HttpClientResponseHandler *responseHandler,
+                                                 HttpClientBodyHandler *bodyHandler,
+                                                 void *userData) {
+  if (NULL == session->responseParser) {
+    prepareForNewResponse(session);
+  }
+  HttpResponseParser *parser = session->responseParser;
+  parser->responseHandler = responseHandler;
+  parser->bodyHandler = bodyHandler;
+  parser->handlerData = userData;
+  parser->noBody = !strcmp(session->request->method, "HEAD");
+  if (NULL == parser->streamBuffer) {
+    parser->streamBuffer = SLHAlloc(parser->slh, HTTP_CLIENT_STREAM_BUFSIZE);
+  }
+  return parser;
+}
+
+/* one socket read pushed through the parser, sets session->response when the body is complete */
+static int receiveStreamedFragment(HttpClientContext *ctx, HttpClientSession *session) {
+  HttpResponseParser *parser = session->responseParser;
+  int bpxrc = 0, bpxrsn = 0;
+
+  int sts = waitForResponseData(ctx, session);
+  if (0 != sts) {
+    return sts;
+  }
+  int bytesRead = socketRead(session->socket, parser->streamBuffer, HTTP_CLIENT_STREAM_BUFSIZE, &bpxrc, &bpxrsn);
+  session->tlsDataMayBePending = (HTTP_CLIENT_STREAM_BUFSIZE == bytesRead);
+  if ((0 == bytesRead) && parser->readUntilClose) {
+    session->response = parser->resp;
+    return 0;
+  }
+  if (bytesRead < 1) {
+    HTTP_CLIENT_TRACE_VERBOSE("http client stream read error rc=%d, rsn=0x%x\n", bpxrc, bpxrsn);
+    return HTTP_CLIENT_READ_ERROR;
+  }
+  if (ANSI_OK != processHttpResponseFragment(parser, parser->streamBuffer, bytesRead, &(session->response))) {
+    HTTP_CLIENT_TRACE_VERBOSE("http client stream %s\n", parser->aborted ? "abandoned by handler" : "response parse error");
+    return parser->aborted ? HTTP_CLIENT_ABORTED : HTTP_CLIENT_RESP_PARSE_FAILED;
+  }
+  return 0;
+}
+
+int httpClientSessionReceiveStream(HttpClientContext *ctx,
+                                   HttpClientSession *session,
+                                   HttpClientResponseHandler *responseHandler,
+                                   HttpClientBodyHandler *bodyHandler,
+                                   void *userData) {
+  int sts = 0;
+
+  do {
+    if ((NULL == ctx) || (NULL == session) || (NULL == bodyHandler)) {
+      sts = HTTP_CLIENT_INVALID_ARGUMENT;
+      break;
+    }
+    if (NULL == session->request) {
+      sts = HTTP_CLIENT_NO_REQUEST;
+      break;
+    }
+    startStreamedResponse(session, responseHandler, bodyHandler, userData);
+    while ((0 == sts) && (NULL == session->response)) {
+      sts = receiveStreamedFragment(ctx, session);
+    }
+  } while (0);
+
+  return sts;
+}
+
+/* a read never yields more body bytes than it read, so pendingBody cannot overflow */
+static int collectPendingBody(char *data, int length, void *userData) {
+  HttpResponseParser *parser = (HttpResponseParser*)userData;
+  if (parser->pendingBodyLength + length > HTTP_CLIENT_STREAM_BUFSIZE) {
+    return 1;
+  }
+  memcpy(parser->pendingBody + parser->pendingBodyLength, data, length);
+  parser->pendingBodyLength += length;
+  return 0;
+}
+
+int httpClientSessionReceiveHead(HttpClientContext *ctx, HttpClientSession *session,
+                                 HttpClientResponse **outResponse) {
+  int sts = 0;
+
+  do {
+    if ((NULL == ctx) || (NULL == session) || (NULL == outResponse)) {
+      sts = HTTP_CLIENT_INVALID_ARGUMENT;
+      break;
+    }
+    if (NULL == session->request) {
+      sts = HTTP_CLIENT_NO_REQUEST;
+      break;
+    }
+    HttpResponseParser *parser = startStreamedResponse(session, NULL, collectPendingBody, NULL);
+    parser->handlerData = parser;
+    if (NULL == parser->pendingBody) {
+      parser->pendingBody = SLHAlloc(parser->slh, HTTP_CLIENT_STREAM_BUFSIZE);
+    }
+    /* any body bytes that came in with the headers wait in pendingBody */
+    while ((0 == sts) && (NULL == parser->resp)) {
+      sts = receiveStreamedFragment(ctx, session);
+    }
+    if (0 == sts) {
+      *outResponse = parser->resp;
+    }
+  } while (0);
+
+  return sts;
+}
+
+int httpClientSessionReadBody(HttpClientContext *ctx, HttpClientSession *session,
+                              char **outData, int *outLength) {
+  int sts = 0;
+
+  do {
+    if ((NULL == ctx) || (NULL == session) || (NULL == outData) || (NULL == outLength)) {
+      sts = HTTP_CLIENT_INVALID_ARGUMENT;
+      break;
+    }
+    HttpResponseParser *parser = session->responseParser;
+    if ((NULL == parser) || (NULL == parser->pendingBody) || (NULL == parser->resp)) {
+      /* httpClientSessionReceiveHead comes first */
+      sts = HTTP_CLIENT_INVALID_ARGUMENT;
+      break;
+    }
+    if (parser->pendingBodyTaken) {
+      parser->pendingBodyLength = 0;
+      parser->pendingBodyTaken = FALSE;
+    }
+    while ((0 == sts) && (0 == parser->pendingBodyLength) && (NULL == session->response)) {
+      sts = receiveStreamedFragment(ctx, session);
+    }
+    if (0 != sts) {
+      break;
+    }
+    *outData = parser->pendingBody;
+    *outLength = parser->pendingBodyLength;
+    parser->pendingBodyTaken = TRUE;
+  } while (0);
+
+  return sts;
+}
+
+typedef struct HttpClientFileSink_tag {
+  const char *filename;
+  UnixFile *file;
+  int64 bytesWritten;
+  int failed;
+} HttpClientFileSink;
+
+/* the file is only opened once the status says the body is the real thing */
+static int openFileSink(HttpClientResponse *response, void *userData) {
+  HttpClientFileSink *sink = (HttpClientFileSink*)userData;
+  int returnCode = 0, reasonCode = 0;
+  if ((response->statusCode < 200) || (response->statusCode > 299)) {
+    return 0;
+  }
+  sink->file = fileOpen(sink->filename, FILE_OPTION_CREATE | FILE_OPTION_TRUNCATE | FILE_OPTION_WRITE_ONLY,
+                        0700, 0, &returnCode, &reasonCode);
+  if (NULL == sink->file) {
+    HTTP_CLIENT_TRACE_VERBOSE("http client could not open %s, rc=%d, rsn=0x%x\n", sink->filename, returnCode, reasonCode);
+    sink->failed = TRUE;
+    return 1;
+  }
+  return 0;
+}
+
+static int writeFileSink(char *data, int length, void *userData) {
+  HttpClientFileSink *sink = (HttpClientFileSink*)userData;
+  int returnCode = 0, reasonCode = 0;
+  if (NULL == sink->file) {
+    return 0;
+  }
+  while (length > 0) {
+    int written = fileWrite(sink->file, data, length, &returnCode, &reasonCode);
+    if (written <= 0) {
+      HTTP_CLIENT_TRACE_VERBOSE("http client write to %s failed, rc=%d, rsn=0x%x\n", sink->filename, returnCode, reasonCode);
+      sink->failed = TRUE;
+      return 1;
+    }
+    data += written;
+    length -= written;
+    sink->bytesWritten += written;
+  }
+  return 0;
+}
+
+int httpClientSessionReceiveToFile(HttpClientContext *ctx, HttpClientSession *session,
+                                   const char *filename, int64 *outBytesWritten) {
+  if (NULL == filename) {
+    return HTTP_CLIENT_INVALID_ARGUMENT;
+  }
+  HttpClientFileSink sink;
+  memset(&sink, 0, sizeof(HttpClientFileSink));
+  sink.filename = filename;
+
+  int sts = httpClientSessionReceiveStream(ctx, session, openFileSink, writeFileSink, &sink);
+  if (sink.file) {
+    int returnCode = 0, reasonCode = 0;
+    if (0 != fileClose(sink.file, &returnCode, &reasonCode)) {
+      sink.failed = TRUE;
+    }
+  }
+  if (sink.failed) {
+    sts = HTTP_CLIENT_FILE_ERROR;
+  }
+  if (outBytesWritten) {
+    *outBytesWritten = sink.bytesWritten;
+  }
+  return sts;
+}
+
+typedef struct HttpClientJsonSink_tag {
+  char *data;
+  int length;
+  int capacity;
+  int maxLength;
+  int tooLarge;
+} HttpClientJsonSink;
+
+static int collectJsonSink(char *data, int length, void *userData) {
+  HttpClientJsonSink *sink = (HttpClientJsonSink*)userData;
+  if (length > sink->maxLength - sink->length) {
+    sink->tooLarge = TRUE;
+    return 1;
+  }
+  if (sink->length + length > sink->capacity) {
+    int capacity = sink->capacity ? sink->capacity : HTTP_CLIENT_STREAM_BUFSIZE;
+    while (capacity < sink->length + length) {
+      capacity *= 2;
+    }
+    if (capacity > sink->maxLength) {
+      capacity = sink->maxLength;
+    }
+    char *grown = safeMalloc(capacity, "http client json body");
+    if (sink->data) {
+      memcpy(grown, sink->data, sink->length);
+      safeFree(sink->data, sink->capacity);
+    }
+    sink->data = grown;
+    sink->capacity = capacity;
+  }
+  memcpy(sink->data + sink->length, data, length);
+  sink->length += length;
+  return 0;
+}
+
+int httpClientSessionReceiveJson(HttpClientContext *ctx, HttpClientSession *session, int maxBodySize,
+                                 Json **outJson, char *errorBufferOrNull, int errorBufferSize) {
+  if ((NULL == outJson) || (maxBodySize <= 0)) {
+    return HTTP_CLIENT_INVALID_ARGUMENT;
+  }
+  HttpClientJsonSink sink;
+  memset(&sink, 0, sizeof(HttpClientJsonSink));
+  sink.maxLength = maxBodySize;
+  *outJson = NULL;
+
+  int sts = httpClientSessionReceiveStream(ctx, session, NULL, collectJsonSink, &sink);
+  if (sink.tooLarge) {
+    HTTP_CLIENT_TRACE_VERBOSE("http client json response exceeds %d bytes\n", maxBodySize);
+    sts = HTTP_CLIENT_BODY_TOO_LARGE;
+  } else if ((0 == sts) && (0 == sink.length)) {
+    if (errorBufferOrNull) {
+      snprintf(errorBufferOrNull, errorBufferSize, "empty response body");
+    }
+    sts = HTTP_CLIENT_JSON_PARSE_FAILED;
+  } else if (0 == sts) {
+    /* the parsed tree lives as long as the session */
+#ifdef __ZOWE_EBCDIC
+    *outJson = jsonParseUnterminatedUtf8String(session->slh, CCSID_IBM1047, sink.data, sink.length,
+                                               errorBufferOrNull, errorBufferSize);
+#else
+    *outJson = jsonParseUnterminatedString(session->slh, sink.data, sink.length,
+                                           errorBufferOrNull, errorBufferSize);
+#endif
+    if (NULL == *outJson) {
+      sts = HTTP_CLIENT_JSON_PARSE_FAILED;
+    }
+  }
+  if (sink.data) {
+    safeFree(sink.data, sink.capacity);
+  }
+  return sts;
+}
+
 /* parse response based on reading up to maxlen bytes from the socket */
 int httpClientSessionReceiveNative(HttpClientContext *ctx, HttpClientSession *session, int maxlen) {
   int sts = 0;
@@ -45,8 +45,15 @@
 #include "bpxnet.h"
 #include "unixfile.h"
 #include "xlate.h"
+#include "timeutls.h"
+#ifdef HTTPSERVER_BINARY_TRACE
+#include "bintrace.h"
+#else
+#define BINARY_TRACE(...) do {} while (0)
+#endif
 
 #ifdef __ZOWE_OS_ZOS
+#include <builtins.h>
 #include "zos.h"
 #include "icsf.h"
 #include "recovery.h"
@@ -65,6 +72,7 @@
 #include "charsets.h"
 #include "impersonation.h"
 #include "httpserver.h"
+#include "httpclient.h"
 
 #ifdef USE_RS_SSL
 #include "rs_ssl.h"
@@ -75,6 +83,10 @@
 
 #include "../jwt/jwt/jwt.h"
 
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
 /* bool and time_t are not available for
  * METAL builds, but casting them to ints
  * is valid.
@@ -160,6 +172,21 @@ static int traceSocket = 0;
 static int traceHttpCloseConversation = 0;
 static int traceAuth = 0;
 
+/*
+  Binary trace points for the request path, compiled in when HTTPSERVER_BINARY_TRACE is defined,
+  in which case bintrace.c must be linked as well.  They cost nothing until binaryTraceStart is
+  called and, unlike the trace flags above, format nothing when they fire, so they can stay
+  enabled under load and be dumped with binaryTraceDumpFile when a problem shows up.
+ */
+#ifdef HTTPSERVER_BINARY_TRACE
+static BinaryTraceFormat traceSocketRead =
+  BINARY_TRACE_FORMAT("socket read returned %d, rc=%d\n");
+static BinaryTraceFormat traceParseFragment =
+  BINARY_TRACE_FORMAT("parser 0x%p fragment of %d bytes in state %d\n");
+static BinaryTraceFormat traceRequestParsed =
+  BINARY_TRACE_FORMAT("parser 0x%p request parsed, method length %d, uri length %d, content length %d\n");
+#endif
+
 int setHttpParseTrace(int toWhat) {
   int was = traceParse;
 #ifndef METTLE
@@ -240,6 +267,10 @@ static unsigned int tlsWarnCounter = 0;
 #endif
 
 static int64 getFineGrainedTime();
+static int64 getMetricsMicros();
+
+static int writeResponseBytes(HttpResponse *response, char *data, int length);
+static int writeResponseVector(HttpResponse *response, HttpIOVector *vector, int count, int flags);
 
 static char *getSessionTokenCookieName(HttpService *service);
 
@@ -346,6 +377,7 @@ int readByte(BufferedInputStream *s){
     int reasonCode;
     /* how do we *WAIT* on a read */
     int bytesRead = socketRead(s->socket,s->buffer,s->bufferSize,&returnCode,&reasonCode);
+    BINARY_TRACE(&traceSocketRead, bytesRead, returnCode);
 
     if (bytesRead > 0)
     {
@@ -386,6 +418,17 @@ void initChunkedOutput(ChunkedOutputStream *s, HttpResponse *response,
   s->buffer = buffer;
   s->translateBuffer = translateBuffer;
   s->bufferSize = bufferSize;
+  s->isErrorState = false;
+  s->pendingHeader = NULL;
+  s->pendingHeaderLength = 0;
+  s->offeredCoding = HTTP_CONTENT_CODING_IDENTITY;
+  s->contentCoding = HTTP_CONTENT_CODING_IDENTITY;
+  s->codingDecided = false;
+  s->compressionLevel = HTTP_COMPRESSION_DEFAULT_LEVEL;
+  s->compressionMinSize = HTTP_COMPRESSION_DEFAULT_MIN_SIZE;
+  s->compressor = NULL;
+  s->compressBuffer = NULL;
+  s->compressBufferSize = 0;
   
   s->fill = 0;
 }
@@ -414,7 +457,26 @@ static void chunkWrite(ChunkedOutputStream *s, char *data, int len){
     zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG3, "ENQUEUE\n");
     stcEnqueueWork(stcBase,prefix);
   } else{
-    int writeRC = writeFully(s->response->socket,data,len);
+    int writeRC = writeResponseBytes(s->response,data,len);
+    if (writeRC == 0) {
+      s->isErrorState = true;
+    }
+  }
+}
+
+static void chunkWriteVector(ChunkedOutputStream *s, HttpIOVector *vector, int count, int flags){
+  if (s->isErrorState) {
+    return;
+  }
+  if (s->response->runningInSubtask){
+    /* the main task does the socket IO for subtasks, one work element per piece */
+    for (int i = 0; i < count; i++){
+      if (vector[i].length > 0){
+        chunkWrite(s,vector[i].data,vector[i].length);
+      }
+    }
+  } else{
+    int writeRC = writeResponseVector(s->response,vector,count,flags);
     if (writeRC == 0) {
       s->isErrorState = true;
     }
@@ -432,48 +494,364 @@ void writeTransferChunkHeader(ChunkedOutputStream *s, int size){
   chunkWrite(s,buffer,len);
 }
 
+static const char ASCII_HEX_DIGITS[16] = { 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37,
+                                           0x38, 0x39, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66 };
+
+static char lastChunk[] = { 0x30, 0x0d, 0x0a, 0x0d, 0x0a };
+
+/* formats "<hex size>CRLF" directly in ASCII, returns the length */
+static int formatChunkSizeLine(char *buffer, int size){
+  char digits[8];
+  int digitCount = 0;
+  do {
+    digits[digitCount++] = ASCII_HEX_DIGITS[size & 0xF];
+    size = ((unsigned int)size) >> 4;
+  } while (size != 0);
+  int len = 0;
+  while (digitCount > 0){
+    buffer[len++] = digits[--digitCount];
+  }
+  buffer[len++] = 0x0d;
+  buffer[len++] = 0x0a;
+  return len;
+}
+
+/*
+  Gathers any pending header block, the chunk size line, up to two pieces of (already translated)
+  payload, the chunk trailer and optionally the terminating zero-length chunk into one vectored write.
+ */
+static void writeChunkFramed(ChunkedOutputStream *s,
+                             char *data1, int len1,
+                             char *data2, int len2,
+                             int isLast){
+  HttpIOVector vector[6];
+  int count = 0;
+  char sizeLine[16];
+  int chunkSize = len1 + len2;
+
+  if (s->pendingHeader){
+    vector[count].data = s->pendingHeader;
+    vector[count++].length = s->pendingHeaderLength;
+    s->pendingHeader = NULL;
+    s->pendingHeaderLength = 0;
+  }
+  if (chunkSize > 0){
+    vector[count].data = sizeLine;
+    vector[count++].length = formatChunkSizeLine(sizeLine,chunkSize);
+    vector[count].data = data1;
+    vector[count++].length = len1;
+    vector[count].data = data2;
+    vector[count++].length = len2;
+    vector[count].data = crlf;
+    vector[count++].length = 2;
+  }
+  if (isLast){
+    vector[count].data = lastChunk;
+    vector[count++].length = sizeof(lastChunk);
+  }
+  if (count == 0){
+    return;
+  }
+  chunkWriteVector(s,vector,count,(isLast ? 0 : HTTP_WRITE_MORE_TO_FOLLOW));
+}
+
+/********** RESPONSE COMPRESSION **********/
+
+#define COMPRESS_BUFFER_SIZE 16384
+
+static char *getContentCodingName(int coding){
+  switch (coding){
+  case HTTP_CONTENT_CODING_GZIP:
+    return "gzip";
+  case HTTP_CONTENT_CODING_DEFLATE:
+    return "deflate";
+  default:
+    return "identity";
+  }
+}
+
+/* a q-value of 0 (0, 0.0, 0.000) means "not acceptable" */
+static int isZeroQValue(char *q){
+  while ((*q >= '0' && *q <= '9') || *q == '.'){
+    if (*q >= '1' && *q <= '9'){
+      return FALSE;
+    }
+    q++;
+  }
+  return TRUE;
+}
+
+/* Picks a coding from Accept-Encoding, preferring gzip, then deflate */
+static int chooseContentCoding(HttpRequest *request){
+  HttpHeader *header = (request ? getHeader(request, "Accept-Encoding") : NULL);
+  if (header == NULL || header->nativeValue == NULL){
+    return HTTP_CONTENT_CODING_IDENTITY;
+  }
+  int gzipAccepted = FALSE;
+  int deflateAccepted = FALSE;
+  char *p = header->nativeValue;
+  while (*p){
+    while (*p == ' ' || *p == ','){
+      p++;
+    }
+    char *token = p;
+    while (*p && *p != ',' && *p != ';' && *p != ' '){
+      p++;
+    }
+    int tokenLength = (int)(p - token);
+    int acceptable = TRUE;
+    while (*p && *p != ','){
+      if (*p == ';'){
+        p++;
+        while (*p == ' '){
+          p++;
+        }
+        if ((*p == 'q' || *p == 'Q') && p[1] == '='){
+          acceptable = !isZeroQValue(p+2);
+        }
+      } else{
+        p++;
+      }
+    }
+    if (!acceptable || tokenLength == 0){
+      continue;
+    }
+    if ((tokenLength == 4 && !compareIgnoringCase("gzip", token, 4)) ||
+        (tokenLength == 6 && !compareIgnoringCase("x-gzip", token, 6)) ||
+        (tokenLength == 1 && *token == '*')){
+      gzipAccepted = TRUE;
+    } else if (tokenLength == 7 && !compareIgnoringCase("deflate", token, 7)){
+      deflateAccepted = TRUE;
+    }
+  }
+  if (gzipAccepted){
+    return HTTP_CONTENT_CODING_GZIP;
+  } else if (deflateAccepted){
+    return HTTP_CONTENT_CODING_DEFLATE;
+  } else{
+    return HTTP_CONTENT_CODING_IDENTITY;
+  }
+}
+
+/* whether the server compresses responses at all, which makes them vary by Accept-Encoding */
+static bool isCompressionEnabled(HttpResponse *response){
+#ifdef USE_ZLIB
+  return (response->conversation != NULL &&
+          response->conversation->server->config->compressionLevel > 0);
+#else
+  return false;
+#endif
+}
+
+/* returns the coding the server is willing to use for this response, considering its config */
+static int getOfferedContentCoding(HttpResponse *response){
+  if (!isCompressionEnabled(response)){
+    return HTTP_CONTENT_CODING_IDENTITY;
+  }
+  return chooseContentCoding(response->request);
+}
+
+static void offerStreamCompression(ChunkedOutputStream *s){
+  HttpResponse *response = s->response;
+  s->offeredCoding = getOfferedContentCoding(response);
+  if (s->offeredCoding != HTTP_CONTENT_CODING_IDENTITY){
+    HttpServerConfig *config = response->conversation->server->config;
+    s->compressionLevel = config->compressionLevel;
+    s->compressionMinSize = config->compressionMinSize;
+  }
+}
+
+static int startStreamCompression(ChunkedOutputStream *s, int coding){
+#ifdef USE_ZLIB
+  z_stream *z = (z_stream*)safeMalloc(sizeof(z_stream),"z_stream");
+  memset(z,0,sizeof(z_stream));
+  /* +16 asks zlib for a gzip wrapper, plain windowBits is the zlib wrapper HTTP calls "deflate" */
+  int windowBits = (coding == HTTP_CONTENT_CODING_GZIP) ? (MAX_WBITS + 16) : MAX_WBITS;
+  int level = (s->compressionLevel > 9) ? 9 : s->compressionLevel;
+  if (deflateInit2(z, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK){
+    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_WARNING, "deflateInit2 failed, sending identity\n");
+    safeFree((char*)z,sizeof(z_stream));
+    return 8;
+  }
+  s->compressBufferSize = COMPRESS_BUFFER_SIZE;
+  s->compressBuffer = SLHAlloc(s->response->slh,COMPRESS_BUFFER_SIZE);
+  z->next_out = (Bytef*)s->compressBuffer;
+  z->avail_out = s->compressBufferSize;
+  s->compressor = z;
+  s->contentCoding = coding;
+  s->codingDecided = true;
+  return 0;
+#else
+  return 8;
+#endif
+}
+
+static void endStreamCompression(ChunkedOutputStream *s){
+#ifdef USE_ZLIB
+  if (s->compressor){
+    z_stream *z = (z_stream*)s->compressor;
+    deflateEnd(z);
+    safeFree((char*)z,sizeof(z_stream));
+    s->compressor = NULL;
+  }
+#endif
+}
+
+/*
+  Adds Vary, and Content-Encoding if a coding was chosen, to the held-back header block, in front
+  of its final CRLF.  Identity responses get Vary too, since another client could have got gzip.
+ */
+static void addContentCodingToPendingHeader(ChunkedOutputStream *s){
+  char lines[128];
+  int len = 0;
+  if (s->contentCoding != HTTP_CONTENT_CODING_IDENTITY){
+    len = sprintf(lines,"Content-Encoding: %s",getContentCodingName(s->contentCoding));
+    memcpy(lines+len,crlf,2);
+    len += 2;
+  }
+  int varyLen = sprintf(lines+len,"Vary: Accept-Encoding");
+  memcpy(lines+len+varyLen,crlf,2);
+  len += varyLen+2;
+  asciify(lines,len);
+
+  int headLength = s->pendingHeaderLength - 2;
+  char *block = SLHAlloc(s->response->slh,headLength+len+2);
+  memcpy(block,s->pendingHeader,headLength);
+  memcpy(block+headLength,lines,len);
+  memcpy(block+headLength+len,crlf,2);
+  s->pendingHeader = block;
+  s->pendingHeaderLength = headLength+len+2;
+}
+
+/*
+  How much of what was written so far must go out now: CHUNK_PART lets the compressor hold on to
+  its output until its buffer fills, CHUNK_FLUSH is an explicit flush by the caller and CHUNK_LAST
+  ends the body.  Uncompressed output goes out on every one of them.
+ */
+#define CHUNK_PART  0
+#define CHUNK_FLUSH 1
+#define CHUNK_LAST  2
+
+#ifdef USE_ZLIB
+/* runs deflate once and ships the output buffer as a chunk whenever it fills up */
+static int deflateStep(ChunkedOutputStream *s, int flush){
+  z_stream *z = (z_stream*)s->compressor;
+  int zrc = deflate(z, flush);
+  if (zrc == Z_STREAM_ERROR){
+    s->isErrorState = true;
+    return zrc;
+  }
+  if (z->avail_out == 0){
+    writeChunkFramed(s,s->compressBuffer,s->compressBufferSize,NULL,0,FALSE);
+    z->next_out = (Bytef*)s->compressBuffer;
+    z->avail_out = s->compressBufferSize;
+  }
+  return zrc;
+}
+
+static void compressAndWriteChunk(ChunkedOutputStream *s,
+                                  char *data1, int len1,
+                                  char *data2, int len2,
+                                  int flush){
+  z_stream *z = (z_stream*)s->compressor;
+  char *pieces[2] = { data1, data2 };
+  int lengths[2] = { len1, len2 };
+  for (int i = 0; i < 2; i++){
+    z->next_in = (Bytef*)pieces[i];
+    z->avail_in = (lengths[i] > 0) ? lengths[i] : 0;
+    while (z->avail_in > 0 && !s->isErrorState){
+      deflateStep(s,Z_NO_FLUSH);
+    }
+  }
+  if (flush == CHUNK_LAST){
+    int zrc = Z_OK;
+    while (zrc == Z_OK && !s->isErrorState){
+      zrc = deflateStep(s,Z_FINISH);
+    }
+    int pending = s->compressBufferSize - z->avail_out;
+    writeChunkFramed(s,s->compressBuffer,pending,NULL,0,TRUE);
+    endStreamCompression(s);
+  } else if (flush == CHUNK_FLUSH){
+    /* 
+       A sync flush costs ratio and an extra chunk, so it is only done when the caller asks,
+       e.g. for a slowly produced stream that the client should see as it goes.
+     */
+    int outputFilled = FALSE;
+    do {
+      int zrc = deflate(z, Z_SYNC_FLUSH);
+      if (zrc == Z_STREAM_ERROR){
+        s->isErrorState = true;
+        break;
+      }
+      int pending = s->compressBufferSize - z->avail_out;
+      outputFilled = (z->avail_out == 0);
+      if (pending > 0){
+        writeChunkFramed(s,s->compressBuffer,pending,NULL,0,FALSE);
+        z->next_out = (Bytef*)s->compressBuffer;
+        z->avail_out = s->compressBufferSize;
+      }
+    } while (outputFilled && !s->isErrorState);
+  }
+}
+#endif
+
+/*
+  All chunked output funnels through here.  The content coding offered when the stream was made is
+  settled on the first flush: it is only used if the header block is still held back (so
+  Content-Encoding can be added) and the body is not known to be below the minimum size.
+ */
+static void writeChunkGathered(ChunkedOutputStream *s,
+                               char *data1, int len1,
+                               char *data2, int len2,
+                               int flush){
+  if (!s->codingDecided){
+    s->codingDecided = true;
+    if (s->pendingHeader != NULL){
+      if (s->offeredCoding != HTTP_CONTENT_CODING_IDENTITY &&
+          (flush != CHUNK_LAST || (len1 + len2) >= s->compressionMinSize)){
+        startStreamCompression(s,s->offeredCoding);
+      }
+      if (isCompressionEnabled(s->response)){
+        addContentCodingToPendingHeader(s);
+      }
+    }
+  }
+#ifdef USE_ZLIB
+  if (s->compressor){
+    compressAndWriteChunk(s,data1,len1,data2,len2,flush);
+    return;
+  }
+#endif
+  writeChunkFramed(s,data1,len1,data2,len2,(flush == CHUNK_LAST));
+}
+
 void writeBytes(ChunkedOutputStream *s, char *data, int len, int translate){
   /* if data len greater than bufferSize
         1) finish chunk if fill > 0
 	2) write data as a transfer chunk
         3) reset to 0
      if data fills or overfills
-        1) lay in the section to fill current chunk
-	2) flush buffer as transfer chunk
-	3) accumulate remainder into buffer
+        1) flush buffer and data together as one transfer chunk
         otherwise
         3) accumulate to buffer 
    */
   if (len > s->bufferSize){
-    if (s->fill > 0){
-      writeTransferChunkHeader(s,s->fill);
-      /* HERE - translate */
-      if (translate) {
-        toASCIIUTF8(s->buffer,s->fill);
-      }
-      chunkWrite(s,s->buffer,s->fill);
-      chunkWrite(s,crlf,2);
-    }
-    writeTransferChunkHeader(s,len);
     if (translate) {
+      toASCIIUTF8(s->buffer,s->fill);
       toASCIIUTF8(data,len);
     }
-    chunkWrite(s,data,len);
-    chunkWrite(s,crlf,2);
+    writeChunkGathered(s,s->buffer,s->fill,data,len,CHUNK_PART);
     s->fill = 0;
   } else if ((s->fill + len) >= s->bufferSize){
-    int whatFits = (s->bufferSize - s->fill);
-    writeTransferChunkHeader(s,s->fill+len);
+    char *tail = data;
     if (translate) {
       toASCIIUTF8(s->buffer,s->fill);
-    }
-    chunkWrite(s,s->buffer,s->fill);
-    memcpy(s->translateBuffer,data,len);
-    if (translate) {
+      /* the caller's data must not be translated in place when it may be a short literal */
+      memcpy(s->translateBuffer,data,len);
       toASCIIUTF8(s->translateBuffer,len);
+      tail = s->translateBuffer;
     }
-    chunkWrite(s,s->translateBuffer,len);
-    chunkWrite(s,crlf,2);
+    writeChunkGathered(s,s->buffer,s->fill,tail,len,CHUNK_PART);
     s->fill = 0;
   } else{
     memcpy(s->buffer+s->fill,data,len);
@@ -488,20 +866,25 @@ void writeString(ChunkedOutputStream *s, char *string){
   writeBytes(s,string,len,TRANSLATE_8859_1);
 }
 
+/* sends what has been written so far, including anything the compressor holds on to */
+void flushChunkedOutput(ChunkedOutputStream *s, int translate){
+  if (s->fill > 0 && translate){
+    toASCIIUTF8(s->buffer,s->fill);
+  }
+  writeChunkGathered(s,s->buffer,s->fill,NULL,0,CHUNK_FLUSH);
+  s->fill = 0;
+}
+
 static void finishChunkedOutput(ChunkedOutputStream *s, int translate){
   /* flush the last chunk 
      write the 0 chunk
      */
-  if (s->fill > 0){
-    writeTransferChunkHeader(s,s->fill);
-    if (translate)  {
-      toASCIIUTF8(s->buffer,s->fill);
-    }
-    chunkWrite(s,s->buffer,s->fill);
-    chunkWrite(s,crlf,2);
+  if (s->fill > 0 && translate){
+    toASCIIUTF8(s->buffer,s->fill);
   }
-  writeTransferChunkHeader(s,0);
-  chunkWrite(s,crlf,2);
+  writeChunkGathered(s,s->buffer,s->fill,NULL,0,CHUNK_LAST);
+  s->fill = 0;
+  endStreamCompression(s);
 }
 
 // **NOTE**
@@ -526,6 +909,7 @@ void finishResponse(HttpResponse *response){
   }
   if (response->conversation){  /* should be true except when unit-testing a "pseudoResponse" */
     response->conversation->workingOnResponse = FALSE;
+    response->conversation->lastActivityMicros = getMetricsMicros();
   }
 
   response->conversation = NULL;    // Prevent a second free of the response block
@@ -533,6 +917,455 @@ void finishResponse(HttpResponse *response){
   SLHFree(response->slh);
 }
 
+/*
+  Metrics.
+
+  The server keeps gauges for connections, WebSocket sessions, requests waiting for the main
+  task and requests being served, and counters for connections accepted and bytes in and out.
+  Each registered service keeps counts by status class and a latency histogram per phase:
+
+    parse   - from the request's first bytes being readable to it being dequeued from the parser
+    auth    - authentication, including session token and JWT checks
+    handler - the service function, less the time it spent writing
+    write   - time blocked writing the response to the socket from the main task
+
+  Histograms are log-linear like HDR histograms: values below 8us get a bucket each, and every
+  power of two above that is split into 8 buckets, which keeps percentiles within 12.5% up to
+  about an hour with a fixed 2KB per histogram.  Every counter is updated atomically on its own,
+  so requests to different services share nothing, and a scrape racing a request can be off by
+  that request.
+ */
+
+#define HTTP_LATENCY_SUB_BUCKET_BITS 3
+#define HTTP_LATENCY_SUB_BUCKETS (1<<HTTP_LATENCY_SUB_BUCKET_BITS)
+#define HTTP_LATENCY_MAX_MAGNITUDE 32  /* 2^32us, about 71 minutes, later values land in the last bucket */
+#define HTTP_LATENCY_BUCKETS ((HTTP_LATENCY_MAX_MAGNITUDE-2)*HTTP_LATENCY_SUB_BUCKETS)
+
+#define HTTP_METRICS_PHASE_PARSE   0
+#define HTTP_METRICS_PHASE_AUTH    1
+#define HTTP_METRICS_PHASE_HANDLER 2
+#define HTTP_METRICS_PHASE_WRITE   3
+#define HTTP_METRICS_PHASE_COUNT   4
+
+static char *metricsPhaseNames[HTTP_METRICS_PHASE_COUNT] = { "parse", "auth", "handler", "write" };
+
+/* index 0 is for responses without a status line the server wrote */
+#define HTTP_METRICS_STATUS_CLASSES 6
+static char *metricsStatusClassNames[HTTP_METRICS_STATUS_CLASSES] = { "other", "1xx", "2xx", "3xx", "4xx", "5xx" };
+
+typedef struct HttpLatencyHistogram_tag{
+  int64 count;
+  int64 sumMicros;
+  int64 maxMicros;
+  int64 buckets[HTTP_LATENCY_BUCKETS];
+} HttpLatencyHistogram;
+
+typedef struct HttpServiceMetrics_tag{
+  int   inFlight;                /* admitted and not yet finished, see admitServiceRequest */
+  int   maxInFlight;             /* 0 for no limit */
+  int64 rejected;
+  int64 requests;
+  int64 requestsByStatusClass[HTTP_METRICS_STATUS_CLASSES];
+  HttpLatencyHistogram phases[HTTP_METRICS_PHASE_COUNT];
+} HttpServiceMetrics;
+
+/* returns the new value, used for counters shared between the STC work thread and other tasks */
+static int httpAtomicAdd(int *counter, int delta){
+#ifdef __ZOWE_OS_ZOS
+  return atomicIncrement(counter,delta);
+#elif defined __GNUC__ || defined __ZOWE_OS_AIX
+  return __sync_add_and_fetch(counter,delta);
+#elif defined __ZOWE_OS_WINDOWS
+  return atomic_fetch_add((atomic_int*)counter,delta) + delta;
+#else
+  #error Unsupported platform for atomic operation
+#endif
+}
+
+static int64 httpAtomicAdd64(int64 *counter, int64 delta){
+#ifdef __ZOWE_OS_ZOS
+  int64 oldValue = *counter;
+  int64 newValue = oldValue + delta;
+  /* CSG reloads oldValue when another task got there first */
+  while (__csg(&oldValue,counter,&newValue)){
+    newValue = oldValue + delta;
+  }
+  return newValue;
+#elif defined __GNUC__ || defined __ZOWE_OS_AIX
+  return __sync_add_and_fetch(counter,delta);
+#elif defined __ZOWE_OS_WINDOWS
+  return atomic_fetch_add((atomic_llong*)counter,delta) + delta;
+#else
+  #error Unsupported platform for atomic operation
+#endif
+}
+
+/* raises *counter to value unless another task has already raised it further */
+static void httpAtomicMax64(int64 *counter, int64 value){
+  int64 oldValue = *counter;
+  while (value > oldValue){
+#ifdef __ZOWE_OS_ZOS
+    int64 newValue = value;
+    if (!__csg(&oldValue,counter,&newValue)){
+      break;
+    }
+#elif defined __GNUC__ || defined __ZOWE_OS_AIX
+    int64 seen = __sync_val_compare_and_swap(counter,oldValue,value);
+    if (seen == oldValue){
+      break;
+    }
+    oldValue = seen;
+#elif defined __ZOWE_OS_WINDOWS
+    if (atomic_compare_exchange_strong((atomic_llong*)counter,&oldValue,value)){
+      break;
+    }
+#else
+  #error Unsupported platform for atomic operation
+#endif
+  }
+}
+
+typedef struct HttpServerMetrics_tag{
+  int64 startedAt;               /* microseconds, see getMetricsMicros */
+  int   activeConnections;       /* gauges are updated with httpAtomicAdd */
+  int   activeWebSockets;
+  int   queuedRequests;
+  int   inFlightRequests;
+  int64 connectionsAccepted;     /* counters are updated with httpAtomicAdd64 */
+  int64 connectionsRefused;      /* over the connection cap or the client's rate */
+  int64 connectionsTimedOut;     /* idle or too slow sending a request */
+  int64 requestsRejected;        /* over the client's rate or the service's in-flight cap */
+  int64 bytesIn;
+  int64 bytesOut;
+} HttpServerMetrics;
+
+/* microseconds from the TOD clock, in which bit 51 is one microsecond */
+static int64 getMetricsMicros(){
+  int64 stck = 0;
+  getSTCK(&stck);
+  return (int64)(((uint64)stck) >> 12);
+}
+
+static HttpServerMetrics *makeHttpServerMetrics(){
+  HttpServerMetrics *metrics = (HttpServerMetrics*)safeMalloc(sizeof(HttpServerMetrics),"HttpServerMetrics");
+  memset(metrics,0,sizeof(HttpServerMetrics));
+  metrics->startedAt = getMetricsMicros();
+  return metrics;
+}
+
+static HttpServiceMetrics *makeHttpServiceMetrics(){
+  HttpServiceMetrics *metrics = (HttpServiceMetrics*)safeMalloc(sizeof(HttpServiceMetrics),"HttpServiceMetrics");
+  memset(metrics,0,sizeof(HttpServiceMetrics));
+  return metrics;
+}
+
+static int latencyBucket(int64 micros){
+  if (micros < HTTP_LATENCY_SUB_BUCKETS){
+    return (micros < 0) ? 0 : (int)micros;
+  }
+  int magnitude = 0;
+  uint64 v = (uint64)micros;
+  while (v >>= 1){
+    magnitude++;
+  }
+  int index = ((magnitude - HTTP_LATENCY_SUB_BUCKET_BITS + 1) << HTTP_LATENCY_SUB_BUCKET_BITS) +
+    (int)((micros >> (magnitude - HTTP_LATENCY_SUB_BUCKET_BITS)) & (HTTP_LATENCY_SUB_BUCKETS-1));
+  return (index < HTTP_LATENCY_BUCKETS) ? index : (HTTP_LATENCY_BUCKETS-1);
+}
+
+/* the smallest value that is too large for the bucket */
+static int64 latencyBucketLimit(int index){
+  if (index < HTTP_LATENCY_SUB_BUCKETS){
+    return index+1;
+  }
+  int magnitude = (index >> HTTP_LATENCY_SUB_BUCKET_BITS) + HTTP_LATENCY_SUB_BUCKET_BITS - 1;
+  int64 subBucket = index & (HTTP_LATENCY_SUB_BUCKETS-1);
+  return (HTTP_LATENCY_SUB_BUCKETS + subBucket + 1) << (magnitude - HTTP_LATENCY_SUB_BUCKET_BITS);
+}
+
+static void recordLatency(HttpLatencyHistogram *histogram, int64 micros){
+  if (micros < 0){
+    micros = 0;
+  }
+  httpAtomicAdd64(&histogram->count,1);
+  httpAtomicAdd64(&histogram->sumMicros,micros);
+  httpAtomicMax64(&histogram->maxMicros,micros);
+  httpAtomicAdd64(&histogram->buckets[latencyBucket(micros)],1);
+}
+
+static int64 latencyPercentile(HttpLatencyHistogram *histogram, double fraction){
+  int64 count = histogram->count;
+  if (count == 0){
+    return 0;
+  }
+  int64 rank = (int64)(fraction * count);
+  if (rank < 1){
+    rank = 1;
+  }
+  int64 seen = 0;
+  for (int i = 0; i < HTTP_LATENCY_BUCKETS; i++){
+    seen += histogram->buckets[i];
+    if (seen >= rank){
+      int64 limit = latencyBucketLimit(i) - 1;
+      return (limit < histogram->maxMicros) ? limit : histogram->maxMicros;
+    }
+  }
+  return histogram->maxMicros;
+}
+
+static int statusClassOf(int status){
+  return (status >= 100 && status < 600) ? status/100 : 0;
+}
+
+static void countBytesIn(HttpServer *server, int bytes){
+  HttpServerMetrics *metrics = server ? server->metrics : NULL;
+  if (metrics && bytes > 0){
+    httpAtomicAdd64(&metrics->bytesIn,bytes);
+  }
+}
+
+static void noteResponseOutput(HttpResponse *response, int bytes, int64 writeMicros){
+  HttpConversation *conversation = response->conversation;
+  if (conversation == NULL || conversation->server == NULL){
+    return;
+  }
+  conversation->responseWriteMicros += writeMicros;
+  HttpServerMetrics *metrics = conversation->server->metrics;
+  if (metrics && bytes > 0){
+    httpAtomicAdd64(&metrics->bytesOut,bytes);
+  }
+}
+
+static int writeResponseBytes(HttpResponse *response, char *data, int length){
+  int64 writeStart = getMetricsMicros();
+  int writeRC = writeFully(response->socket,data,length);
+  noteResponseOutput(response,length,getMetricsMicros()-writeStart);
+  return writeRC;
+}
+
+static int writeResponseVector(HttpResponse *response, HttpIOVector *vector, int count, int flags){
+  int length = 0;
+  for (int i = 0; i < count; i++){
+    length += vector[i].length;
+  }
+  int64 writeStart = getMetricsMicros();
+  int writeRC = writeFullyVector(response->socket,vector,count,flags);
+  noteResponseOutput(response,length,getMetricsMicros()-writeStart);
+  return writeRC;
+}
+
+static void recordServiceMetrics(HttpServer *server, HttpService *service, HttpConversation *conversation,
+                                 int64 authMicros, int64 serveMicros){
+  HttpServerMetrics *metrics = server ? server->metrics : NULL;
+  HttpServiceMetrics *serviceMetrics = service->metrics;
+  if (metrics == NULL || serviceMetrics == NULL || conversation == NULL){
+    return;
+  }
+  int64 writeMicros = conversation->responseWriteMicros;
+  httpAtomicAdd64(&serviceMetrics->requests,1);
+  httpAtomicAdd64(&serviceMetrics->requestsByStatusClass[statusClassOf(conversation->responseStatus)],1);
+  recordLatency(&serviceMetrics->phases[HTTP_METRICS_PHASE_PARSE],conversation->requestParseMicros);
+  recordLatency(&serviceMetrics->phases[HTTP_METRICS_PHASE_AUTH],authMicros);
+  recordLatency(&serviceMetrics->phases[HTTP_METRICS_PHASE_HANDLER],serveMicros-writeMicros);
+  recordLatency(&serviceMetrics->phases[HTTP_METRICS_PHASE_WRITE],writeMicros);
+}
+
+/* Prometheus label values escape backslash, quote and newline */
+static char *escapeMetricLabel(char *value, char *buffer, int bufferSize){
+  int pos = 0;
+  for (char *c = value; *c && pos < bufferSize-2; c++){
+    if (*c == '\\' || *c == '"'){
+      buffer[pos++] = '\\';
+      buffer[pos++] = *c;
+    } else if (*c == '\n'){
+      buffer[pos++] = '\\';
+      buffer[pos++] = 'n';
+    } else{
+      buffer[pos++] = *c;
+    }
+  }
+  buffer[pos] = 0;
+  return buffer;
+}
+
+static void writeMetricHeader(ChunkedOutputStream *out, char *name, char *type, char *help){
+  char line[256];
+  snprintf(line,sizeof(line),"# HELP %s %s\n# TYPE %s %s\n",name,help,name,type);
+  writeString(out,line);
+}
+
+static void writeMetricValue(ChunkedOutputStream *out, char *name, int64 value){
+  char line[256];
+  snprintf(line,sizeof(line),"%s %lld\n",name,value);
+  writeString(out,line);
+}
+
+/* the exposition format's buckets are the powers of two from 64us to about 33s */
+#define PROMETHEUS_FIRST_MAGNITUDE 6
+#define PROMETHEUS_LAST_MAGNITUDE 25
+
+static void writePrometheusMetrics(HttpServer *server, ChunkedOutputStream *out){
+  HttpServerMetrics *metrics = server->metrics;
+  char line[512];
+  char serviceLabel[256];
+
+  writeMetricHeader(out,"zowe_http_uptime_seconds","gauge","Seconds since the server started.");
+  writeMetricValue(out,"zowe_http_uptime_seconds",(getMetricsMicros()-metrics->startedAt)/1000000);
+  writeMetricHeader(out,"zowe_http_connections_active","gauge","Open HTTP and WebSocket connections.");
+  writeMetricValue(out,"zowe_http_connections_active",metrics->activeConnections);
+  writeMetricHeader(out,"zowe_http_connections_total","counter","Connections accepted.");
+  writeMetricValue(out,"zowe_http_connections_total",metrics->connectionsAccepted);
+  writeMetricHeader(out,"zowe_http_websockets_active","gauge","Open WebSocket sessions.");
+  writeMetricValue(out,"zowe_http_websockets_active",metrics->activeWebSockets);
+  writeMetricHeader(out,"zowe_http_requests_queued","gauge","Requests read and waiting for the main task.");
+  writeMetricValue(out,"zowe_http_requests_queued",metrics->queuedRequests);
+  writeMetricHeader(out,"zowe_http_requests_in_flight","gauge","Requests being served.");
+  writeMetricValue(out,"zowe_http_requests_in_flight",metrics->inFlightRequests);
+  writeMetricHeader(out,"zowe_http_connections_refused_total","counter","Connections refused by admission control.");
+  writeMetricValue(out,"zowe_http_connections_refused_total",metrics->connectionsRefused);
+  writeMetricHeader(out,"zowe_http_connections_timed_out_total","counter","Connections closed for idling or sending a request too slowly.");
+  writeMetricValue(out,"zowe_http_connections_timed_out_total",metrics->connectionsTimedOut);
+  writeMetricHeader(out,"zowe_http_requests_rejected_total","counter","Requests rejected by admission control.");
+  writeMetricValue(out,"zowe_http_requests_rejected_total",metrics->requestsRejected);
+  writeMetricHeader(out,"zowe_http_received_bytes_total","counter","Bytes read from clients.");
+  writeMetricValue(out,"zowe_http_received_bytes_total",metrics->bytesIn);
+  writeMetricHeader(out,"zowe_http_sent_bytes_total","counter","Bytes of responses and WebSocket frames written.");
+  writeMetricValue(out,"zowe_http_sent_bytes_total",metrics->bytesOut);
+
+  writeMetricHeader(out,"zowe_http_requests_total","counter","Requests served, by service and status class.");
+  for (HttpService *service = server->config->serviceList; service; service = service->next){
+    HttpServiceMetrics *serviceMetrics = service->metrics;
+    if (serviceMetrics == NULL || serviceMetrics->requests == 0){
+      continue;
+    }
+    escapeMetricLabel(service->name,serviceLabel,sizeof(serviceLabel));
+    for (int c = 0; c < HTTP_METRICS_STATUS_CLASSES; c++){
+      if (serviceMetrics->requestsByStatusClass[c] > 0){
+        snprintf(line,sizeof(line),"zowe_http_requests_total{service=\"%s\",code=\"%s\"} %lld\n",
+                 serviceLabel,metricsStatusClassNames[c],serviceMetrics->requestsByStatusClass[c]);
+        writeString(out,line);
+      }
+    }
+  }
+
+  writeMetricHeader(out,"zowe_http_request_phase_seconds","histogram","Time spent in each phase of a request, by service.");
+  for (HttpService *service = server->config->serviceList; service; service = service->next){
+    HttpServiceMetrics *serviceMetrics = service->metrics;
+    if (serviceMetrics == NULL || serviceMetrics->requests == 0){
+      continue;
+    }
+    escapeMetricLabel(service->name,serviceLabel,sizeof(serviceLabel));
+    for (int p = 0; p < HTTP_METRICS_PHASE_COUNT; p++){
+      HttpLatencyHistogram *histogram = &serviceMetrics->phases[p];
+      int64 cumulative = 0;
+      int bucket = 0;
+      for (int magnitude = PROMETHEUS_FIRST_MAGNITUDE; magnitude <= PROMETHEUS_LAST_MAGNITUDE; magnitude++){
+        /* the fine buckets nest inside powers of two, so these counts are exact */
+        int bucketLimit = (magnitude - HTTP_LATENCY_SUB_BUCKET_BITS + 1) << HTTP_LATENCY_SUB_BUCKET_BITS;
+        while (bucket < bucketLimit){
+          cumulative += histogram->buckets[bucket++];
+        }
+        snprintf(line,sizeof(line),"zowe_http_request_phase_seconds_bucket{service=\"%s\",phase=\"%s\",le=\"%.6f\"} %lld\n",
+                 serviceLabel,metricsPhaseNames[p],((double)(1LL << magnitude))/1000000.0,cumulative);
+        writeString(out,line);
+      }
+      snprintf(line,sizeof(line),"zowe_http_request_phase_seconds_bucket{service=\"%s\",phase=\"%s\",le=\"+Inf\"} %lld\n",
+               serviceLabel,metricsPhaseNames[p],histogram->count);
+      writeString(out,line);
+      snprintf(line,sizeof(line),"zowe_http_request_phase_seconds_sum{service=\"%s\",phase=\"%s\"} %.6f\n",
+               serviceLabel,metricsPhaseNames[p],((double)histogram->sumMicros)/1000000.0);
+      writeString(out,line);
+      snprintf(line,sizeof(line),"zowe_http_request_phase_seconds_count{service=\"%s\",phase=\"%s\"} %lld\n",
+               serviceLabel,metricsPhaseNames[p],histogram->count);
+      writeString(out,line);
+    }
+  }
+}
+
+static void writeJsonMetrics(HttpServer *server, jsonPrinter *out){
+  HttpServerMetrics *metrics = server->metrics;
+  jsonStart(out);
+  jsonAddInt64(out,"uptimeSeconds",(getMetricsMicros()-metrics->startedAt)/1000000);
+  jsonStartObject(out,"connections");
+  jsonAddInt(out,"active",metrics->activeConnections);
+  jsonAddInt64(out,"accepted",metrics->connectionsAccepted);
+  jsonAddInt(out,"webSockets",metrics->activeWebSockets);
+  jsonAddInt64(out,"refused",metrics->connectionsRefused);
+  jsonAddInt64(out,"timedOut",metrics->connectionsTimedOut);
+  jsonEndObject(out);
+  jsonStartObject(out,"requests");
+  jsonAddInt(out,"queued",metrics->queuedRequests);
+  jsonAddInt(out,"inFlight",metrics->inFlightRequests);
+  jsonAddInt64(out,"rejected",metrics->requestsRejected);
+  jsonEndObject(out);
+  jsonStartObject(out,"bytes");
+  jsonAddInt64(out,"received",metrics->bytesIn);
+  jsonAddInt64(out,"sent",metrics->bytesOut);
+  jsonEndObject(out);
+  jsonStartArray(out,"services");
+  for (HttpService *service = server->config->serviceList; service; service = service->next){
+    HttpServiceMetrics *serviceMetrics = service->metrics;
+    if (serviceMetrics == NULL || serviceMetrics->requests == 0){
+      continue;
+    }
+    jsonStartObject(out,NULL);
+    jsonAddString(out,"name",service->name);
+    jsonAddInt64(out,"requests",serviceMetrics->requests);
+    jsonAddInt(out,"inFlight",serviceMetrics->inFlight);
+    jsonAddInt64(out,"rejected",serviceMetrics->rejected);
+    jsonStartObject(out,"statusClasses");
+    for (int c = 0; c < HTTP_METRICS_STATUS_CLASSES; c++){
+      jsonAddInt64(out,metricsStatusClassNames[c],serviceMetrics->requestsByStatusClass[c]);
+    }
+    jsonEndObject(out);
+    jsonStartObject(out,"latencyMicros");
+    for (int p = 0; p < HTTP_METRICS_PHASE_COUNT; p++){
+      HttpLatencyHistogram *histogram = &serviceMetrics->phases[p];
+      jsonStartObject(out,metricsPhaseNames[p]);
+      jsonAddInt64(out,"count",histogram->count);
+      jsonAddInt64(out,"mean",histogram->count ? histogram->sumMicros/histogram->count : 0);
+      jsonAddInt64(out,"p50",latencyPercentile(histogram,0.50));
+      jsonAddInt64(out,"p90",latencyPercentile(histogram,0.90));
+      jsonAddInt64(out,"p99",latencyPercentile(histogram,0.99));
+      jsonAddInt64(out,"p999",latencyPercentile(histogram,0.999));
+      jsonAddInt64(out,"max",histogram->maxMicros);
+      jsonEndObject(out);
+    }
+    jsonEndObject(out);
+    jsonEndObject(out);
+  }
+  jsonEndArray(out);
+  jsonEnd(out);
+}
+
+static int serveMetrics(HttpService *service, HttpResponse *response){
+  HttpServer *server = service->server;
+  HttpRequest *request = response->request;
+  char *format = getQueryParam(request,"format");
+  HttpHeader *accept = getHeader(request,"Accept");
+  int asJson = (format != NULL) ? !strcmp(format,"json") :
+    (accept != NULL && strstr(accept->nativeValue,"application/json") != NULL);
+
+  if (asJson){
+    jsonPrinter *out = respondWithJsonPrinter(response);
+    setResponseStatus(response,200,"OK");
+    setDefaultJSONRESTHeaders(response);
+    writeHeader(response);
+    writeJsonMetrics(server,out);
+  } else{
+    ChunkedOutputStream *out = respondWithChunkedOutputStream(response);
+    setResponseStatus(response,200,"OK");
+    setContentType(response,"text/plain; version=0.0.4");
+    addStringHeader(response,"Server","jdmfws");
+    addStringHeader(response,"Transfer-Encoding","chunked");
+    addStringHeader(response,"Cache-control","no-store");
+    writeHeader(response);
+    writePrometheusMetrics(server,out);
+  }
+  finishResponse(response);
+  return 0;
+}
+
 /********** BIG BUFFER **********/
 
 static BigBuffer *makeBigBuffer(int initialSize, ShortLivedHeap *slh){
@@ -560,9 +1393,13 @@ static void freeBigBuffer(BigBuffer *buffer, int freeData){
 
 
 
-static void writeToBigBuffer(BigBuffer *buffer, char *newData, int length){
+/* returns where the next length bytes go, growing the buffer if need be */
+static char *reserveBigBuffer(BigBuffer *buffer, int length){
   if (buffer->pos + length > buffer->size){
-    int newSize = buffer->size * 2;
+    int newSize = (buffer->size > 0 ? buffer->size * 2 : 256);
+    while (newSize < buffer->pos + length){
+      newSize *= 2;
+    }
     char *newArray = (buffer->slh? 
                       SLHAlloc(buffer->slh,newSize) :
                       safeMalloc31(newSize,"BigBuffer Data Extension"));
@@ -573,15 +1410,12 @@ static void writeToBigBuffer(BigBuffer *buffer, char *newData, int length){
     buffer->data = newArray;
     buffer->size = newSize;
   } 
-  memcpy(buffer->data+buffer->pos,newData,length);
-  buffer->pos += length;
+  return buffer->data+buffer->pos;
 }
 
-static void writeByteToBigBuffer(BigBuffer *buffer, int b){
-  char c;
-
-  c = b&0xff;
-  writeToBigBuffer(buffer,&c,1);
+static void writeToBigBuffer(BigBuffer *buffer, char *newData, int length){
+  memcpy(reserveBigBuffer(buffer,length),newData,length);
+  buffer->pos += length;
 }
 
 
@@ -602,8 +1436,10 @@ static WSFrame *makeFrame(int opcodeAndFlags, ShortLivedHeap *slh,
   frame->data = data;
   frame->dataLength = dataLength;
   zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG3, "WSFrame data in makeFrame length=0x%x\n",dataLength);
-  dumpbuffer(data,dataLength);
-  dumpbufferA(data,dataLength);
+  if (logShouldTrace(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG3)){
+    dumpbuffer(data,dataLength);
+    dumpbufferA(data,dataLength);
+  }
   return frame;
 }
 
@@ -628,13 +1464,38 @@ static void addWSFrame(WSMessage *message, WSFrame *newFrame){
   }
 }
 
+/* the payload buffer is sized from the frame header, see readMachineAdvance */
 static WSReadMachine *makeWSReadMachine(){
   WSReadMachine *machine = (WSReadMachine*)safeMalloc(sizeof(WSReadMachine),"WSReadMachine");
   memset(machine,0,sizeof(WSReadMachine));
-  machine->payloadStream = makeBigBuffer(256,NULL);
   return machine;
 }
 
+/*
+  XORs length bytes of src with the client's mask into dest, starting phase bytes into the mask,
+  eight bytes at a time.  The mask is laid out in memory the way it is applied, so byte order
+  does not matter.  Returns the phase for the next call.
+ */
+static int unmaskWSPayload(char *dest, const char *src, int length, const char *maskBytes, int phase){
+  char maskRun[8];
+  for (int i=0; i<8; i++){
+    maskRun[i] = maskBytes[(phase+i)&3];
+  }
+  uint64 maskWord;
+  memcpy(&maskWord,maskRun,8);
+  int pos = 0;
+  for (; pos+8 <= length; pos += 8){
+    uint64 word;
+    memcpy(&word,src+pos,8);
+    word ^= maskWord;
+    memcpy(dest+pos,&word,8);
+  }
+  for (; pos < length; pos++){
+    dest[pos] = src[pos]^maskRun[pos&7];
+  }
+  return (phase+length)&3;
+}
+
 static void enqueueInputMessage(WSReadMachine *machine, WSMessage *newMessage){
   if (machine->messageQueueHead){
     WSMessage *message = machine->messageQueueHead;
@@ -647,41 +1508,347 @@ static void enqueueInputMessage(WSReadMachine *machine, WSMessage *newMessage){
   }
 }
 
-/*adds new server WS msg to provided work element*/
+/*
+  permessage-deflate (RFC 7692).  A compressed message is a raw deflate stream that ends in a
+  Z_SYNC_FLUSH, sent without the 00 00 FF FF the flush finishes with; the first frame of the
+  message carries RSV1.  Unless no_context_takeover was agreed for a direction, the window
+  carries over from one message to the next.
+ */
+
+#define WS_RSV1 0x40
+
+#ifdef USE_ZLIB
+
+#define WS_DEFLATE_MAX_MESSAGE_SIZE (64*1024*1024) /* inflated messages past this fail the connection */
+#define WS_INFLATE_STEP 16384
+
+typedef struct WSDeflate_tag{
+  int       level;
+  int       serverNoContextTakeover;
+  int       clientNoContextTakeover;
+  int       serverMaxWindowBits;
+  int       clientMaxWindowBits;
+  int       deflaterReady;
+  int       inflaterReady;
+  int       compressingOutput;  /* the message being sent went out with RSV1 */
+  z_stream  deflater;
+  z_stream  inflater;
+  char     *outputBuffer;
+  int       outputBufferSize;
+} WSDeflate;
+
+static const char wsDeflateTail[4] = { 0x00, 0x00, (char)0xFF, (char)0xFF };
+
+/* trims blanks, and the quotes a parameter value may come in, off both ends in place */
+static char *trimWSExtensionToken(char *s){
+  while (*s == ' ' || *s == '\t' || *s == '"'){
+    s++;
+  }
+  int len = strlen(s);
+  while (len > 0 && (s[len-1] == ' ' || s[len-1] == '\t' || s[len-1] == '"')){
+    s[--len] = 0;
+  }
+  return s;
+}
+
+/* splits off the next delimited piece of *cursor in place */
+static char *nextWSExtensionToken(char **cursor, char delimiter){
+  char *start = *cursor;
+  if (start == NULL){
+    return NULL;
+  }
+  char *end = strchr(start,delimiter);
+  if (end){
+    *end = 0;
+    *cursor = end+1;
+  } else{
+    *cursor = NULL;
+  }
+  return trimWSExtensionToken(start);
+}
+
+/* window bits are 8 to 15, but zlib cannot produce a raw deflate stream with a 256 byte window */
+static int parseWSWindowBits(char *value, int minimum){
+  if (value == NULL || *value == 0){
+    return -1;
+  }
+  for (char *c = value; *c; c++){
+    if (*c < '0' || *c > '9'){
+      return -1;
+    }
+  }
+  int bits = atoi(value);
+  return (bits >= minimum && bits <= MAX_WBITS) ? bits : -1;
+}
+
+/*
+  Takes the first permessage-deflate offer in Sec-WebSocket-Extensions whose parameters are all
+  understood, and returns its state along with the extension line to answer with.  Returns NULL
+  when there is nothing acceptable, so the connection goes on uncompressed.
+ */
+static WSDeflate *negotiateWSDeflate(ShortLivedHeap *slh, char *offers, int level, char **agreed){
+  char *offerCursor = copyString(slh,offers,strlen(offers));
+  char *offer = NULL;
+  while ((offer = nextWSExtensionToken(&offerCursor,',')) != NULL){
+    char *paramCursor = offer;
+    char *name = nextWSExtensionToken(&paramCursor,';');
+    if (strcmp(name,"permessage-deflate")){
+      continue;
+    }
+    WSDeflate terms;
+    memset(&terms,0,sizeof(WSDeflate));
+    terms.serverMaxWindowBits = MAX_WBITS;
+    terms.clientMaxWindowBits = MAX_WBITS;
+    int serverBitsGiven = FALSE;
+    int clientBitsGiven = FALSE;
+    int clientBitsOffered = FALSE;
+    int acceptable = TRUE;
+    char *param = NULL;
+    while (acceptable && (param = nextWSExtensionToken(&paramCursor,';')) != NULL){
+      char *value = strchr(param,'=');
+      if (value){
+        *value = 0;
+        value = trimWSExtensionToken(value+1);
+        param = trimWSExtensionToken(param);
+      }
+      if (!strcmp(param,"server_no_context_takeover") && value == NULL && !terms.serverNoContextTakeover){
+        terms.serverNoContextTakeover = TRUE;
+      } else if (!strcmp(param,"client_no_context_takeover") && value == NULL && !terms.clientNoContextTakeover){
+        terms.clientNoContextTakeover = TRUE;
+      } else if (!strcmp(param,"server_max_window_bits") && !serverBitsGiven){
+        serverBitsGiven = TRUE;
+        terms.serverMaxWindowBits = parseWSWindowBits(value,9);
+        acceptable = (terms.serverMaxWindowBits > 0);
+      } else if (!strcmp(param,"client_max_window_bits") && !clientBitsOffered){
+        /* without a value the client only says it can honour a limit, none is set here */
+        clientBitsOffered = TRUE;
+        if (value){
+          clientBitsGiven = TRUE;
+          terms.clientMaxWindowBits = parseWSWindowBits(value,8);
+          acceptable = (terms.clientMaxWindowBits > 0);
+        }
+      } else{
+        acceptable = FALSE;
+      }
+    }
+    if (!acceptable){
+      zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "declined permessage-deflate offer with parameter '%s'\n",
+              param ? param : "");
+      continue;
+    }
+    char *line = SLHAlloc(slh,128);
+    int len = sprintf(line,"permessage-deflate");
+    if (terms.serverNoContextTakeover){
+      len += sprintf(line+len,"; server_no_context_takeover");
+    }
+    if (terms.clientNoContextTakeover){
+      len += sprintf(line+len,"; client_no_context_takeover");
+    }
+    if (serverBitsGiven){
+      len += sprintf(line+len,"; server_max_window_bits=%d",terms.serverMaxWindowBits);
+    }
+    if (clientBitsGiven){
+      len += sprintf(line+len,"; client_max_window_bits=%d",terms.clientMaxWindowBits);
+    }
+    *agreed = line;
+    WSDeflate *state = (WSDeflate*)safeMalloc(sizeof(WSDeflate),"WSDeflate");
+    memcpy(state,&terms,sizeof(WSDeflate));
+    state->level = (level > 9) ? 9 : level;
+    return state;
+  }
+  return NULL;
+}
+
+static void freeWSDeflate(WSDeflate *state){
+  if (state->deflaterReady){
+    deflateEnd(&state->deflater);
+  }
+  if (state->inflaterReady){
+    inflateEnd(&state->inflater);
+  }
+  if (state->outputBuffer){
+    safeFree(state->outputBuffer,state->outputBufferSize);
+  }
+  safeFree((char*)state,sizeof(WSDeflate));
+}
+
+/*
+  Replaces the frames of a message that arrived with RSV1 by one final frame holding the inflated
+  payload.  Returns FALSE if the data does not inflate or inflates to more than the limit.
+ */
+static int inflateWSMessage(WSDeflate *state, WSMessage *message){
+  z_stream *z = &state->inflater;
+  if (!state->inflaterReady){
+    /* a larger window than the client uses is harmless, zlib wants at least 9 bits */
+    int windowBits = (state->clientMaxWindowBits < 9) ? 9 : state->clientMaxWindowBits;
+    memset(z,0,sizeof(z_stream));
+    if (inflateInit2(z,-windowBits) != Z_OK){
+      return FALSE;
+    }
+    state->inflaterReady = TRUE;
+  }
+  int compressedLength = 0;
+  for (WSFrame *frame = message->firstFrame; frame; frame = frame->next){
+    compressedLength += frame->dataLength;
+  }
+  BigBuffer *inflated = makeBigBuffer(compressedLength < WS_INFLATE_STEP ? WS_INFLATE_STEP : compressedLength*2,NULL);
+  int ok = TRUE;
+  int streamEnded = FALSE;
+  WSFrame *frame = message->firstFrame;
+  while (ok && !streamEnded){
+    if (frame){
+      z->next_in = (Bytef*)frame->data;
+      z->avail_in = frame->dataLength;
+    } else{
+      z->next_in = (Bytef*)wsDeflateTail;
+      z->avail_in = sizeof(wsDeflateTail);
+    }
+    do{
+      z->next_out = (Bytef*)reserveBigBuffer(inflated,WS_INFLATE_STEP);
+      z->avail_out = WS_INFLATE_STEP;
+      int zrc = inflate(z,Z_SYNC_FLUSH);
+      inflated->pos += WS_INFLATE_STEP - z->avail_out;
+      if (zrc == Z_STREAM_END){
+        /* a final block was sent, nothing after it belongs to the stream */
+        streamEnded = TRUE;
+      } else if (zrc == Z_BUF_ERROR){
+        break;
+      } else if (zrc != Z_OK){
+        ok = FALSE;
+      }
+      if (inflated->pos > WS_DEFLATE_MAX_MESSAGE_SIZE){
+        ok = FALSE;
+      }
+    } while (ok && !streamEnded && (z->avail_in > 0 || z->avail_out == 0));
+    if (frame == NULL){
+      break;
+    }
+    frame = frame->next;
+  }
+  if (!ok){
+    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_WARNING, "WebSocket message did not inflate: %s\n",
+            z->msg ? z->msg : "too large");
+    freeBigBuffer(inflated,TRUE);
+    return FALSE;
+  }
+  if (streamEnded || state->clientNoContextTakeover){
+    inflateReset(z);
+  }
+  /* ownership of the big buffer's data goes to the new frame */
+  int opcodeAndFlags = (message->firstFrame->opcodeAndFlags & ~WS_RSV1) | 0x80;
+  message->firstFrame = makeFrame(opcodeAndFlags,NULL,inflated->data,inflated->pos);
+  freeBigBuffer(inflated,FALSE);
+  return TRUE;
+}
+
+/*
+  Compresses one frame's worth of an outgoing message into the session's deflate buffer.  Frames
+  before the last are not flushed, so they may come out short or even empty.
+ */
+static int deflateWSPayload(WSDeflate *state, char *payload, int length, int isLastFrame,
+                            char **compressed, int *compressedLength){
+  z_stream *z = &state->deflater;
+  if (!state->deflaterReady){
+    memset(z,0,sizeof(z_stream));
+    if (deflateInit2(z, state->level, Z_DEFLATED, -state->serverMaxWindowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK){
+      return 8;
+    }
+    state->deflaterReady = TRUE;
+  }
+  int flush = isLastFrame ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+  int pos = 0;
+  z->next_in = (Bytef*)payload;
+  z->avail_in = length;
+  while (TRUE){
+    if (state->outputBufferSize - pos < 64){
+      int newSize = state->outputBufferSize ? state->outputBufferSize*2 : (length/2 + 256);
+      char *newBuffer = safeMalloc(newSize,"WS deflate buffer");
+      if (pos > 0){
+        memcpy(newBuffer,state->outputBuffer,pos);
+      }
+      if (state->outputBuffer){
+        safeFree(state->outputBuffer,state->outputBufferSize);
+      }
+      state->outputBuffer = newBuffer;
+      state->outputBufferSize = newSize;
+    }
+    z->next_out = (Bytef*)(state->outputBuffer+pos);
+    z->avail_out = state->outputBufferSize-pos;
+    int zrc = deflate(z,flush);
+    pos = state->outputBufferSize - z->avail_out;
+    if (zrc == Z_STREAM_ERROR){
+      return 8;
+    }
+    /* room left over means all the input is in and any flush is complete */
+    if (z->avail_out > 0){
+      break;
+    }
+  }
+  if (isLastFrame){
+    if (pos >= 4 && !memcmp(state->outputBuffer+pos-4,wsDeflateTail,4)){
+      pos -= 4;
+    } else if (pos == 0){
+      /* an empty message right after a flush, sent as the lone empty stored block header */
+      state->outputBuffer[0] = 0;
+      pos = 1;
+    }
+    if (state->serverNoContextTakeover){
+      deflateReset(z);
+    }
+  }
+  *compressed = state->outputBuffer;
+  *compressedLength = pos;
+  return 0;
+}
+
+#endif /* USE_ZLIB */
+
+static int wsFrameHeaderLength(int payloadLength){
+  if (payloadLength >= 65536){
+    return 10;
+  } else if (payloadLength >= 126){
+    return 4;
+  } else{
+    return 2;
+  }
+}
+
+/* writes an unmasked (server) frame header, the extended length is in network byte order */
+static int encodeWSFrameHeader(char *header, int opcodeAndFlags, int payloadLength){
+  int headerLength = wsFrameHeaderLength(payloadLength);
+  header[0] = opcodeAndFlags;
+  if (headerLength == 10){
+    header[1] = 127;
+    int64 longLength = payloadLength;
+    for (int i=0; i<8; i++){
+      header[2+i] = (char)((longLength >> (56-8*i)) & 0xFF);
+    }
+  } else if (headerLength == 4){
+    header[1] = 126;
+    header[2] = (char)((payloadLength >> 8) & 0xFF);
+    header[3] = (char)(payloadLength & 0xFF);
+  } else{
+    header[1] = payloadLength;
+  }
+  return headerLength;
+}
+
+/*adds new server WS msg to provided work element*/
 static void addNewWSFrame(HttpWorkElement *workElement, 
                           WSSession *session,
                           int opcodeAndFlags, 
                           int payloadLength, 
                           char *payload, 
                           int isLastFrame) {
-  /* build header here */
-  int isMasked = FALSE; /* false for servers */
-  int headerLength = 2;
-  if (payloadLength >= 65536){
-    headerLength += 8;
-  } else if (payloadLength >= 126){
-    headerLength += 2;
-  }                            
-                            
+  int headerLength = wsFrameHeaderLength(payloadLength);
   workElement->buffer = safeMalloc(payloadLength+headerLength,"ws write buffer");
-  workElement->buffer[0] = opcodeAndFlags;
-  if (payloadLength >= 65536){
-    workElement->buffer[1] = 127;
-    int64 longLength = payloadLength;
-    memcpy(workElement->buffer+2,&longLength,8);
-  } else if (payloadLength >= 126){
-    workElement->buffer[1] = 126;
-    unsigned short shortLength = payloadLength&0xFFFF;
-    memcpy(workElement->buffer+2,&shortLength,2);
-  } else{
-    workElement->buffer[1] = payloadLength;
-  }
-
+  encodeWSFrameHeader(workElement->buffer,opcodeAndFlags,payloadLength);
   memcpy(workElement->buffer+headerLength,payload,payloadLength);
   workElement->bufferLength = payloadLength+headerLength;
   workElement->reclaimAfterWrite = TRUE;
   workElement->wsResponseIsBinary = session->isOutputBinary;
   workElement->wsResponseIsLastFrame = isLastFrame;
+  httpAtomicAdd(&session->pendingOutputFrames,1);
 }
 
 static void wsMessageClose(HttpConversation *conversation,
@@ -703,15 +1870,16 @@ static void wsMessageClose(HttpConversation *conversation,
   stcEnqueueWork(stcBase,prefix);                          
 }
 
+#define WS_PAYLOAD_PREALLOCATE_LIMIT (1024*1024) /* larger frames grow as they arrive */
+
 static int readMachineAdvance(WSReadMachine *m, char *data, WSSession *wsSession, int offset, int length){
   int available = length;
   int loopMax = 10;
   int loopCount = 0;
   int anyMessagesReady = FALSE;
   int shouldClose = FALSE;
-  m->trace = TRUE;
   while (available > 0){
-    if (TRUE || m->trace){
+    if (m->trace){
       printf("advanceLoop offset=%02d available=%02d headerFill=%02d headerNeed=%02d\n",
              offset,available,m->headerFill,m->headerNeed);
       dumpbuffer(data+offset,available);
@@ -770,7 +1938,6 @@ static int readMachineAdvance(WSReadMachine *m, char *data, WSSession *wsSession
         break;
       case 2:
         m->payloadLength = (int64)(*((unsigned short*)(&m->headerBuffer[2])));
-        printf("m->payloadLength (firstGo) is %lld\n",m->payloadLength);
         break;
       case 8:
         m->payloadLength = *((int64*)(&m->headerBuffer[2]));
@@ -784,6 +1951,11 @@ static int readMachineAdvance(WSReadMachine *m, char *data, WSSession *wsSession
       }
       m->headerRead = TRUE;
     }
+    if (m->headerRead && m->payloadStream == NULL){
+      /* one allocation of the right size that the frame then owns, within reason */
+      int64 initialSize = (m->payloadLength < WS_PAYLOAD_PREALLOCATE_LIMIT ? m->payloadLength : WS_PAYLOAD_PREALLOCATE_LIMIT);
+      m->payloadStream = makeBigBuffer(initialSize > 0 ? (int)initialSize : 1,NULL);
+    }
     if (m->headerRead){
       int writeLength = ((available > (m->payloadLength - m->payloadFill)) ?
                          (int)(m->payloadLength - m->payloadFill) :
@@ -792,19 +1964,10 @@ static int readMachineAdvance(WSReadMachine *m, char *data, WSSession *wsSession
         printf("data offset=%d, writeLength=%d\n",offset,writeLength);
       }
       if (m->isMasked){
-        dumpbuffer(data,writeLength);
-        for (int i=0; i<writeLength; i++){
-          int d = data[offset+i]&0xff;
-          int maskingByte = m->maskBytes[m->maskModulus]&0xff;
-          int u = d^maskingByte;
-          /* System.out.printf("data[%d]=0x%x m=0x%02x u=0x%02x\n",i,d,maskingByte,u); */
-          writeByteToBigBuffer(m->payloadStream,u);
-          
-          m->maskModulus++;
-          if (m->maskModulus == 4){
-            m->maskModulus = 0;
-          }
-        }
+        /* unmasked on the way out of the read buffer, which the next read will overwrite */
+        char *dest = reserveBigBuffer(m->payloadStream,writeLength);
+        m->maskModulus = unmaskWSPayload(dest,data+offset,writeLength,m->maskBytes,m->maskModulus);
+        m->payloadStream->pos += writeLength;
       } else{
         writeToBigBuffer(m->payloadStream,data+offset,writeLength);
       }
@@ -824,12 +1987,26 @@ static int readMachineAdvance(WSReadMachine *m, char *data, WSSession *wsSession
         if (m->currentMessage == NULL){
           m->currentMessage = makeMessage(OPCODE_UNKNOWN,NULL);
         }
-        /* in the follwing 3 lines ownership of the big buffer goes to the new frame */
+        /* ownership of the big buffer's data goes to the new frame */
         addWSFrame(m->currentMessage,makeFrame(m->flagAndOpcodeByte,NULL,m->payloadStream->data,m->payloadStream->pos));
         freeBigBuffer(m->payloadStream,FALSE);
-        m->payloadStream = makeBigBuffer(256,NULL);
+        m->payloadStream = NULL;
 
         if (m->fin){
+#ifdef USE_ZLIB
+          if (shouldClose == FALSE && wsSession->deflate &&
+              (m->currentMessage->firstFrame->opcodeAndFlags & WS_RSV1)){
+            if (!inflateWSMessage(wsSession->deflate,m->currentMessage)){
+              /* 1007, invalid frame payload data */
+              char closePayload[2] = { 0x03, (char)0xEF };
+              wsSession->closeRequested = TRUE;
+              wsMessageClose((HttpConversation*)wsSession->conversation, wsSession,
+                             0x80|OPCODE_CONNECTION_CLOSE, closePayload, 2);
+              m->currentMessage = NULL;
+              return FALSE;
+            }
+          }
+#endif
           if (shouldClose != FALSE) {
             wsSession->closeRequested = TRUE;
             wsMessageClose((HttpConversation*)wsSession->conversation, wsSession, m->flagAndOpcodeByte, 
@@ -915,6 +2092,7 @@ WSSession *makeWSSession(HttpConversation *conversation,
   session->isServer = TRUE;
   session->wsOutputState = OUTPUT_STATE_ANY;
   session->negotiatedProtocol = negotiatedProtocol;
+  httpAtomicAdd(&conversation->server->metrics->activeWebSockets,1);
   return session;
 }
 
@@ -955,8 +2133,32 @@ static void wsMessageEnqueue(HttpConversation *conversation,
     payloadLength = conversionLength;
   }
 
-  int opcodeAndFlags = ((isLastFrame ? 0x80 : 0x00)|
-                        (session->isOutputBinary ? OPCODE_BINARY_FRAME : OPCODE_TEXT_FRAME));
+  /* only the first frame of a message says what it is, the rest are continuations */
+  int isFirstFrame = (session->wsOutputState == OUTPUT_STATE_ANY);
+  int opcodeAndFlags = (isLastFrame ? 0x80 : 0x00);
+  if (isFirstFrame){
+    opcodeAndFlags |= (session->isOutputBinary ? OPCODE_BINARY_FRAME : OPCODE_TEXT_FRAME);
+  }
+#ifdef USE_ZLIB
+  WSDeflate *deflateState = session->deflate;
+  if (deflateState){
+    if (isFirstFrame){
+      deflateState->compressingOutput = TRUE;
+    }
+    if (deflateState->compressingOutput &&
+        deflateWSPayload(deflateState,payload,payloadLength,isLastFrame,&payload,&payloadLength)){
+      /* nothing reasonable can follow a half compressed message, so the session stops using it */
+      zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_WARNING, "WebSocket deflate failed, closing\n");
+      session->conversation->shouldClose = TRUE;
+      payloadLength = 0;
+    }
+    if (isFirstFrame && deflateState->compressingOutput){
+      opcodeAndFlags |= WS_RSV1;
+    }
+  }
+#endif
+  session->wsOutputState = (isLastFrame ? OUTPUT_STATE_ANY :
+                            (session->isOutputBinary ? OUTPUT_STATE_BINARY_PARTIAL : OUTPUT_STATE_TEXT_PARTIAL));
   addNewWSFrame(workElement, session, opcodeAndFlags, payloadLength, payload, isLastFrame);
   stcEnqueueWork(stcBase,prefix);
 }
@@ -995,6 +2197,270 @@ int wsSessionMoreInput(WSSession *session){
   return 0;
 }
 
+/*
+  WebSocket groups.
+
+  A group is a topic with a set of member sessions.  A broadcast frames its payload once into a
+  reference counted buffer and enqueues a work element pointing at that buffer for each member,
+  so the cost of building the message does not grow with the audience.  Every session counts
+  the frames queued to it that have not been written yet; a member whose count has reached the
+  group's backlog limit is not keeping up, so it is dropped from the group and sent a close
+  (1008) rather than letting its queue grow without end.  A member in the middle of a fragmented
+  message of its own cannot take a frame either; it misses the broadcast, and that is counted
+  with the dropped members.
+
+  There is no lock to share a group between tasks under METTLE, so there are no groups there:
+  getWSGroup returns NULL, and the other calls take a NULL group as an empty one.
+
+  Shared frames are never compressed, a permessage-deflate session simply receives them as
+  uncompressed messages.
+ */
+
+typedef struct WSSharedFrame_tag{
+  int   refCount;
+  int   length;
+  char *data;
+} WSSharedFrame;
+
+struct WSGroup_tag{
+#ifndef METTLE
+  Mutex      lock;
+#endif
+  char      *topic;
+  WSSession **members;
+  int        memberCount;
+  int        memberCapacity;
+  int        maxBacklog;
+  int64      broadcastCount;
+  int64      droppedCount;      /* members dropped for their backlog and messages skipped */
+};
+
+typedef struct WSGroupRegistry_tag{
+#ifndef METTLE
+  Mutex      lock;
+#endif
+  hashtable *groups;            /* topic -> WSGroup */
+} WSGroupRegistry;
+
+#ifndef METTLE
+#define wsGroupLock(g) mutexLock((g)->lock)
+#define wsGroupUnlock(g) mutexUnlock((g)->lock)
+#else
+#define wsGroupLock(g)
+#define wsGroupUnlock(g)
+#endif
+
+static WSGroupRegistry *makeWSGroupRegistry(){
+  WSGroupRegistry *registry = (WSGroupRegistry*)safeMalloc(sizeof(WSGroupRegistry),"WSGroupRegistry");
+  memset(registry,0,sizeof(WSGroupRegistry));
+#ifndef METTLE
+  mutexCreate(registry->lock);
+#endif
+  registry->groups = htCreate(257,stringHash,stringCompare,NULL,NULL);
+  return registry;
+}
+
+static void releaseWSSharedFrame(WSSharedFrame *frame){
+  if (httpAtomicAdd(&frame->refCount,-1) == 0){
+    safeFree31(frame->data,frame->length);
+    safeFree31((char*)frame,sizeof(WSSharedFrame));
+  }
+}
+
+WSGroup *getWSGroup(HttpServer *server, char *topic){
+#ifdef METTLE
+  return NULL;
+#else
+  WSGroupRegistry *registry = server->wsGroups;
+  wsGroupLock(registry);
+  WSGroup *group = (WSGroup*)htGet(registry->groups,topic);
+  if (group == NULL){
+    group = (WSGroup*)safeMalloc(sizeof(WSGroup),"WSGroup");
+    memset(group,0,sizeof(WSGroup));
+#ifndef METTLE
+    mutexCreate(group->lock);
+#endif
+    int topicLength = strlen(topic);
+    group->topic = safeMalloc(topicLength+1,"WSGroup topic");
+    memcpy(group->topic,topic,topicLength+1);
+    group->maxBacklog = WS_GROUP_DEFAULT_MAX_BACKLOG;
+    htPut(registry->groups,group->topic,group);
+  }
+  wsGroupUnlock(registry);
+  return group;
+#endif
+}
+
+void wsGroupSetMaxBacklog(WSGroup *group, int maxBacklog){
+  if (group == NULL){
+    return;
+  }
+  wsGroupLock(group);
+  group->maxBacklog = maxBacklog;
+  wsGroupUnlock(group);
+}
+
+/* caller holds the lock, returns TRUE if the session was a member */
+static int removeWSGroupMember(WSGroup *group, WSSession *session){
+  for (int i = 0; i < group->memberCount; i++){
+    if (group->members[i] == session){
+      group->members[i] = group->members[--group->memberCount];
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+int wsGroupJoin(WSGroup *group, WSSession *session){
+  if (group == NULL){
+    return -1;
+  }
+  wsGroupLock(group);
+  for (int i = 0; i < group->memberCount; i++){
+    if (group->members[i] == session){
+      wsGroupUnlock(group);
+      return group->memberCount;
+    }
+  }
+  if (group->memberCount == group->memberCapacity){
+    int newCapacity = (group->memberCapacity > 0 ? group->memberCapacity*2 : 16);
+    WSSession **newMembers = (WSSession**)safeMalloc(newCapacity*sizeof(WSSession*),"WSGroup members");
+    if (group->memberCount > 0){
+      memcpy(newMembers,group->members,group->memberCount*sizeof(WSSession*));
+    }
+    if (group->members){
+      safeFree((char*)group->members,group->memberCapacity*sizeof(WSSession*));
+    }
+    group->members = newMembers;
+    group->memberCapacity = newCapacity;
+  }
+  group->members[group->memberCount++] = session;
+  int memberCount = group->memberCount;
+  wsGroupUnlock(group);
+  return memberCount;
+}
+
+void wsGroupLeave(WSGroup *group, WSSession *session){
+  if (group == NULL){
+    return;
+  }
+  wsGroupLock(group);
+  removeWSGroupMember(group,session);
+  wsGroupUnlock(group);
+}
+
+static void leaveWSGroupVisitor(void *userData, void *key, void *value){
+  wsGroupLeave((WSGroup*)value,(WSSession*)userData);
+}
+
+/* a session being cleaned up must not be left behind in any group */
+static void leaveAllWSGroups(HttpServer *server, WSSession *session){
+  WSGroupRegistry *registry = server->wsGroups;
+  wsGroupLock(registry);
+  htMap2(registry->groups,leaveWSGroupVisitor,session);
+  wsGroupUnlock(registry);
+}
+
+static void enqueueWSSharedFrame(WSSession *session, WSSharedFrame *frame){
+  HttpConversation  *conversation = session->conversation;
+  WorkElementPrefix *prefix = (WorkElementPrefix*)safeMalloc31(sizeof(WorkElementPrefix)+sizeof(HttpWorkElement),"HttpWorkElement and Prefix for WS");
+  HttpWorkElement   *workElement = (HttpWorkElement*)(((char*)prefix)+sizeof(WorkElementPrefix));
+  memset(prefix,0,sizeof(WorkElementPrefix));
+  memcpy(prefix->eyecatcher,"WRKELMNT",8);
+  prefix->payloadCode = HTTP_WS_OUTPUT;
+  prefix->payloadLength = sizeof(HttpWorkElement);
+  memset(workElement,0,sizeof(HttpWorkElement));
+  workElement->conversation = conversation;
+  workElement->sharedFrame = frame;
+  workElement->wsResponseIsLastFrame = TRUE;
+  httpAtomicAdd(&frame->refCount,1);
+  httpAtomicAdd(&session->pendingOutputFrames,1);
+  stcEnqueueWork(conversation->server->base,prefix);
+}
+
+static int broadcastWSFrame(WSGroup *group, int opcodeAndFlags, char *payload, int payloadLength){
+  if (group == NULL){
+    return 0;
+  }
+  WSSharedFrame *frame = (WSSharedFrame*)safeMalloc31(sizeof(WSSharedFrame),"WSSharedFrame");
+  int headerLength = wsFrameHeaderLength(payloadLength);
+  frame->length = headerLength+payloadLength;
+  frame->data = safeMalloc31(frame->length,"WSSharedFrame data");
+  encodeWSFrameHeader(frame->data,opcodeAndFlags,payloadLength);
+  memcpy(frame->data+headerLength,payload,payloadLength);
+  frame->refCount = 1;          /* held by this function until every member has its own */
+
+  int delivered = 0;
+  wsGroupLock(group);
+  group->broadcastCount++;
+  int i = 0;
+  while (i < group->memberCount){
+    WSSession *session = group->members[i];
+    if (session->closeRequested){
+      i++;
+    } else if (session->pendingOutputFrames >= group->maxBacklog){
+      /* 1008, policy violation */
+      char closePayload[2] = { 0x03, (char)0xF0 };
+      zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_INFO,
+              "WS group '%s' dropping slow session 0x%p, %d frames unsent\n",
+              group->topic,session,session->pendingOutputFrames);
+      removeWSGroupMember(group,session);
+      group->droppedCount++;
+      session->closeRequested = TRUE;
+      wsMessageClose(session->conversation,session,0x80|OPCODE_CONNECTION_CLOSE,closePayload,2);
+    } else if (session->wsOutputState != OUTPUT_STATE_ANY){
+      /* a frame dropped into the middle of a fragmented message would corrupt it */
+      zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_INFO,
+              "WS group '%s' skipped session 0x%p, mid-message\n",group->topic,session);
+      group->droppedCount++;
+      i++;
+    } else{
+      enqueueWSSharedFrame(session,frame);
+      delivered++;
+      i++;
+    }
+  }
+  wsGroupUnlock(group);
+  releaseWSSharedFrame(frame);
+  return delivered;
+}
+
+int wsGroupBroadcastText(WSGroup *group, char *text, int length, int ccsid){
+  if (ccsid == CCSID_UTF_8){
+    return broadcastWSFrame(group,0x80|OPCODE_TEXT_FRAME,text,length);
+  }
+  int convertedLength = 0;
+  int reasonCode = 0;
+  int bufferSize = length*2+1;
+  char *converted = safeMalloc(bufferSize,"WS broadcast conversion");
+  int status = convertCharset(text,length,ccsid,
+                              CHARSET_OUTPUT_USE_BUFFER,&converted,bufferSize,
+                              CCSID_UTF_8,NULL,&convertedLength,&reasonCode);
+  int delivered = -1;
+  if (status == 0){
+    delivered = broadcastWSFrame(group,0x80|OPCODE_TEXT_FRAME,converted,convertedLength);
+  } else{
+    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_WARNING,
+            "WS group '%s' broadcast not converted from CCSID %d, status=%d reason=%d\n",
+            group->topic,ccsid,status,reasonCode);
+  }
+  safeFree(converted,bufferSize);
+  return delivered;
+}
+
+int wsGroupBroadcastBinary(WSGroup *group, char *data, int length){
+  return broadcastWSFrame(group,0x80|OPCODE_BINARY_FRAME,data,length);
+}
+
+int64 wsGroupGetDroppedCount(WSGroup *group){
+  if (group == NULL){
+    return 0;
+  }
+  wsGroupLock(group);
+  int64 droppedCount = group->droppedCount;
+  wsGroupUnlock(group);
+  return droppedCount;
+}
 
 /******** Request/Response and Header Management ***********/
 
@@ -1061,7 +2527,8 @@ static void traceHeader(const char*line, int len)
 
 #define JED_HTTP_KEEP_ALIVE_MAX 1000
 
-void writeHeader(HttpResponse *response){
+/* formats the status line and all headers into one ASCII block in the response SLH */
+static char *formatHeaderBlock(HttpResponse *response, int *blockLength){
   if (response->sessionCookie) {
     addStringHeader(response, "Set-Cookie", response->sessionCookie);
     if (response->sessionTimeout) {
@@ -1080,18 +2547,28 @@ void writeHeader(HttpResponse *response){
     }
   }
 
-  Socket *socket = response->socket;
-  int returnCode;
-  int reasonCode;
-  char line[1024];
-  int len = 0;
   HttpHeader *headerChain = response->headers;
+  int blockSize = 32 + (response->message ? strlen(response->message) : 0);
+  while (headerChain){
+    blockSize += strlen(headerChain->name) + 16 +
+      (headerChain->value ? strlen(headerChain->value) : 0);
+    headerChain = headerChain->next;
+  }
+
+  /* the whole header block is formatted into one buffer so it can go out in one write */
+  char *block = SLHAlloc(response->slh,blockSize);
+  char *line = block;
+  int len = 0;
+  headerChain = response->headers;
   
+  if (response->conversation){
+    response->conversation->responseStatus = response->status;
+  }
   len = sprintf(line,"HTTP/1.1 %d %s",response->status,response->message);
   asciify(line,len);
   traceHeader(line,len);
-  writeFully(socket,line,len);
-  writeFully(socket,crlf,2);
+  memcpy(line+len,crlf,2);
+  line += len+2;
   while (headerChain){
     if (headerChain->value){
       len = sprintf(line,"%s: %s",headerChain->name, headerChain->value);
@@ -1100,11 +2577,36 @@ void writeHeader(HttpResponse *response){
     }
     asciify(line,len);
     traceHeader(line,len);
-    writeFully(socket,line,len);
-    writeFully(socket,crlf,2);
+    memcpy(line+len,crlf,2);
+    line += len+2;
     headerChain = headerChain->next;
   }
-  writeFully(socket,crlf,2);
+  memcpy(line,crlf,2);
+  line += 2;
+  *blockLength = (int)(line - block);
+  return block;
+}
+
+void writeHeader(HttpResponse *response){
+  int blockLength = 0;
+  char *block = formatHeaderBlock(response,&blockLength);
+  ChunkedOutputStream *stream = response->stream;
+  if (stream && !response->runningInSubtask && stream->fill == 0 && stream->pendingHeader == NULL){
+    /* held back until the first chunk (or the end of the response) so they are sent together */
+    stream->pendingHeader = block;
+    stream->pendingHeaderLength = blockLength;
+  } else{
+    writeResponseBytes(response,block,blockLength);
+  }
+}
+
+/* writes the header block and a small, already-encoded body with one vectored write */
+static void writeHeaderAndBody(HttpResponse *response, char *body, int bodyLength){
+  HttpIOVector vector[2];
+  vector[0].data = formatHeaderBlock(response,&vector[0].length);
+  vector[1].data = body;
+  vector[1].length = bodyLength;
+  writeResponseVector(response,vector,2,0);
 }
 
 void writeRequest(HttpRequest *request, Socket *socket){
@@ -1440,77 +2942,1045 @@ static int encodeSessionToken(ShortLivedHeap *slh,
     return -1;
   }
 
-  *result = encodedTokenText;
-  return 0;
+  *result = encodedTokenText;
+  return 0;
+
+#elif defined(__ZOWE_OS_WINDOWS)
+
+  printf("*WARNING* - Trivial Cipher in use\n");
+  trivialEncipher(encodedTokenText,tokenText,tokenTextLength);
+  *result = encodedTokenText;
+  return 0;
+  
+#else
+
+#error Session token encoding has been implemented for z/OS only
+
+#endif /* __ZOWE_OS_ZOS */
+
+}
+
+static int decodeSessionToken(ShortLivedHeap *slh,
+                              const HttpServerConfig *config,
+                              const char *encodedTokenText,
+                              unsigned int encodedTokenTextLength,
+                              char **result) {
+  unsigned int tokenTextLength = encodedTokenTextLength;
+  unsigned int paddingLength = 4;
+  char *tokenText = SLHAlloc(slh, tokenTextLength+paddingLength);
+  if (tokenText == NULL) {
+    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG,
+    		    "Error: decoded session token buffer not allocated "
+            "(size=%u, SLH=%p)\n", encodedTokenTextLength, slh);
+    return -1;
+  }
+
+#ifdef __ZOWE_OS_ZOS
+
+  int icsfRSN = 0;
+  int icsfRC = icsfDecipher(config->sessionTokenKey,
+                            config->sessionTokenKeySize,
+                            encodedTokenText,
+                            encodedTokenTextLength,
+                            tokenText,
+                            tokenTextLength,
+                            &icsfRSN);
+  if (icsfRC != 0) {
+    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG,
+    		    "Error: session token decoding failed, RC = %d, RSN = %d\n",
+            icsfRC, icsfRSN);
+    return FALSE;
+  }
+
+  // always null terminate because consumer might be expecting null terminate on other side
+  tokenText[tokenTextLength]=0;
+  *result = tokenText;
+  return 0;
+
+#elif defined(__ZOWE_OS_WINDOWS)
+
+  printf("*WARNING* - Trivial Cipher in use\n");
+  trivialDecipher(tokenText,encodedTokenText,tokenTextLength);
+  *result = tokenText;
+  return 0;
+
+
+#else
+
+#error Session token decoding has been implemented for z/OS only
+
+#endif /* __ZOWE_OS_ZOS */
+
+}
+
+#ifdef __ZOWE_OS_ZOS
+
+#define ONE_SECOND (4096*1000000)    /* one second in STCK */
+
+static int64 getFineGrainedTime(){
+  int64 stck = 0;
+  unsigned long long outSeconds = 0;
+  __asm(ASM_PREFIX
+        " STCK %0 "
+        :
+        "=m"(stck)
+        :
+        : "r15");
+
+  return stck;
+}
+#else
+
+#define ONE_SECOND 1     /* unix 32 bit time is usually in integral seconds */
+
+static int64 getFineGrainedTime(){
+  time_t rawtime;
+
+  time ( &rawtime );
+  if (sizeof(time_t) == 4){
+    return ((int64)rawtime)<<32;
+  } else{
+    return (int64)rawtime;
+  }
+}
+#endif
+
+#define SESSION_VALIDITY_IN_SECONDS 3600
+
+/*
+  Session token cache.
+
+  Deciphering a session token and looking up the user's session length can take a trip to ICSF
+  and the security product, and a browser sends the same token with every call a page makes.
+  Entries are keyed by a SHA-1 digest of the cookie value, so the cache does not hold usable
+  tokens, and keep what checking the token found.  They are added when a token is minted or first
+  checked.  An entry lives for the cache TTL or until the token expires, whichever comes first,
+  and a token minted by renewing a cached one inherits the time its session length was looked up,
+  so that no session goes longer than the TTL without a fresh look-up.
+
+  Logout revokes the whole session, that is the token that was presented and every renewal of it
+  before or after, which all carry the time the session started.  Revocations are kept apart from
+  the entries, are never evicted, and go once no token of the session can still be valid.
+ */
+
+#define SESSION_TOKEN_DIGEST_LENGTH 20
+
+typedef struct HttpSessionCacheEntry_tag{
+  char      key[2*SESSION_TOKEN_DIGEST_LENGTH+1]; /* hex digest of the cookie value */
+  char     *username;           /* upper case */
+  int       usernameLength;
+  uint64    issuedAt;           /* the timestamp in the token */
+  uint64    sessionStart;       /* when the session's first token was issued */
+  uint64    serverInstanceUID;
+  int       validitySec;        /* -1 for no expiry */
+  uint64    checkedAt;          /* when validitySec was looked up */
+  uint64    expiresAt;          /* when the entry must be dropped, 0 for never */
+  struct HttpSessionCacheEntry_tag *newer;
+  struct HttpSessionCacheEntry_tag *older;
+} HttpSessionCacheEntry;
+
+typedef struct HttpSessionRevocation_tag{
+  char     *sessionKey;         /* user:sessionStart:serverInstanceUID */
+  int       sessionKeyLength;
+  uint64    expiresAt;          /* 0 for never */
+  struct HttpSessionRevocation_tag *next;
+} HttpSessionRevocation;
+
+typedef struct HttpSessionCache_tag{
+#ifndef METTLE
+  Mutex      lock;
+#endif
+  hashtable *entries;           /* key -> HttpSessionCacheEntry */
+  HttpSessionCacheEntry *newest;
+  HttpSessionCacheEntry *oldest;
+  int        count;
+  int        maxEntries;        /* 0 when caching is off, revocations are still kept */
+  int        ttlSeconds;
+  hashtable *revocations;       /* sessionKey -> HttpSessionRevocation */
+  HttpSessionRevocation *revocationList;
+} HttpSessionCache;
+
+#ifndef METTLE
+#define sessionCacheLock(c) mutexLock((c)->lock)
+#define sessionCacheUnlock(c) mutexUnlock((c)->lock)
+#else
+#define sessionCacheLock(c)
+#define sessionCacheUnlock(c)
+#endif
+
+static HttpSessionCache *makeHttpSessionCache(int maxEntries, int ttlSeconds){
+  HttpSessionCache *cache = (HttpSessionCache*)safeMalloc(sizeof(HttpSessionCache),"HttpSessionCache");
+  memset(cache,0,sizeof(HttpSessionCache));
+#ifndef METTLE
+  mutexCreate(cache->lock);
+#endif
+  cache->entries = htCreate(1021,stringHash,stringCompare,NULL,NULL);
+  cache->revocations = htCreate(257,stringHash,stringCompare,NULL,NULL);
+  cache->maxEntries = maxEntries;
+  cache->ttlSeconds = ttlSeconds;
+  return cache;
+}
+
+static void makeSessionTokenKey(char *tokenText, char *key){
+  DigestContext context;
+  char hash[SESSION_TOKEN_DIGEST_LENGTH];
+  digestContextInit(&context,CRYPTO_DIGEST_SHA1);
+  digestContextUpdate(&context,tokenText,strlen(tokenText));
+  digestContextFinish(&context,hash);
+  simpleHexPrint(key,hash,SESSION_TOKEN_DIGEST_LENGTH);
+}
+
+static char *makeSessionKey(ShortLivedHeap *slh, char *username, uint64 sessionStart,
+                            uint64 serverInstanceUID){
+  int keySize = strlen(username) + 40;
+  char *sessionKey = SLHAlloc(slh,keySize);
+  snprintf(sessionKey,keySize,"%s:%llx:%llx",username,sessionStart,serverInstanceUID);
+  strupcase(sessionKey);
+  return sessionKey;
+}
+
+/* caller holds the lock */
+static void removeSessionCacheEntry(HttpSessionCache *cache, HttpSessionCacheEntry *entry){
+  htRemove(cache->entries,entry->key);
+  if (entry->older){
+    entry->older->newer = entry->newer;
+  } else{
+    cache->oldest = entry->newer;
+  }
+  if (entry->newer){
+    entry->newer->older = entry->older;
+  } else{
+    cache->newest = entry->older;
+  }
+  cache->count--;
+  safeFree(entry->username,entry->usernameLength+1);
+  safeFree((char*)entry,sizeof(HttpSessionCacheEntry));
+}
+
+/* caller holds the lock, makes room for more entries */
+static void trimSessionCache(HttpSessionCache *cache, int extraEntries){
+  while (cache->oldest && cache->count + extraEntries > cache->maxEntries){
+    removeSessionCacheEntry(cache,cache->oldest);
+  }
+}
+
+/* the entry may be used until the TTL from the look-up runs out, and never past the token's expiry */
+static uint64 sessionCacheExpiry(HttpSessionCache *cache, uint64 checkedAt, uint64 issuedAt, int validitySec){
+  uint64 tokenExpiry = validitySec > 0 ? issuedAt + ((uint64)validitySec)*ONE_SECOND : 0;
+  uint64 ttlExpiry = checkedAt + ((uint64)cache->ttlSeconds)*ONE_SECOND;
+  return (tokenExpiry != 0 && tokenExpiry < ttlExpiry) ? tokenExpiry : ttlExpiry;
+}
+
+/* checkedAt is when validitySec was looked up, 0 if it is not known */
+static void sessionCachePut(HttpServer *server, char *tokenText, char *username, uint64 issuedAt,
+                            uint64 sessionStart, uint64 serverInstanceUID, int validitySec,
+                            uint64 checkedAt){
+  HttpSessionCache *cache = server->sessionCache;
+  if (cache == NULL || cache->maxEntries <= 0 || validitySec == 0 || checkedAt == 0){
+    return;
+  }
+  uint64 expiresAt = sessionCacheExpiry(cache,checkedAt,issuedAt,validitySec);
+  if (expiresAt <= getFineGrainedTime()){
+    return;
+  }
+  int usernameLength = strlen(username);
+  HttpSessionCacheEntry *entry = (HttpSessionCacheEntry*)safeMalloc(sizeof(HttpSessionCacheEntry),"HttpSessionCacheEntry");
+  memset(entry,0,sizeof(HttpSessionCacheEntry));
+  makeSessionTokenKey(tokenText,entry->key);
+  entry->username = safeMalloc(usernameLength+1,"HttpSessionCacheEntry user");
+  memcpy(entry->username,username,usernameLength+1);
+  strupcase(entry->username);
+  entry->usernameLength = usernameLength;
+  entry->issuedAt = issuedAt;
+  entry->sessionStart = sessionStart;
+  entry->serverInstanceUID = serverInstanceUID;
+  entry->validitySec = validitySec;
+  entry->checkedAt = checkedAt;
+  entry->expiresAt = expiresAt;
+
+  sessionCacheLock(cache);
+  HttpSessionCacheEntry *existing = (HttpSessionCacheEntry*)htGet(cache->entries,entry->key);
+  if (existing){
+    removeSessionCacheEntry(cache,existing);
+  }
+  trimSessionCache(cache,1);
+  htPut(cache->entries,entry->key,entry);
+  entry->older = cache->newest;
+  if (cache->newest){
+    cache->newest->newer = entry;
+  } else{
+    cache->oldest = entry;
+  }
+  cache->newest = entry;
+  cache->count++;
+  sessionCacheUnlock(cache);
+}
+
+/* copies what is needed out of the entry, the entry itself may go as soon as the lock is dropped */
+static bool sessionCacheGet(HttpServer *server, char *tokenText, ShortLivedHeap *slh, char **username,
+                            uint64 *issuedAt, uint64 *sessionStart, uint64 *serverInstanceUID,
+                            int *validitySec, uint64 *checkedAt){
+  HttpSessionCache *cache = server->sessionCache;
+  if (cache == NULL || cache->maxEntries <= 0){
+    return false;
+  }
+  bool found = false;
+  char key[2*SESSION_TOKEN_DIGEST_LENGTH+1];
+  makeSessionTokenKey(tokenText,key);
+  uint64 now = getFineGrainedTime();
+  sessionCacheLock(cache);
+  HttpSessionCacheEntry *entry = (HttpSessionCacheEntry*)htGet(cache->entries,key);
+  if (entry && now > entry->expiresAt){
+    removeSessionCacheEntry(cache,entry);
+    entry = NULL;
+  }
+  if (entry){
+    *username = SLHAlloc(slh,entry->usernameLength+1);
+    memcpy(*username,entry->username,entry->usernameLength+1);
+    *issuedAt = entry->issuedAt;
+    *sessionStart = entry->sessionStart;
+    *serverInstanceUID = entry->serverInstanceUID;
+    *validitySec = entry->validitySec;
+    *checkedAt = entry->checkedAt;
+    found = true;
+  }
+  sessionCacheUnlock(cache);
+  return found;
+}
+
+static bool isSessionRevoked(HttpServer *server, char *sessionKey){
+  HttpSessionCache *cache = server->sessionCache;
+  if (cache == NULL){
+    return false;
+  }
+  sessionCacheLock(cache);
+  HttpSessionRevocation *revocation = (HttpSessionRevocation*)htGet(cache->revocations,sessionKey);
+  bool revoked = (revocation != NULL);
+  sessionCacheUnlock(cache);
+  return revoked;
+}
+
+/* caller holds the lock, drops the revocations of sessions whose tokens have all expired */
+static void pruneSessionRevocations(HttpSessionCache *cache, uint64 now){
+  HttpSessionRevocation **link = &cache->revocationList;
+  while (*link){
+    HttpSessionRevocation *revocation = *link;
+    if (revocation->expiresAt != 0 && now > revocation->expiresAt){
+      *link = revocation->next;
+      htRemove(cache->revocations,revocation->sessionKey);
+      safeFree(revocation->sessionKey,revocation->sessionKeyLength+1);
+      safeFree((char*)revocation,sizeof(HttpSessionRevocation));
+    } else{
+      link = &revocation->next;
+    }
+  }
+}
+
+/*
+  Tokens are only renewed while the session is not revoked, so the last one was issued by now and
+  no token of the session outlives now plus the session length.
+ */
+static void revokeSession(HttpServer *server, char *sessionKey, int validitySec){
+  HttpSessionCache *cache = server->sessionCache;
+  uint64 now = getFineGrainedTime();
+  int sessionKeyLength = strlen(sessionKey);
+  HttpSessionRevocation *revocation = (HttpSessionRevocation*)safeMalloc(sizeof(HttpSessionRevocation),"HttpSessionRevocation");
+  memset(revocation,0,sizeof(HttpSessionRevocation));
+  revocation->sessionKey = safeMalloc(sessionKeyLength+1,"HttpSessionRevocation key");
+  memcpy(revocation->sessionKey,sessionKey,sessionKeyLength+1);
+  revocation->sessionKeyLength = sessionKeyLength;
+  revocation->expiresAt = validitySec > 0 ? now + ((uint64)validitySec)*ONE_SECOND : 0;
+
+  sessionCacheLock(cache);
+  pruneSessionRevocations(cache,now);
+  HttpSessionRevocation *existing = (HttpSessionRevocation*)htGet(cache->revocations,sessionKey);
+  if (existing){
+    if (existing->expiresAt != 0 && (revocation->expiresAt == 0 || revocation->expiresAt > existing->expiresAt)){
+      existing->expiresAt = revocation->expiresAt;
+    }
+  } else{
+    htPut(cache->revocations,revocation->sessionKey,revocation);
+    revocation->next = cache->revocationList;
+    cache->revocationList = revocation;
+    revocation = NULL;
+  }
+  sessionCacheUnlock(cache);
+  if (revocation){
+    safeFree(revocation->sessionKey,revocation->sessionKeyLength+1);
+    safeFree((char*)revocation,sizeof(HttpSessionRevocation));
+  }
+}
+
+void httpServerSetSessionCache(HttpServer *server, int maxEntries, int ttlSeconds){
+  HttpServerConfig *config = server->config;
+  config->sessionCacheMaxEntries = maxEntries;
+  config->sessionCacheTTLSeconds = ttlSeconds;
+  HttpSessionCache *cache = server->sessionCache;
+  if (cache == NULL){
+    /* made even when caching is off, it holds the revocations */
+    server->sessionCache = makeHttpSessionCache(maxEntries,ttlSeconds);
+    return;
+  }
+  sessionCacheLock(cache);
+  cache->maxEntries = maxEntries;
+  cache->ttlSeconds = ttlSeconds;
+  trimSessionCache(cache,0);
+  sessionCacheUnlock(cache);
+}
+
+/*
+  Admission control.
+
+  Three checks keep a busy or abusive client from taking the server down with it:
+
+    - a cap on open connections, checked at accept
+    - a token bucket per client IPv4 address, refilled at clientRequestRate and holding up to
+      clientRequestBurst requests.  A request takes a token when it is dispatched; at accept the
+      bucket is only looked at, so a client that is out of tokens is turned away before it costs
+      a heap and a parser
+    - a cap on the requests each service runs at once, checked at dispatch
+
+  Refusals at accept are a canned response written straight to the socket.  Refusals at dispatch
+  are ordinary responses, sent before authentication or the service runs; the request's body has
+  already been read by then, as the parser buffers whole requests.  Buckets hold micro-tokens so
+  that refills are integer arithmetic, and full buckets are dropped by the background sweep since
+  they are no different from a client that has not been seen.
+ */
+
+#define HTTP_TOKEN 1000000LL  /* micro-tokens */
+#define HTTP_CLIENT_BUCKET_SWEEP_MAX 256
+
+typedef struct HttpClientBucket_tag{
+  int64 tokens;         /* micro-tokens */
+  int64 updatedMicros;
+} HttpClientBucket;
+
+typedef struct HttpAdmission_tag{
+#ifndef METTLE
+  Mutex lock;
+#endif
+  LongHashtable *clientBuckets;  /* IPv4 address -> HttpClientBucket */
+  int64 lastSweepMicros;
+} HttpAdmission;
+
+#ifndef METTLE
+#define admissionLock(a) mutexLock((a)->lock)
+#define admissionUnlock(a) mutexUnlock((a)->lock)
+#else
+#define admissionLock(a)
+#define admissionUnlock(a)
+#endif
+
+static void freeClientBucket(void *value){
+  safeFree((char*)value,sizeof(HttpClientBucket));
+}
+
+static HttpAdmission *makeHttpAdmission(){
+  HttpAdmission *admission = (HttpAdmission*)safeMalloc(sizeof(HttpAdmission),"HttpAdmission");
+  memset(admission,0,sizeof(HttpAdmission));
+#ifndef METTLE
+  mutexCreate(admission->lock);
+#endif
+  admission->clientBuckets = lhtCreate(1021,freeClientBucket);
+  return admission;
+}
+
+static int64 clientBucketCapacity(HttpServerConfig *config){
+  int burst = (config->clientRequestBurst > 0) ? config->clientRequestBurst : config->clientRequestRate;
+  return burst * HTTP_TOKEN;
+}
+
+/* caller holds the admission lock */
+static void refillClientBucket(HttpServerConfig *config, HttpClientBucket *bucket, int64 now){
+  int64 elapsed = now - bucket->updatedMicros;
+  if (elapsed > 0){
+    int64 capacity = clientBucketCapacity(config);
+    /* a bucket idle this long is full whatever it held, and the product could overflow */
+    if (elapsed >= capacity){
+      bucket->tokens = capacity;
+    } else{
+      bucket->tokens += elapsed * config->clientRequestRate;
+      if (bucket->tokens > capacity){
+        bucket->tokens = capacity;
+      }
+    }
+    bucket->updatedMicros = now;
+  }
+}
+
+/* The client's address as a bucket key, or -1 when the rate limit is off or the peer is not IPv4 */
+static int64 getClientAddress(HttpServer *server, Socket *socket){
+  SocketAddress address;
+  if (server->config->clientRequestRate <= 0){
+    return -1;
+  }
+  memset(&address,0,sizeof(SocketAddress));
+  if (getSocketName2(socket,&address) != 0 || address.family != AF_INET){
+    return -1;
+  }
+  return (int64)(unsigned int)GET_V4_ADDR_FOR_SOCKET_AS_INT(address);
+}
+
+/*
+  Takes a token from the client's bucket, or only looks when consume is FALSE.  Returns 0 when
+  the client may go ahead, else the seconds until a token will be there, for Retry-After.
+ */
+static int takeClientToken(HttpServer *server, int64 clientAddress, int consume){
+  HttpServerConfig *config = server->config;
+  HttpAdmission *admission = server->admission;
+  int rate = config->clientRequestRate;
+  if (rate <= 0 || clientAddress < 0 || admission == NULL){
+    return 0;
+  }
+  int64 now = getMetricsMicros();
+  int retryAfter = 0;
+  admissionLock(admission);
+  HttpClientBucket *bucket = (HttpClientBucket*)lhtGet(admission->clientBuckets,clientAddress);
+  if (bucket == NULL){
+    if (consume){
+      bucket = (HttpClientBucket*)safeMalloc(sizeof(HttpClientBucket),"HttpClientBucket");
+      bucket->tokens = clientBucketCapacity(config) - HTTP_TOKEN;
+      bucket->updatedMicros = now;
+      lhtPut(admission->clientBuckets,clientAddress,bucket);
+    }
+  } else{
+    refillClientBucket(config,bucket,now);
+    if (bucket->tokens < HTTP_TOKEN){
+      int64 waitMicros = (HTTP_TOKEN - bucket->tokens + rate - 1) / rate;
+      retryAfter = (int)((waitMicros + 999999) / 1000000);
+      if (retryAfter < 1){
+        retryAfter = 1;
+      }
+    } else if (consume){
+      bucket->tokens -= HTTP_TOKEN;
+    }
+  }
+  admissionUnlock(admission);
+  return retryAfter;
+}
+
+typedef struct ClientBucketSweep_tag{
+  HttpServerConfig *config;
+  int64 now;
+  int   count;
+  int64 addresses[HTTP_CLIENT_BUCKET_SWEEP_MAX];
+} ClientBucketSweep;
+
+static void visitClientBucket(void *userData, int64 key, void *value){
+  ClientBucketSweep *sweep = (ClientBucketSweep*)userData;
+  HttpClientBucket *bucket = (HttpClientBucket*)value;
+  if (sweep->count < HTTP_CLIENT_BUCKET_SWEEP_MAX){
+    refillClientBucket(sweep->config,bucket,sweep->now);
+    if (bucket->tokens >= clientBucketCapacity(sweep->config)){
+      sweep->addresses[sweep->count++] = key;
+    }
+  }
+}
+
+/* drops the buckets of clients that have been quiet long enough to be full again */
+static void sweepClientBuckets(HttpServer *server, int64 now){
+  HttpAdmission *admission = server->admission;
+  ClientBucketSweep sweep;
+  sweep.config = server->config;
+  sweep.now = now;
+  sweep.count = 0;
+  admissionLock(admission);
+  lhtMap(admission->clientBuckets,visitClientBucket,&sweep);
+  for (int i = 0; i < sweep.count; i++){
+    lhtRemove(admission->clientBuckets,sweep.addresses[i]);
+  }
+  admissionUnlock(admission);
+}
+
+/*
+  A bodiless response for a connection that is about to be closed, written without a conversation
+  or an HttpResponse.  It is short enough for a blocking socket to take without waiting.
+ */
+static void writeClosingResponse(Socket *socket, int status, char *reason, int retryAfter){
+  char response[256];
+  int len = 0;
+  if (retryAfter > 0){
+    len = snprintf(response,sizeof(response),
+                   "HTTP/1.1 %d %s\r\nRetry-After: %d\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+                   status,reason,retryAfter);
+  } else{
+    len = snprintf(response,sizeof(response),
+                   "HTTP/1.1 %d %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+                   status,reason);
+  }
+  toASCIIUTF8(response,len);
+  writeFully(socket,response,len);
+}
+
+/* turns a connection away before it gets a conversation */
+static void refuseConnection(Socket *socket, int status, char *reason, int retryAfter){
+  int returnCode = 0;
+  int reasonCode = 0;
+  writeClosingResponse(socket,status,reason,retryAfter);
+  socketClose(socket,&returnCode,&reasonCode);
+}
+
+static void respondWithRetryAfter(HttpResponse *response, int status, char *message, int retryAfter){
+  char buffer[256];
+  int len = strlen(message);
+  memcpy(buffer,message,len);
+  toASCIIUTF8(buffer,len);
+  setResponseStatus(response,status,message);
+  setContentType(response,"text/plain");
+  addStringHeader(response,"Server","jdmfws");
+  addIntHeader(response,"Retry-After",retryAfter);
+  addIntHeader(response,"Content-Length",len);
+  writeHeaderAndBody(response,buffer,len);
+  finishResponse(response);
+}
+
+static void countRefusedConnection(HttpServer *server){
+  httpAtomicAdd64(&server->metrics->connectionsRefused,1);
+}
+
+static void countRejectedRequest(HttpServer *server, HttpService *service){
+  httpAtomicAdd64(&server->metrics->requestsRejected,1);
+  if (service && service->metrics){
+    httpAtomicAdd64(&service->metrics->rejected,1);
+  }
+}
+
+/* counts the request in against the service's cap, or returns FALSE when the service is full */
+static int admitServiceRequest(HttpService *service){
+  HttpServiceMetrics *metrics = service->metrics;
+  if (metrics == NULL){
+    return TRUE;
+  }
+  int inFlight = httpAtomicAdd(&metrics->inFlight,1);
+  if (metrics->maxInFlight > 0 && inFlight > metrics->maxInFlight){
+    httpAtomicAdd(&metrics->inFlight,-1);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void releaseServiceRequest(HttpService *service){
+  if (service->metrics){
+    httpAtomicAdd(&service->metrics->inFlight,-1);
+  }
+}
+
+void httpServerSetConnectionLimit(HttpServer *server, int maxConnections){
+  server->config->maxConnections = (maxConnections > 0) ? maxConnections : 0;
+}
+
+void httpServerSetClientRateLimit(HttpServer *server, int requestsPerSecond, int burst){
+  HttpServerConfig *config = server->config;
+  HttpAdmission *admission = server->admission;
+  if (admission){
+    admissionLock(admission);
+  }
+  config->clientRequestRate = (requestsPerSecond > 0) ? requestsPerSecond : 0;
+  config->clientRequestBurst = (burst > 0) ? burst : 0;
+  if (admission){
+    admissionUnlock(admission);
+  }
+}
+
+void httpServerSetTimeouts(HttpServer *server, int idleSeconds, int requestSeconds){
+  if (server->base && server->base->socketSet){
+    setSocketSetIdleTimeLimit(server->base->socketSet,idleSeconds);
+  }
+  server->config->requestTimeoutSeconds = (requestSeconds > 0) ? requestSeconds : 0;
+}
+
+int httpServiceSetMaxInFlight(HttpService *service, int maxInFlight){
+  if (service->metrics == NULL){
+    return -1;
+  }
+  service->metrics->maxInFlight = (maxInFlight > 0) ? maxInFlight : 0;
+  return 0;
+}
+
+/*
+  Static file cache.
+
+  Remembers what was worked out about a file (MIME type, binary-ness) and, for small files sent
+  raw, the bytes themselves.  Nothing is trusted without the stat that every file request already
+  does: an entry is only used while the size, modification and status change times, inode and ccsid
+  still match.  Those times only have a granularity of a second, so content is not kept for a file
+  changed within FILE_CACHE_RACY_SECONDS of being read; a same-size rewrite in that second would
+  otherwise go unnoticed.  Content is kept together with the autocvt setting it was read with.
+  Entries are reference counted so that one can be evicted while another thread is still sending
+  its content.
+ */
+
+#define FILE_CACHE_RACY_SECONDS 2
+
+typedef struct HttpFileCacheEntry_tag{
+  char     *path;
+  int       pathLength;
+  int64     size;
+  time_t    mtime;
+  time_t    ctime;
+  int       inode;
+  int       ccsid;
+  char     *mimeType;
+  int       mimeTypeLength;
+  int       isBinary;
+  char     *content;       /* NULL until a raw send reads the whole file */
+  int       contentAutocvt;
+  int64     sidecarAbsentAt; /* when "<path>.gz" was last found missing or older, 0 if not */
+  int       refCount;      /* the cache holds one while the entry is linked */
+  bool      linked;
+  struct HttpFileCacheEntry_tag *newer;
+  struct HttpFileCacheEntry_tag *older;
+} HttpFileCacheEntry;
+
+typedef struct HttpFileCache_tag{
+#ifndef METTLE
+  Mutex      lock;
+#endif
+  hashtable *entries;      /* path -> HttpFileCacheEntry */
+  HttpFileCacheEntry *newest;
+  HttpFileCacheEntry *oldest;
+  int        count;
+  int64      contentBytes;
+  int        maxEntries;
+  int        maxFileSize;
+  int64      maxBytes;
+} HttpFileCache;
+
+#ifndef METTLE
+#define fileCacheLock(c) mutexLock((c)->lock)
+#define fileCacheUnlock(c) mutexUnlock((c)->lock)
+#else
+#define fileCacheLock(c)
+#define fileCacheUnlock(c)
+#endif
+
+static HttpFileCache *makeHttpFileCache(int maxEntries, int maxFileSize, int64 maxBytes){
+  HttpFileCache *cache = (HttpFileCache*)safeMalloc(sizeof(HttpFileCache),"HttpFileCache");
+  memset(cache,0,sizeof(HttpFileCache));
+#ifndef METTLE
+  mutexCreate(cache->lock);
+#endif
+  cache->entries = htCreate(1021,stringHash,stringCompare,NULL,NULL);
+  cache->maxEntries = maxEntries;
+  cache->maxFileSize = maxFileSize;
+  cache->maxBytes = maxBytes;
+  return cache;
+}
+
+static void freeFileCacheEntry(HttpFileCacheEntry *entry){
+  if (entry->content){
+    safeFree(entry->content,(int)entry->size);
+  }
+  if (entry->mimeType){
+    safeFree(entry->mimeType,entry->mimeTypeLength+1);
+  }
+  if (entry->path){
+    safeFree(entry->path,entry->pathLength+1);
+  }
+  safeFree((char*)entry,sizeof(HttpFileCacheEntry));
+}
+
+/* caller holds the lock */
+static void dropFileCacheReference(HttpFileCacheEntry *entry){
+  if (--entry->refCount == 0){
+    freeFileCacheEntry(entry);
+  }
+}
 
-#elif defined(__ZOWE_OS_WINDOWS)
+/* caller holds the lock */
+static void unlinkFileCacheEntry(HttpFileCache *cache, HttpFileCacheEntry *entry){
+  htRemove(cache->entries,entry->path);
+  if (entry->older){
+    entry->older->newer = entry->newer;
+  } else{
+    cache->oldest = entry->newer;
+  }
+  if (entry->newer){
+    entry->newer->older = entry->older;
+  } else{
+    cache->newest = entry->older;
+  }
+  entry->newer = NULL;
+  entry->older = NULL;
+  entry->linked = false;
+  cache->count--;
+  if (entry->content){
+    cache->contentBytes -= entry->size;
+  }
+  dropFileCacheReference(entry);
+}
 
-  printf("*WARNING* - Trivial Cipher in use\n");
-  trivialEncipher(encodedTokenText,tokenText,tokenTextLength);
-  *result = encodedTokenText;
-  return 0;
-  
-#else
+/* caller holds the lock */
+static void linkFileCacheEntryAsNewest(HttpFileCache *cache, HttpFileCacheEntry *entry){
+  entry->older = cache->newest;
+  entry->newer = NULL;
+  if (cache->newest){
+    cache->newest->newer = entry;
+  } else{
+    cache->oldest = entry;
+  }
+  cache->newest = entry;
+}
 
-#error Session token encoding has been implemented for z/OS only
+/* caller holds the lock */
+static void touchFileCacheEntry(HttpFileCache *cache, HttpFileCacheEntry *entry){
+  if (entry == cache->newest){
+    return;
+  }
+  if (entry->older){
+    entry->older->newer = entry->newer;
+  } else{
+    cache->oldest = entry->newer;
+  }
+  entry->newer->older = entry->older;
+  linkFileCacheEntryAsNewest(cache,entry);
+}
 
-#endif /* __ZOWE_OS_ZOS */
+/* caller holds the lock, evicts the oldest entries until the additions fit */
+static void trimFileCache(HttpFileCache *cache, int extraEntries, int64 extraBytes){
+  while (cache->oldest &&
+         (cache->count + extraEntries > cache->maxEntries ||
+          cache->contentBytes + extraBytes > cache->maxBytes)){
+    unlinkFileCacheEntry(cache,cache->oldest);
+  }
+}
 
+/* caller holds the lock, returns a valid entry or NULL after dropping a stale one */
+static HttpFileCacheEntry *findFileCacheEntry(HttpFileCache *cache, char *path, const FileInfo *info){
+  HttpFileCacheEntry *entry = (HttpFileCacheEntry*)htGet(cache->entries,path);
+  if (entry == NULL){
+    return NULL;
+  }
+  if (entry->size != fileInfoSize(info) ||
+      entry->mtime != fileInfoUnixModificationTime(info) ||
+      entry->ctime != fileInfoUnixStatusChangeTime(info) ||
+      entry->inode != fileGetINode(info) ||
+      entry->ccsid != fileInfoCCSID(info)){
+    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG2, "File cache entry for %s is stale\n", path);
+    unlinkFileCacheEntry(cache,entry);
+    return NULL;
+  }
+  touchFileCacheEntry(cache,entry);
+  return entry;
 }
 
-static int decodeSessionToken(ShortLivedHeap *slh,
-                              const HttpServerConfig *config,
-                              const char *encodedTokenText,
-                              unsigned int encodedTokenTextLength,
-                              char **result) {
-  unsigned int tokenTextLength = encodedTokenTextLength;
-  unsigned int paddingLength = 4;
-  char *tokenText = SLHAlloc(slh, tokenTextLength+paddingLength);
-  if (tokenText == NULL) {
-    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG,
-    		    "Error: decoded session token buffer not allocated "
-            "(size=%u, SLH=%p)\n", encodedTokenTextLength, slh);
-    return -1;
+/* fills in the MIME type (copied into the response heap) and binary flag if the file is known */
+static bool fileCacheGetInfo(HttpFileCache *cache, HttpResponse *response, char *path,
+                             const FileInfo *info, char **mimeType, int *isBinary){
+  if (cache == NULL){
+    return false;
   }
+  bool found = false;
+  fileCacheLock(cache);
+  HttpFileCacheEntry *entry = findFileCacheEntry(cache,path,info);
+  if (entry){
+    *mimeType = SLHAlloc(response->slh,entry->mimeTypeLength+1);
+    memcpy(*mimeType,entry->mimeType,entry->mimeTypeLength+1);
+    *isBinary = entry->isBinary;
+    found = true;
+  }
+  fileCacheUnlock(cache);
+  return found;
+}
 
-#ifdef __ZOWE_OS_ZOS
+static void fileCachePutInfo(HttpFileCache *cache, char *path, const FileInfo *info,
+                             char *mimeType, int isBinary){
+  if (cache == NULL || cache->maxEntries <= 0){
+    return;
+  }
+  int pathLength = strlen(path);
+  int mimeTypeLength = strlen(mimeType);
+  HttpFileCacheEntry *entry = (HttpFileCacheEntry*)safeMalloc(sizeof(HttpFileCacheEntry),"HttpFileCacheEntry");
+  memset(entry,0,sizeof(HttpFileCacheEntry));
+  entry->path = safeMalloc(pathLength+1,"HttpFileCacheEntry path");
+  memcpy(entry->path,path,pathLength+1);
+  entry->pathLength = pathLength;
+  entry->mimeType = safeMalloc(mimeTypeLength+1,"HttpFileCacheEntry mimeType");
+  memcpy(entry->mimeType,mimeType,mimeTypeLength+1);
+  entry->mimeTypeLength = mimeTypeLength;
+  entry->size = fileInfoSize(info);
+  entry->mtime = fileInfoUnixModificationTime(info);
+  entry->ctime = fileInfoUnixStatusChangeTime(info);
+  entry->inode = fileGetINode(info);
+  entry->ccsid = fileInfoCCSID(info);
+  entry->isBinary = isBinary;
+  entry->refCount = 1;
+  entry->linked = true;
+
+  fileCacheLock(cache);
+  HttpFileCacheEntry *existing = (HttpFileCacheEntry*)htGet(cache->entries,path);
+  if (existing){
+    unlinkFileCacheEntry(cache,existing);
+  }
+  trimFileCache(cache,1,0);
+  htPut(cache->entries,entry->path,entry);
+  linkFileCacheEntryAsNewest(cache,entry);
+  cache->count++;
+  fileCacheUnlock(cache);
+}
+
+/* returns a referenced entry whose content is loaded, or NULL; release with fileCacheRelease */
+static HttpFileCacheEntry *fileCacheGetContent(HttpFileCache *cache, char *path, const FileInfo *info,
+                                               int autocvt){
+  if (cache == NULL){
+    return NULL;
+  }
+  fileCacheLock(cache);
+  HttpFileCacheEntry *entry = findFileCacheEntry(cache,path,info);
+  if (entry && entry->content && entry->contentAutocvt == autocvt){
+    entry->refCount++;
+  } else{
+    entry = NULL;
+  }
+  fileCacheUnlock(cache);
+  return entry;
+}
 
-  int icsfRSN = 0;
-  int icsfRC = icsfDecipher(config->sessionTokenKey,
-                            config->sessionTokenKeySize,
-                            encodedTokenText,
-                            encodedTokenTextLength,
-                            tokenText,
-                            tokenTextLength,
-                            &icsfRSN);
-  if (icsfRC != 0) {
-    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG,
-    		    "Error: session token decoding failed, RC = %d, RSN = %d\n",
-            icsfRC, icsfRSN);
-    return FALSE;
+/* 
+   Whether the gzip sidecar of a file was found unusable recently enough to skip the stat of it.
+   A sidecar that appears later is noticed within FILE_CACHE_SIDECAR_RECHECK_SECONDS.
+ */
+#define FILE_CACHE_SIDECAR_RECHECK_SECONDS 10
+
+static bool fileCacheIsSidecarAbsent(HttpFileCache *cache, char *path, const FileInfo *info){
+  if (cache == NULL){
+    return false;
+  }
+  bool absent = false;
+  fileCacheLock(cache);
+  HttpFileCacheEntry *entry = findFileCacheEntry(cache,path,info);
+  if (entry && entry->sidecarAbsentAt != 0 &&
+      getMetricsMicros() - entry->sidecarAbsentAt < FILE_CACHE_SIDECAR_RECHECK_SECONDS * 1000000LL){
+    absent = true;
   }
+  fileCacheUnlock(cache);
+  return absent;
+}
 
-  // always null terminate because consumer might be expecting null terminate on other side
-  tokenText[tokenTextLength]=0;
-  *result = tokenText;
-  return 0;
+static void fileCacheSetSidecarAbsent(HttpFileCache *cache, char *path, const FileInfo *info, bool absent){
+  if (cache == NULL){
+    return;
+  }
+  fileCacheLock(cache);
+  HttpFileCacheEntry *entry = findFileCacheEntry(cache,path,info);
+  if (entry){
+    entry->sidecarAbsentAt = absent ? getMetricsMicros() : 0;
+  }
+  fileCacheUnlock(cache);
+}
 
-#elif defined(__ZOWE_OS_WINDOWS)
+static void fileCacheRelease(HttpFileCache *cache, HttpFileCacheEntry *entry){
+  fileCacheLock(cache);
+  dropFileCacheReference(entry);
+  fileCacheUnlock(cache);
+}
 
-  printf("*WARNING* - Trivial Cipher in use\n");
-  trivialDecipher(tokenText,encodedTokenText,tokenTextLength);
-  *result = tokenText;
-  return 0;
+/* drops every entry, e.g. when the MIME types they were worked out with change */
+static void fileCacheClear(HttpFileCache *cache){
+  if (cache == NULL){
+    return;
+  }
+  fileCacheLock(cache);
+  while (cache->oldest){
+    unlinkFileCacheEntry(cache,cache->oldest);
+  }
+  fileCacheUnlock(cache);
+}
 
+/* a file changed this recently may change again within the same second of its times */
+static bool isFileRacilyClean(const FileInfo *info){
+  int64 stck = 0;
+  getSTCK(&stck);
+  int64 now = stckToUnix(stck);
+  return (fileInfoUnixModificationTime(info) > now - FILE_CACHE_RACY_SECONDS ||
+          fileInfoUnixStatusChangeTime(info) > now - FILE_CACHE_RACY_SECONDS);
+}
 
-#else
+/*
+  Reads the whole of a small open file and attaches it to the path's entry.  If the cache has no
+  room for it, or the entry went away meanwhile, the returned entry is a private one that is freed
+  on release, as is the content of a file that changed too recently to be trusted later.
+  Returns NULL, with the file rewound, if the file could not be read as stat'ed.
+ */
+static HttpFileCacheEntry *fileCacheLoadContent(HttpFileCache *cache, char *path, const FileInfo *info,
+                                                int autocvt, UnixFile *in){
+  int returnCode = 0;
+  int reasonCode = 0;
+  int size = (int)fileInfoSize(info);
+  char *content = safeMalloc(size,"HttpFileCacheEntry content");
+  int total = 0;
+  while (total < size){
+    int bytesRead = fileRead(in,content+total,size-total,&returnCode,&reasonCode);
+    if (bytesRead <= 0){
+      break;
+    }
+    total += bytesRead;
+  }
+  if (total != size){
+    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG2, "File cache read %d of %d bytes of %s\n",
+            total, size, path);
+    safeFree(content,size);
+    fileSeek(in,0,FILE_SEEK_SET,&returnCode,&reasonCode);
+    return NULL;
+  }
 
-#error Session token decoding has been implemented for z/OS only
+  bool racy = isFileRacilyClean(info);
+  fileCacheLock(cache);
+  HttpFileCacheEntry *entry = racy ? NULL : findFileCacheEntry(cache,path,info);
+  if (entry && entry->content == NULL && size <= cache->maxBytes){
+    /* the entry itself is protected from the trim by this reference */
+    entry->refCount++;
+    trimFileCache(cache,0,size);
+    entry->content = content;
+    entry->contentAutocvt = autocvt;
+    content = NULL;
+    if (entry->linked){
+      cache->contentBytes += size;
+    }
+  } else if (entry && entry->content && entry->contentAutocvt == autocvt){
+    /* another request got there first, ours is identical */
+    entry->refCount++;
+  } else{
+    entry = NULL;
+  }
+  fileCacheUnlock(cache);
 
-#endif /* __ZOWE_OS_ZOS */
+  if (entry){
+    if (content){
+      safeFree(content,size);
+    }
+    return entry;
+  }
+  HttpFileCacheEntry *privateEntry = (HttpFileCacheEntry*)safeMalloc(sizeof(HttpFileCacheEntry),"HttpFileCacheEntry");
+  memset(privateEntry,0,sizeof(HttpFileCacheEntry));
+  privateEntry->size = size;
+  privateEntry->content = content;
+  privateEntry->refCount = 1;
+  return privateEntry;
+}
 
+void httpServerSetFileCache(HttpServer *server, int maxEntries, int maxFileSize, int64 maxBytes){
+  HttpServerConfig *config = server->config;
+  config->fileCacheMaxEntries = maxEntries;
+  config->fileCacheMaxFileSize = maxFileSize;
+  config->fileCacheMaxBytes = maxBytes;
+  HttpFileCache *cache = server->fileCache;
+  if (cache == NULL){
+    if (maxEntries > 0){
+      server->fileCache = makeHttpFileCache(maxEntries,maxFileSize,maxBytes);
+    }
+    return;
+  }
+  fileCacheLock(cache);
+  cache->maxEntries = maxEntries;
+  cache->maxFileSize = maxFileSize;
+  cache->maxBytes = maxBytes;
+  trimFileCache(cache,0,0);
+  fileCacheUnlock(cache);
 }
 
+static hashtable *makeMimeTypeTable(void);
+
 static
 HttpServer *makeHttpServerInner(STCBase *base,
                                 InetAddr *addr,
@@ -1565,6 +4035,17 @@ HttpServer *makeHttpServerInner(STCBase *base,
          sizeof (sessionTokenKey));
   server->config->authTokenType = SERVICE_AUTH_TOKEN_TYPE_LEGACY;
   server->config->httpRequestHeapMaxBlocks = HTTP_REQUEST_HEAP_DEFAULT_BLOCKS;
+  server->config->compressionLevel = HTTP_COMPRESSION_DEFAULT_LEVEL;
+  server->config->compressionMinSize = HTTP_COMPRESSION_DEFAULT_MIN_SIZE;
+  httpServerSetFileCache(server, HTTP_FILE_CACHE_DEFAULT_MAX_ENTRIES,
+                         HTTP_FILE_CACHE_DEFAULT_MAX_FILE_SIZE, HTTP_FILE_CACHE_DEFAULT_MAX_BYTES);
+  httpServerSetSessionCache(server, HTTP_SESSION_CACHE_DEFAULT_MAX_ENTRIES,
+                            HTTP_SESSION_CACHE_DEFAULT_TTL_SECONDS);
+  server->mimeTypes = makeMimeTypeTable();
+  server->wsGroups = makeWSGroupRegistry();
+  server->metrics = makeHttpServerMetrics();
+  server->admission = makeHttpAdmission();
+  httpServerSetTimeouts(server, HTTP_DEFAULT_IDLE_TIMEOUT_SECONDS, HTTP_DEFAULT_REQUEST_TIMEOUT_SECONDS);
 
   return server;
 }
@@ -1658,6 +4139,17 @@ static HttpServer *makeSecureHttpServerInner(STCBase *base, int port,
   server->config->sessionTokenKeySize = sizeof (now);
   memcpy(&server->config->sessionTokenKey[0], &now, sizeof (now));
   server->config->httpRequestHeapMaxBlocks = HTTP_REQUEST_HEAP_DEFAULT_BLOCKS;
+  server->config->compressionLevel = HTTP_COMPRESSION_DEFAULT_LEVEL;
+  server->config->compressionMinSize = HTTP_COMPRESSION_DEFAULT_MIN_SIZE;
+  httpServerSetFileCache(server, HTTP_FILE_CACHE_DEFAULT_MAX_ENTRIES,
+                         HTTP_FILE_CACHE_DEFAULT_MAX_FILE_SIZE, HTTP_FILE_CACHE_DEFAULT_MAX_BYTES);
+  httpServerSetSessionCache(server, HTTP_SESSION_CACHE_DEFAULT_MAX_ENTRIES,
+                            HTTP_SESSION_CACHE_DEFAULT_TTL_SECONDS);
+  server->mimeTypes = makeMimeTypeTable();
+  server->wsGroups = makeWSGroupRegistry();
+  server->metrics = makeHttpServerMetrics();
+  server->admission = makeHttpAdmission();
+  httpServerSetTimeouts(server, HTTP_DEFAULT_IDLE_TIMEOUT_SECONDS, HTTP_DEFAULT_REQUEST_TIMEOUT_SECONDS);
 
   return server;
 }
@@ -1706,6 +4198,11 @@ int httpServerSetSessionTokenKey(HttpServer *server, unsigned int size,
   return 0;
 }
 
+void httpServerSetCompression(HttpServer *server, int level, int minSize){
+  server->config->compressionLevel = level;
+  server->config->compressionMinSize = minSize;
+}
+
 HttpServer *makeHttpServer(STCBase *base, int port, int *returnCode, int *reasonCode){
   return makeHttpServer2(base, NULL, port, 0, returnCode, reasonCode);
 }
@@ -1729,11 +4226,14 @@ int registerHttpService(HttpServer *server, HttpService *service){
 
   service->serverInstanceUID = server->serverInstanceUID;
   service->productURLPrefix = server->defaultProductURLPrefix;
+  /* services come from several constructors that do not all clear the struct */
+  service->metrics = makeHttpServiceMetrics();
   return 0;
 }
 
 int registerHttpServiceOfLastResort(HttpServer *server, HttpService *service){
   server->config->serviceOfLastResort = service;
+  service->metrics = makeHttpServiceMetrics();
   return 0;
 }
 
@@ -1778,6 +4278,7 @@ static ChunkedOutputStream *makeChunkedOutputStreamInternal(HttpResponse *respon
   char *translateBuffer = responseAlloc(response,1024);
   
   initChunkedOutput(out,response,buffer,translateBuffer,1024);
+  offerStreamCompression(out);
   return out;
 }
 
@@ -2056,6 +4557,8 @@ HttpRequest *dequeueHttpRequest(HttpRequestParser *parser){
 }
 
 static int resetParserAndEnqueue(HttpRequestParser *parser){
+  BINARY_TRACE(&traceRequestParsed, parser, parser->methodNameLength, parser->uriLength,
+               parser->specifiedContentLength);
   enqueueLastRequest(parser);
   parser->methodNameLength = 0;
   parser->uriLength = 0;
@@ -2136,6 +4639,7 @@ int shouldContinueGivenAllowedMethods(HttpResponse *response,
 }
 
 int processHttpFragment(HttpRequestParser *parser, char *data, int len){
+  BINARY_TRACE(&traceParseFragment, parser, len, parser->state);
   for (int i=0; i<len; i++){
     char c = data[i];
     int isWhitespace = FALSE;
@@ -2452,19 +4956,241 @@ int processHttpFragment(HttpRequestParser *parser, char *data, int len){
 }
 
 
+/*
+  Reverse proxy.
+
+  Requests go to the upstream over connections from a small per-service pool of keep-alive
+  sockets, so a busy upstream is not paying a connect per request.  The request body goes out
+  straight from the parser's buffer, because the server reads whole requests before dispatching
+  them.  The response body is streamed to the client as it arrives.  It keeps its Content-Length
+  when the upstream gave one and is re-chunked otherwise.
+ */
+
+typedef struct HttpProxyUpstream_tag{
+  char              *hostHeader;  /* host:port, native */
+  HttpClientContext *clientContext; /* also pools the idle upstream connections */
+#ifndef METTLE
+  Mutex              lock;
+#endif
+  int                active;      /* requests being forwarded right now */
+  int                maxActive;
+} HttpProxyUpstream;
+
+#ifndef METTLE
+#define proxyLock(u) mutexLock((u)->lock)
+#define proxyUnlock(u) mutexUnlock((u)->lock)
+#else
+#define proxyLock(u)
+#define proxyUnlock(u)
+#endif
+
+typedef struct ProxyExchange_tag{
+  HttpResponse        *response;
+  bool                 isHead;
+  bool                 headersSent;
+  ChunkedOutputStream *stream;    /* only when re-chunking */
+} ProxyExchange;
+
+/* framing and connection management are the proxy's own business on each side */
+static char *PROXY_MANAGED_HEADERS[] = {
+  "Connection", "Keep-Alive", "Proxy-Connection", "Proxy-Authenticate", "Proxy-Authorization",
+  "TE", "Trailer", "Transfer-Encoding", "Upgrade", "Content-Length", "Host", NULL
+};
+
+static bool isProxyManagedHeader(char *nativeName){
+  int nameLength = strlen(nativeName);
+  for (int i = 0; PROXY_MANAGED_HEADERS[i] != NULL; i++){
+    if (strlen(PROXY_MANAGED_HEADERS[i]) == nameLength &&
+        !compareIgnoringCase(nativeName, PROXY_MANAGED_HEADERS[i], nameLength)){
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool acquireUpstreamSlot(HttpProxyUpstream *upstream){
+  bool acquired = false;
+  proxyLock(upstream);
+  if (upstream->active < upstream->maxActive){
+    upstream->active++;
+    acquired = true;
+  }
+  proxyUnlock(upstream);
+  return acquired;
+}
+
+static void releaseUpstreamSlot(HttpProxyUpstream *upstream){
+  proxyLock(upstream);
+  upstream->active--;
+  proxyUnlock(upstream);
+}
+
+static int proxyResponseHeaders(HttpClientResponse *upstreamResponse, void *userData){
+  ProxyExchange *exchange = (ProxyExchange*)userData;
+  HttpResponse *response = exchange->response;
+  char *headContentLength = NULL;
+
+  setResponseStatus(response, upstreamResponse->statusCode, upstreamResponse->statusReason);
+  HttpHeader *header = upstreamResponse->headers;
+  while (header){
+    if (!isProxyManagedHeader(header->nativeName)){
+      addStringHeader(response, header->nativeName, header->nativeValue);
+    } else if (exchange->isHead && !compareIgnoringCase(header->nativeName, "Content-Length", 14)){
+      headContentLength = header->nativeValue;
+    }
+    header = header->next;
+  }
+  if (exchange->isHead){
+    if (headContentLength != NULL){
+      addStringHeader(response, "Content-Length", headContentLength);
+    }
+  } else if (upstreamResponse->contentLength >= 0){
+    addIntHeader(response, "Content-Length", upstreamResponse->contentLength);
+  } else{
+    addStringHeader(response, "Transfer-Encoding", "chunked");
+    exchange->stream = makeChunkedOutputStreamInternal(response);
+    /* whatever coding the upstream chose goes through untouched */
+    exchange->stream->offeredCoding = HTTP_CONTENT_CODING_IDENTITY;
+    exchange->stream->codingDecided = true;
+  }
+  writeHeader(response);
+  exchange->headersSent = true;
+  return 0;
+}
+
+static int proxyResponseBody(char *data, int length, void *userData){
+  ProxyExchange *exchange = (ProxyExchange*)userData;
+  if (exchange->stream){
+    writeBytes(exchange->stream, data, length, NO_TRANSLATE);
+    return exchange->stream->isErrorState ? 1 : 0;
+  }
+  return (writeResponseBytes(exchange->response, data, length) == 0) ? 1 : 0;
+}
+
+static bool isIdempotentMethod(char *method){
+  return (!strcmp(method, "GET") || !strcmp(method, "HEAD") ||
+          !strcmp(method, "PUT") || !strcmp(method, "DELETE") ||
+          !strcmp(method, "OPTIONS"));
+}
+
+/*
+  Sends the request and streams back the response.  A pooled connection may have been closed by
+  the upstream just as it was handed out, so if it fails before any of the response arrived an
+  idempotent request is tried once more on a fresh connection.
+ */
+static int forwardToUpstream(HttpProxyUpstream *upstream, HttpRequest *innerRequest, ProxyExchange *exchange){
+  HttpClientContext *clientContext = upstream->clientContext;
+  int status = HTTP_CLIENT_CONNECT_FAILED;
+  for (int attempt = 0; attempt < 2; attempt++){
+    HttpClientSession *session = NULL;
+    status = httpClientSessionInit(clientContext, &session);
+    if (status != 0){
+      zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_WARNING, "Could not connect to upstream %s, status=%d\n",
+              upstream->hostHeader, status);
+      return status;
+    }
+    bool reused = session->reusedConnection;
+    session->request = innerRequest;
+    status = httpClientSessionSend(clientContext, session);
+    if (status == 0){
+      status = httpClientSessionReceiveStream(clientContext, session,
+                                              proxyResponseHeaders, proxyResponseBody, exchange);
+    }
+    /* goes back to the pool only if the response was read to its end */
+    httpClientSessionDestroy(session);
+    if (status != 0 && reused && !exchange->headersSent && isIdempotentMethod(innerRequest->method)){
+      zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "Retrying on a new connection to %s after status %d\n",
+              upstream->hostHeader, status);
+      continue;
+    }
+    break;
+  }
+  return status;
+}
+
+/* fills in whatever the transformer left alone from the client's request */
+static void completeProxyRequest(HttpProxyUpstream *upstream, HttpRequest *request, HttpRequest *innerRequest){
+  if (innerRequest->method == NULL){
+    innerRequest->method = request->method;
+  }
+  if (innerRequest->uri == NULL){
+    innerRequest->uri = request->uri;
+  }
+  if (innerRequest->headerChain == NULL){
+    HttpHeader *header = request->headerChain;
+    while (header){
+      if (!isProxyManagedHeader(header->nativeName)){
+        requestStringHeader(innerRequest, TRUE, header->nativeName, header->nativeValue);
+      }
+      header = header->next;
+    }
+    HttpHeader *hostHeader = getHeader(request, "Host");
+    if (hostHeader != NULL){
+      requestStringHeader(innerRequest, TRUE, "X-Forwarded-Host", hostHeader->nativeValue);
+    }
+  }
+  requestStringHeader(innerRequest, TRUE, "Host", upstream->hostHeader);
+  if (innerRequest->contentBody == NULL && request->contentLength > 0){
+    innerRequest->contentBody = request->contentBody;
+    innerRequest->contentLength = request->contentLength;
+  }
+}
+
 static int proxyServe(HttpService *service,
                       HttpRequest *request,
                       HttpResponse *response){
   HttpConversation *conversation = response->conversation;
+  HttpProxyUpstream *upstream = service->proxyUpstream;
   conversation->conversationType = CONVERSATION_HTTP_PROXY;
-  printf("proxyServe started, conversation=0x%p\n",conversation);
+  zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG2, "proxyServe started, conversation=0x%p\n", conversation);
+  if (upstream == NULL){
+    respondWithError(response, HTTP_STATUS_BAD_GATEWAY, "No upstream configured");
+    return 1;
+  }
   HttpRequest *innerRequest = (HttpRequest*)SLHAlloc(response->slh,sizeof(HttpRequest));
   memset(innerRequest,0,sizeof(HttpRequest));
-  int transformationStatus = service->requestTransformer(conversation,request,innerRequest);
-  if (transformationStatus == HTTP_PROXY_OK){
-    Socket *innerSocket = NULL;
-    writeRequest(innerRequest,innerSocket);
+  innerRequest->slh = response->slh;
+  if (service->requestTransformer != NULL){
+    int transformationStatus = service->requestTransformer(conversation,request,innerRequest);
+    if (transformationStatus != HTTP_PROXY_OK){
+      respondWithError(response, HTTP_STATUS_FORBIDDEN, "Forbidden");
+      return 1;
+    }
+  }
+  completeProxyRequest(upstream, request, innerRequest);
+
+  if (!acquireUpstreamSlot(upstream)){
+    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "Upstream %s has %d requests in flight, refusing\n",
+            upstream->hostHeader, upstream->maxActive);
+    respondWithError(response, HTTP_STATUS_SERVICE_UNAVAILABLE, "Upstream busy");
+    return 1;
+  }
+  ProxyExchange exchange;
+  memset(&exchange, 0, sizeof(ProxyExchange));
+  exchange.response = response;
+  exchange.isHead = !strcmp(innerRequest->method, "HEAD");
+  int status = forwardToUpstream(upstream, innerRequest, &exchange);
+  releaseUpstreamSlot(upstream);
+
+  if (!exchange.headersSent){
+    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "Upstream %s failed with status %d\n",
+            upstream->hostHeader, status);
+    if (status == HTTP_CLIENT_TIMEOUT){
+      respondWithError(response, HTTP_STATUS_GATEWAY_TIMEOUT, "Upstream timed out");
+    } else{
+      respondWithError(response, HTTP_STATUS_BAD_GATEWAY, "Upstream failed");
+    }
+    return 1;
+  }
+  if (status == 0 && exchange.stream != NULL){
+    finishChunkedOutput(exchange.stream, NO_TRANSLATE);
+  } else if (status != 0){
+    /* the client has a partial body, only closing the connection can tell it so */
+    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "Upstream %s response cut short, status %d\n",
+            upstream->hostHeader, status);
+    conversation->shouldClose = TRUE;
   }
+  finishResponse(response);
   return 1;
 }
 
@@ -2934,40 +5660,6 @@ int extractBearerToken(HttpRequest *request, HttpHeader *authHeader) {
   return TRUE;
 }
 
-#ifdef __ZOWE_OS_ZOS
-
-#define ONE_SECOND (4096*1000000)    /* one second in STCK */
-
-static int64 getFineGrainedTime(){
-  int64 stck = 0;
-  unsigned long long outSeconds = 0;
-  __asm(ASM_PREFIX
-        " STCK %0 "
-        :
-        "=m"(stck)
-        :
-        : "r15");
-
-  return stck;
-}
-#else
-
-#define ONE_SECOND 1     /* unix 32 bit time is usually in integral seconds */
-
-static int64 getFineGrainedTime(){
-  time_t rawtime;
-
-  time ( &rawtime );
-  if (sizeof(time_t) == 4){
-    return ((int64)rawtime)<<32;
-  } else{
-    return (int64)rawtime;
-  }
-}
-#endif
-
-#define SESSION_VALIDITY_IN_SECONDS 3600
-
 //validitySec 0=not found, -1=no expiration, positive int=session in seconds
 static int getGroupSessionValidity(int groupId, const HttpServerConfig *config,
                                   int *validitySec, int *returnCode, int *reasonCode) {
@@ -3028,9 +5720,13 @@ static int getUserSessionValidity(char *username, const HttpServerConfig *config
   }
 }
 
-static int sessionTokenStillValid(HttpService *service, HttpRequest *request, char *sessionTokenText, int *sessionValiditySec, uint64 *sessionTimeRemaining){
-  HttpServer *server = service->server;
-  ShortLivedHeap *slh = request->slh;
+/*
+  Deciphers the token, FALSE if it is malformed.  The plaintext is user:issuedAt:serverInstanceUID,
+  followed by :sessionStart in tokens that renew an earlier one.
+ */
+static int decodeSessionTokenFields(HttpServer *server, ShortLivedHeap *slh, char *sessionTokenText,
+                                    char **outUsername, uint64 *outTimestamp,
+                                    uint64 *outServerInstanceUID, uint64 *outSessionStart){
   char *decodedData = SLHAlloc(slh,strlen(sessionTokenText));
   int decodedDataLength = decodeBase64(sessionTokenText,decodedData);
 
@@ -3068,19 +5764,59 @@ static int sessionTokenStillValid(HttpService *service, HttpRequest *request, ch
   username[colonPos]=0;
   strupcase(username);
 
-  uint64 decodedTimestamp= strtoull(plaintextSessionToken+colonPos+1, NULL, 16);
-  uint64 serverInstanceUID = strtoull(plaintextSessionToken+colonPos2+1, NULL, 16);
-  uint64 now = getFineGrainedTime();
+  *outUsername = username;
+  *outTimestamp = strtoull(plaintextSessionToken+colonPos+1, NULL, 16);
+  *outServerInstanceUID = strtoull(plaintextSessionToken+colonPos2+1, NULL, 16);
+  int colonPos3 = indexOf(plaintextSessionToken, decodedDataLength, ':', colonPos2+1);
+  *outSessionStart = (colonPos3 == -1) ? *outTimestamp : strtoull(plaintextSessionToken+colonPos3+1, NULL, 16);
+  return TRUE;
+}
+
+/* deciphers the token and looks up the user's session length, FALSE if the token is malformed */
+static int readSessionToken(HttpService *service, HttpRequest *request, char *sessionTokenText,
+                            char **outUsername, uint64 *outTimestamp, uint64 *outServerInstanceUID,
+                            uint64 *outSessionStart, int *sessionValiditySec, bool *validityKnown){
+  if (!decodeSessionTokenFields(service->server, request->slh, sessionTokenText, outUsername,
+                                outTimestamp, outServerInstanceUID, outSessionStart)){
+    return FALSE;
+  }
+  char *username = *outUsername;
   //determined by lookup or default
   int reasonCode = 0;
   int returnCode = 0;
 
-  int retVal = getUserSessionValidity(username, server->config, sessionValiditySec, &returnCode, &reasonCode);
+  int retVal = getUserSessionValidity(username, service->server->config, sessionValiditySec, &returnCode, &reasonCode);
   AUTH_TRACE("got secs=%d for user=%s, retv=%d, rc=%d, rsn=%d\n",*sessionValiditySec,username,retVal, returnCode, reasonCode);
   if (retVal) {
     zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_WARNING, "Error when getting session duration for user '%s'. rc=%d, rsn=%d\n",
             username, returnCode, reasonCode);
   }
+  *validityKnown = (retVal == 0);
+  return TRUE;
+}
+
+/* validityCheckedAt is when the session length was looked up, 0 if the look-up failed */
+static int sessionTokenStillValid(HttpService *service, HttpRequest *request, char *sessionTokenText,
+                                  int *sessionValiditySec, uint64 *sessionTimeRemaining,
+                                  uint64 *sessionStart, uint64 *validityCheckedAt){
+  HttpServer *server = service->server;
+  char *username = NULL;
+  uint64 decodedTimestamp = 0;
+  uint64 serverInstanceUID = 0;
+  bool validityKnown = false;
+
+  bool cached = sessionCacheGet(server, sessionTokenText, request->slh, &username, &decodedTimestamp,
+                                sessionStart, &serverInstanceUID, sessionValiditySec, validityCheckedAt);
+  if (cached){
+    AUTH_TRACE("session token for user=%s found in cache\n",username);
+  } else if (!readSessionToken(service, request, sessionTokenText, &username, &decodedTimestamp,
+                               &serverInstanceUID, sessionStart, sessionValiditySec, &validityKnown)){
+    return FALSE;
+  } else{
+    *validityCheckedAt = validityKnown ? getFineGrainedTime() : 0;
+  }
+
+  uint64 now = getFineGrainedTime();
   AUTH_TRACE("session validity sec = %d\n",*sessionValiditySec);
   uint64 interval = ((uint64)(*sessionValiditySec))*ONE_SECOND;
 
@@ -3102,6 +5838,15 @@ static int sessionTokenStillValid(HttpService *service, HttpRequest *request, ch
     }
   }
 
+  if (isSessionRevoked(server, makeSessionKey(request->slh, username, *sessionStart, serverInstanceUID))){
+    AUTH_TRACE("session was logged out, returning FALSE\n");
+    return FALSE;
+  }
+
+  if (!cached){
+    sessionCachePut(server, sessionTokenText, username, decodedTimestamp, *sessionStart,
+                    serverInstanceUID, *sessionValiditySec, *validityCheckedAt);
+  }
   request->username = username;
 
   AUTH_TRACE("returning TRUE\n");
@@ -3112,12 +5857,23 @@ static char *getSessionTokenCookieName(HttpService *service) {
   return service->server->cookieName;
 }
 
-static char *generateSessionTokenKeyValue(HttpService *service, HttpRequest *request, char *username){
+/*
+  validitySec is the user's session length and checkedAt when it was looked up, the new token is
+  cached unless either is 0 (unknown).  sessionStart is 0 for a new session and otherwise carried
+  over from the token being renewed.
+ */
+static char *generateSessionTokenKeyValue(HttpService *service, HttpRequest *request, char *username,
+                                          int validitySec, uint64 sessionStart, uint64 checkedAt){
   HttpServer *server = service->server;
   ShortLivedHeap *slh = request->slh;
-  char *tokenPlaintextBuffer = SLHAlloc(slh,528); /* started at 512, and I added a STCK. May be overkill, but I felt the number needed an explanation */
+  char *tokenPlaintextBuffer = SLHAlloc(slh,548); /* started at 512, and I added a STCK. May be overkill, but I felt the number needed an explanation. Then the session start. */
   /* NOTE: could add randomness in addition to getFineGrainedTime() */
-  int tokenPlaintextLength = sprintf(tokenPlaintextBuffer,"%s:%llx:%llx",username,getFineGrainedTime(),service->serverInstanceUID);
+  uint64 issuedAt = getFineGrainedTime();
+  if (sessionStart == 0){
+    sessionStart = issuedAt;
+  }
+  int tokenPlaintextLength = sprintf(tokenPlaintextBuffer,"%s:%llx:%llx:%llx",username,issuedAt,
+                                     service->serverInstanceUID,sessionStart);
 
   char *tokenCiphertext = NULL;
   int encodeRC = encodeSessionToken(slh, server->config,
@@ -3130,6 +5886,9 @@ static char *generateSessionTokenKeyValue(HttpService *service, HttpRequest *req
 
   int encodedLength = 0;
   char *base64Output = encodeBase64(slh,tokenCiphertext,tokenPlaintextLength,&encodedLength,TRUE);
+  /* the browser sends this one back next, often on several requests at once */
+  sessionCachePut(server,base64Output,username,issuedAt,sessionStart,service->serverInstanceUID,
+                  validitySec,checkedAt);
 
   char *cookieName = getSessionTokenCookieName(service);
 
@@ -3145,6 +5904,47 @@ static char *generateSessionTokenKeyValue(HttpService *service, HttpRequest *req
   return keyValueBuffer;
 }
 
+void httpServerInvalidateSessionToken(HttpServer *server, char *tokenText){
+  if (server->sessionCache == NULL || tokenText == NULL){
+    return;
+  }
+  ShortLivedHeap *slh = makeShortLivedHeap(4096,10);
+  char *username = NULL;
+  uint64 issuedAt = 0;
+  uint64 sessionStart = 0;
+  uint64 serverInstanceUID = 0;
+  int validitySec = 0;
+  uint64 checkedAt = 0;
+  if (sessionCacheGet(server, tokenText, slh, &username, &issuedAt, &sessionStart,
+                      &serverInstanceUID, &validitySec, &checkedAt) ||
+      decodeSessionTokenFields(server, slh, tokenText, &username, &issuedAt,
+                               &serverInstanceUID, &sessionStart)){
+    int returnCode = 0;
+    int reasonCode = 0;
+    /* the current length, the cached one may be out of date */
+    if (getUserSessionValidity(username, server->config, &validitySec, &returnCode, &reasonCode) != 0 ||
+        validitySec == 0){
+      int defaultValiditySec = server->config->defaultTimeout ? server->config->defaultTimeout : SESSION_VALIDITY_IN_SECONDS;
+      validitySec = (validitySec > defaultValiditySec || validitySec == -1) ? validitySec : defaultValiditySec;
+    }
+    revokeSession(server, makeSessionKey(slh, username, sessionStart, serverInstanceUID), validitySec);
+  }
+  SLHFree(slh);
+}
+
+void httpServerLogout(HttpService *service, HttpRequest *request, HttpResponse *response){
+  char *cookieName = getSessionTokenCookieName(service);
+  httpServerInvalidateSessionToken(service->server, getCookieValue(request, cookieName));
+  int keyValueBufferSize = strlen(cookieName) + 64;
+  char *keyValueBuffer = SLHAlloc(response->slh, keyValueBufferSize);
+#ifdef INSECURE_COOKIE
+  snprintf(keyValueBuffer, keyValueBufferSize, "%s=non-token; Path=/; Max-Age=0", cookieName);
+#else
+  snprintf(keyValueBuffer, keyValueBufferSize, "%s=non-token; Path=/; Max-Age=0; HttpOnly; SameSite=Strict", cookieName);
+#endif
+  response->sessionCookie = keyValueBuffer;
+}
+
 static void logTimeoutLookupError(const char *username, const int rc, const int rsn){
   zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_WARNING,
           "serviceAuthNativeWithSessionToken: Error when getting session duration for user '%s'. rc=%d, rsn=%d\n",
@@ -3237,10 +6037,14 @@ static int serviceAuthNativeWithSessionToken(HttpService *service, HttpRequest *
            (tokenCookieText ? tokenCookieText : "<noAuthToken>"));
     uint64 timeRemainingStck = 0;
     int sessionLengthSec = 0;
-    if (sessionTokenStillValid(service,request,tokenCookieText,&sessionLengthSec,&timeRemainingStck)){
+    uint64 sessionStart = 0;
+    uint64 validityCheckedAt = 0;
+    if (sessionTokenStillValid(service,request,tokenCookieText,&sessionLengthSec,&timeRemainingStck,
+                               &sessionStart,&validityCheckedAt)){
       zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG3,
               "serviceAuthNativeWithSessionToken: Cookie still good, renewing cookie\n");
-      char *sessionToken = generateSessionTokenKeyValue(service, request,request->username);
+      char *sessionToken = generateSessionTokenKeyValue(service, request,request->username,sessionLengthSec,
+                                                        sessionStart,validityCheckedAt);
       if (sessionToken == NULL){
         return FALSE;
       }
@@ -3251,13 +6055,14 @@ static int serviceAuthNativeWithSessionToken(HttpService *service, HttpRequest *
       if (nativeAuth(service,request,authResponse)){
         zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG3,
                "serviceAuthNativeWithSessionToken: Cookie not valid, auth is good\n");
-        char *sessionToken = generateSessionTokenKeyValue(service,request,request->username);
         retVal = getUserSessionValidity(request->username, service->server->config,
                                       &response->sessionTimeout, &returnCode, &reasonCode);
         if (retVal) {
           logTimeoutLookupError(request->username, returnCode, reasonCode);
           return FALSE;
         }
+        char *sessionToken = generateSessionTokenKeyValue(service,request,request->username,
+                                                          response->sessionTimeout,0,getFineGrainedTime());
         response->sessionCookie = sessionToken;
         return TRUE;
       } else{
@@ -3281,13 +6086,14 @@ static int serviceAuthNativeWithSessionToken(HttpService *service, HttpRequest *
               "before generate session token req=0x%p, username=0x%p, response=0x%p\n",
               request,request->username,response);
 
-      char *sessionToken = generateSessionTokenKeyValue(service,request,request->username);
       retVal = getUserSessionValidity(request->username, service->server->config,
                                       &response->sessionTimeout, &returnCode, &reasonCode);
       if (retVal) {
         logTimeoutLookupError(request->username, returnCode, reasonCode);
         return FALSE;
       }
+      char *sessionToken = generateSessionTokenKeyValue(service,request,request->username,
+                                                        response->sessionTimeout,0,getFineGrainedTime());
       response->sessionCookie = sessionToken;
       return TRUE;
     } else{
@@ -3389,7 +6195,7 @@ static int serviceAuthWithJwt(HttpService *service,
     snprintf(jwtCookie, jwtCookieLen, "%s=%s", JWT_COOKIE_NAME, jwtTokenText);
     addStringHeader(response, "Set-Cookie", jwtCookie);
     response->sessionCookie = NULL;
-    char *sessionToken = generateSessionTokenKeyValue(service,request,request->username);
+    char *sessionToken = generateSessionTokenKeyValue(service,request,request->username,0,0,0);
     response->sessionCookie = sessionToken;
     addStringHeader(response, "Set-Cookie", response->sessionCookie);
     strupcase(request->username);
@@ -3419,6 +6225,9 @@ int httpServerInitJwtContext(HttpServer *self,
   if (*makeContextRc != RC_JWT_OK) {
     return 1;
   }
+  /* the key is local, so a signature that checked out once stays good */
+  jwtContextSetVerificationCache(context, JWT_VERIFICATION_CACHE_DEFAULT_MAX_ENTRIES,
+                                 JWT_VERIFICATION_CACHE_DEFAULT_TTL_SECONDS);
   self->config->jwtContext = context;
   self->config->authTokenType = legacyFallback?
       SERVICE_AUTH_TOKEN_TYPE_JWT_WITH_LEGACY_FALLBACK
@@ -3614,6 +6423,8 @@ static int handleHttpService(HttpServer *server,
   }
 
   HTTPServiceABENDInfo abendInfo = {"RSHTTPAI", 0, 0};
+  /* set after the push, so it must be read from storage when a retry comes back here */
+  volatile int inFlightCounted = FALSE;
   int recoveryRC = recoveryPush(service->name,
                                 RCVR_FLAG_RETRY | RCVR_FLAG_SDWA_TO_LOGREC | RCVR_FLAG_DELETE_ON_RETRY,
                                 NULL, extractABENDInfo, &abendInfo, NULL, NULL);
@@ -3637,6 +6448,9 @@ static int handleHttpService(HttpServer *server,
       zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_SEVERE, "httpserver: error running service %s unknown recovery code %d\n",
           service->name, recoveryRC);
     }
+    if (inFlightCounted){
+      httpAtomicAdd(&server->metrics->inFlightRequests,-1);
+    }
     return handleServiceFailed(conversation, service, response);
   }
 #endif
@@ -3644,6 +6458,20 @@ static int handleHttpService(HttpServer *server,
 
   service->server = server;
 
+  /* the response may be gone by the time the metrics are recorded, the conversation is not */
+  HttpConversation *metricsConversation = response->conversation;
+  if (metricsConversation){
+    metricsConversation->responseWriteMicros = 0;
+    metricsConversation->responseStatus = 0;
+  }
+  if (server){
+    httpAtomicAdd(&server->metrics->inFlightRequests,1);
+#ifdef __ZOWE_OS_ZOS
+    inFlightCounted = TRUE;
+#endif
+  }
+  int64 authStart = getMetricsMicros();
+
   int clearSessionToken = FALSE;
   AuthResponse authResponse;
 
@@ -3680,6 +6508,7 @@ static int handleHttpService(HttpServer *server,
     break;
   }
   zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG3, "service=%s authenticated=%d\n",service->name,request->authenticated);
+  int64 serveStart = getMetricsMicros();
   if (request->authenticated == FALSE){
     if (service->authFlags & SERVICE_AUTH_FLAG_OPTIONAL) {
       // Allow the service to decide when to respond with HTTP 401
@@ -3706,6 +6535,13 @@ static int handleHttpService(HttpServer *server,
 
   }
   zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG3, "service=%s auth succeeded\n",service->name);
+  if (server){
+    recordServiceMetrics(server,service,metricsConversation,serveStart-authStart,getMetricsMicros()-serveStart);
+#ifdef __ZOWE_OS_ZOS
+    inFlightCounted = FALSE;
+#endif
+    httpAtomicAdd(&server->metrics->inFlightRequests,-1);
+  }
 
 #ifdef __ZOWE_OS_ZOS
   recoveryPop();
@@ -3729,12 +6565,17 @@ HttpConversation *makeHttpConversation(SocketExtension *socketExtension,
   conversation->closeEnqueued = FALSE;
   conversation->requestCount = 0;
   conversation->isKeepAlive = FALSE;
+  conversation->lastActivityMicros = getMetricsMicros();
+  conversation->clientAddress = -1;
   socketExtension->protocolHandler = conversation;
   socketExtension->moduleID = STC_MODULE_JEDHTTP;
   socketExtension->isServerSocket = FALSE;
   if (socketExtension->readBuffer) {
     conversation->readBuffer = socketExtension->readBuffer;
   }
+  HttpServerMetrics *metrics = server->metrics;
+  httpAtomicAdd(&metrics->activeConnections,1);
+  httpAtomicAdd64(&metrics->connectionsAccepted,1);
   return conversation;
 }
 
@@ -3927,8 +6768,7 @@ void respondWithError(HttpResponse *response, int code, char *message){
          }
          */
   addIntHeader(response,"Content-Length",len);
-  writeHeader(response);
-  writeFully(response->socket,buffer,len);
+  writeHeaderAndBody(response,buffer,len);
   finishResponse(response);
 }
 
@@ -3957,8 +6797,7 @@ void respondWithMessage(HttpResponse *response, int status,
   setContentType(response, "text/plain");
   addStringHeader(response, "Server", "jdmfws");
   addIntHeader(response, "Content-Length", messageLength);
-  writeHeader(response);
-  writeFully(response->socket, errorMessageASCII, messageLength);
+  writeHeaderAndBody(response, errorMessageASCII, messageLength);
 
   finishResponse(response);
 
@@ -4085,10 +6924,10 @@ HttpRequestParam *getCheckedParam(HttpRequest *request, char *paramName){
   return NULL;
 }
 
-static char *getMimeType2(char *extension, int *isBinary, int dotPos, int ccsid);
+static char *getMimeType2(HttpServer *server, char *extension, int *isBinary, int dotPos, int ccsid);
 
 char *getMimeType(char *extension, int *isBinary) {
-  return getMimeType2(extension, isBinary, FALSE, -1);
+  return getMimeType2(NULL, extension, isBinary, FALSE, -1);
 }
 
 typedef struct MimeType_tag {
@@ -4116,9 +6955,6 @@ static MimeType MIME_TYPES[] = {
   {"doc", "application/msword", TRUE },
   {"docx", "application/vnd.openxmlformats-officedocument.wordprocessingml.document", TRUE},
   {"py", "text/plain", FALSE},
-  {"cbl", "text/plain", FALSE},
-  {"cpp", "text/plain", FALSE},
-  {"csv", "text/csv", FALSE},
   {"env", "text/plain", FALSE},
   {"gif", "image/gif", TRUE},
   {"gz", "application/gzip", TRUE},
@@ -4146,7 +6982,6 @@ static MimeType MIME_TYPES[] = {
   {"php", "text/plain", FALSE},
   {"pl", "text/plain", FALSE},
   {"png", "image/png", TRUE}, 
-  {"py", "text/plain", FALSE},
   {"woff2", "application/font-woff2", TRUE},
   {"ttf", "application/font-ttf", TRUE},
   {"mp3", "audio/mpeg", TRUE},
@@ -4155,7 +6990,6 @@ static MimeType MIME_TYPES[] = {
   {"swift", "text/plain", FALSE},
   {"pdf", "application/pdf", TRUE},
   {"tar", "application/x-tar", TRUE},
-  {"ts", "text/plain", FALSE},
   {"tsx", "text/plain", FALSE},
   {"txt", "text/plain", FALSE},
   {"webm", "video/webm", TRUE},
@@ -4166,7 +7000,45 @@ static MimeType MIME_TYPES[] = {
 
 #define MIME_TYPE_COUNT sizeof(MIME_TYPES)/sizeof(MIME_TYPES[0])
 
-static MimeType *findMimeTypeByExtension(const char *extention) {
+/*
+  Each server hashes the extensions once at construction, with additions from
+  httpServerAddMimeType layered on top.  The linear scan is only for callers without a server.
+ */
+static hashtable *makeMimeTypeTable(void) {
+  hashtable *table = htCreate(257, stringHash, stringCompare, NULL, NULL);
+  for (int i = 0; i < MIME_TYPE_COUNT; i++) {
+    htPut(table, MIME_TYPES[i].extension, &MIME_TYPES[i]);
+  }
+  return table;
+}
+
+void httpServerAddMimeType(HttpServer *server, const char *extension, const char *mimeType, int isBinary) {
+  int mimeTypeLength = strlen(mimeType);
+  MimeType *existing = (MimeType*)htGet(server->mimeTypes, (void*)extension);
+  if (existing != NULL && (existing < &MIME_TYPES[0] || existing >= &MIME_TYPES[MIME_TYPE_COUNT])) {
+    /* added earlier, the string may be reused by a response still in flight so it is kept */
+    char *copy = safeMalloc(mimeTypeLength+1, "MimeType mimeType");
+    memcpy(copy, mimeType, mimeTypeLength+1);
+    existing->mimeType = copy;
+    existing->isBinary = isBinary;
+  } else {
+    int extensionLength = strlen(extension);
+    MimeType *added = (MimeType*)safeMalloc(sizeof(MimeType), "MimeType");
+    added->extension = safeMalloc(extensionLength+1, "MimeType extension");
+    memcpy(added->extension, extension, extensionLength+1);
+    added->mimeType = safeMalloc(mimeTypeLength+1, "MimeType mimeType");
+    memcpy(added->mimeType, mimeType, mimeTypeLength+1);
+    added->isBinary = isBinary;
+    htPut(server->mimeTypes, added->extension, added);
+  }
+  /* cached files were typed with what this addition replaces */
+  fileCacheClear(server->fileCache);
+}
+
+static MimeType *findMimeTypeByExtension(HttpServer *server, const char *extention) {
+  if (server != NULL && server->mimeTypes != NULL) {
+    return (MimeType*)htGet(server->mimeTypes, (void*)extention);
+  }
   for (int i = 0; i < MIME_TYPE_COUNT; i++) {
     if (0 == strcmp(extention, MIME_TYPES[i].extension)) {
       return &MIME_TYPES[i];
@@ -4175,13 +7047,13 @@ static MimeType *findMimeTypeByExtension(const char *extention) {
   return NULL;
 }
 
-static char *getMimeType2(char *extension, int *isBinary, int isDotFile, int ccsid){
+static char *getMimeType2(HttpServer *server, char *extension, int *isBinary, int isDotFile, int ccsid){
   bool isTaggedAsText = (ccsid > 0);
   if (isDotFile) {
     *isBinary = FALSE;
     return "text/plain";
   }
-  MimeType *mimeType = findMimeTypeByExtension(extension);
+  MimeType *mimeType = findMimeTypeByExtension(server, extension);
   if (mimeType) {
     *isBinary = isTaggedAsText ? FALSE : mimeType->isBinary;
     return mimeType->mimeType;
@@ -4362,6 +7234,288 @@ static int streamBinaryForFile2(HttpResponse *response, Socket *socket, UnixFile
 static int streamTextForFile2(HttpResponse *response, Socket *socket, UnixFile *in, int encoding,
                       int sourceCCSID, int targetCCSID, bool asB64);
 
+#define BYTE_RANGE_NONE          0
+#define BYTE_RANGE_SATISFIABLE   1
+#define BYTE_RANGE_UNSATISFIABLE 2
+
+/*
+  Looks at the Range and If-Range headers of the request.  Only a single "bytes=" range is honored;
+  multiple ranges or anything unparseable fall back to the whole file, which RFC 7233 allows.
+  If-Range only matches our own ETag, and a date in If-Range never matches because we do not send
+  Last-Modified.
+ */
+static int getRequestedByteRange(HttpRequest *request, int64 fileSize, uint64_t etag,
+                                 int64 *first, int64 *last){
+  HttpHeader *rangeHeader = getHeader(request, "Range");
+  if (rangeHeader == NULL || rangeHeader->nativeValue == NULL){
+    return BYTE_RANGE_NONE;
+  }
+  HttpHeader *ifRangeHeader = getHeader(request, "If-Range");
+  if (ifRangeHeader != NULL && ifRangeHeader->nativeValue != NULL){
+    /* a strong comparison with the whole ETag, as sent by addCacheRelatedHeaders */
+    char ownEtag[24];
+    char *value = ifRangeHeader->nativeValue;
+    int valueLength = strlen(value);
+    while (valueLength > 0 && value[valueLength-1] == ' '){
+      valueLength--;
+    }
+    while (valueLength > 0 && *value == ' '){
+      value++;
+      valueLength--;
+    }
+    if (valueLength >= 2 && value[0] == '"' && value[valueLength-1] == '"'){
+      value++;
+      valueLength -= 2;
+    }
+    snprintf(ownEtag, sizeof(ownEtag), "%.16llx", (unsigned long long)etag);
+    if (valueLength != strlen(ownEtag) || strncmp(value, ownEtag, valueLength) != 0){
+      return BYTE_RANGE_NONE;
+    }
+  }
+  char *spec = rangeHeader->nativeValue;
+  while (*spec == ' '){
+    spec++;
+  }
+  if (strncmp(spec, "bytes=", 6) != 0 || strchr(spec, ',') != NULL){
+    return BYTE_RANGE_NONE;
+  }
+  spec += 6;
+  char *dash = strchr(spec, '-');
+  if (dash == NULL){
+    return BYTE_RANGE_NONE;
+  }
+  long long start = 0;
+  long long end = 0;
+  int hasStart = (dash != spec);
+  int hasEnd = (dash[1] != 0 && dash[1] != ' ');
+  if (hasStart && sscanf(spec, "%lld", &start) != 1){
+    return BYTE_RANGE_NONE;
+  }
+  if (hasEnd && sscanf(dash+1, "%lld", &end) != 1){
+    return BYTE_RANGE_NONE;
+  }
+  if (!hasStart && !hasEnd){
+    return BYTE_RANGE_NONE;
+  }
+  if (!hasStart){
+    /* suffix range, the last N bytes */
+    if (end <= 0 || fileSize == 0){
+      return BYTE_RANGE_UNSATISFIABLE;
+    }
+    *first = (end >= fileSize) ? 0 : fileSize - end;
+    *last = fileSize - 1;
+    return BYTE_RANGE_SATISFIABLE;
+  }
+  if (hasEnd && end < start){
+    return BYTE_RANGE_NONE;
+  }
+  if (start >= fileSize){
+    return BYTE_RANGE_UNSATISFIABLE;
+  }
+  *first = start;
+  *last = (!hasEnd || end >= fileSize) ? fileSize - 1 : end;
+  return BYTE_RANGE_SATISFIABLE;
+}
+
+static char *formatInt64(HttpResponse *response, int64 value){
+  char *buffer = SLHAlloc(response->slh, 24);
+  snprintf(buffer, 24, "%lld", (long long)value);
+  return buffer;
+}
+
+/* copies the byte range of the file to the socket through a heap buffer */
+static int copyFileRangeToSocket(Socket *socket, UnixFile *in, int64 offset, int64 length){
+  int returnCode = 0;
+  int reasonCode = 0;
+  int bufferSize = (length < FILE_STREAM_BUFFER_SIZE) ? (int)length : FILE_STREAM_BUFFER_SIZE;
+  char *buffer = safeMalloc(bufferSize, "copyFileRangeBuffer");
+  int status = 0;
+
+  if (offset > 0 && fileSeek(in, offset, FILE_SEEK_SET, &returnCode, &reasonCode) != 0){
+    /* not seekable, skip forward by reading */
+    int64 skipped = 0;
+    while (skipped < offset){
+      int64 want = offset - skipped;
+      int bytesRead = fileRead(in, buffer, (want < bufferSize) ? (int)want : bufferSize,
+                               &returnCode, &reasonCode);
+      if (bytesRead <= 0){
+        status = 8;
+        break;
+      }
+      skipped += bytesRead;
+    }
+  }
+  int64 remaining = length;
+  while (status == 0 && remaining > 0){
+    int bytesRead = fileRead(in, buffer, (remaining < bufferSize) ? (int)remaining : bufferSize,
+                             &returnCode, &reasonCode);
+    if (bytesRead <= 0){
+      zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG2,
+              "File range ended early with %lld bytes left (return = 0x%x, reason = 0x%x)\n",
+              (long long)remaining, returnCode, reasonCode);
+      status = 8;
+      break;
+    }
+    if (writeFully(socket, buffer, bytesRead) == 0){
+      status = 8;
+      break;
+    }
+    remaining -= bytesRead;
+  }
+  safeFree(buffer, bufferSize);
+  return status;
+}
+
+static int getUnixFileDescriptor(UnixFile *in){
+#ifndef __ZOWE_OS_ZOS
+  if (in->internalFile != NULL){
+    return fileno(in->internalFile);
+  }
+#endif
+  return in->fd;
+}
+
+/*
+  Sends a file that needs no encoding or translation with a Content-Length instead of chunking,
+  so that the kernel can move it from disk to the socket (sendfile on Linux).  Honors single
+  byte-range requests with 206 and 416 responses.  The caller opens and closes the file and
+  finishes the response.  When the file's bytes are already in memory they are passed as content
+  and sent with the header in one write, and in may be NULL.
+ */
+static void respondWithRawFile(HttpService *service, HttpResponse *response, UnixFile *in,
+                               char *content, int64 fileSize, char *mimeType, time_t mtime, uint64_t etag,
+                               char *contentEncoding){
+  int64 first = 0;
+  int64 last = fileSize - 1;
+  int rangeStatus = getRequestedByteRange(response->request, fileSize, etag, &first, &last);
+
+  if (rangeStatus == BYTE_RANGE_UNSATISFIABLE){
+    char *contentRange = SLHAlloc(response->slh, 48);
+    snprintf(contentRange, 48, "bytes */%lld", (long long)fileSize);
+    setResponseStatus(response, 416, "Range Not Satisfiable");
+    addStringHeader(response, "Server", "jdmfws");
+    addStringHeader(response, "Content-Range", contentRange);
+    addIntHeader(response, "Content-Length", 0);
+    writeHeader(response);
+    return;
+  }
+
+  int64 length = (rangeStatus == BYTE_RANGE_SATISFIABLE) ? (last - first + 1) : fileSize;
+  if (rangeStatus == BYTE_RANGE_SATISFIABLE){
+    char *contentRange = SLHAlloc(response->slh, 80);
+    snprintf(contentRange, 80, "bytes %lld-%lld/%lld",
+             (long long)first, (long long)last, (long long)fileSize);
+    setResponseStatus(response, 206, "Partial Content");
+    addStringHeader(response, "Content-Range", contentRange);
+  } else{
+    first = 0;
+    setResponseStatus(response, 200, "OK");
+  }
+  addStringHeader(response, "Server", "jdmfws");
+  addStringHeader(response, "Cache-control", "no-store");
+  addStringHeader(response, "Pragma", "no-cache");
+  addStringHeader(response, "Accept-Ranges", "bytes");
+  addStringHeader(response, "Content-Length", formatInt64(response, length));
+  setContentType(response, mimeType);
+  if (contentEncoding != NULL){
+    addStringHeader(response, "Content-Encoding", contentEncoding);
+    addStringHeader(response, "Vary", "Accept-Encoding");
+  }
+  addCacheRelatedHeaders(response, mtime, etag);
+
+  if ((NULL != service) &&
+      (NULL != service->customHeadersFunction))
+  {
+    service->customHeadersFunction(service, response);
+  }
+  if (content != NULL){
+    writeHeaderAndBody(response, content+first, (int)length);
+    return;
+  }
+  writeHeader(response);
+  if (length == 0){
+    return;
+  }
+
+  /* 
+     Content-Length is out, so after a failure the body on the wire is short and the
+     connection cannot carry another response.
+   */
+  int sendStatus = writeFullyFromFile(response->socket, getUnixFileDescriptor(in), first, length);
+  if (sendStatus < 0){
+    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG2, "Copying %lld bytes at %lld through a buffer\n",
+            (long long)length, (long long)first);
+    if (copyFileRangeToSocket(response->socket, in, first, length) != 0){
+      zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "file copy failed after the header was sent\n");
+      sendStatus = 0;
+    }
+  } else if (sendStatus == 0){
+    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "sendfile failed after partial send\n");
+  }
+  if (sendStatus == 0 && response->conversation != NULL){
+    response->conversation->shouldClose = TRUE;
+  }
+}
+
+/*
+  If the client takes gzip and there is a "<file>.gz" next to the file that is at least as new,
+  the precompressed bytes are sent as-is with Content-Encoding: gzip.  The sidecar is expected to
+  hold exactly what would otherwise go on the wire, i.e. it was compressed from web-ready text.
+  Returns true if the response was sent and finished, otherwise *hasSidecar says whether the
+  response would have differed for a client that takes gzip.  The file cache remembers a missing
+  sidecar, so that files without one do not pay for a second stat on every request.
+ */
+static bool respondWithGzipSidecar(HttpService *service, HttpResponse *response,
+                                   char *absolutePath, const FileInfo *fileInfoOfPath,
+                                   time_t mtime, char *mimeType, bool *hasSidecar){
+  *hasSidecar = false;
+  HttpFileCache *fileCache = httpResponseServer(response)->fileCache;
+  if (fileCacheIsSidecarAbsent(fileCache, absolutePath, fileInfoOfPath)){
+    return false;
+  }
+  int returnCode = 0;
+  int reasonCode = 0;
+  FileInfo info;
+  int pathLength = strlen(absolutePath);
+  char *sidecarPath = SLHAlloc(response->slh, pathLength+4);
+  sprintf(sidecarPath, "%s.gz", absolutePath);
+  if (fileInfo(sidecarPath, &info, &returnCode, &reasonCode) != 0 ||
+      fileInfoIsDirectory(&info) ||
+      fileInfoUnixModificationTime(&info) < mtime){
+    fileCacheSetSidecarAbsent(fileCache, absolutePath, fileInfoOfPath, true);
+    return false;
+  }
+  *hasSidecar = true;
+  if (chooseContentCoding(response->request) != HTTP_CONTENT_CODING_GZIP){
+    return false;
+  }
+  time_t sidecarMtime = fileInfoUnixModificationTime(&info);
+  uint64_t etag = makeFileEtag(&info);
+  if (!isCachedCopyModified(response->request, etag, sidecarMtime)) {
+    setResponseStatus(response, 304, "Not modified");
+    addStringHeader(response, "Cache-control", "no-store");
+    addStringHeader(response, "Pragma", "no-cache");
+    addStringHeader(response, "Server", "jdmfws");
+    addStringHeader(response, "Vary", "Accept-Encoding");
+    addCacheRelatedHeaders(response, sidecarMtime, etag);
+    writeHeader(response);
+    finishResponse(response);
+    return true;
+  }
+  UnixFile *in = fileOpen(sidecarPath, FILE_OPTION_READ_ONLY, 0, 0, &returnCode, &reasonCode);
+  if (in == NULL){
+    return false;
+  }
+#ifdef __ZOWE_OS_ZOS
+  fileDisableConversion(in, &returnCode, &reasonCode);
+#endif
+  zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "Sending precompressed %s\n", sidecarPath);
+  respondWithRawFile(service, response, in, NULL, fileInfoSize(&info), mimeType, sidecarMtime, etag, "gzip");
+  fileClose(in, &returnCode, &reasonCode);
+  finishResponse(response);
+  return true;
+}
+
 // Response must ALWAYS be finished on return
 void respondWithUnixFile2(HttpService* service, HttpResponse* response, char* absolutePath, int jsonMode, int autocvt, bool asB64) {
   FileInfo info;
@@ -4380,14 +7534,32 @@ void respondWithUnixFile2(HttpService* service, HttpResponse* response, char* ab
     }
     char *extension = (dotPos == -1) ? "NULL" : absolutePath + dotPos + 1;
     int isBinary = FALSE;
-    long fileSize = fileInfoSize(&info);
+    int64 fileSize = fileInfoSize(&info);
     int ccsid = fileInfoCCSID(&info);
-    char *mimeType = getMimeType2(extension,&isBinary,isDotFile, ccsid);
+    HttpFileCache *fileCache = httpResponseServer(response)->fileCache;
+    char *mimeType = NULL;
+    if (!fileCacheGetInfo(fileCache, response, absolutePath, &info, &mimeType, &isBinary)) {
+      mimeType = getMimeType2(httpResponseServer(response), extension, &isBinary, isDotFile, ccsid);
+      fileCachePutInfo(fileCache, absolutePath, &info, mimeType, isBinary);
+    }
     zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "File ccsid=%d, mimetype=%s isBinary=%s\n",
             ccsid,mimeType,isBinary ? "true" : "false");
     char tmperr[256] = {0};
     time_t mtime = fileInfoUnixModificationTime(&info);
     uint64_t etag = makeFileEtag(&info);
+
+    bool hasSidecar = false;
+    if (!asB64 && respondWithGzipSidecar(service, response, absolutePath, &info, mtime, mimeType, &hasSidecar)) {
+      // Response is finished on return
+      return;
+    }
+    /* raw files are only ever compressed ahead of time, streamed ones when they are large enough */
+    bool sendsRaw = (isBinary || ccsid == -1) && !asB64;
+    if (hasSidecar ||
+        (!sendsRaw && isCompressionEnabled(response) &&
+         fileSize >= httpResponseServer(response)->config->compressionMinSize)) {
+      addStringHeader(response, "Vary", "Accept-Encoding");
+    }
     bool modified = isCachedCopyModified(req, etag, mtime);
 
     if (!modified) {
@@ -4400,6 +7572,23 @@ void respondWithUnixFile2(HttpService* service, HttpResponse* response, char* ab
       finishResponse(response);
       return;
     }
+    /*
+      Small raw files can be sent from memory.  Impersonating services still open the file
+      each time so that the caller's own access to it is checked.
+     */
+    bool useContentCache = (fileCache != NULL) && sendsRaw &&
+                           fileSize > 0 && fileSize <= fileCache->maxFileSize &&
+                           (service != NULL) && !service->doImpersonation;
+    if (useContentCache) {
+      HttpFileCacheEntry *entry = fileCacheGetContent(fileCache, absolutePath, &info, autocvt);
+      if (entry != NULL) {
+        zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "Sending cached %s\n", absolutePath);
+        respondWithRawFile(service, response, NULL, entry->content, fileSize, mimeType, mtime, etag, NULL);
+        fileCacheRelease(fileCache, entry);
+        finishResponse(response);
+        return;
+      }
+    }
     /* attempt open before writing any headers so we have option of returning error */
     UnixFile *in = fileOpen(absolutePath,
                             FILE_OPTION_READ_ONLY,
@@ -4426,6 +7615,19 @@ void respondWithUnixFile2(HttpService* service, HttpResponse* response, char* ab
     }
 #endif
 
+    if (sendsRaw) {
+      zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "Sending raw binary for %s\n", absolutePath);
+      HttpFileCacheEntry *entry = useContentCache ? fileCacheLoadContent(fileCache, absolutePath, &info, autocvt, in) : NULL;
+      respondWithRawFile(service, response, in, entry ? entry->content : NULL,
+                         fileSize, mimeType, mtime, etag, NULL);
+      if (entry != NULL) {
+        fileCacheRelease(fileCache, entry);
+      }
+      fileClose(in,&returnCode,&reasonCode);
+      finishResponse(response);
+      return;
+    }
+
     setResponseStatus(response,200,"OK");
     addStringHeader(response,"Server","jdmfws");
     addStringHeader(response, "Cache-control", "no-store");
@@ -4434,6 +7636,13 @@ void respondWithUnixFile2(HttpService* service, HttpResponse* response, char* ab
     setContentType(response, mimeType);
     addCacheRelatedHeaders(response, mtime, etag);
 
+    int streamEncoding = ENCODING_CHUNKED;
+    if (getOfferedContentCoding(response) == HTTP_CONTENT_CODING_GZIP &&
+        fileSize >= httpResponseServer(response)->config->compressionMinSize) {
+      streamEncoding = ENCODING_GZIP;
+      addStringHeader(response, "Content-Encoding", "gzip");
+    }
+
     if ((NULL != service) &&
         (NULL != service->customHeadersFunction))
     {
@@ -4444,7 +7653,7 @@ void respondWithUnixFile2(HttpService* service, HttpResponse* response, char* ab
       writeHeader(response);
       zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "Streaming binary for %s\n", absolutePath);
       
-      streamBinaryForFile2(response, NULL, in, ENCODING_CHUNKED, asB64);
+      streamBinaryForFile2(response, NULL, in, streamEncoding, asB64);
     } else {
       writeHeader(response);
       zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "Streaming %d for %s\n", ccsid, absolutePath);
@@ -4487,7 +7696,7 @@ void respondWithUnixFile2(HttpService* service, HttpResponse* response, char* ab
            }
 	         zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "Sending with forced conversion between %d and %d\n", 
                    sscanfSource, sscanfTarget);
-           streamTextForFile2(response, NULL, in, ENCODING_CHUNKED, sEncoding, tEncoding, asB64);
+           streamTextForFile2(response, NULL, in, streamEncoding, sEncoding, tEncoding, asB64);
         }
         else {
           respondWithError(response, HTTP_STATUS_BAD_REQUEST, "force encoding enabled make sure to pass all the requried params");
@@ -4497,12 +7706,12 @@ void respondWithUnixFile2(HttpService* service, HttpResponse* response, char* ab
     else if(ccsid == 0) {
 	    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "Sending with default conversion between %d and %d\n", 
               NATIVE_CODEPAGE, webCodePage);
-      streamTextForFile2(response, NULL, in, ENCODING_CHUNKED, NATIVE_CODEPAGE, webCodePage, asB64);
+      streamTextForFile2(response, NULL, in, streamEncoding, NATIVE_CODEPAGE, webCodePage, asB64);
     }
     else {
 	    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "Sending with tagged conversion between %d and %d\n", 
               ccsid, webCodePage);
-      streamTextForFile2(response, NULL, in, ENCODING_CHUNKED, ccsid, webCodePage, asB64);
+      streamTextForFile2(response, NULL, in, streamEncoding, ccsid, webCodePage, asB64);
     }
 
 #ifdef USE_CONTINUE_RESPONSE_HACK
@@ -4579,11 +7788,10 @@ void respondWithUnixFileNotFound(HttpResponse* response, int jsonMode) {
     addStringHeader(response, "Cache-control", "no-store");
     addStringHeader(response, "Pragma", "no-cache");
     addIntHeader(response,"Content-Length",len);
-    writeHeader(response);
 
     toASCIIUTF8(message,len);
 
-    writeFully(response->socket,message,len);
+    writeHeaderAndBody(response,message,len);
     finishResponse(response);
   }
   else {
@@ -4614,6 +7822,22 @@ void respondWithJsonError(HttpResponse *response, char *error, int statusCode, c
   finishResponse(response);
 }
 
+/*
+  The file streamers write their own header before making the stream, so the coding cannot be
+  negotiated on the first flush.  For ENCODING_GZIP the caller has already added Content-Encoding.
+ */
+static ChunkedOutputStream *makeChunkedOutputStreamForFile(HttpResponse *response, int encoding){
+  ChunkedOutputStream *stream = makeChunkedOutputStreamInternal(response);
+  stream->offeredCoding = HTTP_CONTENT_CODING_IDENTITY;
+  stream->codingDecided = true;
+  if (encoding == ENCODING_GZIP &&
+      startStreamCompression(stream, HTTP_CONTENT_CODING_GZIP) != 0) {
+    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_WARNING, "Could not start gzip for a file response\n");
+    stream->isErrorState = true;
+  }
+  return stream;
+}
+
 #define ENCODE64_SIZE(SZ) (2 + 4 * ((SZ + 2) / 3))
 
 /*
@@ -4629,16 +7853,12 @@ static int streamBinaryForFile2(HttpResponse *response, Socket *socket, UnixFile
     zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "bad arguments: either response or socket must be not NULL, never both\n");	
     return 8;
   }
-  if (encoding == ENCODING_GZIP) {
-    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "GZIP encoding not implemented\n");	
-    return 8;
-  }
-  if (encoding == ENCODING_CHUNKED && !response) {
+  if ((encoding == ENCODING_CHUNKED || encoding == ENCODING_GZIP) && !response) {
     zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "bad arguments: response must be not NULL to use chunked encoding\n");	
     return 8;
   }
-  if (encoding == ENCODING_CHUNKED) {
-    stream = makeChunkedOutputStreamInternal(response);
+  if (encoding == ENCODING_CHUNKED || encoding == ENCODING_GZIP) {
+    stream = makeChunkedOutputStreamForFile(response, encoding);
   }
   
   // To make bufferSize divisble by 3 for correct base64 encoding.
@@ -4664,7 +7884,7 @@ static int streamBinaryForFile2(HttpResponse *response, Socket *socket, UnixFile
     }
     char *outPtr = asB64 ? encodedBuffer : buffer;
     int outLen = asB64 ? encodedLength : bytesRead;
-    if (encoding == ENCODING_CHUNKED) {
+    if (stream != NULL) {
       writeBytes(stream, outPtr, outLen, NO_TRANSLATE);
     } else {
       writeFully(socket, outPtr, outLen);
@@ -4672,7 +7892,7 @@ static int streamBinaryForFile2(HttpResponse *response, Socket *socket, UnixFile
 
     if (NULL != encodedBuffer) safeFree31(encodedBuffer, ENCODE64_SIZE(bytesRead)+1);
   }
-  if (encoding == ENCODING_CHUNKED) {
+  if (stream != NULL) {
     /* finish the chunked output here because finishResponse will not flush this stream's data */
     finishChunkedOutput(stream, NO_TRANSLATE);
   }
@@ -4686,6 +7906,62 @@ int streamBinaryForFile(Socket *socket, UnixFile *in, bool asB64) {
   return streamBinaryForFile2(NULL, socket, in, ENCODING_SIMPLE, asB64);
 }
 
+/*
+  Base64 output of a text stream.  Converted chunks seldom end on a 3 byte boundary, so the 1 or
+  2 bytes past the last whole quantum wait in carry for the next chunk, and only the end of the
+  stream is padded.
+ */
+typedef struct StreamedBase64_tag {
+  char carry[3];
+  int carryLength;
+  char *encoded;
+  int encodedSize;
+} StreamedBase64;
+
+static void writeStreamedBytes(ChunkedOutputStream *stream, Socket *socket, char *data, int length) {
+  if (stream != NULL) {
+    writeBytes(stream, data, length, NO_TRANSLATE);
+  } else {
+    writeFully(socket, data, length);
+  }
+}
+
+/* writes data, base64 encoded when base64 is not NULL, and returns the number of bytes written */
+static int writeStreamedText(ChunkedOutputStream *stream, Socket *socket, char *data, int length,
+                             StreamedBase64 *base64, bool last) {
+  if (base64 == NULL) {
+    if (length > 0) {
+      writeStreamedBytes(stream, socket, data, length);
+    }
+    return length;
+  }
+  int written = 0;
+  int encodedLength = 0;
+  if (base64->carryLength > 0) {
+    while (base64->carryLength < 3 && length > 0) {
+      base64->carry[base64->carryLength++] = *data++;
+      length--;
+    }
+    if (base64->carryLength == 3 || last) {
+      encodeBase64NoAlloc(base64->carry, base64->carryLength, base64->encoded, &encodedLength, FALSE);
+      writeStreamedBytes(stream, socket, base64->encoded, encodedLength);
+      written += encodedLength;
+      base64->carryLength = 0;
+    }
+  }
+  int whole = last ? length : length - (length % 3);
+  if (whole > 0) {
+    encodeBase64NoAlloc(data, whole, base64->encoded, &encodedLength, FALSE);
+    writeStreamedBytes(stream, socket, base64->encoded, encodedLength);
+    written += encodedLength;
+  }
+  if (length > whole) {
+    memcpy(base64->carry + base64->carryLength, data + whole, length - whole);
+    base64->carryLength += length - whole;
+  }
+  return written;
+}
+
 /*
   * when encoding is ENCODING_SIMPLE then socket is mandatory
   * when encoding is ENCODING_CHUNKED then response is mandatory
@@ -4707,21 +7983,36 @@ static int streamTextForFile2(HttpResponse *response, Socket *socket, UnixFile *
   }
   switch (encoding){
   case ENCODING_CHUNKED:
+  case ENCODING_GZIP:
     if (!response) {
       zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "bad arguments: response must be not NULL to use chunked encoding\n");	
       return 8;
     }
-    stream = makeChunkedOutputStreamInternal(response);
+    stream = makeChunkedOutputStreamForFile(response, encoding);
     /* fallthrough */
   case ENCODING_SIMPLE: {
-    // To make bufferSize divisble by 3 for correct base64 encoding.
-    int bufferSize = FILE_STREAM_BUFFER_SIZE - (FILE_STREAM_BUFFER_SIZE % 3);
+    int bufferSize = FILE_STREAM_BUFFER_SIZE;
     char *buffer = safeMalloc(bufferSize+4, "streamTextBuffer");
     char *translation = safeMalloc((2*bufferSize)+4, "streamTextConvertBuffer"); /* UTF inflation tolerance */
-    int encodedLength;
+    StreamedBase64 base64Output;
+    StreamedBase64 *base64 = NULL;
+    if (asB64) {
+      memset(&base64Output, 0, sizeof(StreamedBase64));
+      base64Output.encodedSize = BASE64_ENCODE_SIZE(2*bufferSize+3)+1;
+      base64Output.encoded = safeMalloc(base64Output.encodedSize, "streamTextBase64Buffer");
+      base64 = &base64Output;
+    }
+    /* the stream converter carries split characters and shift state from one read to the next */
+    CharsetConverter *converter = NULL;
+    if (sourceCCSID != targetCCSID) {
+      int converterReason = 0;
+      converter = makeCharsetConverter(sourceCCSID, targetCCSID, &converterReason);
+    }
 
     while (!fileEOF(in)){
-      zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "WARNING: UTF8 might not be aligned properly: preserve 3 bytes for the next read cycle to fix UTF boundaries\n");
+      if (sourceCCSID != targetCCSID && converter == NULL) {
+        zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "WARNING: UTF8 might not be aligned properly: preserve 3 bytes for the next read cycle to fix UTF boundaries\n");
+      }
       int bytesRead = fileRead(in,buffer,bufferSize,&returnCode,&reasonCode);
       if (bytesRead <= 0) {
         zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG,
@@ -4729,48 +8020,59 @@ static int streamTextForFile2(HttpResponse *response, Socket *socket, UnixFile *
                 returnCode, reasonCode);
         break;
       }
-      unsigned int inLen, outLen;
-      int rc;
-      char *inPtr, *outPtr;
 
       if (sourceCCSID == targetCCSID) {
-        outPtr = buffer;
-        outLen = (unsigned int)bytesRead;
+        bytesSent += writeStreamedText(stream, socket, buffer, bytesRead, base64, FALSE);
+      } else if (converter != NULL) {
+        /* a chunk that inflates past the translation buffer takes more than one call */
+        int offset = 0;
+        int rc = 0;
+        do {
+          int consumed = 0;
+          int translationLength = 0;
+          int reasonCode = 0;
+          rc = charsetConverterConvert(converter, buffer+offset, bytesRead-offset, translation, 2*bufferSize,
+                                       &consumed, &translationLength, &reasonCode);
+          if (TRACE_CHARSET_CONVERSION){
+            printf("charsetConverterConvert consumed=%d transLen=%d\n",consumed,translationLength);
+            dumpbuffer(translation,translationLength);
+          }
+          offset += consumed;
+          bytesSent += writeStreamedText(stream, socket, translation, translationLength, base64, FALSE);
+          if (consumed == 0 && translationLength == 0) {
+            break;
+          }
+        } while (rc == CHARSET_SHORT_BUFFER && offset < bytesRead);
+        if (rc != 0 && rc != CHARSET_SHORT_BUFFER){
+          zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "iconv rc = %d, bytesRead=%d consumed=%d\n",rc,bytesRead,offset);
+        }
       } else {
-        inPtr = buffer;
-        outPtr = translation;
-        inLen = (unsigned int)bytesRead;
-        outLen = (unsigned int) 2 * bytesRead;
-
         /* TBD: I don't like this scheme.
          * As mentioned in the warning above, if the encodings are not single-byte encodings, either 
-           the input or output buffers could break in the middle of a multi-byte character. The current
-           API for convertCharset doesn't let you restart in such cases.
-         * Every call to convertCharset will (in the current implementation) use iconv_open to get
-           a converter. That's expensive.
+           the input or output buffers could break in the middle of a multi-byte character. The
+           convertCharset API doesn't let you restart in such cases.
          * If no conversion is necessary, Linuxland could use the sendfile(2) system call.
         */
-
-        /* dumpbuffer(buffer,bytesRead); */
+        char *outPtr = translation;
         int translationLength = 0;
         int reasonCode = 0;
-        rc = convertCharset(inPtr,
-                            inLen,
-                            sourceCCSID,
-                            CHARSET_OUTPUT_USE_BUFFER,
-                            &outPtr,
-                            outLen,
-                            targetCCSID,
-                            NULL,
-                            &translationLength,
-                            &reasonCode);
-
-        if (inLen != translationLength) {
+        int rc = convertCharset(buffer,
+                                bytesRead,
+                                sourceCCSID,
+                                CHARSET_OUTPUT_USE_BUFFER,
+                                &outPtr,
+                                2*bytesRead,
+                                targetCCSID,
+                                NULL,
+                                &translationLength,
+                                &reasonCode);
+
+        if (bytesRead != translationLength) {
           zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "streamTextForFile(%d (%s), %d (%s), %d, %d, %d, %d): "
                  "after sending %d bytes got translation length error; expected %d, got %d\n",
                  getSocketDebugID(socket), socket->debugName, 
                  in->fd, in->pathname,
-                 encoding, sourceCCSID, targetCCSID, asB64, bytesSent, inLen, translationLength);
+                 encoding, sourceCCSID, targetCCSID, asB64, bytesSent, bytesRead, translationLength);
         }
         if (TRACE_CHARSET_CONVERSION){
           printf("convertCharset transLen=%d\n",translationLength);
@@ -4779,30 +8081,24 @@ static int streamTextForFile2(HttpResponse *response, Socket *socket, UnixFile *
         if (rc != 0){
           zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "iconv rc = %d, bytesRead=%d xlateLength=%d\n",rc,bytesRead,translationLength);
         }
-
-        outPtr = translation;
-        outLen = (unsigned int) translationLength;
-      }
-      int allocSize = 0;
-      char *encodedBuffer = NULL;
-      if (asB64) {
-        if (outLen % 3) { 
-          zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "buffer length not divisble by 3.  Base64Encode will fail if this is not the eof.\n");
-        }
-        allocSize = ENCODE64_SIZE(outLen)+1;
-        encodedBuffer = encodeBase64(NULL, outPtr, outLen, &encodedLength, FALSE);
-        outPtr = encodedBuffer;
-        outLen = encodedLength;
+        bytesSent += writeStreamedText(stream, socket, translation, translationLength, base64, FALSE);
       }
-      if (encoding == ENCODING_CHUNKED) {
-        writeBytes(stream, outPtr, (int) outLen, NO_TRANSLATE);
-      } else {
-        writeFully(socket,outPtr,(int) outLen);
+    }
+    if (converter != NULL) {
+      int tailLength = 0;
+      int tailReason = 0;
+      int rc = charsetConverterFinish(converter, translation, 2*bufferSize, &tailLength, &tailReason);
+      if (rc != 0) {
+        zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "iconv rc = %d at end of stream, reason = %d\n", rc, tailReason);
       }
-      if (NULL != encodedBuffer) safeFree31(encodedBuffer, allocSize);
-      bytesSent += encodedLength;
+      bytesSent += writeStreamedText(stream, socket, translation, tailLength, base64, FALSE);
+      freeCharsetConverter(converter);
     }
-    if (encoding == ENCODING_CHUNKED) {
+    if (base64 != NULL) {
+      bytesSent += writeStreamedText(stream, socket, NULL, 0, base64, TRUE);
+      safeFree(base64->encoded, base64->encodedSize);
+    }
+    if (stream != NULL) {
       /* finish the chunked output here because finishResponse will not flush this stream's data */
       finishChunkedOutput(stream, NO_TRANSLATE);
     }
@@ -4810,9 +8106,6 @@ static int streamTextForFile2(HttpResponse *response, Socket *socket, UnixFile *
     safeFree(translation, (2*bufferSize)+4);
     break;
   }
-  case ENCODING_GZIP:
-    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG3, "HELP - not implemented\n");
-    break;
   }
   if (traceSocket > 0) {
     printf("streamTextForFile(%d (%s), %d (%s), %d, %d, %d, %d) sent %d bytes\n",
@@ -5309,12 +8602,28 @@ HttpService *makeWebSocketService(char *name, char *urlMask, WSEndpoint *endpoin
   return service;
 }
 
+/*
+  Serves the server's metrics, Prometheus text unless ?format=json or Accept asks for JSON.  It
+  authenticates like the server's other services; a scraper without credentials needs the caller
+  to set SERVICE_AUTH_NONE on purpose.
+ */
+HttpService *makeMetricsService(char *name, char *urlMask){
+  HttpService *service = (HttpService*)safeMalloc(sizeof(HttpService),"HttpService-Metrics");
+  memset(service,0,sizeof(HttpService));
+  service->name = name;
+  service->serviceType = SERVICE_TYPE_GENERATOR;
+  parseURLMask(service,urlMask);
+  service->authType = SERVICE_AUTH_NATIVE_WITH_SESSION_TOKEN;
+  service->serviceFunction = serveMetrics;
+  return service;
+}
+
 HttpService *makeProxyService(char *name, 
                               char *urlMask, 
                               int (*requestTransformer)(HttpConversation *conversation,
                                                         HttpRequest *inputRequest,
                                                         HttpRequest *outputRequest)){
-  HttpService *service = (HttpService*)safeMalloc(sizeof(HttpService),"HttpService-WebSocket");
+  HttpService *service = (HttpService*)safeMalloc(sizeof(HttpService),"HttpService-Proxy");
   service->name = name;
   service->serviceType = SERVICE_TYPE_PROXY;
   parseURLMask(service,urlMask);
@@ -5324,6 +8633,59 @@ HttpService *makeProxyService(char *name,
   return service;
 }
 
+HttpService *makeReverseProxyService(char *name,
+                                     char *urlMask,
+                                     char *host,
+                                     int port,
+                                     int (*requestTransformer)(HttpConversation *conversation,
+                                                               HttpRequest *inputRequest,
+                                                               HttpRequest *outputRequest)){
+  HttpClientSettings settings;
+  memset(&settings, 0, sizeof(HttpClientSettings));
+  settings.host = host;
+  settings.port = port;
+  settings.recvTimeoutSeconds = HTTP_PROXY_DEFAULT_TIMEOUT_SECONDS;
+  HttpClientContext *clientContext = NULL;
+  int status = httpClientContextInit(&settings, getLoggingContext(), &clientContext);
+  if (status != 0){
+    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_WARNING, "Proxy service %s cannot reach %s:%d, status=%d\n",
+            name, host, port, status);
+    return NULL;
+  }
+  HttpProxyUpstream *upstream = (HttpProxyUpstream*)safeMalloc(sizeof(HttpProxyUpstream),"HttpProxyUpstream");
+  memset(upstream, 0, sizeof(HttpProxyUpstream));
+  int hostHeaderSize = strlen(host) + 16;
+  upstream->hostHeader = safeMalloc(hostHeaderSize, "HttpProxyUpstream host");
+  snprintf(upstream->hostHeader, hostHeaderSize, "%s:%d", host, port);
+  upstream->clientContext = clientContext;
+#ifndef METTLE
+  mutexCreate(upstream->lock);
+#endif
+  upstream->maxActive = HTTP_PROXY_DEFAULT_MAX_ACTIVE;
+  httpClientContextSetPool(clientContext, HTTP_PROXY_DEFAULT_MAX_IDLE, HTTP_PROXY_DEFAULT_IDLE_SECONDS);
+
+  HttpService *service = makeProxyService(name, urlMask, requestTransformer);
+  service->proxyUpstream = upstream;
+#ifdef __ZOWE_OS_ZOS
+  /* upstream IO blocks, so keep it off the main task */
+  service->runInSubtask = TRUE;
+#endif
+  return service;
+}
+
+void proxyServiceSetLimits(HttpService *service, int maxActive, int maxIdle,
+                           int idleSeconds, int timeoutSeconds){
+  HttpProxyUpstream *upstream = service->proxyUpstream;
+  if (upstream == NULL){
+    return;
+  }
+  proxyLock(upstream);
+  upstream->maxActive = maxActive;
+  upstream->clientContext->recvTimeoutSeconds = timeoutSeconds;
+  proxyUnlock(upstream);
+  httpClientContextSetPool(upstream->clientContext, maxIdle, idleSeconds);
+}
+
 
 static WorkElementPrefix *makeCloseConversationWorkElement(HttpConversation *conversation) {
   WorkElementPrefix *prefix = (WorkElementPrefix*)safeMalloc31(sizeof(WorkElementPrefix)+sizeof(HttpWorkElement),"HttpWorkElement and Prefix");
@@ -5412,6 +8774,8 @@ static int httpTaskMain(RLETask *task){
                                       element->request,
                                       element->response);
   }
+  /* admitted by doHttpResponseWork whether or not it ran */
+  releaseServiceRequest(conversation->pendingService);
 
   safeFree31((char *)element, sizeof(HttpWorkElement));
   element = NULL;
@@ -5502,12 +8866,28 @@ static void upgradeToWebSocket(HttpConversation *conversation,
       negotiatedProtocol = chooseWSProtocol(response->slh,webSocketProtocol->nativeValue);
       addStringHeader(response,"Sec-WebSocket-Protocol",negotiatedProtocol);
     }
+#ifdef USE_ZLIB
+    struct WSDeflate_tag *deflateState = NULL;
+    HttpHeader *webSocketExtensions = getHeader(request,"Sec-WebSocket-Extensions");
+    int compressionLevel = conversation->server->config->compressionLevel;
+    if (webSocketExtensions != NULL && compressionLevel > 0){
+      char *agreedExtension = NULL;
+      deflateState = negotiateWSDeflate(response->slh,webSocketExtensions->nativeValue,
+                                        compressionLevel,&agreedExtension);
+      if (deflateState){
+        addStringHeader(response,"Sec-WebSocket-Extensions",agreedExtension);
+      }
+    }
+#endif
     /* parse URI sets up all the URI fragments in request */
     zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG3, "WS Upgrade parse UI\n");
     parseURI(request);
     conversation->wsSession = makeWSSession(conversation,
                                             service,
                                             negotiatedProtocol);
+#ifdef USE_ZLIB
+    conversation->wsSession->deflate = deflateState;
+#endif
     /* All we should need to write back is a header -
        client should not expect *ANY* body */
     writeHeader(response);
@@ -5568,6 +8948,9 @@ static void doHttpResponseWork(HttpConversation *conversation)
 
       conversation->requestCount++;
       conversation->isKeepAlive = firstRequest->keepAlive;
+      conversation->requestParseMicros = (conversation->requestStartMicros ?
+                                          getMetricsMicros() - conversation->requestStartMicros : 0);
+      conversation->requestStartMicros = 0;
 
       response = makeHttpResponse(firstRequest,parser->slh,conversation->socketExtension->socket);
       /* parse URI after request and response ready for work, have SLH's, etc */
@@ -5581,7 +8964,20 @@ static void doHttpResponseWork(HttpConversation *conversation)
 #endif
         header = header->next;
       }
-      HttpService *service = findHttpService(conversation->server,firstRequest);
+      HttpServer *server = conversation->server;
+      int retryAfter = takeClientToken(server,conversation->clientAddress,TRUE);
+      if (retryAfter > 0){
+        zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "doHttpResponseWork: client over its request rate. conversation=0x%p\n",conversation);
+        countRejectedRequest(server,NULL);
+        response->conversation = conversation;
+        conversation->workingOnResponse = TRUE;
+        respondWithRetryAfter(response,HTTP_STATUS_TOO_MANY_REQUESTS,"Too many requests",retryAfter);
+        if (!firstRequest->keepAlive) {
+          conversation->shouldClose = TRUE;
+        }
+        break;
+      }
+      HttpService *service = findHttpService(server,firstRequest);
       if (service){
         zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG3, "doHttpResponseWork serviceName=%s req->isWebSocket=%d\n",
                 service->name,firstRequest->isWebSocket);
@@ -5597,6 +8993,15 @@ static void doHttpResponseWork(HttpConversation *conversation)
           // Response is finished on return
           break;
         }
+        if (!admitServiceRequest(service)){
+          zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "doHttpResponseWork: service %s is at its in-flight limit\n",service->name);
+          countRejectedRequest(server,service);
+          respondWithRetryAfter(response,HTTP_STATUS_SERVICE_UNAVAILABLE,"Service busy",HTTP_OVERLOAD_RETRY_AFTER_SECONDS);
+          if (!firstRequest->keepAlive) {
+            conversation->shouldClose = TRUE;
+          }
+          break;
+        }
         if (service->runInSubtask){
           /* response->runningInSubtask = TRUE; */
           conversation->task = makeRLETask(conversation->server->base->rleAnchor,
@@ -5618,7 +9023,8 @@ static void doHttpResponseWork(HttpConversation *conversation)
           startHttpTask(conversation->task);
           break;
         }
-        handleHttpService(conversation->server,service,firstRequest,response);
+        handleHttpService(server,service,firstRequest,response);
+        releaseServiceRequest(service);
         break;
       }
       zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG3, "doHttpResponseWork:  no service found. conversation=0x%p\n",conversation);
@@ -5642,7 +9048,13 @@ static void doHttpReadWork(HttpConversation *conversation, int readBufferSize){
   HttpRequestParser *parser = conversation->parser;
   char *readBuffer = (conversation->readBuffer ? conversation->readBuffer : SLHAlloc(slh,readBufferSize));
 
+  int64 now = getMetricsMicros();
+  conversation->lastActivityMicros = now;
+  if (conversation->requestStartMicros == 0){
+    conversation->requestStartMicros = now;
+  }
   int bytesRead = socketRead(socket,readBuffer,readBufferSize,&returnCode,&reasonCode);
+  countBytesIn(conversation->server,bytesRead);
   if (bytesRead < 1) {
     zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "HTTP desiredBytes = %d bytesRead=%d, so a problem or no more available rc=0x%x, reason=0x%x. conversation=0x%p\n",
             readBufferSize,bytesRead,returnCode,reasonCode,conversation);
@@ -5665,6 +9077,7 @@ static void doHttpReadWork(HttpConversation *conversation, int readBufferSize){
   prefix->payloadLength = sizeof(HttpWorkElement);
   memset(workElement,0,sizeof(HttpWorkElement));
   workElement->conversation = conversation;
+  httpAtomicAdd(&conversation->server->metrics->queuedRequests,1);
   stcEnqueueWork(stcBase,prefix);
 }
 
@@ -5679,6 +9092,7 @@ static void doWSReadWork(HttpConversation *conversation, int readBufferSize){
   char *readBuffer = (conversation->readBuffer ? conversation->readBuffer : SLHAlloc(slh,readBufferSize));
 
   int bytesRead = socketRead(socket,readBuffer,readBufferSize,&returnCode,&reasonCode);
+  countBytesIn(conversation->server,bytesRead);
   if (bytesRead < 1){
     zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "WS desiredBytes = %d bytesRead=%d, so a problem or no more available rc=0x%x, reason=0x%x, conversation=0x%p\n",
             readBufferSize,bytesRead,returnCode,reasonCode,conversation);
@@ -5825,6 +9239,22 @@ static int httpHandleTCP(STCBase *base,
       }
 #endif // USE_ZOWE_TLS
       HttpServer *server = (HttpServer*) module->data;
+      int maxConnections = server->config->maxConnections;
+      if (maxConnections > 0 && server->metrics->activeConnections >= maxConnections){
+        zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG,
+                "httpserver: refusing connection, %d of %d open\n",server->metrics->activeConnections,maxConnections);
+        countRefusedConnection(server);
+        refuseConnection(peerSocket,HTTP_STATUS_SERVICE_UNAVAILABLE,"Service Unavailable",HTTP_OVERLOAD_RETRY_AFTER_SECONDS);
+        break;
+      }
+      int64 clientAddress = getClientAddress(server,peerSocket);
+      int retryAfter = takeClientToken(server,clientAddress,FALSE);
+      if (retryAfter > 0){
+        zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "httpserver: refusing connection from a client over its request rate\n");
+        countRefusedConnection(server);
+        refuseConnection(peerSocket,HTTP_STATUS_TOO_MANY_REQUESTS,"Too Many Requests",retryAfter);
+        break;
+      }
       unsigned int maxBlocks = server->config->httpRequestHeapMaxBlocks;
       ShortLivedHeap *slh = makeShortLivedHeap(READ_BUFFER_SIZE, maxBlocks);
   #ifndef __ZOWE_OS_WINDOWS
@@ -5844,7 +9274,8 @@ static int httpHandleTCP(STCBase *base,
                                                            NULL,
                                                            READ_BUFFER_SIZE);
       peerSocket->userData = peerExtension;
-      HttpConversation *httpConversation = makeHttpConversation(peerExtension,(HttpServer*)(module->data));
+      HttpConversation *httpConversation = makeHttpConversation(peerExtension,server);
+      httpConversation->clientAddress = clientAddress;
       stcRegisterSocketExtension(base, peerExtension, STC_MODULE_JEDHTTP);
 
       break; /* end server socket processing */
@@ -6158,6 +9589,7 @@ int httpWorkElementHandler(STCBase *base,
         fflush(stdout);
       }
       stcReleaseSocketExtension(base, sext);
+      httpAtomicAdd(&conversation->server->metrics->activeConnections, -1);
 
       /* clean up the non-SLH conversation contents */
       if (conversation->wsSession) {
@@ -6166,6 +9598,8 @@ int httpWorkElementHandler(STCBase *base,
           fflush(stdout);
         }
         WSSession *wss = conversation->wsSession;
+        leaveAllWSGroups(conversation->server, wss);
+        httpAtomicAdd(&conversation->server->metrics->activeWebSockets, -1);
         if (wss->readMachine) {
           if (traceHttpCloseConversation) {
             printf("WSReadMachine cleanup...\n");
@@ -6189,6 +9623,11 @@ int httpWorkElementHandler(STCBase *base,
           }
           safeFree((char*)wss->negotiatedProtocol, 1 + strlen(wss->negotiatedProtocol));
         }
+#ifdef USE_ZLIB
+        if (wss->deflate) {
+          freeWSDeflate(wss->deflate);
+        }
+#endif
         safeFree((char*)wss, sizeof(WSSession));
       } /* end wsSession cleanup */
       /* the HttpRequestParser was allocated on the (sext's) SLH */
@@ -6237,6 +9676,7 @@ int httpWorkElementHandler(STCBase *base,
   case HTTP_START_RESPONSE:
     {
       HttpWorkElement *workElement = (HttpWorkElement*)((char*)prefix + sizeof(WorkElementPrefix));
+      httpAtomicAdd(&workElement->conversation->server->metrics->queuedRequests,-1);
       doHttpResponseWork(workElement->conversation);
     }
     break;
@@ -6291,12 +9731,25 @@ int httpWorkElementHandler(STCBase *base,
       }
       zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG3, "HTTP_WS_OUTPUT: writing 0x%x bytes, dumping=0x%x\n",
               workElement->bufferLength,dumpLength);
-      dumpbufferA(workElement->buffer,dumpLength);
-      fflush(stdout);
-      writeFully(socketExtension->socket,workElement->buffer,workElement->bufferLength);
-      if (workElement->reclaimAfterWrite){
-        safeFree31(workElement->buffer,workElement->bufferLength);
+      /* the shared frame may be freed by the release below, so its length is taken first */
+      int bytesWritten = workElement->bufferLength;
+      if (workElement->sharedFrame){
+        /* a group broadcast, the frame is shared with the other members */
+        bytesWritten = workElement->sharedFrame->length;
+        writeFully(socketExtension->socket,workElement->sharedFrame->data,bytesWritten);
+        releaseWSSharedFrame(workElement->sharedFrame);
+      } else{
+        dumpbufferA(workElement->buffer,dumpLength);
+        fflush(stdout);
+        writeFully(socketExtension->socket,workElement->buffer,workElement->bufferLength);
+        if (workElement->reclaimAfterWrite){
+          safeFree31(workElement->buffer,workElement->bufferLength);
+        }
+      }
+      if (conversation->wsSession){
+        httpAtomicAdd(&conversation->wsSession->pendingOutputFrames,-1);
       }
+      httpAtomicAdd64(&conversation->server->metrics->bytesOut,bytesWritten);
           
       /* after sending a close response, close is ok */
       if (prefix->payloadCode == HTTP_WS_CLOSE_HANDSHAKE){
@@ -6319,6 +9772,74 @@ int httpWorkElementHandler(STCBase *base,
   return status;
 }
 
+#define HTTP_SWEEP_INTERVAL_MICROS 1000000LL
+
+/*
+  Closes conversations that have waited for a request longer than the SocketSet's idle limit, and
+  answers 408 to those that started a request and have not finished sending it in time: the
+  headers must be complete within the request limit, and after that the body may take as long as
+  it needs so long as no gap between reads is longer than the limit.  This
+  runs on the main task between selects, so no read is in progress on these sockets.  WebSocket
+  sessions and conversations with a response or subtask under way are left alone.
+ */
+static void sweepHttpConversations(STCBase *base, HttpServer *server){
+  HttpAdmission *admission = server->admission;
+  int64 now = getMetricsMicros();
+  if (admission == NULL || now - admission->lastSweepMicros < HTTP_SWEEP_INTERVAL_MICROS){
+    return;
+  }
+  admission->lastSweepMicros = now;
+  if (server->config->clientRequestRate > 0){
+    sweepClientBuckets(server,now);
+  }
+
+  SocketSet *socketSet = base->socketSet;
+  int64 idleLimit = ((int64)socketSet->idleTimeLimit) * 1000000;
+  int64 requestLimit = ((int64)server->config->requestTimeoutSeconds) * 1000000;
+  if (idleLimit == 0 && requestLimit == 0){
+    return;
+  }
+#ifdef __ZOWE_OS_WINDOWS
+  int socketCount = socketSet->socketCount;
+#else
+  int socketCount = socketSet->highestAllowedSD + 1;
+#endif
+  for (int i = 0; i < socketCount; i++){
+    Socket *socket = socketSet->sockets[i];
+    SocketExtension *extension = (socket ? (SocketExtension*)socket->userData : NULL);
+    if (extension == NULL || extension->moduleID != STC_MODULE_JEDHTTP ||
+        extension->isServerSocket || IS_SYNTHETIC_PIPE(socket->protocol)){
+      continue;
+    }
+    HttpConversation *conversation = (HttpConversation*)extension->protocolHandler;
+    if (conversation == NULL || conversation->server != server || conversation->wsSession ||
+        conversation->workingOnResponse || conversation->runningTasks || conversation->shouldClose){
+      continue;
+    }
+    /* a large upload is fine as long as it keeps coming */
+    HttpRequestParser *parser = conversation->parser;
+    int readingBody = (parser != NULL && parser->state >= HTTP_STATE_READING_FIXED_BODY);
+    int64 requestWait = now - (readingBody ? conversation->lastActivityMicros : conversation->requestStartMicros);
+    int requestTimedOut = (requestLimit > 0 && conversation->requestStartMicros != 0 &&
+                           requestWait > requestLimit);
+    int idleTimedOut = (idleLimit > 0 && conversation->requestStartMicros == 0 &&
+                        now - conversation->lastActivityMicros > idleLimit);
+    if (!requestTimedOut && !idleTimedOut){
+      continue;
+    }
+    zowelog(NULL, LOG_COMP_HTTPSERVER, ZOWE_LOG_DEBUG, "httpserver: closing %s conversation 0x%p\n",
+            (requestTimedOut ? "slow" : "idle"),conversation);
+    if (requestTimedOut){
+      writeClosingResponse(socket,HTTP_STATUS_REQUEST_TIMEOUT,"Request Timeout",0);
+    }
+    httpAtomicAdd64(&server->metrics->connectionsTimedOut,1);
+    /* as handlePeerSocketRead does for a conversation marked to close */
+    conversation->shouldClose = TRUE;
+    stcReleaseSocketExtension(base,extension);
+    serializeConsiderCloseEnqueue(conversation,FALSE);
+  }
+}
+
 int httpBackgroundHandler(STCBase *base, STCModule *module, int selectStatus) {
   if (httpServerIOTrace){
 #ifdef __ZOWE_OS_ZOS
@@ -6335,6 +9856,7 @@ int httpBackgroundHandler(STCBase *base, STCModule *module, int selectStatus) {
       fflush(stdout);
     }
   }
+  sweepHttpConversations(base,(HttpServer*)module->data);
   return 0;
 }
 
@@ -10,6 +10,9 @@
   Copyright Contributors to the Zowe Project.
 */
 
+/* this file defines zowelog and zowedump, which the compiled level must not turn into macros */
+#define LOGGING_NO_COMPILED_LEVEL 1
+
 #ifdef METTLE
 #include <metal/metal.h>
 #include <metal/stddef.h>
@@ -26,6 +29,15 @@
 #include <string.h>
 #include <stdarg.h>
 #include <sys/stat.h>
+#include <time.h>
+#ifdef __ZOWE_OS_WINDOWS
+#include <stdatomic.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/time.h>
+#endif
 
 #endif
 
@@ -36,6 +48,13 @@
 #include "utils.h"
 #include "logging.h"
 #include "printables_for_dump.h"
+#ifndef METTLE
+#include "openprims.h"
+#include "json.h"
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+#endif
 
 #ifdef __ZOWE_OS_ZOS
 #include "le.h"
@@ -155,6 +174,134 @@ static void *logHTPut(LoggingHashTable *ht, int64 key, void *value) {
 #define LOG_DEFAULT_COMPONENT_COUNT 128
 #define LOG_VENDOR_HT_BACKBONE_SIZE 127
 
+/*
+  What the library keeps about components that is not in their public struct, in a table keyed
+  by the struct's address.  Components are configured while other threads log, so the table and
+  the paths are only touched under the side data's lock.  A LoggingComponentData stays where it
+  is until the context goes, so a record may use its rate limit without holding the lock.
+ */
+#define LOG_COMPONENT_PATH_MAX 256
+
+typedef struct LoggingComponentData_tag {
+  char eyecatcher[8];   /* RSLOGCDT */
+  char *path;           /* dotted names from the top of the tree, resolved by logConfigureComponent */
+  struct LogRateLimit_tag *rateLimit;  /* set by logSetComponentRateLimit */
+} LoggingComponentData;
+
+typedef struct LoggingSideData_tag {
+  char eyecatcher[8];     /* RSLOGSDT */
+  hashtable *components;  /* LoggingComponent * -> LoggingComponentData */
+#ifndef METTLE
+  Mutex lock;
+#endif
+} LoggingSideData;
+
+#ifndef METTLE
+#define sideDataLock(c) mutexLock((c)->sideData->lock)
+#define sideDataUnlock(c) mutexUnlock((c)->sideData->lock)
+#else
+#define sideDataLock(c)
+#define sideDataUnlock(c)
+#endif
+
+/* like LogHandler, but for destinations that record the level and the fields of a record;
+   level is ZOWE_LOG_NA for text that did not come through zowelog, such as dump lines */
+typedef void (*LogRecordHandler)(struct LoggingContext_tag *context,
+                                 LoggingComponent *component,
+                                 void *data,
+                                 int level,
+                                 LogField *fields,
+                                 int fieldCount,
+                                 char *formatString,
+                                 va_list argList);
+
+/* called with the side data's lock held */
+static LoggingComponentData *getComponentDataLocked(LoggingContext *context, LoggingComponent *component,
+                                                    bool create) {
+  LoggingComponentData *data = htGet(context->sideData->components, component);
+  if (data == NULL && create) {
+    data = (LoggingComponentData *)safeMalloc(sizeof(LoggingComponentData), "LoggingComponentData");
+    memset(data, 0, sizeof(LoggingComponentData));
+    memcpy(data->eyecatcher, "RSLOGCDT", sizeof(data->eyecatcher));
+    htPut(context->sideData->components, component, data);
+  }
+  return data;
+}
+
+static LoggingComponentData *getComponentData(LoggingContext *context, LoggingComponent *component, bool create) {
+  sideDataLock(context);
+  LoggingComponentData *data = getComponentDataLocked(context, component, create);
+  sideDataUnlock(context);
+  return data;
+}
+
+/* copies the component's path to a buffer of LOG_COMPONENT_PATH_MAX, returns FALSE if it has none */
+static bool copyComponentPath(LoggingContext *context, LoggingComponent *component, char *path) {
+  sideDataLock(context);
+  LoggingComponentData *data = getComponentDataLocked(context, component, FALSE);
+  bool found = (data != NULL && data->path != NULL);
+  if (found) {
+    strcpy(path, data->path);
+  }
+  sideDataUnlock(context);
+  return found;
+}
+
+#ifndef METTLE
+static void freeRateLimit(struct LogRateLimit_tag *limit);
+#endif
+
+static void freeComponentDataVisitor(void *userData, void *key, void *value) {
+  LoggingComponentData *data = value;
+  if (data->path != NULL) {
+    safeFree(data->path, strlen(data->path) + 1);
+  }
+#ifndef METTLE
+  if (data->rateLimit != NULL) {
+    freeRateLimit(data->rateLimit);
+  }
+#endif
+  safeFree((char *)data, sizeof(LoggingComponentData));
+}
+
+#ifndef METTLE
+static void printJson(LoggingContext *context, LoggingComponent *component, void *data,
+                      char *formatString, va_list argList);
+static void printJsonRecord(LoggingContext *context, LoggingComponent *component, void *data,
+                            int level, LogField *fields, int fieldCount,
+                            char *formatString, va_list argList);
+#endif
+
+/*
+  Destinations that take whole records are the library's own, and are known by the LogHandler
+  they are configured with, so finding the record handler needs nothing that can change under
+  a record.
+ */
+static LogRecordHandler getRecordHandler(LoggingDestination *destination) {
+#ifndef METTLE
+  if (destination->handler == printJson) {
+    return printJsonRecord;
+  }
+#endif
+  return NULL;
+}
+
+/* a grown table moves its components, and what is kept about them has to follow */
+static void moveComponentData(LoggingContext *context, LoggingComponentTable *from, LoggingComponentTable *to) {
+  hashtable *components = context->sideData->components;
+  sideDataLock(context);
+  for (int i = 0; i < from->componentCount; i++) {
+    LoggingComponentData *data = htGet(components, &from->components[i]);
+    if (data != NULL) {
+      htRemove(components, &from->components[i]);
+      htPut(components, &to->components[i], data);
+    }
+  }
+  sideDataUnlock(context);
+}
+
+static void refreshEffectiveLevels(LoggingContext *context);
+
 static LoggingComponentTable *makeComponentTable(int componentCount) {
 
   int tableSize = sizeof(LoggingComponentTable) + componentCount * sizeof(LoggingComponent);
@@ -166,7 +313,8 @@ static LoggingComponentTable *makeComponentTable(int componentCount) {
   return table;
 }
 
-static LoggingComponentTable *reallocComponentTable(LoggingComponentTable *existingTable, int newComponentCount) {
+static LoggingComponentTable *reallocComponentTable(LoggingContext *context, LoggingComponentTable *existingTable,
+                                                    int newComponentCount) {
 
   if (existingTable != NULL && newComponentCount <= existingTable->componentCount) {
     return existingTable;
@@ -178,6 +326,7 @@ static LoggingComponentTable *reallocComponentTable(LoggingComponentTable *exist
     int existingTableSize = sizeof(LoggingComponentTable) + existingTable->componentCount * sizeof(LoggingComponent);
     memcpy(newTable, existingTable, existingTableSize);
     newTable->componentCount = newComponentCount;
+    moveComponentData(context, existingTable, newTable);
     safeFree((char *)existingTable, existingTableSize);
     existingTable = NULL;
   }
@@ -258,6 +407,15 @@ LoggingContext *makeLocalLoggingContext() {
   memcpy(context->eyecatcher, "RSLOGCTX", sizeof(context->eyecatcher));
   context->vendorTable = htCreate(LOG_VENDOR_HT_BACKBONE_SIZE, NULL, NULL, NULL, NULL);
   context->zoweAnchor = makeZoweAnchor();
+  LoggingSideData *sideData = (LoggingSideData *)safeMalloc(sizeof(LoggingSideData), "LoggingSideData");
+  memset(sideData, 0, sizeof(LoggingSideData));
+  memcpy(sideData->eyecatcher, "RSLOGSDT", sizeof(sideData->eyecatcher));
+  sideData->components = htCreate(LOG_VENDOR_HT_BACKBONE_SIZE, NULL, NULL, NULL, NULL);
+#ifndef METTLE
+  mutexCreate(sideData->lock);
+#endif
+  context->sideData = sideData;
+  refreshEffectiveLevels(context);
 
   return context;
 }
@@ -290,6 +448,11 @@ static void cleanVendorInHT(void *userData, void *vendor) {
 
 void removeLocalLoggingContext(LoggingContext *context) {
 
+  /* first, so that the rate limit reporter lets go of the context before the components go */
+  htMap2(context->sideData->components, freeComponentDataVisitor, NULL);
+  htDestroy(context->sideData->components);
+  safeFree((char *)context->sideData, sizeof(LoggingSideData));
+  context->sideData = NULL;
   htPrune(context->vendorTable, matchAll, cleanVendorInHT, NULL);
   htDestroy(context->vendorTable);
   context->vendorTable = NULL;
@@ -313,40 +476,72 @@ static void lastResortLog(char *s){
 }
 
 /* default dumper, based on dumpBufferToStream from utils.c */
-static char *standardDumperFunction(char *workBuffer, int workBufferSize,
-                                    void *data, int dataSize, int lineNumber){
+/*
+  Dump lines look like
+
+    00000020  00010203 04050607 08090A0B 0C0D0E0F  10111213 14151617 18191A1B 1C1D1E1F |................................|
+
+  and are filled in from constant tables: the column of every byte's hex digits and the
+  printable character of every byte value.
+ */
+
+#define DUMP_BYTES_PER_LINE   32
+#define DUMP_PRINTABLE_COLUMN 82
+#define DUMP_LINE_MAX         (DUMP_PRINTABLE_COLUMN + 2 + DUMP_BYTES_PER_LINE + 2)  /* with '|' and newline */
+
+static const char dumpHexDigits[16] = {
+  '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
+};
 
-  int formatWidth = 32;
-  int index = lineNumber * formatWidth;
-  int length = dataSize;
-  int lastIndex = length - 1;
-  const unsigned char *tranlationTable = printableEBCDIC;
+static const unsigned char dumpHexColumns[DUMP_BYTES_PER_LINE] = {
+  10, 12, 14, 16,  19, 21, 23, 25,  28, 30, 32, 34,  37, 39, 41, 43,
+  47, 49, 51, 53,  56, 58, 60, 62,  65, 67, 69, 71,  74, 76, 78, 80
+};
+
+/* formats the line for data[index], without a newline or terminator, returning its length */
+static int formatDumpLine(char *line, const unsigned char *data, int dataSize, int index){
+  const unsigned char *translationTable = printableEBCDIC;
   /* TODO should ASCII be default on non-z/OS systems? */
+  const unsigned char *bytes = data + index;
+  int count = dataSize - index < DUMP_BYTES_PER_LINE ? dataSize - index : DUMP_BYTES_PER_LINE;
 
-  if (index <= lastIndex){
-    int pos;
-    int linePos = 0;
-    linePos = hexFill(workBuffer, linePos, 0, 8, 2, index);
-    for (pos = 0; pos < 32; pos++){
-      if (((index + pos) % 4 == 0) && ((index + pos) % 32 != 0)){
-        if ((index + pos) % 16 == 0){
-          workBuffer[linePos++] = ' ';
-        }
-        workBuffer[linePos++] = ' ';
-      }
-      if ((index + pos) < length){
-        linePos = hexFill(workBuffer, linePos, 0, 2, 0, (0xFF & ((char *) data)[index + pos]));
-      } else {
-        linePos += sprintf(workBuffer + linePos, "  ");
-      }
-    }
-    linePos += sprintf(workBuffer + linePos, " |");
-    for (pos = 0; pos < 32 && (index + pos) < length; pos++){
-      int ch = tranlationTable[0xFF & ((char *) data)[index + pos]];
-      workBuffer[linePos++] = ch;
-    }
-    workBuffer[linePos++] = '|';
-    workBuffer[linePos++] = 0;
+  memset(line, ' ', DUMP_PRINTABLE_COLUMN + 1);
+  for (int i = 0, shift = 28; i < 8; i++, shift -= 4) {
+    line[i] = dumpHexDigits[(index >> shift) & 0xF];
+  }
+  for (int pos = 0; pos < count; pos++) {
+    char *hex = line + dumpHexColumns[pos];
+    hex[0] = dumpHexDigits[bytes[pos] >> 4];
+    hex[1] = dumpHexDigits[bytes[pos] & 0xF];
+  }
+  char *printable = line + DUMP_PRINTABLE_COLUMN + 1;
+  *printable++ = '|';
+  for (int pos = 0; pos < count; pos++) {
+    printable[pos] = translationTable[bytes[pos]];
+  }
+  printable[count] = '|';
+  return DUMP_PRINTABLE_COLUMN + 2 + count + 1;
+}
+
+/* formats as many whole lines as fit, advancing *index, and returns the length */
+static int formatDumpBlock(char *buffer, int bufferSize, const unsigned char *data, int dataSize, int *index){
+  int length = 0;
+  while (*index < dataSize && length + DUMP_LINE_MAX + 1 <= bufferSize) {
+    length += formatDumpLine(buffer + length, data, dataSize, *index);
+    buffer[length++] = '\n';
+    *index += DUMP_BYTES_PER_LINE;
+  }
+  buffer[length] = 0;
+  return length;
+}
+
+static char *standardDumperFunction(char *workBuffer, int workBufferSize,
+                                    void *data, int dataSize, int lineNumber){
+
+  int index = lineNumber * DUMP_BYTES_PER_LINE;
+  if (index < dataSize && workBufferSize > DUMP_LINE_MAX){
+    int length = formatDumpLine(workBuffer, (const unsigned char *)data, dataSize, index);
+    workBuffer[length] = 0;
     return workBuffer;
   }
 
@@ -482,6 +677,100 @@ void logConfigureStandardDestinations(LoggingContext *context){
   logConfigureDestination(context,LOG_DEST_PRINTF_STDERR,"printf(stderr)",NULL,printStderr);
 }
 
+static void appendComponentPath(char *path, int *pathLength, char *name) {
+  if (name == NULL || name[0] == 0) {
+    return;
+  }
+  int length = *pathLength;
+  int nameLength = strlen(name);
+  if (length + nameLength + 2 > LOG_COMPONENT_PATH_MAX) {
+    return;
+  }
+  if (length > 0) {
+    path[length++] = '.';
+  }
+  memcpy(path + length, name, nameLength + 1);
+  *pathLength = length + nameLength;
+}
+
+/* path holds the names of the component's ancestors, the component's own name goes last */
+static void setComponentPath(LoggingContext *context, LoggingComponent *component, uint64 compID,
+                             char *compName, char *path, int pathLength) {
+  appendComponentPath(path, &pathLength, compName);
+  if (pathLength == 0) {
+    pathLength = sprintf(path, "%016llX", (unsigned long long)compID);
+  }
+  char *newPath = safeMalloc(pathLength + 1, "LoggingComponentPath");
+  memcpy(newPath, path, pathLength + 1);
+  sideDataLock(context);
+  LoggingComponentData *data = getComponentDataLocked(context, component, TRUE);
+  char *oldPath = data->path;
+  data->path = newPath;
+  sideDataUnlock(context);
+  if (oldPath != NULL) {
+    safeFree(oldPath, strlen(oldPath) + 1);
+  }
+}
+
+/* the cache has three bits, which is room for every level up to ZOWE_LOG_DEBUG3 */
+static void setEffectiveLevel(LoggingComponent *component, int level) {
+  int cached = level < 0 ? 0 : (level > 7 ? 7 : level);
+  component->flags = (component->flags & ~LOG_COMP_LEVEL_MASK) |
+                     LOG_COMP_FLAG_LEVEL_KNOWN | (cached << LOG_COMP_LEVEL_SHIFT);
+}
+
+static int getEffectiveLevel(LoggingComponent *component) {
+  return (component->flags & LOG_COMP_LEVEL_MASK) >> LOG_COMP_LEVEL_SHIFT;
+}
+
+static void refreshZoweLevels(LoggingComponent *component, int depth, int inheritedLevel, int *maxLevel) {
+  int level = component->currentDetailLevel > inheritedLevel ? component->currentDetailLevel : inheritedLevel;
+  setEffectiveLevel(component, level);
+  if (level > *maxLevel) {
+    *maxLevel = level;
+  }
+  LoggingComponentTable *componentTable = component->subcomponents;
+  if (componentTable != NULL && depth < 3) {
+    for (int i = 0; i < componentTable->componentCount; i++) {
+      refreshZoweLevels(&componentTable->components[i], depth + 1, level, maxLevel);
+    }
+  }
+}
+
+static void refreshVendorLevels(LoggingComponent *component, int depth, int inheritedLevel, int *maxLevel) {
+  int level = component->currentDetailLevel > inheritedLevel ? component->currentDetailLevel : inheritedLevel;
+  setEffectiveLevel(component, level);
+  if (level > *maxLevel) {
+    *maxLevel = level;
+  }
+  LoggingHashTable *componentTable = component->subcomponents;
+  if (componentTable != NULL && depth < 3) {
+    for (int i = 0; i < componentTable->backboneSize; i++) {
+      for (LoggingHashEntry *entry = componentTable->backbone[i]; entry != NULL; entry = entry->next) {
+        refreshVendorLevels((LoggingComponent *)entry->value, depth + 1, level, maxLevel);
+      }
+    }
+  }
+}
+
+static void refreshVendorLevelsVisitor(void *userData, void *key, void *value) {
+  refreshVendorLevels(&((LoggingVendor *)value)->topLevelComponent, 0, ZOWE_LOG_SEVERE, (int *)userData);
+}
+
+/*
+  Recomputes the cached effective level of every component and the maximum over all of them,
+  which logShouldTrace relies on.  Both are kept in the flags of the components and in the spare
+  field of the anchor's table, so that the struct layouts stay as they were.  Levels change
+  rarely, so this favors a simple full walk.
+ */
+static void refreshEffectiveLevels(LoggingContext *context) {
+  int maxLevel = ZOWE_LOG_SEVERE;
+  refreshZoweLevels(&context->zoweAnchor->topLevelComponent, 0, ZOWE_LOG_SEVERE, &maxLevel);
+  htMap2(context->vendorTable, refreshVendorLevelsVisitor, &maxLevel);
+  maxLevel = maxLevel < 0 ? 0 : (maxLevel > 7 ? 7 : maxLevel);
+  context->zoweAnchor->topLevelComponentTable.maxLevel = LOG_MAX_LEVEL_KNOWN | maxLevel;
+}
+
 void logConfigureComponent(LoggingContext *context, uint64 compID, char *compName, int destination, int level){
 
   if (context == NULL) {
@@ -498,10 +787,15 @@ void logConfigureComponent(LoggingContext *context, uint64 compID, char *compNam
     LoggingComponent *component = &ranchor->topLevelComponent;
     LoggingComponentTable **componentTableHandle = (LoggingComponentTable **)&component->subcomponents;
     LoggingComponentTable *componentTable = component->subcomponents;
+    char path[LOG_COMPONENT_PATH_MAX] = {0};
+    int pathLength = 0;
 
     for (int i = 1; id[i] != 0 && i < 4; i++) {
+      if (i > 1) {
+        appendComponentPath(path, &pathLength, component->name);
+      }
       if (componentTable == NULL || componentTable->componentCount <= id[i]) {
-        componentTable = reallocComponentTable(componentTable, min(id[i] * 2 + 1, 0xFFFF));
+        componentTable = reallocComponentTable(context, componentTable, min(id[i] * 2 + 1, 0xFFFF));
         *componentTableHandle = componentTable;
       }
       component = &componentTable->components[id[i]];
@@ -513,6 +807,7 @@ void logConfigureComponent(LoggingContext *context, uint64 compID, char *compNam
     component->currentDetailLevel = level;
     component->destination = destination;
     component->name = compName;
+    setComponentPath(context, component, compID, compName, path, pathLength);
 
   } else {
 
@@ -525,8 +820,13 @@ void logConfigureComponent(LoggingContext *context, uint64 compID, char *compNam
     LoggingComponent *component = &vendor->topLevelComponent;
     LoggingHashTable **componentTableHandle = (LoggingHashTable **)&component->subcomponents;
     LoggingHashTable *componentTable = component->subcomponents;
+    char path[LOG_COMPONENT_PATH_MAX] = {0};
+    int pathLength = 0;
 
     for (int i = 1; id[i] != 0 && i < 4; i++) {
+      if (i > 1) {
+        appendComponentPath(path, &pathLength, component->name);
+      }
       LoggingComponent localLoggingComponent;
       memset(&localLoggingComponent, 0, sizeof(LoggingComponent));
       if (componentTable == NULL) {
@@ -545,9 +845,12 @@ void logConfigureComponent(LoggingContext *context, uint64 compID, char *compNam
     component->currentDetailLevel = level;
     component->destination = destination;
     component->name = compName;
+    setComponentPath(context, component, compID, compName, path, pathLength);
 
   }
 
+  refreshEffectiveLevels(context);
+
 }
 
 static LoggingDestination *getDestinationTable(LoggingContext *context, uint64 compID){
@@ -635,6 +938,7 @@ void logSetLevel(LoggingContext *context, uint64 compID, int level){
   LoggingComponent *component = getComponent(context, compID, NULL);
   if (component != NULL) {
     component->currentDetailLevel = level;
+    refreshEffectiveLevels(context);
   }
 
 }
@@ -649,11 +953,261 @@ int logGetLevel(LoggingContext *context, uint64 compID){
   return component ? component->currentDetailLevel : ZOWE_LOG_NA;
 }
 
-void zowelog(LoggingContext *context, uint64 compID, int level, char *formatString, ...){
+static void printToDestination(LoggingDestination *destination,
+                               struct LoggingContext_tag *context,
+                               LoggingComponent *component,
+                               void *data, char *formatString, ...){
+  va_list argPointer;
+  va_start(argPointer, formatString);
+  destination->handler(context,component,destination->data,formatString,argPointer);
+  va_end(argPointer);
+}
 
-  if (logShouldTrace(context, compID, level) == FALSE) {
-    return;
+#ifndef METTLE
+
+/*
+  Rate limits.
+
+  A component can be given a token bucket, ratePerSecond records with bursts of up to burst,
+  and 1-in-N sampling in front of it.  Records that are sampled out or find the bucket empty
+  are only counted, before anything is formatted, so a failure storm costs a lock and a compare
+  per call.  A reporter thread, started with the first limit, sends the count in a summary record
+  every LOG_RATE_REPORT_SECONDS while there is one, so the summary does not wait for the next
+  record of the component.  If the thread cannot be started, that next record reports it.
+
+  The limit hangs off the component's side data, and the reporter finds the component again by
+  its ID, because components move when their table grows.
+ */
+
+#define LOG_RATE_REPORT_SECONDS 10
+#define LOG_RATE_TICK_MILLIS    1000
+
+#define LOG_RATE_REPORTER_NONE    0
+#define LOG_RATE_REPORTER_RUNNING 1
+#define LOG_RATE_REPORTER_FAILED  2
+
+typedef struct LogRateLimit_tag{
+  char eyecatcher[8];           /* RSLOGRTL */
+  Mutex lock;
+  LoggingContext *context;
+  uint64 compID;
+  int ratePerSecond;
+  int burst;
+  int sampleEvery;
+  int64 tokens;                 /* in millionths of a record */
+  uint64 refilledAt;            /* micros */
+  unsigned int seen;
+  unsigned int suppressed;
+  uint64 reportedAt;            /* micros */
+  struct LogRateLimit_tag *next;
+} LogRateLimit;
+
+static LogRateLimit *rateLimits = NULL;      /* what the reporter walks, under rateLimitsLock */
+static Mutex rateLimitsLock;
+static int rateReporterState = LOG_RATE_REPORTER_NONE;
+static OSThread rateReporter;
+
+static void logAsyncSleep(int millis);
+
+static uint64 logClockMicros(){
+#ifdef __ZOWE_OS_WINDOWS
+  LARGE_INTEGER counter;
+  LARGE_INTEGER frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return ((uint64)(counter.QuadPart / frequency.QuadPart)) * 1000000 +
+         ((uint64)(counter.QuadPart % frequency.QuadPart)) * 1000000 / frequency.QuadPart;
+#else
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return ((uint64)now.tv_sec) * 1000000 + now.tv_usec;
+#endif
+}
+
+/* called with the limit's lock held */
+static unsigned int takeSuppressedCount(LogRateLimit *limit, uint64 now){
+  unsigned int suppressed = 0;
+  if (limit->suppressed > 0 && now - limit->reportedAt >= ((uint64)LOG_RATE_REPORT_SECONDS) * 1000000) {
+    suppressed = limit->suppressed;
+    limit->suppressed = 0;
+    limit->reportedAt = now;
   }
+  return suppressed;
+}
+
+/* decides whether a record may pass, and hands out the suppressed count when it is due and
+   there is no reporter to do it */
+static bool admitRateLimitedRecord(LogRateLimit *limit, unsigned int *suppressedToReport){
+  bool admitted = TRUE;
+  uint64 now = logClockMicros();
+
+  mutexLock(limit->lock);
+  if (limit->sampleEvery > 1 && (limit->seen++ % limit->sampleEvery) != 0) {
+    admitted = FALSE;
+  }
+  if (admitted && limit->ratePerSecond > 0) {
+    int64 capacity = ((int64)limit->burst) * 1000000;
+    if (now > limit->refilledAt) {
+      limit->tokens += (int64)(now - limit->refilledAt) * limit->ratePerSecond;
+      if (limit->tokens > capacity) {
+        limit->tokens = capacity;
+      }
+      limit->refilledAt = now;
+    }
+    if (limit->tokens >= 1000000) {
+      limit->tokens -= 1000000;
+    } else {
+      admitted = FALSE;
+    }
+  }
+  if (!admitted) {
+    limit->suppressed++;
+  }
+  *suppressedToReport = (rateReporterState == LOG_RATE_REPORTER_RUNNING) ? 0 : takeSuppressedCount(limit, now);
+  mutexUnlock(limit->lock);
+
+  return admitted;
+}
+
+static void reportSuppressedRecords(LoggingContext *context, LoggingComponent *component,
+                                    LoggingDestination *destination, unsigned int suppressed){
+  char path[LOG_COMPONENT_PATH_MAX];
+  char *componentName = path;
+  if (!copyComponentPath(context, component, path)) {
+    componentName = component->name ? component->name : "";
+  }
+  printToDestination(destination, context, component, destination->data,
+                     "%s: suppressed %u messages by rate limit or sampling\n", componentName, suppressed);
+}
+
+static void *logRateReporterMain(void *data){
+  while (TRUE) {
+    logAsyncSleep(LOG_RATE_TICK_MILLIS);
+    uint64 now = logClockMicros();
+
+    mutexLock(rateLimitsLock);
+    for (LogRateLimit *limit = rateLimits; limit != NULL; limit = limit->next) {
+      mutexLock(limit->lock);
+      unsigned int suppressed = takeSuppressedCount(limit, now);
+      mutexUnlock(limit->lock);
+      if (suppressed == 0) {
+        continue;
+      }
+      LoggingComponent *component = getComponent(limit->context, limit->compID, NULL);
+      if (component == NULL || component->destination >= MAX_LOGGING_DESTINATIONS) {
+        continue;
+      }
+      LoggingDestination *destination = &getDestinationTable(limit->context, limit->compID)[component->destination];
+      if (destination->state != LOG_DESTINATION_STATE_UNINITIALIZED && destination->handler != NULL) {
+        reportSuppressedRecords(limit->context, component, destination, suppressed);
+      }
+    }
+    mutexUnlock(rateLimitsLock);
+  }
+  return NULL;
+}
+
+static LogRateLimit *makeRateLimit(LoggingContext *context, uint64 compID){
+  if (rateReporterState == LOG_RATE_REPORTER_NONE) {
+    mutexCreate(rateLimitsLock);
+    int createStatus = threadCreate((&rateReporter), (void * (*)(void *))logRateReporterMain, NULL);
+    if (createStatus != 0) {
+      char message[128];
+      sprintf(message, "logSetComponentRateLimit: reporter thread not started, status=%d\n", createStatus);
+      lastResortLog(message);
+      rateReporterState = LOG_RATE_REPORTER_FAILED;
+    } else {
+      rateReporterState = LOG_RATE_REPORTER_RUNNING;
+    }
+  }
+
+  LogRateLimit *limit = (LogRateLimit *)safeMalloc(sizeof(LogRateLimit), "LogRateLimit");
+  memset(limit, 0, sizeof(LogRateLimit));
+  memcpy(limit->eyecatcher, "RSLOGRTL", sizeof(limit->eyecatcher));
+  mutexCreate(limit->lock);
+  limit->context = context;
+  limit->compID = compID;
+  limit->reportedAt = logClockMicros();
+
+  mutexLock(rateLimitsLock);
+  limit->next = rateLimits;
+  rateLimits = limit;
+  mutexUnlock(rateLimitsLock);
+  return limit;
+}
+
+static void freeRateLimit(LogRateLimit *limit){
+  mutexLock(rateLimitsLock);
+  LogRateLimit **link = &rateLimits;
+  while (*link != NULL && *link != limit) {
+    link = &(*link)->next;
+  }
+  if (*link != NULL) {
+    *link = limit->next;
+  }
+  mutexUnlock(rateLimitsLock);
+  safeFree((char *)limit, sizeof(LogRateLimit));
+}
+
+int logSetComponentRateLimit(LoggingContext *context, uint64 compID, int ratePerSecond, int burst, int sampleEvery){
+
+  if (context == NULL) {
+    context = getLoggingContext();
+  }
+
+  LoggingComponent *component = getComponent(context, compID, NULL);
+  if (component == NULL) {
+    return RC_LOG_ERROR;
+  }
+
+  LoggingComponentData *componentData = getComponentData(context, component, FALSE);
+  LogRateLimit *limit = (componentData != NULL) ? componentData->rateLimit : NULL;
+  if (limit == NULL) {
+    if (ratePerSecond <= 0 && sampleEvery <= 1) {
+      return RC_LOG_OK;
+    }
+    limit = makeRateLimit(context, compID);
+    getComponentData(context, component, TRUE)->rateLimit = limit;
+  }
+
+  /* an existing limit is only ever updated, because callers may be inside it right now */
+  mutexLock(limit->lock);
+  limit->ratePerSecond = ratePerSecond > 0 ? ratePerSecond : 0;
+  limit->burst = burst > 0 ? burst : (limit->ratePerSecond > 0 ? limit->ratePerSecond : 1);
+  limit->sampleEvery = sampleEvery > 1 ? sampleEvery : 1;
+  limit->tokens = ((int64)limit->burst) * 1000000;
+  limit->refilledAt = logClockMicros();
+  limit->seen = 0;
+  mutexUnlock(limit->lock);
+
+  component->flags |= LOG_COMP_FLAG_RATE_LIMITED;
+  return RC_LOG_OK;
+}
+
+#endif /* not METTLE */
+
+/* returns FALSE if the component's rate limit or sampling suppresses the record */
+static bool passComponentRateLimit(LoggingContext *context, LoggingComponent *component,
+                                   LoggingDestination *destination){
+#ifndef METTLE
+  /* the flag spares components without a limit the lookup */
+  if (component->flags & LOG_COMP_FLAG_RATE_LIMITED) {
+    LoggingComponentData *componentData = getComponentData(context, component, FALSE);
+    if (componentData != NULL && componentData->rateLimit != NULL) {
+      unsigned int suppressed = 0;
+      bool admitted = admitRateLimitedRecord(componentData->rateLimit, &suppressed);
+      if (suppressed > 0) {
+        reportSuppressedRecords(context, component, destination, suppressed);
+      }
+      return admitted;
+    }
+  }
+#endif
+  return TRUE;
+}
+
+static void logRecord(LoggingContext *context, uint64 compID, int level,
+                      LogField *fields, int fieldCount, char *formatString, va_list argList){
 
   if (context == NULL) {
     context = getLoggingContext();
@@ -666,7 +1220,6 @@ void zowelog(LoggingContext *context, uint64 compID, int level, char *formatStri
   }
 
   if (maxDetailLevel >= level){
-    va_list argPointer;
 
     LoggingDestination *destination = &getDestinationTable(context, compID)[component->destination];
 //    printf("log.2 comp.dest=%d\n",component->destination);fflush(stdout);
@@ -687,23 +1240,42 @@ void zowelog(LoggingContext *context, uint64 compID, int level, char *formatStri
       lastResortLog(message);
       return;
     }
+    if (!passComponentRateLimit(context, component, destination)){
+      return;
+    }
     /* here, pass to a var-args handler */
-    va_start(argPointer, formatString);
+    LogRecordHandler recordHandler = getRecordHandler(destination);
+    if (recordHandler != NULL){
+      recordHandler(context,component,destination->data,level,fields,fieldCount,formatString,argList);
+    } else {
+      destination->handler(context,component,destination->data,formatString,argList);
+    }
+  }
 
-    destination->handler(context,component,destination->data,formatString,argPointer);
- 
-    va_end(argPointer);
+}
+
+void zowelog(LoggingContext *context, uint64 compID, int level, char *formatString, ...){
+
+  if (logShouldTrace(context, compID, level) == FALSE) {
+    return;
   }
 
+  va_list argPointer;
+  va_start(argPointer, formatString);
+  logRecord(context, compID, level, NULL, 0, formatString, argPointer);
+  va_end(argPointer);
 }
 
-static void printToDestination(LoggingDestination *destination,
-                               struct LoggingContext_tag *context,
-                               LoggingComponent *component,
-                               void *data, char *formatString, ...){
+void zowelogFields(LoggingContext *context, uint64 compID, int level,
+                   LogField *fields, int fieldCount, char *formatString, ...){
+
+  if (logShouldTrace(context, compID, level) == FALSE) {
+    return;
+  }
+
   va_list argPointer;
   va_start(argPointer, formatString);
-  destination->handler(context,component,destination->data,formatString,argPointer);
+  logRecord(context, compID, level, fields, fieldCount, formatString, argPointer);
   va_end(argPointer);
 }
 
@@ -743,15 +1315,27 @@ void zowedump(LoggingContext *context, uint64 compID, int level, void *data, int
       lastResortLog(message);
       return;
     }
+    if (!passComponentRateLimit(context, component, destination)){
+      return;
+    }
 
     char workBuffer[4096];
-    for (int i = 0; ; i++){
-      char *result = destination->dumper(workBuffer, sizeof(workBuffer), data, dataSize, i);
-      if (result != NULL){
-        printToDestination(destination, context, component, destination->data, "%s\n", result);
+    if (destination->dumper == standardDumperFunction){
+      /* whole blocks of lines go to the destination in one call */
+      int index = 0;
+      while (index < dataSize){
+        formatDumpBlock(workBuffer, sizeof(workBuffer), (const unsigned char *)data, dataSize, &index);
+        printToDestination(destination, context, component, destination->data, "%s", workBuffer);
       }
-      else {
-        break;
+    } else {
+      for (int i = 0; ; i++){
+        char *result = destination->dumper(workBuffer, sizeof(workBuffer), data, dataSize, i);
+        if (result != NULL){
+          printToDestination(destination, context, component, destination->data, "%s\n", result);
+        }
+        else {
+          break;
+        }
       }
     }
 
@@ -759,39 +1343,1041 @@ void zowedump(LoggingContext *context, uint64 compID, int level, void *data, int
 
 }
 
+#ifndef METTLE
+
+/*
+  Asynchronous destinations.
+
+  An asynchronous destination puts each record into a ring of fixed-size slots and returns.  A
+  writer thread drains the ring and passes the records to the target destination in batches,
+  so a slow pipe or file holds up the writer instead of the thread that logged.
+
+  The ring is a bounded multi-producer, single-consumer queue in the style of Dmitry Vyukov's:
+  every slot carries a sequence number that says whether it is free for the producer claiming
+  position p (sequence == p), holds a published record (p+1) or has been drained (p+capacity).
+  Producers claim positions with a compare-and-swap on the tail and format straight into the
+  slot, so the only shared write on the hot path is that one swap.  Records longer than a slot
+  are formatted into a heap copy that the writer frees.  The compare-and-swaps double as the
+  memory barriers that order a record's bytes against its sequence number.
+
+  When the ring is full a record is dropped and counted (LOG_ASYNC_OVERFLOW_DROP), and the
+  writer reports the count in the output, or the producer waits for room
+  (LOG_ASYNC_OVERFLOW_BLOCK).  Asynchronous destinations are drained when the program exits.
+ */
+
+#define LOG_ASYNC_IDLE_MILLIS 10
+#define LOG_ASYNC_FLUSH_LIMIT_MILLIS 2000
+
+typedef struct LogAsyncSlot_tag{
+  volatile unsigned int sequence;
+  int length;
+  LoggingComponent *component;
+  char *longText;               /* when the record did not fit in text */
+  char text[LOG_ASYNC_RECORD_SIZE];
+} LogAsyncSlot;
+
+typedef struct LogAsyncState_tag{
+  char eyecatcher[8];           /* RSLOGASY */
+  LoggingContext *context;
+  LoggingDestination *target;
+  int capacity;                 /* a power of two */
+  int overflowPolicy;
+  volatile unsigned int tail;   /* the next position producers claim */
+  volatile unsigned int head;   /* the next position the writer drains, only it moves this */
+  volatile unsigned int dropped;
+  OSThread writer;
+  LogAsyncSlot *slots;
+  struct LogAsyncState_tag *next;
+} LogAsyncState;
+
+static LogAsyncState *asyncStates = NULL;
+
+static int logCompareAndSwap(volatile unsigned int *target, unsigned int expected, unsigned int replacement){
+#ifdef __ZOWE_OS_ZOS
+  return cs((cs_t *)&expected, (cs_t *)target, (cs_t)replacement) == 0;
+#elif defined __GNUC__ || defined __ZOWE_OS_AIX
+  return __sync_bool_compare_and_swap(target, expected, replacement);
+#elif defined __ZOWE_OS_WINDOWS
+  return atomic_compare_exchange_strong((atomic_uint *)target, &expected, replacement);
+#else
+  #error Unsupported platform for atomic operation
+#endif
+}
+
+static void logAsyncSleep(int millis){
+#ifdef __ZOWE_OS_WINDOWS
+  Sleep(millis);
+#else
+  usleep(millis * 1000);
+#endif
+}
+
+static LogAsyncSlot *claimAsyncSlot(LogAsyncState *state, unsigned int *position){
+  unsigned int mask = state->capacity - 1;
+  while (TRUE) {
+    unsigned int tail = state->tail;
+    LogAsyncSlot *slot = &state->slots[tail & mask];
+    int difference = (int)(slot->sequence - tail);
+    if (difference == 0) {
+      if (logCompareAndSwap(&state->tail, tail, tail + 1)) {
+        *position = tail;
+        return slot;
+      }
+    } else if (difference < 0) {
+      /* the slot still holds the record from one lap ago, so the ring is full */
+      if (state->overflowPolicy != LOG_ASYNC_OVERFLOW_BLOCK) {
+        return NULL;
+      }
+      logAsyncSleep(1);
+    }
+    /* otherwise another producer took this position, try the next */
+  }
+}
+
+static void printAsync(LoggingContext *context, LoggingComponent *component, void *data, char *formatString, va_list argList){
+  LogAsyncState *state = (LogAsyncState *)data;
+  unsigned int position = 0;
+  LogAsyncSlot *slot = claimAsyncSlot(state, &position);
+  if (slot == NULL) {
+    unsigned int dropped;
+    do {
+      dropped = state->dropped;
+    } while (!logCompareAndSwap(&state->dropped, dropped, dropped + 1));
+    return;
+  }
+  va_list argCopy;
+  va_copy(argCopy, argList);
+  int length = vsnprintf(slot->text, sizeof(slot->text), formatString, argList);
+  slot->longText = NULL;
+  if (length >= (int)sizeof(slot->text)) {
+    slot->longText = safeMalloc(length + 1, "LogAsyncLongRecord");
+    vsnprintf(slot->longText, length + 1, formatString, argCopy);
+  }
+  va_end(argCopy);
+  slot->length = (length > 0) ? length : 0;
+  slot->component = component;
+  logCompareAndSwap(&slot->sequence, position, position + 1);
+}
+
+static void flushAsyncTarget(LogAsyncState *state){
+  if (state->target->handler == printStdout) {
+    fflush(stdout);
+  } else if (state->target->handler == printStderr) {
+    fflush(stderr);
+  }
+}
+
+/* drains what has been published so far, returning the number of records written */
+static int drainAsyncRecords(LogAsyncState *state){
+  unsigned int mask = state->capacity - 1;
+  int count = 0;
+
+  unsigned int dropped = state->dropped;
+  if (dropped != 0 && logCompareAndSwap(&state->dropped, dropped, 0)) {
+    printToDestination(state->target, state->context, &state->context->zoweAnchor->topLevelComponent, state->target->data,
+                       "%u log records were dropped because the asynchronous log buffer was full\n", dropped);
+    count++;
+  }
+
+  while (TRUE) {
+    unsigned int head = state->head;
+    LogAsyncSlot *slot = &state->slots[head & mask];
+    /* a no-op swap, to read the sequence with a barrier before reading the record */
+    if (!logCompareAndSwap(&slot->sequence, head + 1, head + 1)) {
+      break;
+    }
+    if (slot->longText != NULL) {
+      printToDestination(state->target, state->context, slot->component, state->target->data, "%s", slot->longText);
+      safeFree(slot->longText, slot->length + 1);
+      slot->longText = NULL;
+    } else {
+      printToDestination(state->target, state->context, slot->component, state->target->data, "%s", slot->text);
+    }
+    logCompareAndSwap(&slot->sequence, head + 1, head + state->capacity);
+    state->head = head + 1;
+    count++;
+  }
+
+  if (count > 0) {
+    flushAsyncTarget(state);
+  }
+  return count;
+}
+
+static void *logAsyncWriterMain(void *data){
+  LogAsyncState *state = (LogAsyncState *)data;
+  while (TRUE) {
+    if (drainAsyncRecords(state) == 0) {
+      logAsyncSleep(LOG_ASYNC_IDLE_MILLIS);
+    }
+  }
+  return NULL;
+}
+
+void logFlushAsyncDestination(LoggingDestination *destination){
+  if (destination == NULL || destination->handler != printAsync) {
+    return;
+  }
+  LogAsyncState *state = (LogAsyncState *)destination->data;
+  unsigned int tail = state->tail;
+  /* bounded, because a producer that stopped between claiming a slot and publishing it
+     would hold the writer back for good */
+  for (int waited = 0; (int)(state->head - tail) < 0 && waited < LOG_ASYNC_FLUSH_LIMIT_MILLIS; waited++) {
+    logAsyncSleep(1);
+  }
+  flushAsyncTarget(state);
+}
+
+static void flushAllAsyncDestinations(void){
+  for (LogAsyncState *state = asyncStates; state != NULL; state = state->next) {
+    unsigned int tail = state->tail;
+    for (int waited = 0; (int)(state->head - tail) < 0 && waited < LOG_ASYNC_FLUSH_LIMIT_MILLIS; waited++) {
+      logAsyncSleep(1);
+    }
+    flushAsyncTarget(state);
+  }
+}
+
+LoggingDestination *logConfigureAsyncDestination(LoggingContext *context,
+                                                 unsigned int id,
+                                                 char *name,
+                                                 unsigned int targetID,
+                                                 int capacity,
+                                                 int overflowPolicy){
+  if (context == NULL) {
+    context = getLoggingContext();
+  }
+
+  LoggingDestination *target = getDestinationTable(context, ((uint64)targetID) << 32);
+  int targetIndex = targetID & 0xFFFF;
+  if (target == NULL || targetIndex >= MAX_LOGGING_DESTINATIONS ||
+      target[targetIndex].state == LOG_DESTINATION_STATE_UNINITIALIZED ||
+      target[targetIndex].handler == NULL || target[targetIndex].handler == printAsync) {
+    char message[128];
+    sprintf(message, "logConfigureAsyncDestination: target destination 0x%X is not usable\n", targetID);
+    lastResortLog(message);
+    return NULL;
+  }
+  target = &target[targetIndex];
+
+  int ringSize = 1;
+  while (ringSize < capacity && ringSize < (1 << 20)) {
+    ringSize <<= 1;
+  }
+  LogAsyncState *state = (LogAsyncState *)safeMalloc(sizeof(LogAsyncState), "LogAsyncState");
+  memset(state, 0, sizeof(LogAsyncState));
+  memcpy(state->eyecatcher, "RSLOGASY", sizeof(state->eyecatcher));
+  state->context = context;
+  state->target = target;
+  state->capacity = ringSize;
+  state->overflowPolicy = overflowPolicy;
+  state->slots = (LogAsyncSlot *)safeMalloc(ringSize * sizeof(LogAsyncSlot), "LogAsyncSlots");
+  for (int i = 0; i < ringSize; i++) {
+    state->slots[i].sequence = i;
+    state->slots[i].longText = NULL;
+  }
+
+  LoggingDestination *destination = logConfigureDestination(context, id, name, state, printAsync);
+  if (destination == NULL) {
+    safeFree((char *)state->slots, ringSize * sizeof(LogAsyncSlot));
+    safeFree((char *)state, sizeof(LogAsyncState));
+    return NULL;
+  }
+
+  OSThread *writer = &state->writer;
+  int createStatus = threadCreate(writer, (void * (*)(void *))logAsyncWriterMain, state);
+  if (createStatus != 0) {
+    char message[128];
+    sprintf(message, "logConfigureAsyncDestination: writer thread not started, status=%d\n", createStatus);
+    lastResortLog(message);
+    /* records go straight to the target instead */
+    destination->handler = target->handler;
+    destination->data = target->data;
+    safeFree((char *)state->slots, ringSize * sizeof(LogAsyncSlot));
+    safeFree((char *)state, sizeof(LogAsyncState));
+    return destination;
+  }
+
+  if (asyncStates == NULL) {
+    atexit(flushAllAsyncDestinations);
+  }
+  state->next = asyncStates;
+  asyncStates = state;
+  return destination;
+}
+
+#endif /* not METTLE */
+
+#ifndef METTLE
+
+/*
+  JSON destinations.
+
+  A JSON destination renders each record as a single-line JSON object and passes the line to
+  its target destination as text:
+
+    {"time":"2024-05-01T12:00:00.123Z","level":"INFO","component":"zss.httpserver",
+     "thread":"7f3a2c1e4700","message":"...","fields":{"key":"value"}}
+
+  The component path was resolved when the component was configured, so the only per-record
+  work is the message, the clock and the escaping that jsonPrinter does.  Records are rendered
+  into a stack buffer that is only replaced by a heap one for very long messages.
+ */
+
+#define LOG_JSON_BUFFER_SIZE 2048
+
+static char *logLevelNames[] = { "SEVERE", "WARNING", "INFO", "DEBUG", "DEBUG2", "DEBUG3" };
+
+typedef struct LogJsonState_tag{
+  char eyecatcher[8];           /* RSLOGJSN */
+  LoggingDestination *target;
+} LogJsonState;
+
+typedef struct LogJsonLine_tag{
+  char *text;
+  int   size;
+  int   length;
+  int   isHeap;
+} LogJsonLine;
+
+static void writeToJsonLine(jsonPrinter *printer, char *text, int length){
+  LogJsonLine *line = (LogJsonLine *)printer->customObject;
+  /* room for the newline and the terminator */
+  if (line->length + length + 2 > line->size) {
+    int newSize = line->size * 2;
+    while (line->length + length + 2 > newSize) {
+      newSize *= 2;
+    }
+    char *newText = safeMalloc(newSize, "LogJsonLine");
+    memcpy(newText, line->text, line->length);
+    if (line->isHeap) {
+      safeFree(line->text, line->size);
+    }
+    line->text = newText;
+    line->size = newSize;
+    line->isHeap = TRUE;
+  }
+  memcpy(line->text + line->length, text, length);
+  line->length += length;
+}
+
+static uint64 logThreadID(){
+#ifdef __ZOWE_OS_WINDOWS
+  return (uint64)GetCurrentThreadId();
+#else
+  pthread_t self = pthread_self();
+  uint64 id = 0;
+  memcpy(&id, &self, (sizeof(self) < sizeof(id)) ? sizeof(self) : sizeof(id));
+  return id;
+#endif
+}
+
+/* an ISO 8601 UTC timestamp with milliseconds */
+static void formatLogTime(char *buffer, int bufferSize){
+  struct tm fields;
+  int millis = 0;
+#ifdef __ZOWE_OS_WINDOWS
+  time_t now = time(NULL);
+  gmtime_s(&fields, &now);
+#else
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  time_t seconds = now.tv_sec;
+  gmtime_r(&seconds, &fields);
+  millis = now.tv_usec / 1000;
+#endif
+  snprintf(buffer, bufferSize, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+           fields.tm_year + 1900, fields.tm_mon + 1, fields.tm_mday,
+           fields.tm_hour, fields.tm_min, fields.tm_sec, millis);
+}
+
+static void printJsonRecord(LoggingContext *context, LoggingComponent *component, void *data,
+                            int level, LogField *fields, int fieldCount,
+                            char *formatString, va_list argList){
+  LogJsonState *state = (LogJsonState *)data;
+
+  char messageBuffer[LOG_JSON_BUFFER_SIZE];
+  char *message = messageBuffer;
+  int messageSize = sizeof(messageBuffer);
+  va_list argCopy;
+  va_copy(argCopy, argList);
+  int messageLength = vsnprintf(messageBuffer, sizeof(messageBuffer), formatString, argList);
+  if (messageLength >= (int)sizeof(messageBuffer)) {
+    messageSize = messageLength + 1;
+    message = safeMalloc(messageSize, "LogJsonMessage");
+    vsnprintf(message, messageSize, formatString, argCopy);
+  }
+  va_end(argCopy);
+  /* callers end most messages with a newline, which the record supplies */
+  while (messageLength > 0 && (message[messageLength - 1] == '\n' || message[messageLength - 1] == '\r')) {
+    message[--messageLength] = 0;
+  }
+
+  char timeText[32];
+  char threadText[24];
+  formatLogTime(timeText, sizeof(timeText));
+  snprintf(threadText, sizeof(threadText), "%llx", (unsigned long long)logThreadID());
+
+  char lineBuffer[LOG_JSON_BUFFER_SIZE];
+  LogJsonLine line = { lineBuffer, sizeof(lineBuffer), 0, FALSE };
+  jsonPrinter *printer = makeCustomNativeJsonPrinter(writeToJsonLine, &line, 0);
+  jsonStart(printer);
+  jsonAddString(printer, "time", timeText);
+  if (level >= ZOWE_LOG_SEVERE && level <= ZOWE_LOG_DEBUG3) {
+    jsonAddString(printer, "level", logLevelNames[level]);
+  }
+  char componentPath[LOG_COMPONENT_PATH_MAX];
+  if (component != NULL && copyComponentPath(context, component, componentPath)) {
+    jsonAddString(printer, "component", componentPath);
+  }
+  jsonAddString(printer, "thread", threadText);
+  jsonAddString(printer, "message", message);
+  if (fieldCount > 0) {
+    jsonStartObject(printer, "fields");
+    for (int i = 0; i < fieldCount; i++) {
+      if (fields[i].key != NULL) {
+        jsonAddString(printer, fields[i].key, fields[i].value ? fields[i].value : "");
+      }
+    }
+    jsonEndObject(printer);
+  }
+  jsonEnd(printer);
+  freeJsonPrinter(printer);
+
+  /* the printer may have left a newline after the object */
+  while (line.length > 0 && line.text[line.length - 1] == '\n') {
+    line.length--;
+  }
+  line.text[line.length++] = '\n';
+  line.text[line.length] = 0;
+  printToDestination(state->target, context, component, state->target->data, "%s", line.text);
+
+  if (line.isHeap) {
+    safeFree(line.text, line.size);
+  }
+  if (message != messageBuffer) {
+    safeFree(message, messageSize);
+  }
+}
+
+/* for text that does not come through zowelog, such as dump lines */
+static void printJson(LoggingContext *context, LoggingComponent *component, void *data, char *formatString, va_list argList){
+  printJsonRecord(context, component, data, ZOWE_LOG_NA, NULL, 0, formatString, argList);
+}
+
+LoggingDestination *logConfigureJsonDestination(LoggingContext *context,
+                                                unsigned int id,
+                                                char *name,
+                                                unsigned int targetID){
+  if (context == NULL) {
+    context = getLoggingContext();
+  }
+
+  LoggingDestination *target = getDestinationTable(context, ((uint64)targetID) << 32);
+  int targetIndex = targetID & 0xFFFF;
+  if (target == NULL || targetIndex >= MAX_LOGGING_DESTINATIONS ||
+      target[targetIndex].state == LOG_DESTINATION_STATE_UNINITIALIZED ||
+      target[targetIndex].handler == NULL) {
+    char message[128];
+    sprintf(message, "logConfigureJsonDestination: target destination 0x%X is not usable\n", targetID);
+    lastResortLog(message);
+    return NULL;
+  }
+
+  LogJsonState *state = (LogJsonState *)safeMalloc(sizeof(LogJsonState), "LogJsonState");
+  memcpy(state->eyecatcher, "RSLOGJSN", sizeof(state->eyecatcher));
+  state->target = &target[targetIndex];
+
+  LoggingDestination *destination = logConfigureDestination(context, id, name, state, printJson);
+  if (destination == NULL) {
+    safeFree((char *)state, sizeof(LogJsonState));
+    return NULL;
+  }
+  return destination;
+}
+
+#endif /* not METTLE */
+
+#ifndef METTLE
+
+/*
+  File destinations.
+
+  Records are formatted straight into a user-space buffer under the destination's lock, and the
+  buffer goes to the file in one write when it fills, when its oldest record has waited
+  flushMillis, or at exit.  The file is opened unbuffered, so that buffer is the only one.
+
+  Rotation renames the active file to <path>.<yyyymmdd-hhmmss>.<n> and opens a new one.  Size
+  rotation happens on the writing thread before the write that would pass maxFileSize; age
+  rotation, syncs, gzip and pruning of rotated files happen on the maintenance thread, so
+  compressing a large file never holds up a caller.  Pruning lists the directory for rotated
+  names, so files left by earlier runs count against keepFiles too.
+
+  While the file cannot be reopened, records are counted and dropped; the count goes to the
+  last resort log, and into the file once it opens again.
+ */
+
+#define LOG_FILE_MIN_BUFFER_SIZE 4096
+#define LOG_FILE_MAX_TICK_MILLIS 1000
+#define LOG_FILE_COPY_SIZE       65536
+
+typedef struct LogRotatedFile_tag{
+  char *path;
+  struct LogRotatedFile_tag *next;
+} LogRotatedFile;
+
+typedef struct LogFileState_tag{
+  char eyecatcher[8];           /* RSLOGFIL */
+  LogFileOptions options;       /* path is a private copy */
+  Mutex lock;
+  FILE *file;
+  int64 fileSize;
+  time_t openedAt;
+  time_t syncedAt;
+  int unsynced;
+  char *buffer;
+  int used;
+  uint64 bufferedAt;            /* when the oldest byte in the buffer was added, in millis */
+  unsigned int rotationCount;
+  LogRotatedFile *rotated;      /* waiting for the maintenance thread, oldest first */
+  int bufferedRecords;
+  int64 droppedRecords;         /* since the file was last open */
+  int hasMaintainer;
+  OSThread maintainer;
+  struct LogFileState_tag *next;
+} LogFileState;
+
+static LogFileState *fileStates = NULL;
+
+static uint64 logClockMillis(){
+#ifdef __ZOWE_OS_WINDOWS
+  return (uint64)GetTickCount64();
+#else
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return ((uint64)now.tv_sec) * 1000 + now.tv_usec / 1000;
+#endif
+}
+
+static char *copyLogString(char *string){
+  int length = strlen(string);
+  char *copy = safeMalloc(length + 1, "LogFileString");
+  memcpy(copy, string, length + 1);
+  return copy;
+}
+
+static void freeLogString(char *string){
+  safeFree(string, strlen(string) + 1);
+}
+
+/* called with the lock held */
+static int openLogFile(LogFileState *state){
+  state->file = fopen(state->options.path, "a");
+  state->openedAt = time(NULL);
+  if (state->file == NULL) {
+    char message[128];
+    snprintf(message, sizeof(message), "log file %.80s could not be opened\n", state->options.path);
+    lastResortLog(message);
+    return -1;
+  }
+  setvbuf(state->file, NULL, _IONBF, 0);
+  fseek(state->file, 0, SEEK_END);
+  state->fileSize = ftell(state->file);
+  if (state->droppedRecords > 0) {
+    char message[192];
+    int length = snprintf(message, sizeof(message), "%lld log records were dropped while %.80s could not be opened\n",
+                          (long long)state->droppedRecords, state->options.path);
+    lastResortLog(message);
+    fwrite(message, 1, length, state->file);
+    state->fileSize += length;
+    state->droppedRecords = 0;
+  }
+  return 0;
+}
+
+/* called with the lock held */
+static void syncLogFile(LogFileState *state){
+  if (state->file != NULL) {
+    fflush(state->file);
+#ifdef __ZOWE_OS_WINDOWS
+    _commit(_fileno(state->file));
+#else
+    fsync(fileno(state->file));
+#endif
+  }
+  state->syncedAt = time(NULL);
+  state->unsynced = FALSE;
+}
+
+/* called with the lock held */
+static void rotateLogFile(LogFileState *state){
+  if (state->file != NULL) {
+    if (state->options.syncPolicy != LOG_FILE_SYNC_NEVER && state->unsynced) {
+      syncLogFile(state);
+    }
+    fclose(state->file);
+    state->file = NULL;
+  }
+
+  time_t now = time(NULL);
+  struct tm fields;
+#ifdef __ZOWE_OS_WINDOWS
+  localtime_s(&fields, &now);
+#else
+  localtime_r(&now, &fields);
+#endif
+  int pathSize = strlen(state->options.path) + 32;
+  char *rotatedPath = safeMalloc(pathSize, "LogFileString");
+  snprintf(rotatedPath, pathSize, "%s.%04d%02d%02d-%02d%02d%02d.%u", state->options.path,
+           fields.tm_year + 1900, fields.tm_mon + 1, fields.tm_mday,
+           fields.tm_hour, fields.tm_min, fields.tm_sec, state->rotationCount++);
+
+  if (rename(state->options.path, rotatedPath) == 0) {
+    LogRotatedFile *rotated = (LogRotatedFile *)safeMalloc(sizeof(LogRotatedFile), "LogRotatedFile");
+    rotated->path = copyLogString(rotatedPath);
+    rotated->next = NULL;
+    LogRotatedFile **tail = &state->rotated;
+    while (*tail != NULL) {
+      tail = &(*tail)->next;
+    }
+    *tail = rotated;
+  }
+  safeFree(rotatedPath, pathSize);
+
+  openLogFile(state);
+}
+
+/* called with the lock held, data holds that many records */
+static void writeLogData(LogFileState *state, char *data, int length, int records){
+  if (state->options.maxFileSize > 0 && state->fileSize > 0 &&
+      state->fileSize + length > state->options.maxFileSize) {
+    rotateLogFile(state);
+  }
+  if (state->file == NULL) {
+    state->droppedRecords += records;
+    return;
+  }
+  fwrite(data, 1, length, state->file);
+  state->fileSize += length;
+  state->unsynced = TRUE;
+  if (state->options.syncPolicy == LOG_FILE_SYNC_ALWAYS) {
+    syncLogFile(state);
+  }
+}
+
+/* called with the lock held */
+static void writeLogBuffer(LogFileState *state){
+  if (state->used > 0) {
+    writeLogData(state, state->buffer, state->used, state->bufferedRecords);
+    state->used = 0;
+    state->bufferedRecords = 0;
+  }
+}
+
+static void printFile(LoggingContext *context, LoggingComponent *component, void *data, char *formatString, va_list argList){
+  LogFileState *state = (LogFileState *)data;
+  va_list argCopy;
+  va_copy(argCopy, argList);
+
+  mutexLock(state->lock);
+  int room = state->options.bufferSize - state->used;
+  int length = vsnprintf(state->buffer + state->used, room, formatString, argList);
+  if (length < 0) {
+    length = 0;
+  } else if (length < room) {
+    if (state->used == 0) {
+      state->bufferedAt = logClockMillis();
+    }
+    state->used += length;
+    state->bufferedRecords++;
+  } else {
+    writeLogBuffer(state);
+    if (length < state->options.bufferSize) {
+      vsnprintf(state->buffer, state->options.bufferSize, formatString, argCopy);
+      state->used = length;
+      state->bufferedRecords = 1;
+      state->bufferedAt = logClockMillis();
+    } else {
+      char *text = safeMalloc(length + 1, "LogFileRecord");
+      vsnprintf(text, length + 1, formatString, argCopy);
+      writeLogData(state, text, length, 1);
+      safeFree(text, length + 1);
+    }
+  }
+  if (!state->hasMaintainer) {
+    writeLogBuffer(state);
+  }
+  mutexUnlock(state->lock);
+
+  va_end(argCopy);
+}
+
+#ifdef USE_ZLIB
+/* returns the path of the compressed file, or NULL if the original had to be kept */
+static char *compressLogFile(char *path){
+  int gzPathSize = strlen(path) + 4;
+  char *gzPath = safeMalloc(gzPathSize, "LogFileString");
+  snprintf(gzPath, gzPathSize, "%s.gz", path);
+
+  int ok = FALSE;
+  FILE *in = fopen(path, "rb");
+  gzFile out = (in != NULL) ? gzopen(gzPath, "wb") : NULL;
+  if (out != NULL) {
+    char *chunk = safeMalloc(LOG_FILE_COPY_SIZE, "LogFileCopy");
+    size_t count;
+    ok = TRUE;
+    while (ok && (count = fread(chunk, 1, LOG_FILE_COPY_SIZE, in)) > 0) {
+      ok = (gzwrite(out, chunk, (unsigned)count) == (int)count);
+    }
+    if (ferror(in)) {
+      ok = FALSE;
+    }
+    safeFree(chunk, LOG_FILE_COPY_SIZE);
+    if (gzclose(out) != Z_OK) {
+      ok = FALSE;
+    }
+  }
+  if (in != NULL) {
+    fclose(in);
+  }
+
+  if (ok) {
+    remove(path);
+    return gzPath;
+  }
+  remove(gzPath);
+  safeFree(gzPath, gzPathSize);
+  return NULL;
+}
+#endif /* USE_ZLIB */
+
+typedef struct LogRotatedName_tag{
+  char *name;
+  char *stamp;                  /* yyyymmdd-hhmmss within name */
+  unsigned long count;
+} LogRotatedName;
+
+#define isLogDigit(c) ((c) >= '0' && (c) <= '9')
+
+/* matches <base>.<yyyymmdd-hhmmss>.<n>, with or without .gz */
+static int parseRotatedName(char *name, char *base, LogRotatedName *parsed){
+  int baseLength = strlen(base);
+  if (strncmp(name, base, baseLength) || name[baseLength] != '.') {
+    return FALSE;
+  }
+  char *stamp = name + baseLength + 1;
+  for (int i = 0; i < 15; i++) {
+    if (i == 8 ? stamp[i] != '-' : !isLogDigit(stamp[i])) {
+      return FALSE;
+    }
+  }
+  if (stamp[15] != '.' || !isLogDigit(stamp[16])) {
+    return FALSE;
+  }
+  char *end = NULL;
+  unsigned long count = strtoul(stamp + 16, &end, 10);
+  if (*end != 0 && strcmp(end, ".gz")) {
+    return FALSE;
+  }
+  parsed->stamp = stamp;
+  parsed->count = count;
+  return TRUE;
+}
+
+static int compareRotatedNames(const void *a, const void *b){
+  const LogRotatedName *x = (const LogRotatedName *)a;
+  const LogRotatedName *y = (const LogRotatedName *)b;
+  int order = strncmp(x->stamp, y->stamp, 15);
+  if (order != 0) {
+    return order;
+  }
+  return (x->count > y->count) - (x->count < y->count);
+}
+
+static void addRotatedName(LogRotatedName **names, int *count, int *capacity,
+                           char *name, LogRotatedName *parsed){
+  if (*count == *capacity) {
+    int newCapacity = (*capacity == 0) ? 16 : *capacity * 2;
+    LogRotatedName *grown = (LogRotatedName *)safeMalloc(newCapacity * sizeof(LogRotatedName), "LogRotatedNames");
+    if (*count > 0) {
+      memcpy(grown, *names, *count * sizeof(LogRotatedName));
+      safeFree((char *)*names, *capacity * sizeof(LogRotatedName));
+    }
+    *names = grown;
+    *capacity = newCapacity;
+  }
+  LogRotatedName *entry = &(*names)[(*count)++];
+  entry->name = copyLogString(name);
+  entry->stamp = entry->name + (parsed->stamp - name);
+  entry->count = parsed->count;
+}
+
+/* maintenance thread only, removes the oldest rotated files beyond keepFiles */
+static void pruneRotatedFiles(LogFileState *state){
+  char *path = state->options.path;
+  char *base = path;
+  for (char *p = path; *p != 0; p++) {
+#ifdef __ZOWE_OS_WINDOWS
+    if (*p == '/' || *p == '\\') {
+#else
+    if (*p == '/') {
+#endif
+      base = p + 1;
+    }
+  }
+  int directoryLength = base - path;
+
+  LogRotatedName *names = NULL;
+  int count = 0;
+  int capacity = 0;
+  LogRotatedName parsed;
+#ifdef __ZOWE_OS_WINDOWS
+  int patternSize = strlen(path) + 3;
+  char *pattern = safeMalloc(patternSize, "LogFileString");
+  snprintf(pattern, patternSize, "%s.*", path);
+  struct _finddata_t found;
+  intptr_t search = _findfirst(pattern, &found);
+  safeFree(pattern, patternSize);
+  if (search == -1) {
+    return;
+  }
+  do {
+    if (parseRotatedName(found.name, base, &parsed)) {
+      addRotatedName(&names, &count, &capacity, found.name, &parsed);
+    }
+  } while (_findnext(search, &found) == 0);
+  _findclose(search);
+#else
+  char *directory = ".";
+  if (directoryLength > 0) {
+    directory = safeMalloc(directoryLength + 1, "LogFileString");
+    memcpy(directory, path, directoryLength);
+    directory[directoryLength] = 0;
+  }
+  DIR *dir = opendir(directory);
+  if (directoryLength > 0) {
+    safeFree(directory, directoryLength + 1);
+  }
+  if (dir == NULL) {
+    return;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (parseRotatedName(entry->d_name, base, &parsed)) {
+      addRotatedName(&names, &count, &capacity, entry->d_name, &parsed);
+    }
+  }
+  closedir(dir);
+#endif
+
+  if (count > state->options.keepFiles) {
+    qsort(names, count, sizeof(LogRotatedName), compareRotatedNames);
+  }
+  for (int i = 0; i < count; i++) {
+    if (i < count - state->options.keepFiles) {
+      int removeSize = directoryLength + strlen(names[i].name) + 1;
+      char *removePath = safeMalloc(removeSize, "LogFileString");
+      snprintf(removePath, removeSize, "%.*s%s", directoryLength, path, names[i].name);
+      remove(removePath);
+      safeFree(removePath, removeSize);
+    }
+    freeLogString(names[i].name);
+  }
+  if (names != NULL) {
+    safeFree((char *)names, capacity * sizeof(LogRotatedName));
+  }
+}
+
+static void *logFileMaintenanceMain(void *data){
+  LogFileState *state = (LogFileState *)data;
+  int tick = state->options.flushMillis < LOG_FILE_MAX_TICK_MILLIS ? state->options.flushMillis : LOG_FILE_MAX_TICK_MILLIS;
+  int pruned = FALSE;           /* the first pass also prunes what earlier runs left */
+
+  while (TRUE) {
+    logAsyncSleep(tick);
+
+    mutexLock(state->lock);
+    if (state->file == NULL) {
+      openLogFile(state);
+    }
+    if (state->used > 0 && logClockMillis() - state->bufferedAt >= (uint64)state->options.flushMillis) {
+      writeLogBuffer(state);
+    }
+    time_t now = time(NULL);
+    if (state->options.rotateSeconds > 0 && now - state->openedAt >= state->options.rotateSeconds) {
+      writeLogBuffer(state);
+      if (state->fileSize > 0) {
+        rotateLogFile(state);
+      } else {
+        state->openedAt = now;  /* no empty rotated files */
+      }
+    }
+    if (state->options.syncPolicy == LOG_FILE_SYNC_INTERVAL && state->unsynced &&
+        now - state->syncedAt >= state->options.syncSeconds) {
+      syncLogFile(state);
+    }
+    LogRotatedFile *rotated = state->rotated;
+    state->rotated = NULL;
+    mutexUnlock(state->lock);
+
+    if (rotated != NULL) {
+      pruned = FALSE;
+    }
+
+    while (rotated != NULL) {
+      LogRotatedFile *next = rotated->next;
+      char *path = rotated->path;
+#ifdef USE_ZLIB
+      if (state->options.compress) {
+        char *gzPath = compressLogFile(path);
+        if (gzPath != NULL) {
+          freeLogString(path);
+          path = gzPath;
+        }
+      }
+#endif
+      freeLogString(path);
+      safeFree((char *)rotated, sizeof(LogRotatedFile));
+      rotated = next;
+    }
+    if (!pruned && state->options.keepFiles > 0) {
+      pruneRotatedFiles(state);
+    }
+    pruned = TRUE;
+  }
+  return NULL;
+}
+
+void logFlushFileDestination(LoggingDestination *destination){
+  if (destination == NULL || destination->handler != printFile) {
+    return;
+  }
+  LogFileState *state = (LogFileState *)destination->data;
+  mutexLock(state->lock);
+  writeLogBuffer(state);
+  if (state->file != NULL) {
+    fflush(state->file);
+  }
+  mutexUnlock(state->lock);
+}
+
+static void flushAllFileDestinations(void){
+  for (LogFileState *state = fileStates; state != NULL; state = state->next) {
+    mutexLock(state->lock);
+    writeLogBuffer(state);
+    if (state->options.syncPolicy != LOG_FILE_SYNC_NEVER && state->unsynced) {
+      syncLogFile(state);
+    } else if (state->file != NULL) {
+      fflush(state->file);
+    }
+    if (state->droppedRecords > 0) {
+      char message[192];
+      snprintf(message, sizeof(message), "%lld log records were dropped because %.80s could not be opened\n",
+               (long long)state->droppedRecords, state->options.path);
+      lastResortLog(message);
+    }
+    mutexUnlock(state->lock);
+  }
+}
+
+LoggingDestination *logConfigureFileDestination(LoggingContext *context,
+                                                unsigned int id,
+                                                char *name,
+                                                LogFileOptions *options){
+  if (context == NULL) {
+    context = getLoggingContext();
+  }
+  if (options == NULL || options->path == NULL) {
+    lastResortLog("logConfigureFileDestination: no path\n");
+    return NULL;
+  }
+
+  LogFileState *state = (LogFileState *)safeMalloc(sizeof(LogFileState), "LogFileState");
+  memset(state, 0, sizeof(LogFileState));
+  memcpy(state->eyecatcher, "RSLOGFIL", sizeof(state->eyecatcher));
+  state->options = *options;
+  state->options.path = copyLogString(options->path);
+  if (state->options.bufferSize <= 0) {
+    state->options.bufferSize = LOG_FILE_DEFAULT_BUFFER_SIZE;
+  } else if (state->options.bufferSize < LOG_FILE_MIN_BUFFER_SIZE) {
+    state->options.bufferSize = LOG_FILE_MIN_BUFFER_SIZE;
+  }
+  if (state->options.flushMillis <= 0) {
+    state->options.flushMillis = LOG_FILE_DEFAULT_FLUSH_MILLIS;
+  }
+  state->buffer = safeMalloc(state->options.bufferSize, "LogFileBuffer");
+  mutexCreate(state->lock);
+  state->syncedAt = time(NULL);
+
+  if (openLogFile(state) != 0) {
+    safeFree(state->buffer, state->options.bufferSize);
+    freeLogString(state->options.path);
+    safeFree((char *)state, sizeof(LogFileState));
+    return NULL;
+  }
+
+  LoggingDestination *destination = logConfigureDestination(context, id, name, state, printFile);
+  if (destination == NULL) {
+    fclose(state->file);
+    safeFree(state->buffer, state->options.bufferSize);
+    freeLogString(state->options.path);
+    safeFree((char *)state, sizeof(LogFileState));
+    return NULL;
+  }
+
+  int createStatus = threadCreate((&state->maintainer), (void * (*)(void *))logFileMaintenanceMain, state);
+  if (createStatus != 0) {
+    char message[128];
+    sprintf(message, "logConfigureFileDestination: maintenance thread not started, status=%d\n", createStatus);
+    lastResortLog(message);
+    /* without it nothing would write a partly filled buffer, so every record is written at once */
+    state->hasMaintainer = FALSE;
+  } else {
+    state->hasMaintainer = TRUE;
+  }
+
+  if (fileStates == NULL) {
+    atexit(flushAllFileDestinations);
+  }
+  state->next = fileStates;
+  fileStates = state;
+  return destination;
+}
+
+#endif /* not METTLE */
+
 bool logShouldTraceInternal(LoggingContext *context, uint64 componentID, int level) {
 
   if (context == NULL) {
     context = getLoggingContext();
   }
 
+  /* a context made by an older library has neither cache, nor anything set in the reserved bits */
+  unsigned short maxLevel = context->zoweAnchor->topLevelComponentTable.maxLevel;
+  if ((maxLevel & LOG_MAX_LEVEL_KNOWN) && level > (maxLevel & 0xFF)) {
+    return FALSE;
+  }
+
   unsigned short *id = (unsigned short *)&componentID;
-  bool shouldTrace = FALSE;
   if (id[0] == LOG_ZOWE_VENDOR_ID) {
+    /* the effective level already accounts for the ancestors, so only the deepest
+       component that exists matters, unless it is not cached and the ancestors are asked */
     LoggingComponent *component = &context->zoweAnchor->topLevelComponent;
-    do {
-      /* level #0 */
-      LoggingComponentTable *componentTable = &context->zoweAnchor->topLevelComponentTable;
-      if (id[1] == 0 || component->currentDetailLevel >= level) {
+    bool ancestorTraces = component->currentDetailLevel >= level;
+    for (int i = 1; i < 4 && id[i] != 0; i++) {
+      LoggingComponentTable *componentTable = component->subcomponents;
+      if (componentTable == NULL || id[i] >= componentTable->componentCount) {
         break;
       }
-      /* level #1 */
-      componentTable = component->subcomponents;
-      component = &componentTable->components[id[1] % componentTable->componentCount];
-      if (id[2] == 0 || component->currentDetailLevel >= level || component->subcomponents == NULL) {
-        break;
-      }
-      /* level #2 */
-      componentTable = component->subcomponents;
-      component = &componentTable->components[id[2] % componentTable->componentCount];
-      if (id[3] == 0 || component->currentDetailLevel >= level || component->subcomponents == NULL) {
-        break;
+      component = &componentTable->components[id[i]];
+      if (component->currentDetailLevel >= level) {
+        ancestorTraces = TRUE;
       }
-      /* level #3 */
-      componentTable = component->subcomponents;
-      component = &componentTable->components[id[3] % componentTable->componentCount];
-    } while (0);
-    return component->currentDetailLevel >= level;
+    }
+    if (component->flags & LOG_COMP_FLAG_LEVEL_KNOWN) {
+      return getEffectiveLevel(component) >= level;
+    }
+    return ancestorTraces;
   } else {
     int maxDetailLevel = 0;
     LoggingComponent *component = getComponent(context, componentID, &maxDetailLevel);
@@ -1298,7 +1298,7 @@ void freeSocketSet(SocketSet *set){
 }
 
 void setSocketSetIdleTimeLimit(SocketSet *set, int idleSeconds) {
-  set->idleTimeLimit = (uint64_t)idleSeconds;
+  set->idleTimeLimit = (idleSeconds > 0) ? idleSeconds : 0;
 }
 
 int socketSetAdd(SocketSet *set, Socket *socket){
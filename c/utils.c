@@ -968,28 +968,97 @@ char *cleanURLParamValue(ShortLivedHeap *slh, char *value){
 }
 
 
-static int getBitsForChar(char c){
-  if (c >= 'a' && c <= 'i'){
-    return (c - 'a') + 26;
-  } else if (c >= 'j' && c <= 'r'){
-    return (c - 'j') + 35;
-  } else if (c >= 's' && c <= 'z'){
-    return (c - 's') + 44;
-  } else if (c >= 'A' && c <= 'I'){
-    return (c - 'A') + 0;
-  } else if (c >= 'J' && c <= 'R'){
-    return (c - 'J') + 9;
-  } else if (c >= 'S' && c <= 'Z'){
-    return (c - 'S') + 18;
-  } else if (c >= '0' && c <= '9'){
-    return (c - '0') + 52;
-  } else if (c == '+'){
-    return 62;
-  } else if (c == '/'){
-    return 63;
-  } else{
-    return -1;
-  }
+/*
+  Base64 decoding looks each character up in a table for the platform's charset, in which
+  characters outside the alphabet are -1.  The standard decoders let those through as before
+  and the base64url decoder rejects them.
+ */
+
+#ifdef __ZOWE_EBCDIC
+static const signed char base64DecodeTable[256] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'00' - x'0f' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'10' - x'1f' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'20' - x'2f' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'30' - x'3f' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1,  /* x'40' - x'4f' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'50' - x'5f' */
+                                                   -1, 63, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'60' - x'6f' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'70' - x'7f' */
+                                                   -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, -1, -1, -1, -1, -1, -1,  /* x'80' - x'8f' */
+                                                   -1, 35, 36, 37, 38, 39, 40, 41, 42, 43, -1, -1, -1, -1, -1, -1,  /* x'90' - x'9f' */
+                                                   -1, -1, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1, -1,  /* x'a0' - x'af' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'b0' - x'bf' */
+                                                   -1,  0,  1,  2,  3,  4,  5,  6,  7,  8, -1, -1, -1, -1, -1, -1,  /* x'c0' - x'cf' */
+                                                   -1,  9, 10, 11, 12, 13, 14, 15, 16, 17, -1, -1, -1, -1, -1, -1,  /* x'd0' - x'df' */
+                                                   -1, -1, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1, -1,  /* x'e0' - x'ef' */
+                                                   52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1};  /* x'f0' - x'ff' */
+static const signed char base64urlDecodeTable[256] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'00' - x'0f' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'10' - x'1f' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'20' - x'2f' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'30' - x'3f' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'40' - x'4f' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'50' - x'5f' */
+                                                      62, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 63, -1, -1,  /* x'60' - x'6f' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'70' - x'7f' */
+                                                      -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, -1, -1, -1, -1, -1, -1,  /* x'80' - x'8f' */
+                                                      -1, 35, 36, 37, 38, 39, 40, 41, 42, 43, -1, -1, -1, -1, -1, -1,  /* x'90' - x'9f' */
+                                                      -1, -1, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1, -1,  /* x'a0' - x'af' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'b0' - x'bf' */
+                                                      -1,  0,  1,  2,  3,  4,  5,  6,  7,  8, -1, -1, -1, -1, -1, -1,  /* x'c0' - x'cf' */
+                                                      -1,  9, 10, 11, 12, 13, 14, 15, 16, 17, -1, -1, -1, -1, -1, -1,  /* x'd0' - x'df' */
+                                                      -1, -1, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1, -1,  /* x'e0' - x'ef' */
+                                                      52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1};  /* x'f0' - x'ff' */
+#else
+static const signed char base64DecodeTable[256] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'00' - x'0f' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'10' - x'1f' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,  /* x'20' - x'2f' */
+                                                   52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,  /* x'30' - x'3f' */
+                                                   -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,  /* x'40' - x'4f' */
+                                                   15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,  /* x'50' - x'5f' */
+                                                   -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,  /* x'60' - x'6f' */
+                                                   41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,  /* x'70' - x'7f' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'80' - x'8f' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'90' - x'9f' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'a0' - x'af' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'b0' - x'bf' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'c0' - x'cf' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'd0' - x'df' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'e0' - x'ef' */
+                                                   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};  /* x'f0' - x'ff' */
+static const signed char base64urlDecodeTable[256] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'00' - x'0f' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'10' - x'1f' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1,  /* x'20' - x'2f' */
+                                                      52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,  /* x'30' - x'3f' */
+                                                      -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,  /* x'40' - x'4f' */
+                                                      15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, 63,  /* x'50' - x'5f' */
+                                                      -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,  /* x'60' - x'6f' */
+                                                      41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,  /* x'70' - x'7f' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'80' - x'8f' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'90' - x'9f' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'a0' - x'af' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'b0' - x'bf' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'c0' - x'cf' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'd0' - x'df' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  /* x'e0' - x'ef' */
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};  /* x'f0' - x'ff' */
+#endif
+
+static void decodeBase64Groups(const signed char *table, const char *s, char *result,
+                               int numGroups, int *invalid){
+  const unsigned char *in = (const unsigned char*)s;
+  int checked = 0;
+  for (int i = 0; i < numGroups; i++){
+    int ch0 = table[in[0]];
+    int ch1 = table[in[1]];
+    int ch2 = table[in[2]];
+    int ch3 = table[in[3]];
+    checked |= ch0 | ch1 | ch2 | ch3;
+    result[0] = (char) ((ch0 << 2) | (ch1 >> 4));
+    result[1] = (char) ((ch1 << 4) | (ch2 >> 2));
+    result[2] = (char) ((ch2 << 6) | ch3);
+    in += 4;
+    result += 3;
+  }
+  *invalid = (checked < 0);
 }
 
 int decodeBase64Unterminated(char *s, char *result, int sLen){
@@ -997,7 +1066,7 @@ int decodeBase64Unterminated(char *s, char *result, int sLen){
   int missingBytesInLastGroup = 0;
   int numFullGroups = numGroups;
   int inCursor = 0, outCursor = 0;
-  int i;
+  int invalid = 0;
     
   if (4 * numGroups != sLen){
     printf("non 4-mult\n");
@@ -1015,24 +1084,18 @@ int decodeBase64Unterminated(char *s, char *result, int sLen){
   }
     
   /* Translate all full groups from base64 to byte array elements */
-  for (i = 0; i < numFullGroups; i++){
-    int ch0 =getBitsForChar(s[inCursor++]);
-    int ch1 =getBitsForChar(s[inCursor++]);
-    int ch2 =getBitsForChar(s[inCursor++]);
-    int ch3 =getBitsForChar(s[inCursor++]);
-    result[outCursor++] = (char) ((ch0 << 2) | (ch1 >> 4));
-    result[outCursor++] = (char) ((ch1 << 4) | (ch2 >> 2));
-    result[outCursor++] = (char) ((ch2 << 6) | ch3);
-  }
+  decodeBase64Groups(base64DecodeTable, s, result, numFullGroups, &invalid);
+  inCursor = 4 * numFullGroups;
+  outCursor = 3 * numFullGroups;
   
   /* Translate partial group, if present */
   if (missingBytesInLastGroup != 0){
-    int ch0 =getBitsForChar(s[inCursor++]);
-    int ch1 =getBitsForChar(s[inCursor++]);
+    int ch0 = base64DecodeTable[(unsigned char)s[inCursor++]];
+    int ch1 = base64DecodeTable[(unsigned char)s[inCursor++]];
     result[outCursor++] = (char) ((ch0 << 2) | (ch1 >> 4));
     
     if (missingBytesInLastGroup == 1){
-      int ch2 =getBitsForChar(s[inCursor++]);
+      int ch2 = base64DecodeTable[(unsigned char)s[inCursor++]];
       result[outCursor++] = (char) ((ch1 << 4) | (ch2 >> 2));
     }
   }
@@ -1045,6 +1108,36 @@ int decodeBase64(char *s, char *result){
   return decodeBase64Unterminated(s,result,sLen);
 }
 
+int decodeBase64urlUnterminated(char *s, char *result, int sLen){
+  /* padding is optional in base64url, so it is ignored */
+  while ((sLen > 0) && (s[sLen - 1] == '=')){
+    sLen--;
+  }
+  int numFullGroups = sLen / 4;
+  int remainder = sLen - 4 * numFullGroups;
+  int inCursor = 4 * numFullGroups;
+  int outCursor = 3 * numFullGroups;
+  int invalid = 0;
+
+  if (remainder == 1){
+    return -1;
+  }
+  decodeBase64Groups(base64urlDecodeTable, s, result, numFullGroups, &invalid);
+  if (remainder != 0){
+    int ch0 = base64urlDecodeTable[(unsigned char)s[inCursor++]];
+    int ch1 = base64urlDecodeTable[(unsigned char)s[inCursor++]];
+    int ch2 = (remainder == 3) ? base64urlDecodeTable[(unsigned char)s[inCursor++]] : 0;
+    if ((ch0 | ch1 | ch2) < 0){
+      invalid = TRUE;
+    }
+    result[outCursor++] = (char) ((ch0 << 2) | (ch1 >> 4));
+    if (remainder == 3){
+      result[outCursor++] = (char) ((ch1 << 4) | (ch2 >> 2));
+    }
+  }
+  return invalid ? -1 : outCursor;
+}
+
 static char binToB64[] ={0x41,0x42,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4A,0x4B,0x4C,0x4D,0x4E,0x4F,0x50,
 			 0x51,0x52,0x53,0x54,0x55,0x56,0x57,0x58,0x59,0x5A,0x61,0x62,0x63,0x64,0x65,0x66,
 			 0x67,0x68,0x69,0x6A,0x6B,0x6C,0x6D,0x6E,0x6F,0x70,0x71,0x72,0x73,0x74,0x75,0x76,
@@ -1054,7 +1147,58 @@ static char binToEB64[] ={0xc1,0xc2,0xc3,0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xd1,0xd2
                           0xd8,0xd9,0xe2,0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0x81,0x82,0x83,0x84,0x85,0x86,
                           0x87,0x88,0x89,0x91,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0xa2,0xa3,0xa4,0xa5,
                           0xa6,0xa7,0xa8,0xa9,0xf0,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0x4e,0x61};
-                          
+
+static char binToB64url[] ={0x41,0x42,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4A,0x4B,0x4C,0x4D,0x4E,0x4F,0x50,
+                            0x51,0x52,0x53,0x54,0x55,0x56,0x57,0x58,0x59,0x5A,0x61,0x62,0x63,0x64,0x65,0x66,
+                            0x67,0x68,0x69,0x6A,0x6B,0x6C,0x6D,0x6E,0x6F,0x70,0x71,0x72,0x73,0x74,0x75,0x76,
+                            0x77,0x78,0x79,0x7A,0x30,0x31,0x32,0x33,0x34,0x35,0x36,0x37,0x38,0x39,0x2D,0x5F};
+
+static char binToEB64url[] ={0xc1,0xc2,0xc3,0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xd1,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,
+                             0xd8,0xd9,0xe2,0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0x81,0x82,0x83,0x84,0x85,0x86,
+                             0x87,0x88,0x89,0x91,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0xa2,0xa3,0xa4,0xa5,
+                             0xa6,0xa7,0xa8,0xa9,0xf0,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0x60,0x6d};
+
+/* equalsChar 0 leaves the output unpadded */
+static void encodeBase64WithTable(const char buf[], int size, char result[], int *resultSize,
+                                  const char *translation, char equalsChar){
+  const unsigned char *data = (const unsigned char*)buf;
+  int numFullGroups = size / 3;
+  int numBytesInPartialGroup = size - 3 * numFullGroups;
+  char *resPtr = result;
+#ifdef DEBUG
+  printf("num in full groups %d num in partial %d\n",numFullGroups,numBytesInPartialGroup);
+#endif
+  for (int i = 0; i < numFullGroups; i++){
+    unsigned int bits = (data[0] << 16) | (data[1] << 8) | data[2];
+    resPtr[0] = translation[bits >> 18];
+    resPtr[1] = translation[(bits >> 12) & 0x3f];
+    resPtr[2] = translation[(bits >> 6) & 0x3f];
+    resPtr[3] = translation[bits & 0x3f];
+    data += 3;
+    resPtr += 4;
+  }
+
+  if (numBytesInPartialGroup != 0){
+    int byte0 = data[0];
+    *resPtr++ = translation[byte0 >> 2];
+    if (numBytesInPartialGroup == 1){
+      *resPtr++ = translation[(byte0 << 4) & 0x3f];
+      if (equalsChar){
+        *resPtr++ = equalsChar;
+        *resPtr++ = equalsChar;
+      }
+    } else{
+      int byte1 = data[1];
+      *resPtr++ = translation[((byte0 << 4) & 0x3f) | (byte1 >> 4)];
+      *resPtr++ = translation[(byte1 << 2) & 0x3f];
+      if (equalsChar){
+        *resPtr++ = equalsChar;
+      }
+    }
+  }
+  *resultSize = resPtr - result;
+  result[*resultSize] = 0;
+}
 
 char *encodeBase64(ShortLivedHeap *slh, const char buf[], int size, int *resultSize, int useEbcdic){
   int   allocSize = BASE64_ENCODE_SIZE(size)+1;  /* +1 for null term */
@@ -1070,43 +1214,27 @@ char *encodeBase64(ShortLivedHeap *slh, const char buf[], int size, int *resultS
 
 void encodeBase64NoAlloc(const char buf[], int size, char result[], int *resultSize,
                          int useEbcdic){
-  const char *data = (char*)buf;
-  char equalsChar = (useEbcdic ? '=' : 0x3D);
-  char *translation = (useEbcdic ? binToEB64 : binToB64);
-    int numFullGroups = size / 3;
-    int numBytesInPartialGroup = size - 3 * numFullGroups;
-    int inCursor = 0;
-    char *resPtr = result;
-#ifdef DEBUG
-    printf("num in full groups %d num in partial %d\n",numFullGroups,numBytesInPartialGroup);
-#endif
-    for (int i = 0; i < numFullGroups; i++){
-      int byte0 = data[inCursor++] & 0xff;
-      int byte1 = data[inCursor++] & 0xff;
-      int byte2 = data[inCursor++] & 0xff;
-      *resPtr++ = (char)(translation[byte0 >> 2]); 
-      *resPtr++ = (char)(translation[((byte0 << 4) & 0x3f) | (byte1 >> 4)]); 
-      *resPtr++ = (char)(translation[((byte1 << 2) & 0x3f) | (byte2 >> 6)]); 
-      *resPtr++ = (char)(translation[byte2 & 0x3f]); 
-    }
-
-    if (numBytesInPartialGroup != 0){
-      int byte0 = data[inCursor++] & 0xff;
-      *resPtr++ = (char)(translation[byte0 >> 2]); 
-      if (numBytesInPartialGroup == 1){
-        *resPtr++ = (char)(translation[(byte0 << 4) & 0x3f]); 
-        *resPtr++ = equalsChar; 
-        *resPtr++ = equalsChar; 
-      }
-      else{
-        int byte1 = data[inCursor++] & 0xff;
-        *resPtr++ = (char)(translation[((byte0 << 4) & 0x3f) | (byte1 >> 4)]); 
-        *resPtr++ = (char)(translation[(byte1 << 2) & 0x3f]); 
-        *resPtr++ = equalsChar; 
-      }
-    }
-    *resultSize = resPtr - result;
-    result[*resultSize] = 0;
+  encodeBase64WithTable(buf, size, result, resultSize,
+                        (useEbcdic ? binToEB64 : binToB64),
+                        (useEbcdic ? 0x7E : 0x3D));
+}
+
+char *encodeBase64url(ShortLivedHeap *slh, const char buf[], int size, int *resultSize, int useEbcdic){
+  int   allocSize = BASE64_ENCODE_SIZE(size)+1;  /* +1 for null term */
+  char *result = (slh ? SLHAlloc(slh,allocSize) : safeMalloc31(allocSize,"BASE64URL"));
+  if (result){
+    encodeBase64urlNoAlloc(buf, size, result, resultSize, useEbcdic);
+    return result;
+  } else{
+    *resultSize = 0;
+    return NULL;
+  }
+}
+
+void encodeBase64urlNoAlloc(const char buf[], int size, char result[], int *resultSize,
+                            int useEbcdic){
+  encodeBase64WithTable(buf, size, result, resultSize,
+                        (useEbcdic ? binToEB64url : binToB64url), 0);
 }
 
 /*
@@ -839,6 +839,10 @@ void freeSocketSet(SocketSet *set) {
   return;
 }
 
+void setSocketSetIdleTimeLimit(SocketSet *set, int idleSeconds){
+  set->idleTimeLimit = (idleSeconds > 0) ? idleSeconds : 0;
+}
+
 int socketSetAdd(SocketSet *set, Socket *socket){
   printf("winskt.socketSetAdd set=0x%p socket=0x%p\n",set,socket);
   fflush(stdout);
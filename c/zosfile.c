@@ -54,6 +54,7 @@
 #pragma linkage(BPX4LST,OS)
 #pragma linkage(BPX4GGN,OS)
 #pragma linkage(BPX4GPN,OS)
+#pragma linkage(BPX4LSK,OS)
 
 #define BPXRED BPX4RED
 #define BPXOPN BPX4OPN
@@ -75,6 +76,7 @@
 #define BPXLST BPX4LST
 #define BPXGGN BPX4GGN
 #define BPXGPN BPX4GPN
+#define BPXLSK BPX4LSK
 
 #else
 
@@ -98,6 +100,7 @@
 #pragma linkage(BPX1LST,OS)
 #pragma linkage(BPX1GGN,OS)
 #pragma linkage(BPX1GPN,OS)
+#pragma linkage(BPX1LSK,OS)
 
 #define BPXRED BPX1RED
 #define BPXOPN BPX1OPN
@@ -119,6 +122,7 @@
 #define BPXLST BPX1LST
 #define BPXGGN BPX1GGN
 #define BPXGPN BPX1GPN
+#define BPXLSK BPX1LSK
 #endif
 
 /* Better compilers need these symbols to be declared as functions */
@@ -142,6 +146,7 @@ int BPXFCT();
 int BPXLST();
 int BPXGGN();
 int BPXGPN();
+int BPXLSK();
 
 #define MAX_ENTRY_BUFFER_SIZE 2550
 #define MAX_NUM_ENTRIES       1000
@@ -370,6 +375,53 @@ int fileWrite(UnixFile *file, const char *buffer, int desiredBytes,
   return returnValue;
 }
 
+int fileSeek(UnixFile *file, int64 offset, int whence,
+             int *returnCode, int *reasonCode) {
+  if (file == NULL) {
+#ifdef METTLE
+    *returnCode = -1;
+    *reasonCode = 0;
+#else
+    *returnCode = EINVAL;
+    *reasonCode = 0;
+#endif
+    return -1;
+  }
+
+  int fd = file->fd;
+  int returnValue = 0;
+  int *reasonCodePtr;
+  int64 newOffset = offset;
+
+#ifndef _LP64
+  reasonCodePtr = (int*) (0x80000000 | ((int)reasonCode));
+#else
+  reasonCodePtr = reasonCode;
+#endif
+
+  BPXLSK(&fd,
+         &newOffset,
+         &whence,
+         &returnValue,
+         returnCode,
+         reasonCodePtr);
+
+  if (returnValue < 0) {
+    if (fileTrace) {
+      zowelog(NULL, LOG_COMP_ZOS, ZOWE_LOG_DEBUG, "BPXLSK FAILED: returnValue: %d, returnCode: %d, reasonCode: 0x%08x\n",
+              returnValue, *returnCode, *reasonCode);
+    }
+    return -1;
+  }
+  *returnCode = 0;
+  *reasonCode = 0;
+  /* whatever was buffered for fileGetChar belongs to the old position */
+  file->bufferPos = 0;
+  file->bufferFill = 0;
+  file->eofKnown = FALSE;
+  return 0;
+}
+
 int fileGetChar(UnixFile *file, int *returnCode, int *reasonCode) {
   zowelog(NULL, LOG_COMP_ZOS, ZOWE_LOG_DEBUG3, "bufferSize = %d\n",file->bufferSize);
   if (file->bufferSize == 0){
@@ -978,6 +1030,10 @@ int fileInfoUnixModificationTime(const FileInfo *info){
   return info->lastModificationTime;
 }
 
+int fileInfoUnixStatusChangeTime(const FileInfo *info){
+  return info->lastFileStatusChangeTime;
+}
+
 int fileEOF(const UnixFile *file) {
   return ((file->bufferPos >= file->bufferFill) && file->eofKnown);
 }
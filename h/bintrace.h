@@ -0,0 +1,147 @@
+
+
+/*
+  This program and the accompanying materials are
+  made available under the terms of the Eclipse Public License v2.0 which accompanies
+  this distribution, and is available at https://www.eclipse.org/legal/epl-v20.html
+
+  SPDX-License-Identifier: EPL-2.0
+
+  Copyright Contributors to the Zowe Project.
+*/
+
+#ifndef __BINTRACE__
+#define __BINTRACE__ 1
+
+#include "zowetypes.h"
+#ifndef METTLE
+#include <stdio.h>
+#endif
+
+/*
+  Binary trace.
+
+  A deferred-formatting trace for hot paths.  Each call site owns a static format, and a trace
+  point stores only the format id, a timestamp and the raw argument values into a circular
+  buffer that belongs to the calling thread.  Nothing is formatted and nothing is written until
+  the buffers are dumped, so detailed tracing can stay on in production:
+
+    static BinaryTraceFormat headerByte = BINARY_TRACE_FORMAT("header byte 0x%02x at %d\n");
+    ...
+    BINARY_TRACE(&headerByte, c, pos);
+
+  binaryTraceDump writes the recent records of every thread together with the format table,
+  and binaryTraceDecode (or the decoder built from bintrace.c with BINARY_TRACE_DECODER
+  defined) renders a dump as text, ordered by time.
+
+  The values of the format's conversions are captured at the trace point: integers and pointers
+  by value, doubles by bit pattern and strings by copying them into the record, truncated to
+  what is left of BINARY_TRACE_TEXT_SIZE.  '*' widths and precisions count as int arguments.  A
+  format can have at most BINARY_TRACE_MAX_ARGS conversions; further ones render as "?".
+
+  Binary tracing is not available under METTLE, where trace points compile to nothing.
+ */
+
+#define BINARY_TRACE_MAX_ARGS            6
+#define BINARY_TRACE_TEXT_SIZE          64
+#define BINARY_TRACE_DEFAULT_RECORDS  4096
+
+#define BINARY_TRACE_ARG_NONE    0
+#define BINARY_TRACE_ARG_INT     1
+#define BINARY_TRACE_ARG_INT64   2
+#define BINARY_TRACE_ARG_DOUBLE  3
+#define BINARY_TRACE_ARG_POINTER 4
+#define BINARY_TRACE_ARG_STRING  5
+#define BINARY_TRACE_ARG_LONG_DOUBLE 6   /* recorded as a double */
+
+typedef struct BinaryTraceFormat_tag{
+  char *format;
+  volatile int id;                            /* 0 until the first trace through this format */
+  int argCount;
+  char argKinds[BINARY_TRACE_MAX_ARGS];
+} BinaryTraceFormat;
+
+#define BINARY_TRACE_FORMAT(formatString) { (formatString), 0, 0, {0} }
+
+/* 128 bytes, so that records never straddle more cache lines than they need to */
+typedef struct BinaryTraceRecord_tag{
+  uint64 timestamp;                           /* microseconds since the Unix epoch */
+  int    formatID;
+  unsigned short sequence;                    /* low bits of the record's position, for torn-read detection */
+  unsigned char  argCount;
+  unsigned char  textLength;
+  uint64 args[BINARY_TRACE_MAX_ARGS];         /* strings hold offset | length << 16 into text */
+  char   text[BINARY_TRACE_TEXT_SIZE];
+} BinaryTraceRecord;
+
+#ifdef METTLE
+
+#define BINARY_TRACE(...) do {} while (0)
+
+#else
+
+#ifndef __LONGNAME__
+
+#define binaryTraceActive BTRACTIV
+#define binaryTraceStart BTRSTART
+#define binaryTraceStop BTRSTOP
+#define binaryTraceRegister BTRREGFM
+#define binaryTraceRecord BTRRECRD
+#define binaryTraceDump BTRDUMP
+#define binaryTraceDumpFile BTRDUMPF
+#define binaryTraceDecode BTRDECOD
+
+#endif
+
+extern volatile int binaryTraceActive;
+
+/* A trace point costs a single load and branch while binary tracing is off */
+#define BINARY_TRACE(...) \
+  do { if (binaryTraceActive) { binaryTraceRecord(__VA_ARGS__); } } while (0)
+
+/*
+  Starts binary tracing with a circular buffer of recordsPerThread records (rounded up to a
+  power of two) for each thread that traces.  Buffers of threads that have ended are kept for
+  the dump and reused by new threads.  Returns 0, or -1 if tracing is already active.
+ */
+int binaryTraceStart(int recordsPerThread);
+
+/* Stops recording; the buffers are kept so that they can still be dumped */
+void binaryTraceStop(void);
+
+/* Assigns the format an id; BINARY_TRACE does this on first use, so calling it is optional */
+int binaryTraceRegister(BinaryTraceFormat *format);
+
+void binaryTraceRecord(BinaryTraceFormat *format, ...);
+
+/*
+  Writes the records of the last 'seconds' seconds (all of them if seconds <= 0) to out in the
+  binary dump format.  Returns the number of records written or -1.
+ */
+int binaryTraceDump(FILE *out, int seconds);
+
+int binaryTraceDumpFile(char *path, int seconds);
+
+/*
+  Renders a binary dump as text, one line per record, merged across threads in timestamp order.
+  Dumps from a host of the other byte order are swapped, and EBCDIC dumps are translated on
+  ASCII hosts and vice versa.  Returns the number of records rendered or -1 if the input is not
+  a binary trace dump.
+ */
+int binaryTraceDecode(FILE *in, FILE *out);
+
+#endif /* not METTLE */
+
+#endif /* __BINTRACE__ */
+
+
+/*
+  This program and the accompanying materials are
+  made available under the terms of the Eclipse Public License v2.0 which accompanies
+  this distribution, and is available at https://www.eclipse.org/legal/epl-v20.html
+
+  SPDX-License-Identifier: EPL-2.0
+
+  Copyright Contributors to the Zowe Project.
+*/
+
@@ -111,6 +111,7 @@ ZOWE_PRAGMA_PACK_RESET
 #define freeSocketSet FRESOCST
 #define socketSetAdd SOCSTADD
 #define socketSetRemove SOCSTREM
+#define setSocketSetIdleTimeLimit SOCSTITL
 #define tcpStatus TCPSTTUS
 #define socketRead SOCREAD
 #define socketWrite SOCWRITE
@@ -272,6 +273,8 @@ typedef struct SocketSet_tag{
 #error Unknown OS
 #endif
   int  revisionNumber;
+  int  idleTimeLimit;  /* seconds a peer may sit without traffic, 0 for no limit; enforced by the
+                          socket's owner, see setSocketSetIdleTimeLimit */
 } SocketSet;
 
 typedef struct hostent_tag{
@@ -402,6 +405,7 @@ SocketSet *makeSocketSet(int highestAllowedSD);
 void freeSocketSet(SocketSet *set);
 int socketSetAdd(SocketSet *set, Socket *socket);
 int socketSetRemove(SocketSet *set, Socket *socket);
+void setSocketSetIdleTimeLimit(SocketSet *set, int idleSeconds);
 
 #if defined(__ZOWE_OS_LINUX) || defined(__ZOWE_OS_AIX)
 /*
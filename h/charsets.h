@@ -83,6 +83,10 @@
  *   and a variety of output memory management options.   IF the output mode is set ot CHARSET_OUTPUT_USE_BUFFER
  *   is used and the output buffer is short, bad things will happen.   Keep in mind that some conversions will produce
  *   output that is 2-3 times longer than the input.  
+ *
+ *   Where conversion is built on iconv, any CCSID in ccsidList.c is accepted, and pairs of two
+ *   single-byte charsets, or of a single-byte charset and UTF-8, are converted by lookup tables
+ *   that are built on first use.
  */
 
 int convertCharset(char *input, 
@@ -96,6 +100,53 @@ int convertCharset(char *input,
                    int *conversionOutputLength, 
                    int *reasonCode);
 
+#ifndef __LONGNAME__
+
+#define makeCharsetConverter CHRMKCNV
+#define charsetConverterConvert CHRCNVRT
+#define charsetConverterFinish CHRCNVFN
+#define freeCharsetConverter CHRFRCNV
+
+#endif
+
+typedef struct CharsetConverter_tag CharsetConverter;
+
+/**
+ *   A CharsetConverter converts a stream that arrives in chunks.  Unlike convertCharset, it keeps
+ *   the shift state between calls and holds back a multibyte character that is split across
+ *   chunks until the next chunk completes it.  It is built on iconv; where that is not available
+ *   makeCharsetConverter returns NULL with *reasonCode set to CHARSET_CONVERSION_UNIMPLEMENTED
+ *   and callers should use convertCharset.  A converter may move between threads but must not
+ *   be used by two threads at once.
+ */
+
+CharsetConverter *makeCharsetConverter(int inputCCSID, int outputCCSID, int *reasonCode);
+
+/**
+ *   Converts the next chunk of the stream into output.  *inputConsumed and *outputProduced report
+ *   how far the conversion got.  On CHARSET_SHORT_BUFFER the caller drains the output and calls
+ *   again with the rest of the input.  Trailing bytes of an incomplete character count as
+ *   consumed.
+ */
+
+int charsetConverterConvert(CharsetConverter *converter,
+                            char *input, int inputLength,
+                            char *output, int outputLength,
+                            int *inputConsumed, int *outputProduced,
+                            int *reasonCode);
+
+/**
+ *   Ends the stream, writing any sequence that returns a stateful encoding to its initial state,
+ *   and readies the converter for a new stream.  Fails with CHARSET_CONVERSION_ROUTINE_FAILURE if
+ *   the stream ended in the middle of a character.
+ */
+
+int charsetConverterFinish(CharsetConverter *converter,
+                           char *output, int outputLength,
+                           int *outputProduced, int *reasonCode);
+
+void freeCharsetConverter(CharsetConverter *converter);
+
 /**
    Returns -1 if charsetName is not known.
    
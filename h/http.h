@@ -201,6 +201,17 @@ char *toASCIIUTF8(char *buffer, int len);
 
 int writeFully(Socket *socket, char *buffer, int len);
 
+typedef struct HttpIOVector_tag{
+  char *data;
+  int   length;
+} HttpIOVector;
+
+/* a hint that more output follows soon, so the network layer may hold back a partial segment */
+#define HTTP_WRITE_MORE_TO_FOLLOW 0x0001
+
+int writeFullyVector(Socket *socket, HttpIOVector *vector, int count, int flags);
+int writeFullyFromFile(Socket *socket, int fd, int64 offset, int64 length);
+
 static const char methodGET[] = { 0x47, 0x45, 0x54, 0x00 };
 static const char methodPOST[] = { 0x50, 0x4f, 0x53, 0x54, 0x00 };
 static const char methodPUT[] = { 0x50, 0x55, 0x54, 0x00 };
@@ -47,6 +47,11 @@ extern "C" {
 #define HTTP_CLIENT_RESPONSE_ZEROLEN      16
 #define HTTP_CLIENT_TLS_ERROR             17
 #define HTTP_CLIENT_TLS_NOT_CONFIGURED    18
+#define HTTP_CLIENT_TIMEOUT               19
+#define HTTP_CLIENT_ABORTED               20
+#define HTTP_CLIENT_FILE_ERROR            21
+#define HTTP_CLIENT_BODY_TOO_LARGE        22
+#define HTTP_CLIENT_JSON_PARSE_FAILED     23
 
 typedef struct HttpClientSettings_tag {
   char *host;
@@ -62,16 +67,27 @@ typedef struct HttpClientContext_tag {
 #ifdef USE_ZOWE_TLS
   TlsEnvironment *tlsEnvironment;
 #endif
+  struct HttpClientPool_tag *pool; /* idle keep-alive connections to serverAddress */
 } HttpClientContext;
 
 typedef struct HttpClientResponse_tag {
   int statusCode;
-  int contentLength;
+  int contentLength; /* when streaming, the announced length or -1 */
   ShortLivedHeap *slh;
   HttpHeader *headers;
-  char *body;
+  char *body;        /* NULL when streaming */
+  char *statusReason; /* native */
+  int keepAlive;     /* the server will take another request on this connection */
 } HttpClientResponse;
 
+/*
+  Streaming receive: the response handler is called once the status line and headers are parsed,
+  then the body handler gets the entity body, de-chunked, as it arrives.  Either one returns
+  non-zero to abandon the response.
+ */
+typedef int HttpClientResponseHandler(HttpClientResponse *response, void *userData);
+typedef int HttpClientBodyHandler(char *data, int length, void *userData);
+
 typedef struct HttpResponseParser_tag {
   ShortLivedHeap *slh;
   int state;
@@ -94,6 +110,18 @@ typedef struct HttpResponseParser_tag {
   char *content;
   int httpStatusCode;
   HttpClientResponse *resp;
+  int connectionClose;     /* Connection: close */
+  int connectionKeepAlive; /* Connection: keep-alive, for HTTP/1.0 servers */
+  int noBody;              /* response to HEAD */
+  int readUntilClose;      /* body has neither a length nor chunking */
+  int aborted;             /* a handler asked to stop */
+  HttpClientResponseHandler *responseHandler;
+  HttpClientBodyHandler *bodyHandler;
+  void *handlerData;
+  char *streamBuffer;      /* socket reads in streaming mode */
+  char *pendingBody;       /* httpClientSessionReadBody: body bytes from the last read */
+  int pendingBodyLength;
+  int pendingBodyTaken;    /* pendingBody was handed out, reuse it on the next read */
 } HttpResponseParser;
 
 typedef struct HttpClientSession_tag {
@@ -102,6 +130,9 @@ typedef struct HttpClientSession_tag {
   HttpRequest *request;
   HttpResponseParser *responseParser;
   HttpClientResponse *response;
+  HttpClientContext *context;
+  int reusedConnection; /* the socket came from the context's pool */
+  int tlsDataMayBePending; /* the last read filled the buffer, see waitForResponseData */
 } HttpClientSession;
 
 void httpClientSettingsDestroy(HttpClientSettings *settings);
@@ -111,6 +142,16 @@ void httpClientContextDestroy(HttpClientContext *ctx);
 
 int httpClientContextInit(HttpClientSettings *settings, LoggingContext *logContext, HttpClientContext **outCtx);
 
+/*
+  Contexts do not pool connections until this is called.  Sessions on a context then take an idle
+  connection from its pool when there is one that is still open and not older than maxIdleSeconds.
+  httpClientSessionDestroy puts the connection back when the session's last response was read
+  completely and the server allows keep-alive.  At most maxIdle connections are kept, 0 turns
+  pooling off.  The server may close an idle connection just as it is handed out, so a request that
+  fails on a session with reusedConnection set should only be sent again if it is idempotent.
+ */
+void httpClientContextSetPool(HttpClientContext *ctx, int maxIdle, int maxIdleSeconds);
+
 #ifdef USE_ZOWE_TLS
 int httpClientContextInitSecure(HttpClientSettings *settings,
                                 LoggingContext *logContext,
@@ -156,6 +197,39 @@ int httpClientSessionReceiveNative(HttpClientContext *ctx, HttpClientSession *se
 /* returns 0 when read/parse loop makes session->response non-NULL */
 int httpClientSessionReceiveNativeLoop(HttpClientContext *ctx, HttpClientSession *session);
 
+/* reads the whole response, handing it to the handlers instead of buffering the body;
+   waits at most the context's timeout for each read, returns 0 once the response is complete */
+int httpClientSessionReceiveStream(HttpClientContext *ctx,
+                                   HttpClientSession *session,
+                                   HttpClientResponseHandler *responseHandler,
+                                   HttpClientBodyHandler *bodyHandler,
+                                   void *userData);
+
+/*
+  Pull-style streaming.  httpClientSessionReceiveHead reads up to the end of the response
+  headers.  Each httpClientSessionReadBody call then returns the next de-chunked run of body bytes,
+  in a buffer that is valid until the next call.  *outLength is 0 once the body is complete, and
+  session->response is set.
+ */
+int httpClientSessionReceiveHead(HttpClientContext *ctx, HttpClientSession *session,
+                                 HttpClientResponse **outResponse);
+int httpClientSessionReadBody(HttpClientContext *ctx, HttpClientSession *session,
+                              char **outData, int *outLength);
+
+/*
+  Streams a 2xx response body into filename, which is created or truncated.  Other responses are
+  read and discarded without touching the file, so check session->response->statusCode.
+ */
+int httpClientSessionReceiveToFile(HttpClientContext *ctx, HttpClientSession *session,
+                                   const char *filename, int64 *outBytesWritten);
+
+/*
+  Collects the body, up to maxBodySize bytes, and parses it as UTF-8 JSON into session->slh.  Unlike
+  httpClientSessionReceiveNative this is not bounded by the response parser's maxResponseSize.
+ */
+int httpClientSessionReceiveJson(HttpClientContext *ctx, HttpClientSession *session, int maxBodySize,
+                                 Json **outJson, char *errorBufferOrNull, int errorBufferSize);
+
 #ifdef __cplusplus
 }
 #endif
@@ -64,6 +64,31 @@
 
 #define HTTP_SERVER_PRIVILEGED_SERVER_PROPERTY  "zisServerName"
 
+/* Content codings for response compression.  Compression itself needs the
+   server to be built with USE_ZLIB; without it everything is sent identity. */
+#define HTTP_CONTENT_CODING_IDENTITY 0
+#define HTTP_CONTENT_CODING_GZIP     1
+#define HTTP_CONTENT_CODING_DEFLATE  2
+
+#define HTTP_COMPRESSION_DEFAULT_LEVEL    6
+#define HTTP_COMPRESSION_DEFAULT_MIN_SIZE 1024
+
+/* Static file cache: stat-validated metadata for served files, plus the bytes of small
+   files that are sent raw.  Zero entries disables it. */
+#define HTTP_FILE_CACHE_DEFAULT_MAX_ENTRIES   512
+#define HTTP_FILE_CACHE_DEFAULT_MAX_FILE_SIZE (64*1024)
+#define HTTP_FILE_CACHE_DEFAULT_MAX_BYTES     (16*1024*1024)
+
+#define HTTP_SESSION_CACHE_DEFAULT_MAX_ENTRIES 4096
+#define HTTP_SESSION_CACHE_DEFAULT_TTL_SECONDS 60
+
+/* Admission control.  Connection and per-client limits are off by default; the timeouts close
+   keep-alive connections that sit idle and clients that trickle in a request's header. */
+#define HTTP_DEFAULT_MAX_CONNECTIONS          0
+#define HTTP_DEFAULT_IDLE_TIMEOUT_SECONDS     300
+#define HTTP_DEFAULT_REQUEST_TIMEOUT_SECONDS  60
+#define HTTP_OVERLOAD_RETRY_AFTER_SECONDS     5
+
 #define HTTP_REQUEST_HEAP_DEFAULT_BLOCKS 1024
 #define HTTP_REQUEST_HEAP_MIN_BLOCKS 100
 #define HTTP_REQUEST_HEAP_MAX_BLOCKS 4096
@@ -84,7 +109,18 @@ typedef struct ChunkedOutputStream_tag{
   int     fill;
   struct  HttpResponse_tag *response;
   bool    isErrorState;
-
+  /* header block held back by writeHeader so it can go out with the first chunk */
+  char   *pendingHeader;
+  int     pendingHeaderLength;
+  /* compression stage, the coding is offered at creation and settled at the first flush */
+  int     offeredCoding;
+  int     contentCoding;
+  bool    codingDecided;
+  int     compressionLevel;
+  int     compressionMinSize;
+  void   *compressor;
+  char   *compressBuffer;
+  int     compressBufferSize;
 } ChunkedOutputStream;
 
 typedef struct HttpRequestParser{
@@ -211,6 +247,8 @@ typedef struct HttpService_tag{
   AuthValidate                   *authValidateFunction;
 #define SERVICE_AUTH_FLAG_OPTIONAL 1
   int    authFlags;
+  struct HttpServiceMetrics_tag *metrics; /* set when registered */
+  struct HttpProxyUpstream_tag *proxyUpstream; /* proxy service only, NULL if transform-only */
 } HttpService;
 
 typedef struct HTTPServerConfig_tag {
@@ -229,6 +267,17 @@ typedef struct HTTPServerConfig_tag {
      a near-global way to get configuration data.
      */
   ConfigManager *configmgr;
+  int compressionLevel;   /* 0 disables response compression */
+  int compressionMinSize; /* smaller responses are sent identity */
+  int fileCacheMaxEntries;
+  int fileCacheMaxFileSize; /* largest file whose content is kept */
+  int64 fileCacheMaxBytes;  /* total content kept */
+  int sessionCacheMaxEntries;
+  int sessionCacheTTLSeconds;
+  int maxConnections;        /* 0 for no limit */
+  int clientRequestRate;     /* requests per second per client address, 0 for no limit */
+  int clientRequestBurst;
+  int requestTimeoutSeconds; /* to receive the headers, then between body reads, 0 for no limit */
 } HttpServerConfig;
 
 #define SESSION_TOKEN_COOKIE_NAME "jedHTTPSession"
@@ -246,6 +295,12 @@ typedef struct HttpServer_tag{
   bool              singleUserMode;
   char             *singleUserAuthBlob;
   char             *cookieName; /* name of the cookie, or SESSION_TOKEN_COOKIE_NAME otherwise */ 
+  struct HttpFileCache_tag *fileCache; /* NULL when disabled */
+  struct HttpSessionCache_tag *sessionCache; /* also holds the revoked sessions */
+  struct WSGroupRegistry_tag *wsGroups; /* topic -> WSGroup */
+  struct HttpServerMetrics_tag *metrics;
+  struct HttpAdmission_tag *admission; /* per-client request buckets */
+  hashtable        *mimeTypes;         /* extension -> MimeType */
 } HttpServer;
 
 #define httpServerConfigManager(s) ((s)->config->configmgr)
@@ -307,8 +362,14 @@ typedef struct WSSession_tag {
   int               isOutputBinary;
   int               outputCCSID;
   void             *userPointer;
+  struct WSDeflate_tag *deflate; /* permessage-deflate state, NULL unless negotiated */
+  int               pendingOutputFrames; /* queued for writing, updated atomically */
 } WSSession;
 
+typedef struct WSGroup_tag WSGroup;
+
+#define WS_GROUP_DEFAULT_MAX_BACKLOG 256
+
 /*
   An HttpConversation is a single-struct omnibus data structure
   for integrating Http and WebSocket services into an asynchronous
@@ -409,6 +470,12 @@ typedef struct HttpConversation_tag{
   int                zeroLengthReadCount;
   int                requestCount;
   bool               isKeepAlive;
+  int64              requestStartMicros;  /* when the request being read first had bytes, 0 between requests */
+  int64              requestParseMicros;
+  int64              responseWriteMicros; /* blocked in socket writes for the current response */
+  int                responseStatus;
+  int64              lastActivityMicros;  /* last read, or the end of the last response */
+  int64              clientAddress;       /* IPv4 address keying the rate limit, -1 when not limited */
 } HttpConversation;
 
 typedef struct HttpWorkElement_tag{
@@ -420,6 +487,7 @@ typedef struct HttpWorkElement_tag{
   int               reclaimAfterWrite;
   int               wsResponseIsBinary;
   int               wsResponseIsLastFrame;
+  struct WSSharedFrame_tag *sharedFrame; /* written instead of buffer, see wsGroupBroadcastText */
 } HttpWorkElement;
 
 /** registerHttpServerModuleWithBase is the function make an HTTP server get associated to an STCBase
@@ -433,6 +501,74 @@ void registerHttpServerModuleWithBase(HttpServer *server, STCBase *base);
 int httpServerSetSessionTokenKey(HttpServer *server, unsigned int size,
                                   unsigned char key[]);
 
+/**
+ *  Sets the zlib level (1-9, 0 to disable) and the minimum body size for compressing responses
+ *  to clients that send Accept-Encoding.  The level also applies to WebSocket messages when the
+ *  client offers permessage-deflate; 0 declines the extension.  Has no effect unless built with
+ *  USE_ZLIB.
+ */
+void httpServerSetCompression(HttpServer *server, int level, int minSize);
+
+/**
+ *  Sizes the static file cache: the number of paths remembered, the largest file whose content
+ *  is held in memory and the total bytes of content held.  Entries are checked against the file's
+ *  size, modification time and inode on every request.  maxEntries of 0 disables the cache.
+ */
+void httpServerSetFileCache(HttpServer *server, int maxEntries, int maxFileSize, int64 maxBytes);
+
+/**
+ *  Sizes the cache of checked session tokens.  A cached token, and the tokens that renew it, are
+ *  trusted for up to ttlSeconds after the user's session length was looked up, and never past their
+ *  own expiry.  maxEntries of 0 disables the cache.
+ */
+void httpServerSetSessionCache(HttpServer *server, int maxEntries, int ttlSeconds);
+
+/**
+ *  Ends the session of the session token (the cookie value): it and every token that renewed it or
+ *  would renew it are rejected from now on.  The rejection is kept, whether the cache is enabled or
+ *  not, until no token of the session can still be valid.
+ */
+void httpServerInvalidateSessionToken(HttpServer *server, char *tokenText);
+
+/**
+ *  For a logout service: ends the session of the request's session token, if it has one, and
+ *  makes the response clear the cookie.
+ */
+void httpServerLogout(HttpService *service, HttpRequest *request, HttpResponse *response);
+
+/**
+ *  Adds or replaces the MIME type served for files with the given extension (no dot), and whether
+ *  such files are sent as binary.  Meant for configuration time, before the server is started.
+ */
+void httpServerAddMimeType(HttpServer *server, const char *extension, const char *mimeType, int isBinary);
+
+/**
+ *  Caps the number of open connections.  Connections accepted past the cap are answered with a
+ *  503 and closed before any request is read.  0 removes the cap.
+ */
+void httpServerSetConnectionLimit(HttpServer *server, int maxConnections);
+
+/**
+ *  Limits each client IPv4 address to requestsPerSecond, allowing bursts of up to burst requests
+ *  (burst of 0 means requestsPerSecond).  Requests over the limit get a 429 with Retry-After, and
+ *  connections from a client with no requests left are refused the same way.  0 disables it.
+ */
+void httpServerSetClientRateLimit(HttpServer *server, int requestsPerSecond, int burst);
+
+/**
+ *  Closes HTTP connections that wait idleSeconds between requests, and answers 408 to clients
+ *  that take longer than requestSeconds to send the headers of a request once they have started,
+ *  or that then stop sending the body for longer than requestSeconds.  The idle limit is kept on
+ *  the base's SocketSet.  WebSocket sessions are exempt.  0 disables either check.
+ */
+void httpServerSetTimeouts(HttpServer *server, int idleSeconds, int requestSeconds);
+
+/**
+ *  Limits the requests a registered service runs at once.  Requests past the limit get a 503
+ *  with Retry-After without being authenticated.  Returns -1 if the service is not registered.
+ */
+int httpServiceSetMaxInFlight(HttpService *service, int maxInFlight);
+
 /**
  *  Register an HttpService to an HttpServer.   When the server is called the service function of this service
  *  function of this service will be called.   There are default services provided to provide standard static content.
@@ -515,6 +651,17 @@ HttpService *makeFileService(char *name, char *urlMask, char *pathRoot);
 HttpService *makeGeneratedService(char *name, char *urlMask);
 HttpService *makeSimpleTemplateService(char *name, char *urlMask, char *templatePath);
 
+/**
+ *  Makes a service that reports the server's metrics: connection, queue and
+ *  in-flight gauges, byte counters, and per-service request counts and latency histograms for
+ *  the parse, auth, handler and write phases.  It answers in the Prometheus text format, or in
+ *  JSON with percentiles when asked with ?format=json or Accept: application/json.  It takes a
+ *  session token or JWT like the server's other services.  Setting its authType to
+ *  SERVICE_AUTH_NONE opens it to scrapers without credentials, which also shows them the
+ *  service names.
+ */
+HttpService *makeMetricsService(char *name, char *urlMask);
+
 #define HTTP_PROXY_OK 0 
 #define HTTP_PROXY_BLOCK 1
 
@@ -524,6 +671,32 @@ HttpService *makeProxyService(char *name,
                                                         HttpRequest *inputRequest,
                                                         HttpRequest *outputRequest));
 
+#define HTTP_PROXY_DEFAULT_MAX_ACTIVE      64
+#define HTTP_PROXY_DEFAULT_MAX_IDLE        16
+#define HTTP_PROXY_DEFAULT_IDLE_SECONDS    30
+#define HTTP_PROXY_DEFAULT_TIMEOUT_SECONDS 30
+
+/**
+ *  Makes a proxy service that forwards matching requests to host:port and streams the responses
+ *  back.  The transformer may be NULL.  If given, it can set the method, URI, headers or body of
+ *  the outgoing request (anything left NULL is copied from the client's request), or return
+ *  HTTP_PROXY_BLOCK to refuse the request with a 403.  Returns NULL if the host cannot be resolved.
+ */
+HttpService *makeReverseProxyService(char *name,
+                                     char *urlMask,
+                                     char *host,
+                                     int port,
+                                     int (*requestTransformer)(HttpConversation *conversation,
+                                                               HttpRequest *inputRequest,
+                                                               HttpRequest *outputRequest));
+
+/**
+ *  Bounds a reverse proxy: requests in flight to the upstream (more get a 503), idle keep-alive
+ *  connections kept and for how long, and the connect and read timeout (a 504 if nothing came back).
+ */
+void proxyServiceSetLimits(HttpService *service, int maxActive, int maxIdle,
+                           int idleSeconds, int timeoutSeconds);
+
 HttpResponse *pseudoRespond(HttpServer *server, HttpRequest *request, ShortLivedHeap *slh);
 
 char *getQueryParam(HttpRequest *request, char *paramName);
@@ -542,6 +715,38 @@ HttpService *makeWebSocketService(char *name, char *urlMask, WSEndpoint *endpoin
 jsonPrinter *initWSJsonPrinting(WSSession *session, int maxFrameSize);
 void flushWSJsonPrinting(WSSession *session);
 
+/**
+ *  Finds the WebSocket group for a topic, making it on first use.  Groups live as long as the
+ *  server; sessions leave them on their own when the connection closes.  Returns NULL under
+ *  METTLE, which has no groups; the calls below treat a NULL group as an empty one.
+ */
+WSGroup *getWSGroup(HttpServer *server, char *topic);
+
+/**
+ *  Sets how many frames may be queued to a member and not yet written before the member is
+ *  dropped from the group and its connection closed.  The default is WS_GROUP_DEFAULT_MAX_BACKLOG.
+ */
+void wsGroupSetMaxBacklog(WSGroup *group, int maxBacklog);
+
+/** Adds a session to a group, returns the number of members, or -1 for a NULL group. */
+int wsGroupJoin(WSGroup *group, WSSession *session);
+void wsGroupLeave(WSGroup *group, WSSession *session);
+
+/**
+ *  Sends one message to every member of the group.  The frame is built once, in UTF-8 for text
+ *  given in the ccsid, and shared by all the members' output queues.  Members in the middle of a
+ *  fragmented message of their own are skipped and counted, see wsGroupGetDroppedCount.  Returns
+ *  the number of sessions it was queued to, or -1 if the text could not be converted.
+ */
+int wsGroupBroadcastText(WSGroup *group, char *text, int length, int ccsid);
+int wsGroupBroadcastBinary(WSGroup *group, char *data, int length);
+
+/**
+ *  How many deliveries the group gave up on: members dropped for their backlog, and members
+ *  that missed a broadcast because they were in the middle of a message.
+ */
+int64 wsGroupGetDroppedCount(WSGroup *group);
+
 void respondWithUnixFile2(HttpService* service, HttpResponse* response, char* absolutePath, int jsonMode, int autocvt, bool asB64);
 void respondWithUnixFileContents(HttpResponse* response, char *absolutePath, int jsonMode);
 void respondWithUnixFileContents2(HttpService* service, HttpResponse* response, char *absolutePath, int jsonMode);
@@ -571,6 +776,8 @@ int shouldContinueGivenAllowedMethods(HttpResponse *response,
 
 void writeString(ChunkedOutputStream *s, char *string);
 void writeBytes(ChunkedOutputStream *s, char *data, int len, int translate);
+/* sends what was written so far now, rather than when the stream's buffers fill */
+void flushChunkedOutput(ChunkedOutputStream *s, int translate);
 
 void *getConfiguredProperty(HttpServer *server, char *key);
 
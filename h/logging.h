@@ -34,7 +34,11 @@ ZOWE_PRAGMA_PACK
 typedef struct LoggingComponent_tag{
   void *subcomponents;
   unsigned char flags;
-#define LOG_COMP_FLAG_REGISTERED  0x01
+#define LOG_COMP_FLAG_REGISTERED   0x01
+#define LOG_COMP_FLAG_RATE_LIMITED 0x02  /* logSetComponentRateLimit was called for it */
+#define LOG_COMP_FLAG_LEVEL_KNOWN  0x80  /* the bits under LOG_COMP_LEVEL_MASK hold the effective level */
+#define LOG_COMP_LEVEL_MASK        0x70
+#define LOG_COMP_LEVEL_SHIFT       4
   signed char currentDetailLevel;
   unsigned short destination;
   char *name;
@@ -54,6 +58,13 @@ ZOWE_PRAGMA_PACK_RESET
 #define ZOWE_LOG_DEBUG2   4
 #define ZOWE_LOG_DEBUG3   5
 
+/* Builds may define ZOWE_LOG_COMPILED_LEVEL, e.g. as ZOWE_LOG_DEBUG, to compile the zowelog,
+   zowedump and logShouldTrace call sites of more detailed levels out entirely.  */
+#if defined(LOGGING_NO_COMPILED_LEVEL) || !defined(ZOWE_LOG_COMPILED_LEVEL)
+#undef ZOWE_LOG_COMPILED_LEVEL
+#define ZOWE_LOG_COMPILED_LEVEL ZOWE_LOG_DEBUG3
+#endif
+
 #define LOG_DESTINATION_STATE_UNINITIALIZED 0
 #define LOG_DESTINATION_STATE_INIT   1
 #define LOG_DESTINATION_STATE_OPEN   2
@@ -100,6 +111,33 @@ ZOWE_PRAGMA_PACK_RESET
 #define LOG_DEST_PRINTF_STDOUT 0x008F0001
 #define LOG_DEST_PRINTF_STDERR 0x008F0002
 
+/* overflow policies for logConfigureAsyncDestination */
+#define LOG_ASYNC_OVERFLOW_DROP  0   /* drop the record and report the count later */
+#define LOG_ASYNC_OVERFLOW_BLOCK 1   /* wait for the writer to make room */
+
+#define LOG_ASYNC_DEFAULT_CAPACITY 1024
+#define LOG_ASYNC_RECORD_SIZE      512  /* longer records are copied to the heap */
+
+/* fsync policies for logConfigureFileDestination */
+#define LOG_FILE_SYNC_NEVER     0   /* leave it to the file system */
+#define LOG_FILE_SYNC_INTERVAL  1   /* every syncSeconds, from the maintenance thread */
+#define LOG_FILE_SYNC_ALWAYS    2   /* after every write of the buffer */
+
+#define LOG_FILE_DEFAULT_BUFFER_SIZE  65536
+#define LOG_FILE_DEFAULT_FLUSH_MILLIS 1000
+
+typedef struct LogFileOptions_tag {
+  char *path;            /* the active file, rotated files get a timestamp suffix */
+  int   bufferSize;      /* bytes buffered between writes, 0 for the default */
+  int   flushMillis;     /* the longest a record waits in the buffer, 0 for the default */
+  int64 maxFileSize;     /* rotate before the file would grow past this, 0 for no limit */
+  int   rotateSeconds;   /* rotate files this old, 0 for no limit */
+  int   keepFiles;       /* rotated files to keep, earlier runs' included, 0 to keep them all */
+  int   syncPolicy;      /* LOG_FILE_SYNC_* */
+  int   syncSeconds;
+  int   compress;        /* gzip rotated files, needs a build with USE_ZLIB */
+} LogFileOptions;
+
 typedef struct LogComponentsMap_tag {
   uint64 compID;
   const char* name;
@@ -138,6 +176,12 @@ typedef void (*LogHandler)(struct LoggingContext_tag *context,
                            va_list argList);
 typedef char *(*DataDumper)(char *workBuffer, int workBufferSize, void *data, int dataSize, int lineNumber);
 
+/* a key/value pair attached to a record by zowelogFields */
+typedef struct LogField_tag{
+  char *key;
+  char *value;
+} LogField;
+
 ZOWE_PRAGMA_PACK
 
 typedef struct LoggingDestination_tag{
@@ -164,7 +208,8 @@ typedef struct LoggingVendor_tag {
 typedef struct LoggingComponentTable_tag {
   char eyecatcher[8]; /* RSLOGCTB */
   unsigned short componentCount;
-  unsigned short reseved;
+  unsigned short maxLevel;  /* in the Zowe anchor's table only, see LOG_MAX_LEVEL_KNOWN */
+#define LOG_MAX_LEVEL_KNOWN 0x8000  /* the low byte holds the most detailed effective level of any component */
   LoggingComponent components[0];
 } LoggingComponentTable;
 
@@ -179,6 +224,9 @@ typedef struct LoggingContext_tag{
   char eyecatcher[8];   /* RSLOGCTX */
   hashtable *vendorTable;
   LoggingZoweAnchor *zoweAnchor;
+  /* Only logging.c reads past this point, so fields may be added here.  The structs above are
+     embedded in arrays that code built against older headers indexes, so they keep their size. */
+  struct LoggingSideData_tag *sideData;  /* what logging.c keeps about components, see there */
 } LoggingContext;
 
 ZOWE_PRAGMA_PACK_RESET
@@ -267,6 +315,13 @@ extern LoggingContext *theLoggingContext;
 #define logSetExternalContext LGSLOGCX
 #define printStdout LGPRSOUT
 #define printStderr LGPRSERR
+#define logConfigureAsyncDestination LGCFGASY
+#define logFlushAsyncDestination LGFLSASY
+#define logConfigureJsonDestination LGCFGJSN
+#define zowelogFields ZOWELOGF
+#define logConfigureFileDestination LGCFGFIL
+#define logFlushFileDestination LGFLSFIL
+#define logSetComponentRateLimit LGSETRTL
 
 #endif 
 
@@ -291,43 +346,47 @@ bool logShouldTraceInternal(LoggingContext *context, uint64 componentID, int lev
 
 #if !defined(LOGGING_NO_MACRO) && (defined(__clang__) || defined(__GNUC__) || defined (__IBMC__) || defined (__IBMCPP__))
 
+/* Levels above the compiled level fold to FALSE, levels above every component's level are
+   rejected with one compare, otherwise the component's cached effective level decides.  The
+   cache lives in fields that every version of LoggingComponent and LoggingComponentTable had,
+   and a library that does not keep it leaves the KNOWN bits off, so this falls back to
+   logShouldTraceInternal. */
 #define logShouldTrace(context, componentID, level) \
 ({\
-  LoggingContext *cntx = context;\
-  if (cntx == NULL) {\
-    cntx = GET_LOGGING_CONTEXT();\
-  }\
-  uint64 componentIDLocal = componentID;\
-  unsigned short *id = (unsigned short *)&componentIDLocal;\
   bool shouldTrace = FALSE;\
-  if (id[0] == LOG_ZOWE_VENDOR_ID) {\
-    LoggingComponent *component = &cntx->zoweAnchor->topLevelComponent;\
-    do {\
-      /* level #0 */\
-      LoggingComponentTable *componentTable = &cntx->zoweAnchor->topLevelComponentTable;\
-      if (id[1] == 0 || component->currentDetailLevel >= level) { break; }\
-      /* level #1 */\
-      componentTable = component->subcomponents;\
-      component = &componentTable->components[id[1] % componentTable->componentCount];\
-      if (id[2] == 0 || component->currentDetailLevel >= level || component->subcomponents == NULL) { break; }\
-      /* level #2 */\
-      componentTable = component->subcomponents;\
-      component = &componentTable->components[id[2] % componentTable->componentCount];\
-      if (id[3] == 0 || component->currentDetailLevel >= level || component->subcomponents == NULL) { break; }\
-      /* level #3 */\
-      componentTable = component->subcomponents;\
-      component = &componentTable->components[id[3] % componentTable->componentCount];\
-    } while (0);\
-    shouldTrace = component->currentDetailLevel >= level;\
-  } else {\
-    shouldTrace = logShouldTraceInternal(cntx, componentID, level);\
+  if ((level) <= ZOWE_LOG_COMPILED_LEVEL) {\
+    LoggingContext *cntx = context;\
+    if (cntx == NULL) {\
+      cntx = GET_LOGGING_CONTEXT();\
+    }\
+    uint64 componentIDLocal = componentID;\
+    unsigned short *id = (unsigned short *)&componentIDLocal;\
+    unsigned short maxLevel = cntx->zoweAnchor->topLevelComponentTable.maxLevel;\
+    if ((maxLevel & LOG_MAX_LEVEL_KNOWN) && (level) > (maxLevel & 0xFF)) {\
+      shouldTrace = FALSE;\
+    } else if (id[0] == LOG_ZOWE_VENDOR_ID) {\
+      LoggingComponent *component = &cntx->zoweAnchor->topLevelComponent;\
+      for (int i = 1; i < 4 && id[i] != 0; i++) {\
+        LoggingComponentTable *componentTable = component->subcomponents;\
+        if (componentTable == NULL || id[i] >= componentTable->componentCount) { break; }\
+        component = &componentTable->components[id[i]];\
+      }\
+      if (component->flags & LOG_COMP_FLAG_LEVEL_KNOWN) {\
+        shouldTrace = ((component->flags & LOG_COMP_LEVEL_MASK) >> LOG_COMP_LEVEL_SHIFT) >= (level);\
+      } else {\
+        shouldTrace = logShouldTraceInternal(cntx, componentID, level);\
+      }\
+    } else {\
+      shouldTrace = logShouldTraceInternal(cntx, componentID, level);\
+    }\
   }\
   shouldTrace;\
 })
 
 #else /* compilers supporting statement expressions */
 
-#define logShouldTrace logShouldTraceInternal
+#define logShouldTrace(context, componentID, level) \
+  ((level) <= ZOWE_LOG_COMPILED_LEVEL && logShouldTraceInternal(context, componentID, level))
 
 #endif /* compilers NOT supporting statement expressions */
 
@@ -337,6 +396,35 @@ bool logShouldTraceInternal(LoggingContext *context, uint64 componentID, int lev
 void zowelog(LoggingContext *context, uint64 compID, int level, char *formatString, ...);
 void zowedump(LoggingContext *context, uint64 compID, int level, void *data, int dataSize);
 
+/* as zowelog, with key/value fields that structured destinations record and others ignore */
+void zowelogFields(LoggingContext *context, uint64 compID, int level,
+                   LogField *fields, int fieldCount, char *formatString, ...);
+
+#if ZOWE_LOG_COMPILED_LEVEL < ZOWE_LOG_DEBUG3
+
+/* call sites of levels that are compiled out disappear, arguments and all */
+#ifdef __LONGNAME__
+#define LOG_ZOWELOG_FUNCTION zowelog
+#define LOG_ZOWEDUMP_FUNCTION zowedump
+#define LOG_ZOWELOGF_FUNCTION zowelogFields
+#else
+#undef zowelog
+#undef zowedump
+#undef zowelogFields
+#define LOG_ZOWELOG_FUNCTION ZOWELOG
+#define LOG_ZOWEDUMP_FUNCTION ZOWEDUMP
+#define LOG_ZOWELOGF_FUNCTION ZOWELOGF
+#endif
+
+#define zowelog(context, compID, level, ...) \
+  do { if ((level) <= ZOWE_LOG_COMPILED_LEVEL) { LOG_ZOWELOG_FUNCTION(context, compID, level, __VA_ARGS__); } } while (0)
+#define zowedump(context, compID, level, data, dataSize) \
+  do { if ((level) <= ZOWE_LOG_COMPILED_LEVEL) { LOG_ZOWEDUMP_FUNCTION(context, compID, level, data, dataSize); } } while (0)
+#define zowelogFields(context, compID, level, fields, fieldCount, ...) \
+  do { if ((level) <= ZOWE_LOG_COMPILED_LEVEL) { LOG_ZOWELOGF_FUNCTION(context, compID, level, fields, fieldCount, __VA_ARGS__); } } while (0)
+
+#endif /* ZOWE_LOG_COMPILED_LEVEL < ZOWE_LOG_DEBUG3 */
+
 #define LOGCHECK(context,component,level) \
   ((component > MAX_LOGGING_COMPONENTS) ? \
    (context->applicationComponents[component].level >= level) : \
@@ -356,6 +444,66 @@ LoggingDestination *logConfigureDestination2(LoggingContext *context,
                                              DataDumper dumper);
 
 void logConfigureStandardDestinations(LoggingContext *context);
+
+#ifndef METTLE
+/**
+ *  Configures destination id to queue records in a ring of capacity slots (rounded up to a power
+ *  of two) and hand them to the already configured destination targetID from a writer thread.
+ *  Callers only format the record, they never wait for its I/O unless overflowPolicy is
+ *  LOG_ASYNC_OVERFLOW_BLOCK and the ring is full.  Records still queued are written at exit.
+ *  Returns NULL if the target is not configured or is itself asynchronous.
+ */
+LoggingDestination *logConfigureAsyncDestination(LoggingContext *context,
+                                                 unsigned int id,
+                                                 char *name,
+                                                 unsigned int targetID,
+                                                 int capacity,
+                                                 int overflowPolicy);
+
+/**
+ *  Waits, for a bounded time, until the records queued on an asynchronous destination before
+ *  the call have been written.  Does nothing for other destinations.
+ */
+void logFlushAsyncDestination(LoggingDestination *destination);
+
+/**
+ *  Configures destination id to write each record as one line of JSON to the already configured
+ *  destination targetID: time, level, component path, thread, message and any fields passed to
+ *  zowelogFields.  Pointing it at an asynchronous destination moves the writes off the caller.
+ *  Returns NULL if the target is not configured.
+ */
+LoggingDestination *logConfigureJsonDestination(LoggingContext *context,
+                                                unsigned int id,
+                                                char *name,
+                                                unsigned int targetID);
+
+/**
+ *  Configures destination id to append to the file options->path through a user-space buffer.
+ *  A maintenance thread writes records that have waited flushMillis, rotates by age, syncs per
+ *  syncPolicy, and compresses and prunes rotated files.  Size rotation happens on the writing
+ *  thread.  The buffer is written at exit.  Returns NULL if the file cannot be opened.
+ */
+LoggingDestination *logConfigureFileDestination(LoggingContext *context,
+                                                unsigned int id,
+                                                char *name,
+                                                LogFileOptions *options);
+
+/**
+ *  Writes what a file destination has buffered and flushes it.  Does nothing for other
+ *  destinations.
+ */
+void logFlushFileDestination(LoggingDestination *destination);
+
+/**
+ *  Bounds the records of a configured component: at most ratePerSecond, with bursts of up to
+ *  burst, and of the records offered only one in every sampleEvery.  Suppressed records cost a
+ *  lock and a compare, and a background thread sends their count to the component's destination
+ *  in a summary record every 10 seconds while there is something to report.  Zero rate and a
+ *  sampleEvery of 0 or 1 remove the limit.
+ *  Returns RC_LOG_ERROR if the component is not configured.
+ */
+int logSetComponentRateLimit(LoggingContext *context, uint64 compID, int ratePerSecond, int burst, int sampleEvery);
+#endif
 void logConfigureComponent(LoggingContext *context, 
                            uint64 compID,
                            char *compName,
@@ -396,6 +396,7 @@ int setFileTrace(int toWhat);
 #ifndef __LONGNAME__
 
 #define fileWrite   FILWRITE
+#define fileSeek    FILSEEK
 #define fileGetChar FILGTCHR
 #define fileCopy    FILECOPY
 #define fileRename  FILRNAME
@@ -411,6 +412,14 @@ int fileRead(UnixFile *file, char *buffer, int desiredBytes,
 int fileWrite(UnixFile *file, const char *buffer, int desiredBytes,
               int *returnCode, int *reasonCode);
 
+#define FILE_SEEK_SET 0
+#define FILE_SEEK_CUR 1
+#define FILE_SEEK_END 2
+
+/* repositions the file offset, whence is one of FILE_SEEK_x; returns 0 on success, -1 on failure */
+int fileSeek(UnixFile *file, int64 offset, int whence,
+             int *returnCode, int *reasonCode);
+
 int fileGetChar(UnixFile *file, int *returnCode, int *reasonCode);
 
 int fileCopy(const char *existingFile, const char *newFile, int *retCode, int *resCode);
@@ -499,6 +508,7 @@ int fileUnlock(UnixFile *file, int *returnCode, int *reasonCode);
 #define fileUnixCreaionime  FILUXCRT
 #define fileEOF             FILISOEF
 #define fileGetINode        FILGINOD
+#define fileInfoUnixStatusChangeTime FILUXSCT
 #define fileGetDeviceID     FILDEVID
 #define fileClose           FILCLOSE
 
@@ -512,6 +522,7 @@ int setFileInfoCCSID(int ccsid);
 int fileInfoCCSID(const FileInfo *info);
 int fileInfoUnixCreationTime(const FileInfo *info);
 int fileInfoUnixModificationTime(const FileInfo *info);
+int fileInfoUnixStatusChangeTime(const FileInfo *info);
 int fileUnixMode(const FileInfo *info);
 int fileEOF(const UnixFile *file);
 int fileGetINode(const FileInfo *file);
@@ -202,6 +202,9 @@ typedef struct ShortLivedHeap_tag{
 #define encodeBase64NoAlloc ENCDB64N
 #define base64ToBase64url B642BURL
 #define base64urlToBase64 B64URLTB
+#define decodeBase64urlUnterminated DECDBURU
+#define encodeBase64url ENCDBURL
+#define encodeBase64urlNoAlloc ENCDBURN
 #define cleanURLParamValue CLNURLPV
 #define percentEncode PCTENCOD
 #define destructivelyUnasciify DSTUNASC
@@ -254,6 +257,17 @@ int base64ToBase64url(char *s);
  */
 int base64urlToBase64(char *s, int bufSize);
 
+/*
+ * base64url (RFC 4648 section 5) without the rewrites above.  The encoders do not pad.  The
+ * decoder accepts input with or without padding, assumes "EBCDIC base64url" on EBCDIC platforms
+ * and returns -1 if the input has a character outside the alphabet or an impossible length.
+ */
+int decodeBase64urlUnterminated(char *s, char *result, int len);
+char *encodeBase64url(ShortLivedHeap *slh, const char buf[], int size, int *resultSize,
+                      int useEbcdic);
+void encodeBase64urlNoAlloc(const char buf[], int size, char result[], int *resultSize,
+                            int useEbcdic);
+
 char *destructivelyUnasciify(char *s);
 
 int base32Decode (int alphabet,
@@ -21,6 +21,10 @@
 #include "alloc.h"
 #include "timeutls.h"
 #include "logging.h"
+#include "collections.h"
+#ifndef METTLE
+#include "openprims.h"
+#endif
 
 
 /* rscrypto */
@@ -63,8 +67,6 @@ const char *RSJWT_ERROR_DESCRIPTIONS[] = {
 #endif
 
 #define MAX_NPARTS 3
-#define BASE64URL_EXTRA_BYTES 2
-#define BASE64URL_EXTRA_BYTES_TOTAL (BASE64URL_EXTRA_BYTES * MAX_NPARTS)
 
 #ifdef __ZOWE_EBCDIC
 #  define BASE64_IS_EBCDIC 1
@@ -87,7 +89,7 @@ int setJwtTrace(int toWhat) {
 }
 
 /*
- * buf should have extra space for base64url -> base64 conversion
+ * decodedText should have room for the decoded parts and a NUL after each
  */
 static int extractParts(char base64Buf[], int maxParts,
                         char *dparts[],  int pLen[], char *decodedText) {
@@ -99,7 +101,7 @@ static int extractParts(char base64Buf[], int maxParts,
       (part != NULL) && (i < maxParts);
       part = strtok_r(NULL, ".", &tokenizer), i++) {
     dparts[i] = part;
-    pLen[i] = strlen(part) + 1;
+    pLen[i] = strlen(part);
     zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "found part %s, len %u\n", dparts[i],  pLen[i]);
   }
   if ((part != NULL) && (i == maxParts)) {
@@ -107,33 +109,13 @@ static int extractParts(char base64Buf[], int maxParts,
     return  RC_JWT_EXTRA_PART;
   }
   nParts = i;
-  if (nParts > 0) {
-    pLen[nParts - 1] += BASE64URL_EXTRA_BYTES;
-    zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "part %d is now %u bytes\n", nParts - 1, pLen[nParts - 1]);
-  }
-  for (i = nParts - 1; i > 0; i--) {
-    char *moved = dparts[i] + i * BASE64URL_EXTRA_BYTES;
-    zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "adding extra space betwen parts: part %d %p -> %p\n", i, dparts[i],
-          moved);
-    memmove(moved, dparts[i], pLen[i]);
-    dparts[i] = moved;
-    pLen[i - 1] += BASE64URL_EXTRA_BYTES;
-    zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "part %d is now %u bytes\n", i - 1, pLen[i - 1]);
-  }
   for (i = 0; i < nParts; i++) {
     int base64Rc = 0;
 
     zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "decoding part %d: %s[%u]...\n", i, dparts[i], pLen[i]);
-    zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "calling base64urlToBase64()...\n");
-    if ((base64Rc = base64urlToBase64(dparts[i], pLen[i])) < 0) {
-      zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "error: invalid base64url %d\n", base64Rc);
-      return RC_JWT_INVALID_ENCODING;
-    }
-    zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "got base64: %s\n", dparts[i]);
-    zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "calling decodeBase64()...\n");
-    base64Rc = decodeBase64(dparts[i], decodedText);
+    base64Rc = decodeBase64urlUnterminated(dparts[i], decodedText, pLen[i]);
     if (base64Rc < 0) {
-      zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "error: invalid base64\n");
+      zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "error: invalid base64url\n");
       return RC_JWT_INVALID_ENCODING;
     }
     dparts[i] = decodedText;
@@ -427,6 +409,47 @@ static int checkSignature(JwsAlgorithm algorithm,
   return sts;
 }
 
+/*
+ * Signature verification cache.
+ *
+ * The same bearer token comes back on every request of a session, and checking its signature
+ * is the expensive part of parsing it.  Tokens whose signature checked out are remembered by their
+ * text, for the cache TTL and never past the token's exp; failures are not kept, so a flood of bad
+ * tokens cannot push the good ones out.  The token is still decoded and its claims parsed on every
+ * call, so exp and nbf are checked afresh by jwtAreBasicClaimsValid.  There is no lock under
+ * METTLE, so there is no cache either.
+ */
+
+typedef struct JwtVerification_tag {
+  char *tokenText;
+  int tokenTextLength;
+  bool ebcdic;
+  int rc;                     /* what the signature check returned */
+  int64 expiresAt;            /* unix time */
+  struct JwtVerification_tag *newer;
+  struct JwtVerification_tag *older;
+} JwtVerification;
+
+typedef struct JwtVerificationCache_tag {
+#ifndef METTLE
+  Mutex lock;
+#endif
+  hashtable *entries;         /* token text -> JwtVerification */
+  JwtVerification *newest;
+  JwtVerification *oldest;
+  int count;
+  int maxEntries;
+  int ttlSeconds;
+} JwtVerificationCache;
+
+#ifndef METTLE
+#define verificationCacheLock(c) mutexLock((c)->lock)
+#define verificationCacheUnlock(c) mutexUnlock((c)->lock)
+#else
+#define verificationCacheLock(c)
+#define verificationCacheUnlock(c)
+#endif
+
 struct JwtContext_tag {
 #define JWT_CONTEXT_TYPE_PKCS11 1
 #define JWT_CONTEXT_TYPE_CUSTOM 2
@@ -435,15 +458,155 @@ struct JwtContext_tag {
   ICSFP11_HANDLE_T *keyHandle;
   JwtCheckSignature *checkSignatureFn;
   void *userData;
+  JwtVerificationCache *verificationCache; /* NULL when disabled */
 };
 
+static int64_t currentUnixTime(void) {
+  int64_t stck; getSTCK(&stck);
+  return stckToUnix(stck);
+}
+
+/* caller holds the lock */
+static void removeVerification(JwtVerificationCache *cache, JwtVerification *entry) {
+  htRemove(cache->entries, entry->tokenText);
+  if (entry->older) {
+    entry->older->newer = entry->newer;
+  } else {
+    cache->oldest = entry->newer;
+  }
+  if (entry->newer) {
+    entry->newer->older = entry->older;
+  } else {
+    cache->newest = entry->older;
+  }
+  cache->count--;
+  safeFree(entry->tokenText, entry->tokenTextLength + 1);
+  safeFree((char *)entry, sizeof (*entry));
+}
+
+static bool lookUpVerification(JwtVerificationCache *cache, const char *tokenText, bool ebcdic, int *rc) {
+  bool found = false;
+  if (cache == NULL) {
+    return false;
+  }
+  int64_t now = currentUnixTime();
+  verificationCacheLock(cache);
+  JwtVerification *entry = htGet(cache->entries, (void *)tokenText);
+  if (entry != NULL && entry->expiresAt <= now) {
+    removeVerification(cache, entry);
+    entry = NULL;
+  }
+  if (entry != NULL && entry->ebcdic == ebcdic) {
+    *rc = entry->rc;
+    found = true;
+  }
+  verificationCacheUnlock(cache);
+  return found;
+}
+
+static void rememberVerification(JwtVerificationCache *cache, const char *tokenText, bool ebcdic, int rc,
+                                 int64 expirationTime) {
+  if (cache == NULL || rc != RC_JWT_OK) {
+    return;
+  }
+  int64_t now = currentUnixTime();
+  int64 expiresAt = now + cache->ttlSeconds;
+  if (expirationTime > 0 && expirationTime < expiresAt) {
+    expiresAt = expirationTime;
+  }
+  if (expiresAt <= now) {
+    return;
+  }
+  JwtVerification *entry = (void *)safeMalloc(sizeof (*entry), "JwtVerification");
+  if (entry == NULL) {
+    return;
+  }
+  memset(entry, 0, sizeof (*entry));
+  entry->tokenTextLength = strlen(tokenText);
+  entry->tokenText = safeMalloc(entry->tokenTextLength + 1, "JwtVerification token");
+  if (entry->tokenText == NULL) {
+    safeFree((char *)entry, sizeof (*entry));
+    return;
+  }
+  memcpy(entry->tokenText, tokenText, entry->tokenTextLength + 1);
+  entry->ebcdic = ebcdic;
+  entry->rc = rc;
+  entry->expiresAt = expiresAt;
+
+  verificationCacheLock(cache);
+  JwtVerification *existing = htGet(cache->entries, entry->tokenText);
+  if (existing != NULL) {
+    removeVerification(cache, existing);
+  }
+  while (cache->oldest != NULL && cache->count >= cache->maxEntries) {
+    removeVerification(cache, cache->oldest);
+  }
+  htPut(cache->entries, entry->tokenText, entry);
+  entry->older = cache->newest;
+  if (cache->newest) {
+    cache->newest->newer = entry;
+  } else {
+    cache->oldest = entry;
+  }
+  cache->newest = entry;
+  cache->count++;
+  verificationCacheUnlock(cache);
+}
+
+static void freeVerificationCache(JwtVerificationCache *cache) {
+  while (cache->oldest != NULL) {
+    removeVerification(cache, cache->oldest);
+  }
+  htDestroy(cache->entries);
+  safeFree((char *)cache, sizeof (*cache));
+}
+
+void jwtContextSetVerificationCache(JwtContext *self, int maxEntries, int ttlSeconds) {
+#ifndef METTLE
+  JwtVerificationCache *cache = self->verificationCache;
+  if (maxEntries <= 0 || ttlSeconds <= 0) {
+    /* the context may be in use, so an existing cache is emptied rather than freed */
+    if (cache != NULL) {
+      verificationCacheLock(cache);
+      cache->maxEntries = 0;
+      cache->ttlSeconds = 0;
+      while (cache->oldest != NULL) {
+        removeVerification(cache, cache->oldest);
+      }
+      verificationCacheUnlock(cache);
+    }
+    return;
+  }
+  if (cache == NULL) {
+    cache = (void *)safeMalloc(sizeof (*cache), "JwtVerificationCache");
+    if (cache == NULL) {
+      return;
+    }
+    memset(cache, 0, sizeof (*cache));
+    mutexCreate(cache->lock);
+    cache->entries = htCreate(257, stringHash, stringCompare, NULL, NULL);
+    cache->maxEntries = maxEntries;
+    cache->ttlSeconds = ttlSeconds;
+    self->verificationCache = cache;
+    return;
+  }
+  verificationCacheLock(cache);
+  cache->maxEntries = maxEntries;
+  cache->ttlSeconds = ttlSeconds;
+  while (cache->oldest != NULL && cache->count > cache->maxEntries) {
+    removeVerification(cache, cache->oldest);
+  }
+  verificationCacheUnlock(cache);
+#endif /* METTLE */
+}
+
 int jwtParse(const char *base64Text, bool ebcdic, const JwtContext *self,
              ShortLivedHeap *slh, Jwt **out) {
   char *base64TextCopy, *decodedText;
   char *decodedParts[MAX_NPARTS] = { NULL };
   int pLen[MAX_NPARTS] = { 0 };
   const int base64Len = strlen(base64Text);
-  const int bufSize = base64Len + BASE64URL_EXTRA_BYTES_TOTAL + 1;
+  const int bufSize = base64Len + MAX_NPARTS + 1;
   int rc = RC_JWT_OK;
   int nparts;
   Jwt *j;
@@ -518,6 +681,11 @@ int jwtParse(const char *base64Text, bool ebcdic, const JwtContext *self,
    * `nparts < 3`: we just won't verify the signature, so everything except the
    * header will be ignored
    */
+  if (lookUpVerification(self->verificationCache, base64Text, ebcdic, &rc)) {
+    zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "signature checked out before\n");
+    *out = j;
+    goto exit;
+  }
   zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "calling checkSignature()...\n");
   if (self->type == JWT_CONTEXT_TYPE_PKCS11) {
     ICSFP11_HANDLE_T *keyHandle = self->keyHandle;
@@ -530,6 +698,7 @@ int jwtParse(const char *base64Text, bool ebcdic, const JwtContext *self,
     rc = RC_JWT_UNKNOWN_CONTEXT_TYPE;
   }
   zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "checkSignature() rc %d...\n", rc);
+  rememberVerification(self->verificationCache, base64Text, ebcdic, rc, j->expirationTime);
   if (rc != RC_JWT_OK && rc != RC_JWT_INSECURE) {
     goto exit;
   }
@@ -820,16 +989,14 @@ int jwtEncode(const Jwt *jwt, bool ebcdic,
 
   int partsLen;
   int base64Size;
-  encodeBase64NoAlloc(jbufHead->data, jbufHead->len, result, &base64Size,
-                      BASE64_IS_EBCDIC);
-  zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "base64 header: %s[%u]\n", result, base64Size);
-  partsLen = base64ToBase64url(result);
+  encodeBase64urlNoAlloc(jbufHead->data, jbufHead->len, result, &base64Size,
+                         BASE64_IS_EBCDIC);
+  partsLen = base64Size;
   zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "base64url header: %s[%u]\n", result, partsLen);
   result[partsLen++] = '.';
-  encodeBase64NoAlloc(jbufClaims->data, jbufClaims->len, &result[partsLen],
-                      &base64Size, BASE64_IS_EBCDIC);
-  zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "base64 claims: %s[%u]\n", &result[partsLen], base64Size);
-  partsLen += base64ToBase64url(&result[partsLen]);
+  encodeBase64urlNoAlloc(jbufClaims->data, jbufClaims->len, &result[partsLen],
+                         &base64Size, BASE64_IS_EBCDIC);
+  partsLen += base64Size;
   zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "base64url header + claims: %.*s[%d]\n", partsLen, result, partsLen);
 
   if (jwt->header.algorithm != JWS_ALGORITHM_none) {
@@ -867,9 +1034,9 @@ asciiBase64_freed:
     if (signRc == RC_JWT_OK) {
       zowelog(NULL, LOG_COMP_JWT, ZOWE_LOG_DEBUG, "signatureLength %d\n", signatureLength);
       result[partsLen++] = '.';
-      encodeBase64NoAlloc(signatureBuf, signatureLength, &result[partsLen],
+      encodeBase64urlNoAlloc(signatureBuf, signatureLength, &result[partsLen],
             &base64Size, BASE64_IS_EBCDIC);
-      partsLen += base64ToBase64url(&result[partsLen]);
+      partsLen += base64Size;
     }
     safeFree(signatureBuf, JWT_MAX_SIGNATURE_SIZE);
 signatureBuf_freed:
@@ -1007,6 +1174,9 @@ char *jwtEncodeToken(const JwtContext *self,
 }
 
 void jwtContextDestroy(JwtContext *self) {
+  if (self->verificationCache != NULL) {
+    freeVerificationCache(self->verificationCache);
+  }
   if (self->tokenHandle != NULL) {
     safeFree((void *)self->tokenHandle, sizeof (*self->tokenHandle));
   }
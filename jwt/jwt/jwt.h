@@ -151,6 +151,17 @@ char *jwtEncodeToken(const JwtContext *self,
                      int *encodedSize,
                      int *rc);
 
+/*
+ * Remembers tokens whose signature checked out, so a token that comes back within ttlSeconds
+ * (and before its exp) is not verified again.  Failed checks are never remembered.  Claims are
+ * still parsed every time.  Off by default, maxEntries of 0 turns it off again.  Not available
+ * under METTLE, where it does nothing.
+ */
+#define JWT_VERIFICATION_CACHE_DEFAULT_MAX_ENTRIES 1024
+#define JWT_VERIFICATION_CACHE_DEFAULT_TTL_SECONDS 300
+
+void jwtContextSetVerificationCache(JwtContext *self, int maxEntries, int ttlSeconds);
+
 void jwtContextDestroy(JwtContext *self);
 
 #endif /* H_JWT_H_ */
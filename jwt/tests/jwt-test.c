@@ -236,6 +236,61 @@ static void shouldRejectInvalidHS256(void) {
   SLHFree(slh);
 }
 
+typedef struct SignatureCounter_tag {
+  int calls;
+  int rc;
+} SignatureCounter;
+
+static int countSignatureCheck(JwsAlgorithm algorithm,
+                               int sigLen, const uint8_t *signature,
+                               int msgLen, const uint8_t *message,
+                               void *userData) {
+  SignatureCounter *counter = userData;
+  counter->calls++;
+  return counter->rc;
+}
+
+static void shouldCacheOnlyVerifiedSignatures(void) {
+
+  printf("\n *** should cache only verified signatures\n");
+
+  static const char JWT_ALG_HS256[] = "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9"
+      ".eyJzdWIiOiIxMjM0NTY3ODkwIiwibmFtZSI6IkpvaG4gRG9lIiwiaWF0IjoxNTE2MjM5MDIyfQ"
+      ".iz6BHMT2SmuJCTvPFj9A1ZIrBqzk6TL3ff2Js1HIVDg";
+  static const char JWT_ALG_HS256_BAD[] = "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9"
+      ".eyJzdWIiOiIxMjM0NTY3ODkwIiwibmFtZSI6IkpvaG4gRG9lIiwiaWF0IjoxNTE2MjM5MDIyfQ"
+      ".iz6CHMT2SmuJCTvPFj9A1ZIrBqzk6TL3ff2Js1HIVDg";
+  SignatureCounter counter = {0};
+  int makeRc = 0;
+  ShortLivedHeap *const slh = makeShortLivedHeap(8192, 1024);
+  JwtContext *const ctx = makeJwtContextCustom(countSignatureCheck, &counter, &makeRc);
+  assert(makeRc == 0);
+  jwtContextSetVerificationCache(ctx, 16, 60);
+
+  int parseRc;
+  counter.rc = RC_JWT_OK;
+  Jwt *j = jwtVerifyAndParseToken(ctx, JWT_ALG_HS256, true, slh, &parseRc);
+  assert(parseRc == 0 && j != NULL);
+  j = jwtVerifyAndParseToken(ctx, JWT_ALG_HS256, true, slh, &parseRc);
+  assert(parseRc == 0 && j != NULL);
+  printf("good token checked %d time(s)\n", counter.calls);
+  assert(counter.calls == 1);
+  assert(strcmp(j->subject, "1234567890") == 0);
+
+  counter.calls = 0;
+  counter.rc = RC_JWT_SIG_MISMATCH;
+  jwtVerifyAndParseToken(ctx, JWT_ALG_HS256_BAD, true, slh, &parseRc);
+  assert(parseRc == RC_JWT_SIG_MISMATCH);
+  jwtVerifyAndParseToken(ctx, JWT_ALG_HS256_BAD, true, slh, &parseRc);
+  assert(parseRc == RC_JWT_SIG_MISMATCH);
+  printf("bad token checked %d time(s)\n", counter.calls);
+  assert(counter.calls == 2);
+
+  jwtContextDestroy(ctx);
+
+  SLHFree(slh);
+}
+
 static void shouldVerifyHS384(void) {
 
   printf("\n *** should verify HS384\n");
@@ -810,6 +865,7 @@ int main(int argc, char **argv) {
   shouldRejectInvalidHS512();
   shouldVerifyRS256();
   shouldRejectInvalidRS256();
+  shouldCacheOnlyVerifiedSignatures();
 
   shouldEncodeASimpleJWT();
 
@@ -4,6 +4,7 @@ TEST_SRC := $(MAINFRAME_C)/c/alloc.c $(MAINFRAME_C)/c/zos.c \
             $(MAINFRAME_C)/c/utils.c $(MAINFRAME_C)/c/json.c \
             $(MAINFRAME_C)/c/charsets.c $(MAINFRAME_C)/c/timeutls.c \
             $(MAINFRAME_C)/c/xlate.c $(MAINFRAME_C)/c/zosfile.c \
+            $(MAINFRAME_C)/c/collections.c \
             tests/jwt-test.c
 
 TEST_OBJ := $(TEST_SRC:.c=.o)
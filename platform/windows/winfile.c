@@ -140,6 +140,21 @@ int fileWrite(UnixFile *file, const char *buffer, int desiredBytes,
   return (int)bytesWritten;
 }
 
+int fileSeek(UnixFile *file, int64 offset, int whence,
+             int *returnCode, int *reasonCode){
+  FILE *internalFile = file->internalFile;
+
+  if (_fseeki64(internalFile,offset,whence) != 0){
+    *returnCode = errno;
+    *reasonCode = errno;
+    return -1;
+  }
+  *returnCode = 0;
+  *reasonCode = 0;
+  file->eofKnown = FALSE;
+  return 0;
+}
+
 int fileGetChar(UnixFile *file, int *returnCode, int *reasonCode){
   if (file->bufferSize == 0){
     *returnCode = 8;
@@ -224,6 +239,11 @@ int fileInfoUnixModificationTime(const FileInfo *info){
   return info->st_mtime;
 }
 
+int fileInfoUnixStatusChangeTime(const FileInfo *info){
+  /* st_ctime is the creation time on Windows, a rewrite only shows in st_mtime */
+  return info->st_ctime;
+}
+
 int fileUnixMode(const FileInfo *info) {
   return info->st_mode;
 }
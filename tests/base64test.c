@@ -0,0 +1,108 @@
+/*
+  This program and the accompanying materials are
+  made available under the terms of the Eclipse Public License v2.0 which accompanies
+  this distribution, and is available at https://www.eclipse.org/legal/epl-v20.html
+
+  SPDX-License-Identifier: EPL-2.0
+
+  Copyright Contributors to the Zowe Project.
+*/
+
+/*
+  Checks that base64 and base64url from utils.c decode what they encode, for every length that
+  ends a quantum each way, and that each alphabet gives the characters RFC 4648 says it should.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zowetypes.h"
+#include "alloc.h"
+#include "utils.h"
+
+#include "testcheck.h"
+
+#ifdef __ZOWE_EBCDIC
+#define NATIVE_IS_EBCDIC TRUE
+#else
+#define NATIVE_IS_EBCDIC FALSE
+#endif
+
+#define MAX_TEST_LENGTH 64
+
+typedef char *Encoder(ShortLivedHeap *slh, const char buf[], int size, int *resultSize,
+                      int useEbcdic);
+typedef int Decoder(char *s, char *result, int len);
+
+/* encodes data and returns whether it decodes back, *encoded keeps a copy of the text */
+static bool roundTrips(Encoder *encode, Decoder *decode, char *data, int length, char *encoded){
+  char decoded[MAX_TEST_LENGTH + 1];
+  int encodedLength = 0;
+  char *text = encode(NULL, data, length, &encodedLength, NATIVE_IS_EBCDIC);
+  if (text == NULL){
+    return false;
+  }
+  memcpy(encoded, text, encodedLength);
+  encoded[encodedLength] = 0;
+  safeFree31(text, BASE64_ENCODE_SIZE(length)+1);
+  int decodedLength = decode(encoded, decoded, encodedLength);
+  return decodedLength == length && !memcmp(decoded, data, length);
+}
+
+static void checkRoundTrips(Encoder *encode, Decoder *decode, char *excluded, char *what){
+  char data[MAX_TEST_LENGTH];
+  char encoded[BASE64_ENCODE_SIZE(MAX_TEST_LENGTH) + 1];
+  int mismatches = 0;
+  int strays = 0;
+  for (int length = 0; length <= MAX_TEST_LENGTH; length++){
+    for (int i = 0; i < length; i++){
+      data[i] = (char)(0xFF - 37*i - length);
+    }
+    if (!roundTrips(encode, decode, data, length, encoded)){
+      mismatches++;
+    } else if (strpbrk(encoded, excluded) != NULL){
+      strays++;
+    }
+  }
+  char text[128];
+  snprintf(text, sizeof(text), "%s (%d differ, %d with \"%s\")", what, mismatches, strays, excluded);
+  check(mismatches == 0 && strays == 0, text);
+}
+
+static bool encodesAs(Encoder *encode, char *data, int length, char *expected){
+  int encodedLength = 0;
+  char *text = encode(NULL, data, length, &encodedLength, NATIVE_IS_EBCDIC);
+  if (text == NULL){
+    return false;
+  }
+  bool same = (encodedLength == strlen(expected) && !memcmp(text, expected, encodedLength));
+  safeFree31(text, BASE64_ENCODE_SIZE(length)+1);
+  return same;
+}
+
+static bool decodesAs(Decoder *decode, char *text, char *expected, int expectedLength){
+  char decoded[MAX_TEST_LENGTH + 1];
+  int decodedLength = decode(text, decoded, strlen(text));
+  return decodedLength == expectedLength && !memcmp(decoded, expected, expectedLength);
+}
+
+int main(int argc, char **argv){
+  /* the last two characters of each alphabet, 62 and 63 */
+  char high[3] = { (char)0xFB, (char)0xFF, (char)0xBF };
+
+  checkRoundTrips(encodeBase64, decodeBase64Unterminated, "-_", "base64 round trips");
+  check(encodesAs(encodeBase64, high, 3, "+/+/"), "base64 uses + and /");
+  check(encodesAs(encodeBase64, "f", 1, "Zg=="), "base64 is padded");
+  check(decodesAs(decodeBase64Unterminated, "+/+/", high, 3), "base64 decodes + and /");
+
+  checkRoundTrips(encodeBase64url, decodeBase64urlUnterminated, "+/=", "base64url round trips");
+  check(encodesAs(encodeBase64url, high, 3, "-_-_"), "base64url uses - and _");
+  check(encodesAs(encodeBase64url, "f", 1, "Zg"), "base64url is not padded");
+  check(decodesAs(decodeBase64urlUnterminated, "-_-_", high, 3), "base64url decodes - and _");
+  check(decodesAs(decodeBase64urlUnterminated, "Zg==", "f", 1), "base64url accepts padding");
+  char decoded[4];
+  check(decodeBase64urlUnterminated("+/+/", decoded, 4) < 0, "base64url refuses + and /");
+
+  return checkResult();
+}
@@ -0,0 +1,114 @@
+/*
+  This program and the accompanying materials are
+  made available under the terms of the Eclipse Public License v2.0 which accompanies
+  this distribution, and is available at https://www.eclipse.org/legal/epl-v20.html
+
+  SPDX-License-Identifier: EPL-2.0
+
+  Copyright Contributors to the Zowe Project.
+*/
+
+/*
+  Checks when the static file cache of httpserver.c trusts what it remembers about a file,
+  in particular that a rewrite of the same size in the same second is never answered with the
+  content that was there before.  Takes a few seconds, for files to settle.  The optional
+  argument is the directory to write the test file in, /tmp by default.
+ */
+
+#include <unistd.h>
+#include <utime.h>
+
+#include "../c/httpserver.c"
+
+#include "testcheck.h"
+
+static void writeTestFile(char *path, char *text){
+  FILE *out = fopen(path, "w");
+  fwrite(text, 1, strlen(text), out);
+  fclose(out);
+}
+
+static int statTestFile(char *path, FileInfo *info){
+  int returnCode = 0;
+  int reasonCode = 0;
+  return fileInfo(path, info, &returnCode, &reasonCode);
+}
+
+/* loads the content the way a raw send does, returns whether it is now cached */
+static bool loadTestFile(HttpFileCache *cache, char *path, FileInfo *info, int autocvt){
+  int returnCode = 0;
+  int reasonCode = 0;
+  UnixFile *in = fileOpen(path, FILE_OPTION_READ_ONLY, 0, 0, &returnCode, &reasonCode);
+  if (in == NULL){
+    return false;
+  }
+  HttpFileCacheEntry *entry = fileCacheLoadContent(cache, path, info, autocvt, in);
+  fileClose(in, &returnCode, &reasonCode);
+  if (entry == NULL){
+    return false;
+  }
+  bool cached = entry->linked;
+  fileCacheRelease(cache, entry);
+  return cached;
+}
+
+static bool hasCachedContent(HttpFileCache *cache, char *path, FileInfo *info, int autocvt,
+                             char *expected){
+  HttpFileCacheEntry *entry = fileCacheGetContent(cache, path, info, autocvt);
+  if (entry == NULL){
+    return false;
+  }
+  bool same = (entry->size == strlen(expected) && !memcmp(entry->content, expected, entry->size));
+  fileCacheRelease(cache, entry);
+  return same;
+}
+
+int main(int argc, char **argv){
+  LoggingContext *loggingContext = makeLoggingContext();
+  logConfigureStandardDestinations(loggingContext);
+
+  char *directory = (argc > 1) ? argv[1] : "/tmp";
+  char path[512];
+  snprintf(path, sizeof(path), "%s/filecachetest.%d.bin", directory, (int)getpid());
+
+  HttpFileCache *cache = makeHttpFileCache(16, 1024, 4096);
+  FileInfo info;
+
+  /* a file written just now is sent, but not kept */
+  writeTestFile(path, "aaaa");
+  statTestFile(path, &info);
+  fileCachePutInfo(cache, path, &info, "application/octet-stream", TRUE);
+  check(!loadTestFile(cache, path, &info, FALSE), "fresh file content is not cached");
+
+  /* once the file has settled, its content is kept */
+  sleep(FILE_CACHE_RACY_SECONDS+1);
+  statTestFile(path, &info);
+  fileCachePutInfo(cache, path, &info, "application/octet-stream", TRUE);
+  check(loadTestFile(cache, path, &info, FALSE), "settled file content is cached");
+  check(hasCachedContent(cache, path, &info, FALSE, "aaaa"), "cached content is returned");
+  check(!hasCachedContent(cache, path, &info, TRUE, "aaaa"), "content is keyed by autocvt");
+
+  /* a same-size rewrite that keeps the modification second must not be served from the cache */
+  struct utimbuf settled;
+  settled.actime = fileInfoUnixModificationTime(&info);
+  settled.modtime = fileInfoUnixModificationTime(&info);
+  writeTestFile(path, "bbbb");
+  utime(path, &settled);
+  statTestFile(path, &info);
+  check(fileInfoSize(&info) == 4 && fileInfoUnixModificationTime(&info) == settled.modtime,
+        "rewrite kept the size and modification second");
+  check(!hasCachedContent(cache, path, &info, FALSE, "aaaa"), "old content is not returned");
+  check(cache->count == 0, "stale entry was dropped");
+  fileCachePutInfo(cache, path, &info, "application/octet-stream", TRUE);
+  check(!loadTestFile(cache, path, &info, FALSE), "rewritten content is not cached yet");
+
+  /* MIME type changes drop everything */
+  fileCachePutInfo(cache, path, &info, "application/octet-stream", TRUE);
+  check(cache->count == 1, "entry added");
+  fileCacheClear(cache);
+  check(cache->count == 0 && cache->contentBytes == 0, "clear empties the cache");
+
+  unlink(path);
+  return checkResult();
+}
+
@@ -0,0 +1,95 @@
+/*
+  This program and the accompanying materials are
+  made available under the terms of the Eclipse Public License v2.0 which accompanies
+  this distribution, and is available at https://www.eclipse.org/legal/epl-v20.html
+
+  SPDX-License-Identifier: EPL-2.0
+
+  Copyright Contributors to the Zowe Project.
+*/
+
+/*
+  Checks the component rate limits of logging.c: how many records a bucket and sampling let
+  through, that the suppressed count is reported without another record coming along, and that
+  a limit stays with its component when the component table grows.  Takes about 15 seconds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "zowetypes.h"
+#include "alloc.h"
+#include "utils.h"
+#include "logging.h"
+
+#include "testcheck.h"
+
+#define TEST_DESTINATION  0x008F0010
+#define TEST_COMPONENT    (LOG_PROD_ZSS | 0x00010000)
+#define TEST_FAR_SIBLING  (LOG_PROD_ZSS | 0x00C80000)   /* past the first table of components */
+#define TEST_UNCONFIGURED (LOG_PROD_ZSS | 0x00020000)
+
+#define REPORT_SECONDS 10   /* LOG_RATE_REPORT_SECONDS in logging.c */
+
+typedef struct Capture_tag{
+  int records;
+  int summaries;
+  char lastSummary[256];
+} Capture;
+
+static void captureRecord(LoggingContext *context, LoggingComponent *component, void *data,
+                          char *formatString, va_list argList){
+  Capture *capture = (Capture *)data;
+  char text[256];
+  vsnprintf(text, sizeof(text), formatString, argList);
+  if (strstr(text, "suppressed") != NULL){
+    capture->summaries++;
+    snprintf(capture->lastSummary, sizeof(capture->lastSummary), "%s", text);
+  } else{
+    capture->records++;
+  }
+}
+
+static int logRecords(LoggingContext *context, Capture *capture, int count){
+  capture->records = 0;
+  for (int i = 0; i < count; i++){
+    zowelog(context, TEST_COMPONENT, ZOWE_LOG_INFO, "record %d\n", i);
+  }
+  return capture->records;
+}
+
+int main(int argc, char **argv){
+  LoggingContext *context = makeLoggingContext();
+  logConfigureStandardDestinations(context);
+
+  Capture capture;
+  memset(&capture, 0, sizeof(Capture));
+  logConfigureDestination(context, TEST_DESTINATION, "capture", &capture, captureRecord);
+  logConfigureComponent(context, TEST_COMPONENT, "ratetest", TEST_DESTINATION, ZOWE_LOG_INFO);
+
+  check(logSetComponentRateLimit(context, TEST_UNCONFIGURED, 1, 1, 0) == RC_LOG_ERROR,
+        "unconfigured component refused");
+
+  check(logSetComponentRateLimit(context, TEST_COMPONENT, 1, 3, 0) == RC_LOG_OK, "limit set");
+  check(logRecords(context, &capture, 10) == 3, "a burst of 3 passes");
+  check(capture.summaries == 0, "no summary before the report interval");
+
+  sleep(REPORT_SECONDS + 2);
+  check(capture.summaries == 1, "summary reported without another record");
+  check(strstr(capture.lastSummary, "suppressed 7 messages") != NULL, "summary counts the suppressed");
+
+  /* the bucket has filled again; growing the table moves the component */
+  logConfigureComponent(context, TEST_FAR_SIBLING, "farsibling", TEST_DESTINATION, ZOWE_LOG_INFO);
+  check(logRecords(context, &capture, 10) == 3, "limit follows the component into a grown table");
+
+  check(logSetComponentRateLimit(context, TEST_COMPONENT, 0, 0, 4) == RC_LOG_OK, "sampling set");
+  check(logRecords(context, &capture, 8) == 2, "one in 4 sampled");
+
+  check(logSetComponentRateLimit(context, TEST_COMPONENT, 0, 0, 0) == RC_LOG_OK, "limit removed");
+  check(logRecords(context, &capture, 5) == 5, "everything passes without a limit");
+
+  return checkResult();
+}
@@ -0,0 +1,166 @@
+/*
+  This program and the accompanying materials are
+  made available under the terms of the Eclipse Public License v2.0 which accompanies
+  this distribution, and is available at https://www.eclipse.org/legal/epl-v20.html
+
+  SPDX-License-Identifier: EPL-2.0
+
+  Copyright Contributors to the Zowe Project.
+*/
+
+/*
+  Checks the single-byte conversion tables of charsets.c against iconv, character by character
+  and over whole buffers, for CCSID pairs of each kind of table.
+ */
+
+#include "../c/charsets.c"
+
+#include "testcheck.h"
+
+typedef struct Conversion_tag{
+  int failed;
+  int length;
+  unsigned char output[32768];
+} Conversion;
+
+static void convertWithTable(SingleByteTable *table, unsigned char *input, int inputLength,
+                             Conversion *conversion){
+  char *in = (char*)input;
+  size_t inSize = inputLength;
+  char *out = (char*)conversion->output;
+  size_t outSize = sizeof(conversion->output);
+  conversion->failed = (singleByteConvert(table,&in,&inSize,&out,&outSize) == (size_t)-1) || (inSize != 0);
+  conversion->length = (int)(sizeof(conversion->output) - outSize);
+}
+
+static void convertWithIconv(iconv_t converter, unsigned char *input, int inputLength,
+                             Conversion *conversion){
+  char *in = (char*)input;
+  size_t inSize = inputLength;
+  char *out = (char*)conversion->output;
+  size_t outSize = sizeof(conversion->output);
+  iconv(converter,NULL,NULL,NULL,NULL);
+  conversion->failed = (iconv(converter,&in,&inSize,&out,&outSize) == (size_t)-1) || (inSize != 0);
+  conversion->length = (int)(sizeof(conversion->output) - outSize);
+}
+
+static int sameConversion(Conversion *a, Conversion *b){
+  if (a->failed || b->failed){
+    return a->failed && b->failed;
+  }
+  return (a->length == b->length) && !memcmp(a->output,b->output,a->length);
+}
+
+/*
+  Every input character on its own, then all the characters that convert in one buffer, then
+  the ASCII ones, which the tables translate in runs, and then each of the others amid ASCII at
+  every offset of a run.
+ */
+static void checkPair(int inputCCSID, int outputCCSID){
+  char what[128];
+  SingleByteTable *table = getSingleByteTable(inputCCSID,outputCCSID);
+  iconv_t converter = openConverter(getCharsetName(outputCCSID),getCharsetName(inputCCSID));
+  snprintf(what,sizeof(what),"%d to %d has a table and an iconv converter",inputCCSID,outputCCSID);
+  check((table != NULL) && (converter != (iconv_t)-1),what);
+  if ((table == NULL) || (converter == (iconv_t)-1)){
+    return;
+  }
+
+  /* the characters: bytes of a single-byte input, the code points of the output charset in UTF-8 */
+  unsigned char characters[256][4];
+  int characterLengths[256];
+  unsigned short characterCodePoints[256];
+  int characterCount = 0;
+  unsigned short codePoints[256];
+  if (inputCCSID != CCSID_UTF_8){
+    loadCodePoints(inputCCSID,codePoints);
+    for (int b = 0; b < 256; b++){
+      characters[characterCount][0] = (unsigned char)b;
+      characterCodePoints[characterCount] = codePoints[b];
+      characterLengths[characterCount++] = 1;
+    }
+  } else {
+    loadCodePoints(outputCCSID,codePoints);
+    for (int b = 0; b < 256; b++){
+      if (codePoints[b] != SBCS_UNMAPPED){
+        characterLengths[characterCount] = encodeUtf8(codePoints[b],characters[characterCount]);
+        characterCodePoints[characterCount] = codePoints[b];
+        characterCount++;
+      }
+    }
+  }
+
+  Conversion byTable;
+  Conversion byIconv;
+  int mismatches = 0;
+  unsigned char whole[1024];
+  int wholeLength = 0;
+  unsigned char ascii[1024];
+  int asciiLength = 0;
+  for (int i = 0; i < characterCount; i++){
+    convertWithTable(table,characters[i],characterLengths[i],&byTable);
+    convertWithIconv(converter,characters[i],characterLengths[i],&byIconv);
+    if (!sameConversion(&byTable,&byIconv)){
+      mismatches++;
+    } else if (!byTable.failed){
+      memcpy(whole+wholeLength,characters[i],characterLengths[i]);
+      wholeLength += characterLengths[i];
+      if (characterCodePoints[i] < 0x80){
+        ascii[asciiLength++] = characters[i][0];
+      }
+    }
+  }
+  snprintf(what,sizeof(what),"%d to %d, each character as iconv (%d differ)",inputCCSID,outputCCSID,mismatches);
+  check(mismatches == 0,what);
+
+  convertWithTable(table,whole,wholeLength,&byTable);
+  convertWithIconv(converter,whole,wholeLength,&byIconv);
+  snprintf(what,sizeof(what),"%d to %d, all characters in one buffer as iconv",inputCCSID,outputCCSID);
+  check(!byTable.failed && sameConversion(&byTable,&byIconv),what);
+
+  convertWithTable(table,ascii,asciiLength,&byTable);
+  convertWithIconv(converter,ascii,asciiLength,&byIconv);
+  snprintf(what,sizeof(what),"%d to %d, %d ASCII characters in one buffer as iconv",
+           inputCCSID,outputCCSID,asciiLength);
+  check(!byTable.failed && sameConversion(&byTable,&byIconv),what);
+
+  static unsigned char mixed[16384];
+  int mixedLength = 0;
+  for (int i = 0; (i < characterCount) && (asciiLength >= 16); i++){
+    convertWithTable(table,characters[i],characterLengths[i],&byTable);
+    if (byTable.failed || (characterCodePoints[i] < 0x80)){
+      continue;
+    }
+    int offset = i % 8;
+    memcpy(mixed+mixedLength,ascii,offset);
+    mixedLength += offset;
+    memcpy(mixed+mixedLength,characters[i],characterLengths[i]);
+    mixedLength += characterLengths[i];
+    memcpy(mixed+mixedLength,ascii+offset,16-offset);
+    mixedLength += 16-offset;
+  }
+  convertWithTable(table,mixed,mixedLength,&byTable);
+  convertWithIconv(converter,mixed,mixedLength,&byIconv);
+  snprintf(what,sizeof(what),"%d to %d, other characters amid ASCII as iconv",inputCCSID,outputCCSID);
+  check(!byTable.failed && sameConversion(&byTable,&byIconv),what);
+
+  iconv_close(converter);
+}
+
+int main(int argc, char **argv){
+  /* single-byte to UTF-8 */
+  checkPair(CCSID_IBM1047,CCSID_UTF_8);
+  checkPair(CCSID_ISO_8859_1,CCSID_UTF_8);
+  checkPair(37,CCSID_UTF_8);
+  checkPair(1140,CCSID_UTF_8);
+  /* UTF-8 to single-byte */
+  checkPair(CCSID_UTF_8,CCSID_IBM1047);
+  checkPair(CCSID_UTF_8,CCSID_ISO_8859_1);
+  checkPair(CCSID_UTF_8,1140);
+  /* single-byte to single-byte */
+  checkPair(CCSID_IBM1047,CCSID_ISO_8859_1);
+  checkPair(CCSID_ISO_8859_1,CCSID_IBM1047);
+  checkPair(37,1140);
+
+  return checkResult();
+}
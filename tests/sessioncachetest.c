@@ -0,0 +1,89 @@
+/*
+  This program and the accompanying materials are
+  made available under the terms of the Eclipse Public License v2.0 which accompanies
+  this distribution, and is available at https://www.eclipse.org/legal/epl-v20.html
+
+  SPDX-License-Identifier: EPL-2.0
+
+  Copyright Contributors to the Zowe Project.
+*/
+
+/*
+  Checks the session token cache of httpserver.c: what it keys on, how long it trusts an entry,
+  and that a logged out session stays rejected.  Takes a couple of seconds, for a revocation to
+  expire.
+ */
+
+#include <unistd.h>
+
+#include "../c/httpserver.c"
+
+#include "testcheck.h"
+
+static bool isCached(HttpServer *server, ShortLivedHeap *slh, char *tokenText, uint64 *checkedAt){
+  char *username = NULL;
+  uint64 issuedAt = 0;
+  uint64 sessionStart = 0;
+  uint64 serverInstanceUID = 0;
+  int validitySec = 0;
+  return sessionCacheGet(server, tokenText, slh, &username, &issuedAt, &sessionStart,
+                         &serverInstanceUID, &validitySec, checkedAt);
+}
+
+int main(int argc, char **argv){
+  LoggingContext *loggingContext = makeLoggingContext();
+  logConfigureStandardDestinations(loggingContext);
+  ShortLivedHeap *slh = makeShortLivedHeap(65536, 10);
+
+  HttpServerConfig config;
+  memset(&config, 0, sizeof(HttpServerConfig));
+  HttpServer server;
+  memset(&server, 0, sizeof(HttpServer));
+  server.config = &config;
+  httpServerSetSessionCache(&server, 4, 60);
+  HttpSessionCache *cache = server.sessionCache;
+
+  uint64 now = getFineGrainedTime();
+  uint64 checkedAt = 0;
+
+  /* entries are keyed by digest, the token text itself is not kept */
+  sessionCachePut(&server, "tokenA", "user1", now, now, 1, 3600, now);
+  check(isCached(&server, slh, "tokenA", &checkedAt), "token is cached");
+  check(checkedAt == now, "look-up time is kept");
+  check(htGet(cache->entries, "tokenA") == NULL, "raw token is not a key");
+
+  /* a renewal inherits the look-up time, so the TTL still runs from the first look-up */
+  sessionCachePut(&server, "tokenB", "user1", now, now, 1, 3600, now - 61*ONE_SECOND);
+  check(!isCached(&server, slh, "tokenB", &checkedAt), "renewal past the TTL is not cached");
+  sessionCachePut(&server, "tokenC", "user1", now, now, 1, 3600, 0);
+  check(!isCached(&server, slh, "tokenC", &checkedAt), "unknown session length is not cached");
+
+  /* revocation covers the session, and survives the eviction of every entry */
+  char *sessionKey = makeSessionKey(slh, "user1", now, 1);
+  revokeSession(&server, sessionKey, 3600);
+  for (int i = 0; i < 10; i++){
+    char tokenText[32];
+    snprintf(tokenText, sizeof(tokenText), "filler%d", i);
+    sessionCachePut(&server, tokenText, "user2", now, now, 1, 3600, now);
+  }
+  check(!isCached(&server, slh, "tokenA", &checkedAt), "entry was evicted");
+  check(isSessionRevoked(&server, makeSessionKey(slh, "USER1", now, 1)), "session stays revoked");
+  check(!isSessionRevoked(&server, makeSessionKey(slh, "user1", now + 1, 1)), "other session is not");
+
+  /* revocations go once the session cannot have a valid token left */
+  revokeSession(&server, makeSessionKey(slh, "user3", now, 1), 1);
+  check(isSessionRevoked(&server, makeSessionKey(slh, "user3", now, 1)), "short session revoked");
+  sleep(2);
+  revokeSession(&server, makeSessionKey(slh, "user4", now, 1), 3600);
+  check(!isSessionRevoked(&server, makeSessionKey(slh, "user3", now, 1)), "expired revocation pruned");
+  check(isSessionRevoked(&server, sessionKey), "live revocation kept");
+
+  /* with caching off, revocations still work */
+  httpServerSetSessionCache(&server, 0, 60);
+  check(isSessionRevoked(&server, sessionKey), "revocation kept with caching off");
+  sessionCachePut(&server, "tokenD", "user5", now, now, 1, 3600, now);
+  check(!isCached(&server, slh, "tokenD", &checkedAt), "nothing cached with caching off");
+
+  SLHFree(slh);
+  return checkResult();
+}
@@ -0,0 +1,144 @@
+/*
+  This program and the accompanying materials are
+  made available under the terms of the Eclipse Public License v2.0 which accompanies
+  this distribution, and is available at https://www.eclipse.org/legal/epl-v20.html
+
+  SPDX-License-Identifier: EPL-2.0
+
+  Copyright Contributors to the Zowe Project.
+*/
+
+/*
+  Checks that streamTextForFile sends all of a file when conversion more than doubles a read,
+  and that its base64 output is the encoding of the whole stream, with padding only at the end.
+  The output goes through a Socket that wraps a plain file, so nothing has to read it meanwhile.
+  The optional argument is the directory for the two files, /tmp by default.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "zowetypes.h"
+#include "alloc.h"
+#include "utils.h"
+#include "logging.h"
+#include "bpxnet.h"
+#include "unixfile.h"
+#include "charsets.h"
+#include "http.h"
+#include "httpserver.h"
+
+#include "testcheck.h"
+
+#define CCSID_IBM1140 1140
+#define EURO_1140 0x9F
+#define A_1140    0x81
+#define EURO_UTF8 "\xE2\x82\xAC"
+
+static void writeTestFile(char *path, char *data, int length){
+  FILE *out = fopen(path, "wb");
+  fwrite(data, 1, length, out);
+  fclose(out);
+}
+
+/* streams inPath into outPath and returns what arrived, *length says how much */
+static char *streamTestFile(char *inPath, char *outPath, int sourceCCSID, int targetCCSID,
+                            bool asB64, int *length){
+  int returnCode = 0;
+  int reasonCode = 0;
+  UnixFile *in = fileOpen(inPath, FILE_OPTION_READ_ONLY, 0, 0, &returnCode, &reasonCode);
+  if (in == NULL){
+    return NULL;
+  }
+  Socket socket;
+  memset(&socket, 0, sizeof(Socket));
+  socket.sd = open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  socket.protocol = IPPROTO_TCP;
+  strcpy(socket.debugName, "streamtexttest");
+  streamTextForFile(&socket, in, ENCODING_SIMPLE, sourceCCSID, targetCCSID, asB64);
+  close(socket.sd);
+  fileClose(in, &returnCode, &reasonCode);
+
+  FILE *result = fopen(outPath, "rb");
+  fseek(result, 0, SEEK_END);
+  *length = (int)ftell(result);
+  fseek(result, 0, SEEK_SET);
+  char *data = safeMalloc(*length + 1, "streamtexttest");
+  *length = (int)fread(data, 1, *length, result);
+  fclose(result);
+  return data;
+}
+
+static bool isBase64Of(char *encoded, int encodedLength, char *expected, int expectedLength){
+  int length = 0;
+  char *reference = encodeBase64(NULL, expected, expectedLength, &length, FALSE);
+  bool same = (length == encodedLength && !memcmp(encoded, reference, length));
+  safeFree31(reference, BASE64_ENCODE_SIZE(expectedLength)+1);
+  return same;
+}
+
+static bool paddedOnlyAtEnd(char *encoded, int encodedLength){
+  char *padding = memchr(encoded, 0x3D, encodedLength);   /* ASCII '=', the output is ASCII */
+  return padding == NULL || padding >= encoded + encodedLength - 2;
+}
+
+int main(int argc, char **argv){
+  LoggingContext *loggingContext = makeLoggingContext();
+  logConfigureStandardDestinations(loggingContext);
+
+  char *directory = (argc > 1) ? argv[1] : "/tmp";
+  char inPath[512];
+  char outPath[512];
+  snprintf(inPath, sizeof(inPath), "%s/streamtexttest.%d.in", directory, (int)getpid());
+  snprintf(outPath, sizeof(outPath), "%s/streamtexttest.%d.out", directory, (int)getpid());
+
+  /* in IBM-1140, 3 bytes of "EUR EUR a" are 7 bytes of UTF-8, past the 2x translation buffer */
+  int repeats = FILE_STREAM_BUFFER_SIZE / 3 + 1000;
+  int sourceLength = 3 * repeats;
+  int expectedLength = 7 * repeats;
+  char *source = safeMalloc(sourceLength, "streamtexttest");
+  char *expected = safeMalloc(expectedLength, "streamtexttest");
+  for (int i = 0; i < repeats; i++){
+    source[3*i] = source[3*i+1] = (char)EURO_1140;
+    source[3*i+2] = (char)A_1140;
+    memcpy(expected + 7*i, EURO_UTF8 EURO_UTF8, 6);
+    expected[7*i+6] = 0x61;
+  }
+  writeTestFile(inPath, source, sourceLength);
+
+  int length = 0;
+  char *result = streamTestFile(inPath, outPath, CCSID_IBM1140, CCSID_UTF_8, FALSE, &length);
+  check(result != NULL && length == expectedLength && !memcmp(result, expected, length),
+        "a read that converts past the buffer is sent whole");
+  if (result){
+    safeFree(result, length + 1);
+  }
+
+  result = streamTestFile(inPath, outPath, CCSID_IBM1140, CCSID_UTF_8, TRUE, &length);
+  check(result != NULL && isBase64Of(result, length, expected, expectedLength),
+        "converted base64 is the encoding of the whole stream");
+  check(result != NULL && paddedOnlyAtEnd(result, length), "converted base64 is padded only at the end");
+  if (result){
+    safeFree(result, length + 1);
+  }
+
+  /* unconverted, a read of FILE_STREAM_BUFFER_SIZE bytes leaves a partial quantum behind */
+  int plainLength = FILE_STREAM_BUFFER_SIZE + 1;
+  writeTestFile(inPath, expected, plainLength);
+  result = streamTestFile(inPath, outPath, CCSID_UTF_8, CCSID_UTF_8, TRUE, &length);
+  check(result != NULL && isBase64Of(result, length, expected, plainLength),
+        "base64 across reads is the encoding of the whole file");
+  check(result != NULL && paddedOnlyAtEnd(result, length), "base64 across reads is padded only at the end");
+  if (result){
+    safeFree(result, length + 1);
+  }
+
+  safeFree(source, sourceLength);
+  safeFree(expected, expectedLength);
+  unlink(inPath);
+  unlink(outPath);
+  return checkResult();
+}
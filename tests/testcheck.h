@@ -0,0 +1,47 @@
+/*
+  This program and the accompanying materials are
+  made available under the terms of the Eclipse Public License v2.0 which accompanies
+  this distribution, and is available at https://www.eclipse.org/legal/epl-v20.html
+
+  SPDX-License-Identifier: EPL-2.0
+
+  Copyright Contributors to the Zowe Project.
+*/
+
+#ifndef __TESTCHECK__
+#define __TESTCHECK__ 1
+
+/*
+  Checks for the unit tests in this directory; "make test_units" builds and runs them all (see
+  UNITTESTS in the Makefile).  Every check prints a line, and main returns checkResult(), which
+  is 8 when any of them failed.  A test of something static to its module includes the module's
+  source rather than linking its object.
+ */
+
+#include <stdio.h>
+
+static int checkFailures = 0;
+
+static void check(int condition, char *what){
+  printf("%s: %s\n", condition ? "ok  " : "FAIL", what);
+  if (!condition){
+    checkFailures++;
+  }
+}
+
+static int checkResult(void){
+  printf("%d failure(s)\n", checkFailures);
+  return checkFailures ? 8 : 0;
+}
+
+#endif
+
+/*
+  This program and the accompanying materials are
+  made available under the terms of the Eclipse Public License v2.0 which accompanies
+  this distribution, and is available at https://www.eclipse.org/legal/epl-v20.html
+
+  SPDX-License-Identifier: EPL-2.0
+
+  Copyright Contributors to the Zowe Project.
+*/
@@ -0,0 +1,127 @@
+/*
+  This program and the accompanying materials are
+  made available under the terms of the Eclipse Public License v2.0 which accompanies
+  this distribution, and is available at https://www.eclipse.org/legal/epl-v20.html
+
+  SPDX-License-Identifier: EPL-2.0
+
+  Copyright Contributors to the Zowe Project.
+*/
+
+/*
+  Checks WebSocket permessage-deflate in httpserver.c: which offers are taken, and that messages
+  compressed frame by frame inflate back to what was sent.  Only builds with USE_ZLIB check
+  anything; the Makefile defines it when given ZLIB.
+ */
+
+#include "../c/httpserver.c"
+
+#include "testcheck.h"
+
+#ifdef USE_ZLIB
+
+static bool agrees(ShortLivedHeap *slh, char *offers, char *expected){
+  char *agreed = NULL;
+  WSDeflate *state = negotiateWSDeflate(slh, offers, 6, &agreed);
+  if (state == NULL){
+    return expected == NULL;
+  }
+  freeWSDeflate(state);
+  return expected != NULL && !strcmp(agreed, expected);
+}
+
+/*
+  Sends text through the server side deflater in frames of frameSize, then inflates the frames
+  the way they would arrive on the client side and compares.
+ */
+static bool roundTrips(ShortLivedHeap *slh, WSDeflate *sender, WSDeflate *receiver,
+                       char *text, int frameSize){
+  int length = strlen(text);
+  WSMessage message;
+  memset(&message, 0, sizeof(WSMessage));
+  WSFrame *lastFrame = NULL;
+  int pos = 0;
+  do{
+    int chunk = (length-pos > frameSize) ? frameSize : length-pos;
+    int isLastFrame = (pos+chunk == length);
+    char *compressed = NULL;
+    int compressedLength = 0;
+    if (deflateWSPayload(sender, text+pos, chunk, isLastFrame, &compressed, &compressedLength)){
+      return false;
+    }
+    /* the deflater reuses its buffer, so each frame gets its own copy */
+    char *data = SLHAlloc(slh, compressedLength+1);
+    memcpy(data, compressed, compressedLength);
+    WSFrame *frame = makeFrame((pos == 0 ? WS_RSV1 : 0) | (isLastFrame ? 0x80 : 0), slh,
+                               data, compressedLength);
+    if (lastFrame){
+      lastFrame->next = frame;
+    } else{
+      message.firstFrame = frame;
+    }
+    lastFrame = frame;
+    pos += chunk;
+  } while (pos < length);
+  if (!inflateWSMessage(receiver, &message)){
+    return false;
+  }
+  WSFrame *inflated = message.firstFrame;
+  return (inflated->dataLength == length && !memcmp(inflated->data, text, length) &&
+          !(inflated->opcodeAndFlags & WS_RSV1));
+}
+
+static void checkRoundTrips(ShortLivedHeap *slh, char *offers, char *what){
+  char *agreed = NULL;
+  WSDeflate *sender = negotiateWSDeflate(slh, offers, 6, &agreed);
+  WSDeflate *receiver = negotiateWSDeflate(slh, offers, 6, &agreed);
+  char *repeated = "abcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabc";
+  bool ok = (sender != NULL && receiver != NULL);
+  ok = ok && roundTrips(slh, sender, receiver, "hello", 1024);
+  ok = ok && roundTrips(slh, sender, receiver, "hello", 1024);           /* shares the window */
+  ok = ok && roundTrips(slh, sender, receiver, repeated, 7);             /* unflushed frames */
+  ok = ok && roundTrips(slh, sender, receiver, "", 1024);                /* empty message */
+  ok = ok && roundTrips(slh, sender, receiver, repeated, 1024);
+  if (sender){
+    freeWSDeflate(sender);
+  }
+  if (receiver){
+    freeWSDeflate(receiver);
+  }
+  check(ok, what);
+}
+
+#endif /* USE_ZLIB */
+
+int main(int argc, char **argv){
+  LoggingContext *loggingContext = makeLoggingContext();
+  logConfigureStandardDestinations(loggingContext);
+
+#ifdef USE_ZLIB
+  ShortLivedHeap *slh = makeShortLivedHeap(65536, 100);
+
+  check(agrees(slh, "permessage-deflate", "permessage-deflate"), "plain offer taken");
+  check(agrees(slh, "x-webkit-deflate-frame, permessage-deflate; client_max_window_bits",
+               "permessage-deflate"), "unknown extension skipped, bare client bits not echoed");
+  check(agrees(slh, "permessage-deflate; server_no_context_takeover; client_max_window_bits=10",
+               "permessage-deflate; server_no_context_takeover; client_max_window_bits=10"),
+        "parameters echoed");
+  check(agrees(slh, "permessage-deflate; server_max_window_bits=8, permessage-deflate",
+               "permessage-deflate"), "8 bit server window declined, next offer taken");
+  check(agrees(slh, "permessage-deflate; mystery=1", NULL), "unknown parameter declined");
+  check(agrees(slh, "permessage-deflate; server_no_context_takeover; server_no_context_takeover", NULL),
+        "repeated parameter declined");
+  check(agrees(slh, "x-webkit-deflate-frame", NULL), "nothing acceptable");
+
+  checkRoundTrips(slh, "permessage-deflate", "round trip with context takeover");
+  checkRoundTrips(slh, "permessage-deflate; server_no_context_takeover; client_no_context_takeover",
+                  "round trip without context takeover");
+  checkRoundTrips(slh, "permessage-deflate; server_max_window_bits=9", "round trip with a small window");
+
+  SLHFree(slh);
+#else
+  printf("built without USE_ZLIB, nothing to check\n");
+#endif
+
+  return checkResult();
+}
+